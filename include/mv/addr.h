@@ -25,12 +25,27 @@ typedef enum {
 extern "C" {
 #endif
 
+struct sockaddr_storage;
+
+/* Returns the address for the given string, such as tcp://10.0.0.2:5557.
+   Addresses are interned: the string is parsed the first time only, and 
+   the same address is returned for the same string after that. Returns 0
+   if the string is not a valid address. */
 extern mv_addr_t mv_addr(const char *s);
 extern int mv_addr_delete(mv_addr_t addr);
 
+/* Returns the string the address was created from. */
+extern const char *mv_addr_str(mv_addr_t addr);
+
+/* Copies the socket address the address resolves to into ss. The address
+   is resolved once and cached, unless refresh is set, e.g. after a failed
+   connect. Returns 0 on success and -1 on failure. */
+extern int mv_addr_sockaddr(mv_addr_t addr, struct sockaddr_storage *ss,
+                            unsigned *len, int refresh);
+
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif /* MV_DEVICE_H */
+#endif /* MV_ADDR_H */
@@ -22,9 +22,20 @@ extern "C" {
 /* NOTE: For now, actual device (persistent) namespace can be implemented
    in many different ways: files, device name server, or DHT */
 
-/* Call this at time 0. */
+/* Call this at time 0. Loads the device-address table in the file. */
 extern int mv_device_module_init(const char *file);
 
+/* Loads the device-address table in the file again, while lookups go on. 
+   Devices are added or given their new addresses, and devices no longer 
+   listed can no longer be looked up. The device signed on keeps its 
+   address. */
+extern int mv_device_reload(const char *file);
+
+/* Looks up devices not in the device-address table in the device 
+   directory at host:port (see mv/dir.h) from now on, and registers the 
+   device signed on there. */
+extern int mv_device_dir_connect(const char *server);
+
 extern mv_device_t mv_device_register(const char *name);
 extern int mv_device_deregister(mv_device_t dev);
 
@@ -32,10 +43,26 @@ extern mv_device_t mv_device_signon(const char *name, mv_addr_t addr);
 extern int mv_device_signoff(mv_device_t dev);
 extern mv_device_t mv_device_self();
 
+/* Looks up a device by name, in constant time, and never waits. With a 
+   directory, a device not in the table is not known until the directory 
+   replies: the first lookup asks for it and returns 0. Senders which 
+   cannot wait look their devices up in advance with 
+   mv_device_lookup_batch. */
 extern mv_device_t mv_device_lookup(const char *name);
+
+/* Looks up n devices at once, with a single request to the directory for
+   those not cached, which it waits for for at most a few tens of 
+   milliseconds. Devices not found are set to 0. Returns the number of
+   devices found. */
+extern int mv_device_lookup_batch(const char **names, int n, 
+                                  mv_device_t *devs);
 extern const char *mv_device_name(mv_device_t dev);
 extern mv_addr_t mv_device_addr(mv_device_t dev);
 
+/* Returns the address string of the device with the given name, as used
+   by mv_message_send. Returns NULL if there is no such device. */
+extern const char *mv_device_addrstr(const char *name);
+
 
 #ifdef __cplusplus
 }
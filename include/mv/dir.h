@@ -0,0 +1,33 @@
+/**
+ * @file dir.h
+ *
+ * @brief Protocol of the device directory service, mvdir.
+ *
+ * Devices register their transport addresses with the directory, and look
+ * up the addresses of other devices there, instead of reading them from a
+ * device.dat deployed to every node. Requests and replies are UDP
+ * datagrams of text lines, so a reply may answer many lookups:
+ *
+ *   REG name addr ttl     register, or renew (heartbeat), for ttl seconds
+ *   UNREG name            remove the registration
+ *   GET name ...          look up one or more devices
+ *   WATCH                 keep receiving updates, without a lookup
+ *
+ *   ADDR name addr ttl    the device is at addr, for at most ttl seconds
+ *   NONE name             no such device
+ *
+ * The directory remembers who sent it a datagram recently, and pushes ADDR
+ * or NONE to them whenever a device registers at a new address,
+ * unregisters, or fails to renew its registration in time. Clients cache
+ * replies for their ttl, and send REG or WATCH at least every
+ * MV_DIR_WATCH_SEC seconds to keep receiving pushes.
+ */
+#ifndef MV_DIR_H
+#define MV_DIR_H
+
+#define MV_DIR_PORT          5556   /* default port of mvdir */
+#define MV_DIR_TTL           30     /* default registration ttl in sec */
+#define MV_DIR_WATCH_SEC     60     /* clients silent longer get no pushes */
+#define MV_DIR_MAX_DATAGRAM  1400   /* requests and replies are split to fit */
+
+#endif /* MV_DIR_H */
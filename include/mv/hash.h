@@ -0,0 +1,40 @@
+/**
+ * @file hash.h
+ *
+ * @brief Hashing of names, and the open-addressing tables they are kept in.
+ */
+#ifndef MV_HASH_H
+#define MV_HASH_H
+
+#include <stddef.h>      /* size_t */
+#include <mv/defs.h>     /* mv_uint32_t */
+
+/* Hash of the empty string, to start hashing several strings as one. */
+#define MV_HASH_INIT  2166136261u
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns the FNV-1a hash of the string. */
+extern mv_uint32_t mv_hash_str(const char *s);
+
+/* Returns the hash of the string following what hash was computed from, 
+   so that mv_hash_str_cont(mv_hash_str(a), b) is the hash of a and b 
+   concatenated. */
+extern mv_uint32_t mv_hash_str_cont(mv_uint32_t hash, const char *s);
+
+/* Moves the entries of an open-addressing table of pointers, probed 
+   linearly, into a new table of newsize slots, by the hash hashof gives 
+   for each. Sizes are powers of two. Frees the old table, and returns the
+   new one, or NULL with the old one left as it is if there is no memory. */
+extern void **mv_hash_table_grow(void **table, size_t size, size_t newsize,
+                                 mv_uint32_t (*hashof)(const void *entry));
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MV_HASH_H */
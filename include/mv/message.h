@@ -96,6 +96,12 @@ int mv_message_delete(mv_message_t *m);
    be freed by the callee. Returns 0 on success and -1 on failure. */
 extern int mv_message_send_value(const char *adr, mv_mtag_t t, mv_value_t arg);
 extern int mv_message_send(const char *addr, mv_mtag_t t, char *arg);
+
+/* Sends the same message to n devices. The message is serialized once, 
+   and shared by all the sends. Returns the number of sends queued, or -1
+   on failure. */
+extern int mv_message_send_multi(const char **addrs, int n, mv_mtag_t t, 
+                                 char *arg);
 extern int mv_message_try_send(mv_addr_t addr, mv_message_t m);
 extern int mv_message_timed_send(mv_addr_t addr, mv_message_t m);
 
@@ -32,6 +32,8 @@ typedef enum {
 mv_vtag_t mv_value_tag(mv_value_t value);
 int mv_value_eq(mv_value_t u, mv_value_t v);
 
+/* Frees an integer, a float or a string value, which must not be used
+   after. Other values are left as they are. */
 int mv_value_delete(mv_value_t v);
 int mv_value_print(mv_value_t v);
 
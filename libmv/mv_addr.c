@@ -1,47 +1,203 @@
 /**
  * @file mv_addr.c
  */
+#include <stdio.h>      /* fprintf */
 #include <stdlib.h>     /* free */
 #include <string.h>     /* strdup */
-#include <assert.h>     /* assert */
+#include <pthread.h>    /* pthread_mutex_t */
+#include <sys/types.h>  /* getaddrinfo */
+#include <sys/socket.h> /* struct sockaddr_storage */
+#include <netdb.h>      /* getaddrinfo */
 #include <mv/addr.h>
+#include <mv/hash.h>    /* mv_hash_str */
 
 
 #define _ADDR_TAG(addr) ((addr) & 0x7)
 #define _ADDR_PTR(addr) ((void *) ((addr) & ~((mv_addr_t) 0x7)))
 #define _ADDR_TAGPTR(ptr, tag) ((mv_addr_t) (ptr) | (tag))
 
+/* A parsed address. Addresses are interned: mv_addr returns the same
+   address for the same string, so that a string is parsed only once, and
+   the socket address it resolves to is looked up only once. */
 typedef struct {
-  union {
-    char *ipaddr;
-  } u;
+  char *str;                      /* address string: tcp://host:port */
+  mv_uint32_t hash;               /* hash of str */
+  int transport;                  /* MV_TRANSPORT_IPv4, etc. */
+  char *host;                     /* host part */
+  char *port;                     /* port part: NULL if none */
+
+  int resolved;                   /* ss is valid */
+  struct sockaddr_storage ss;     /* resolved socket address */
+  unsigned sslen;                 /* length of ss */
 } _addr_t;
 
+/* Intern table: open addressing, and only grows. */
+#define _ADDR_TABLE_MIN_SIZE  64
+static _addr_t **_addr_table = NULL;
+static size_t _addr_table_size = 0;
+static size_t _addr_table_count = 0;
+static pthread_mutex_t _addr_lock = PTHREAD_MUTEX_INITIALIZER;
 
-mv_addr_t mv_addr(const char *s)
+static mv_uint32_t _addr_hashof(const void *addr);
+static _addr_t *_addr_parse(const char *s);
+static int _addr_table_grow();
+
+
+mv_uint32_t _addr_hashof(const void *addr)
 {
-  /* ip://192.168.8.14 */
-  if (s[0] == 'i' && s[1] == 'p' && s[2] == ':' && s[3] == '/' &&
-      s[4] == '/') {
-    _addr_t *addr = malloc(sizeof(_addr_t));
-    addr->u.ipaddr = strdup(s+5);
-    return _ADDR_TAGPTR(addr, MV_TRANSPORT_IPv4);
+  return ((const _addr_t *) addr)->hash;
+}
+
+/* Parses tcp://host:port, tcp://[v6host]:port, or ip://host. */
+_addr_t *_addr_parse(const char *s)
+{
+  const char *host;
+  if (!strncmp(s, "tcp://", 6))
+    host = s + 6;
+  else if (!strncmp(s, "ip://", 5))
+    host = s + 5;
+  else {
+    fprintf(stderr, "mv_addr: Unsupported address: %s\n", s);
+    return NULL;
+  }
+
+  const char *port = NULL;
+  size_t hostlen;
+  int transport = MV_TRANSPORT_IPv4;
+  if (host[0] == '[') {
+    const char *end = strchr(host, ']');
+    if (!end) {
+      fprintf(stderr, "mv_addr: Malformed address: %s\n", s);
+      return NULL;
+    }
+    transport = MV_TRANSPORT_IPv6;
+    hostlen = end - (host + 1);
+    host++;
+    if (end[1] == ':')
+      port = end + 2;
   }
   else {
-    assert(0 && "mv_addr: Not implemented yet");
+    const char *colon = strrchr(host, ':');
+    hostlen = colon ? (size_t) (colon - host) : strlen(host);
+    if (colon)
+      port = colon + 1;
+  }
+  if (hostlen == 0 || (port && !*port)) {
+    fprintf(stderr, "mv_addr: Malformed address: %s\n", s);
+    return NULL;
+  }
+
+  _addr_t *addr = calloc(1, sizeof(_addr_t));
+  addr->str = strdup(s);
+  addr->hash = mv_hash_str(s);
+  addr->transport = transport;
+  addr->host = strndup(host, hostlen);
+  addr->port = port ? strdup(port) : NULL;
+
+  return addr;
+}
+
+int _addr_table_grow()
+{
+  size_t size = _addr_table_size ? _addr_table_size * 2 : _ADDR_TABLE_MIN_SIZE;
+  _addr_t **table = (_addr_t **) 
+    mv_hash_table_grow((void **) _addr_table, _addr_table_size, size, 
+                       _addr_hashof);
+  if (!table)
+    return -1;
+
+  _addr_table = table;
+  _addr_table_size = size;
+
+  return 0;
+}
+
+
+/*
+ * Functions for the addr API.
+ */
+mv_addr_t mv_addr(const char *s)
+{
+  mv_uint32_t hash = mv_hash_str(s);
+  mv_addr_t retval = 0;
+
+  pthread_mutex_lock(&_addr_lock);
+  if ((_addr_table_count + 1) * 2 > _addr_table_size
+      && _addr_table_grow() == -1)
+    goto out;
+
+  size_t mask = _addr_table_size - 1;
+  size_t i = hash & mask;
+  _addr_t *addr;
+  while ((addr = _addr_table[i]) != NULL) {
+    if (addr->hash == hash && !strcmp(addr->str, s))
+      break;
+    i = (i + 1) & mask;
+  }
+
+  if (!addr) {
+    if ((addr = _addr_parse(s)) == NULL)
+      goto out;
+    _addr_table[i] = addr;
+    _addr_table_count++;
   }
-  
-  return (mv_addr_t) 0;
+  retval = _ADDR_TAGPTR(addr, addr->transport);
+
+ out:
+  pthread_mutex_unlock(&_addr_lock);
+  return retval;
 }
 
 int mv_addr_delete(mv_addr_t addr)
 {
-  _addr_t *adr = (_addr_t *) _ADDR_PTR(addr);
-  if (adr)
-    free(adr);
+  /* Addresses are interned and shared by all their users, so they live as
+     long as the process. */
+  (void) addr;
 
   return 0;
 }
 
+const char *mv_addr_str(mv_addr_t addr)
+{
+  _addr_t *adr = (_addr_t *) _ADDR_PTR(addr);
+
+  return adr ? adr->str : NULL;
+}
+
+int mv_addr_sockaddr(mv_addr_t addr, struct sockaddr_storage *ss,
+                     unsigned *len, int refresh)
+{
+  _addr_t *adr = (_addr_t *) _ADDR_PTR(addr);
+  if (!adr)
+    return -1;
 
+  int retval = 0;
+  pthread_mutex_lock(&_addr_lock);
+  if (!adr->resolved || refresh) {
+    struct addrinfo hints;
+    struct addrinfo *result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
 
+    int rv;
+    if ((rv = getaddrinfo(adr->host, adr->port, &hints, &result)) != 0) {
+      fprintf(stderr, "mv_addr_sockaddr: %s at %s\n", gai_strerror(rv),
+              adr->str);
+      adr->resolved = 0;
+      retval = -1;
+      goto out;
+    }
+    memcpy(&adr->ss, result->ai_addr, result->ai_addrlen);
+    adr->sslen = result->ai_addrlen;
+    adr->resolved = 1;
+    freeaddrinfo(result);
+  }
+  memcpy(ss, &adr->ss, adr->sslen);
+  *len = adr->sslen;
+
+ out:
+  pthread_mutex_unlock(&_addr_lock);
+  return retval;
+}
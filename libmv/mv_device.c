@@ -5,84 +5,296 @@
 #include <stdlib.h>      /* free, exit */
 #include <string.h>      /* strdup */
 #include <assert.h>      /* assert */
+#include <errno.h>       /* ETIMEDOUT */
+#include <time.h>        /* time */
+#include <pthread.h>     /* pthread_rwlock_t */
 #include <mv/device.h>   /* mv_deviceid_t */
+#include <mv/dir.h>      /* MV_DIR_TTL */
+#include <mv/hash.h>     /* mv_hash_str */
+#include "mv_dirclient.h"
 
 
-#define MAX_DEVICE_TABLE 4096
 typedef struct _device {
   char *name;               /* globally-unique name */
+  mv_uint32_t hash;         /* hash of name */
   mv_addr_t addr;           /* transport addr */
+  time_t expires;           /* directory entry: cached until then */
+  time_t asked;             /* directory entry: last asked for */
 
-  unsigned free     : 1;    /* free or not */
-  unsigned free_idx : 12;   /* index to free list */
-  unsigned free_nxt : 12;   /* index of next free entry */
-  unsigned pad      : 7;
+  unsigned gone     : 1;    /* deregistered, or dropped by a reload */
+  unsigned dynamic  : 1;    /* from the directory, not device.dat */
+  unsigned pad      : 30;
 } _device_t;
-static _device_t _device_table[MAX_DEVICE_TABLE];
-static _device_t *_free_device;
 
-static void _device_table_init();
-static _device_t *_device_get_free();
-static int _device_delete(_device_t *device);
+/* The device directory is an open-addressing hash table of devices, which
+   only grows. Devices are never freed, since callers hold on to them: a
+   deregistered device, or one dropped from device.dat on reload, is only
+   marked gone, and comes back if it is registered or listed again. Lookups
+   take the read lock. Addresses are interned (see mv_addr), so a device's
+   address can be replaced while others are still sending to the old one.
+
+   With a directory connected (mv_device_dir_connect), devices not in
+   device.dat are looked up there, and cached until the ttl of the reply.
+   A device the directory does not know is cached as gone, for as long.
+   A lookup never waits for the directory, since messages are sent from 
+   the reactors: the first lookup of a device asks for it and finds 
+   nothing, and lookups after the reply find it. Only a batch lookup 
+   waits, for at most _DEVICE_WAIT_MS, as the runtime does for the devices
+   a reactor sends to when its code is loaded. An expired entry is still returned
+   while it is asked for again, and the directory pushes changes to the 
+   devices cached here as they happen. */
+#define _DEVICE_TABLE_MIN_SIZE  64
+static _device_t **_device_table = NULL;
+static size_t _device_table_size = 0;
+static size_t _device_table_count = 0;
+static pthread_rwlock_t _device_lock = PTHREAD_RWLOCK_INITIALIZER;
+_device_t *_self = 0;
+
+/* Lookups waiting for the directory to reply. */
+#define _DEVICE_WAIT_MS  50
+static pthread_mutex_t _device_wait_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _device_wait_cond = PTHREAD_COND_INITIALIZER;
+
+/* What _device_probe found. */
+enum { _PROBE_HIT, _PROBE_STALE, _PROBE_MISS };
+
+static mv_uint32_t _device_hashof(const void *dev);
+static int _device_table_grow();
+static _device_t **_device_slot(const char *name, mv_uint32_t hash);
+static _device_t *_device_add(const char *name, mv_addr_t addr);
 static _device_t *_device_lookup(const char *name);
+static int _device_probe(const char *name, _device_t **pdev);
+static int _device_ask(_device_t *dev);
+static int _device_resolved(_device_t *dev);
+static void _device_wait(_device_t **devs, int n);
+static void _device_dir_update(const char *name, const char *addr, int ttl);
 static int _device_tokenize(char *line, char **dev, char **addr);
+static int _device_load(const char *file, int reload);
 
-void _device_table_init()
+mv_uint32_t _device_hashof(const void *dev)
 {
-  int i;
-  _device_t *dev;
-  for (i = 0; i < MAX_DEVICE_TABLE; i++) {
-    dev = _device_table + i;
-    dev->name = NULL;
-    dev->addr = 0;
+  return ((const _device_t *) dev)->hash;
+}
+
+int _device_table_grow()
+{
+  size_t size = _device_table_size ?
+    _device_table_size * 2 : _DEVICE_TABLE_MIN_SIZE;
+  _device_t **table = (_device_t **)
+    mv_hash_table_grow((void **) _device_table, _device_table_size, size,
+                       _device_hashof);
+  if (!table)
+    return -1;
+
+  _device_table = table;
+  _device_table_size = size;
+
+  return 0;
+}
 
-    dev->free = 1;
-    dev->free_idx = i;
-    dev->free_nxt = i + 1;
+/* Returns the slot of the device with the given name, or the empty slot
+   where it belongs. Call with the lock held. */
+_device_t **_device_slot(const char *name, mv_uint32_t hash)
+{
+  size_t mask = _device_table_size - 1;
+  size_t i = hash & mask;
+  _device_t *dev;
+  while ((dev = _device_table[i]) != NULL) {
+    if (dev->hash == hash && !strcmp(dev->name, name))
+      break;
+    i = (i + 1) & mask;
   }
-  /* the last element */
-  dev->free_idx = i;
-  dev->free_nxt = 0;
 
-  /* The first device, _device_table[0], is reserved to represent "no more
-     device". If free_nxt == 0, it means no more free device is available. */
-  _free_device = _device_table + 1;
-  _device_table[0].free = 0;
+  return _device_table + i;
 }
 
-_device_t *_device_get_free()
+/* Adds the device, or updates its address and brings it back if it is
+   gone. Call with the write lock held. */
+_device_t *_device_add(const char *name, mv_addr_t addr)
 {
-  if (_free_device == _device_table)
+  if ((_device_table_count + 1) * 2 > _device_table_size
+      && _device_table_grow() == -1)
     return NULL;
 
-  _device_t *dev = _free_device;
-  dev->free = 0;
-  _free_device = _device_table + dev->free_nxt;
+  mv_uint32_t hash = mv_hash_str(name);
+  _device_t **slot = _device_slot(name, hash);
+  _device_t *dev = *slot;
+  if (!dev) {
+    if ((dev = calloc(1, sizeof(_device_t))) == NULL)
+      return NULL;
+    dev->name = strdup(name);
+    dev->hash = hash;
+    *slot = dev;
+    _device_table_count++;
+  }
+  __atomic_store_n(&dev->addr, addr, __ATOMIC_RELEASE);
+  dev->gone = 0;
+  dev->dynamic = 0;
+  dev->expires = 0;
 
   return dev;
 }
 
-int _device_delete(_device_t *dev)
+_device_t *_device_lookup(const char *name)
 {
-  dev->free = 1;
-  dev->free_nxt = dev->free_idx;
-  _free_device = dev;
+  _device_t *dev = NULL;
+
+  if (!mv_dirclient_connected()) {
+    pthread_rwlock_rdlock(&_device_lock);
+    if (_device_table) {
+      dev = *_device_slot(name, mv_hash_str(name));
+      if (dev && dev->gone)
+        dev = NULL;
+    }
+    pthread_rwlock_unlock(&_device_lock);
+
+    return dev;
+  }
 
-  return 0;
+  switch (_device_probe(name, &dev)) {
+  case _PROBE_STALE:
+    if (_device_ask(dev))
+      mv_dirclient_get(&name, 1);
+    break;
+  case _PROBE_MISS:
+    /* unknown until the directory replies */
+    if (_device_ask(dev))
+      mv_dirclient_get(&name, 1);
+    dev = NULL;
+    break;
+  }
+
+  return dev;
 }
 
-_device_t *_device_lookup(const char *name)
+/* Returns 1 if the device is to be asked for, at most once a second. */
+int _device_ask(_device_t *dev)
 {
-  /* TODO: hash table */
-  int i;
-  _device_t *dev;
-  for (i = 1; i < MAX_DEVICE_TABLE; i++) {
-    dev = _device_table + i;
-    if (!dev->free && !strcmp(dev->name, name))
-      return dev;
+  time_t now = time(NULL);
+
+  return dev && __atomic_exchange_n(&dev->asked, now, __ATOMIC_RELAXED) != now;
+}
+
+/* Looks up the device in the cache, with a directory connected. On a hit,
+   gives the device, or NULL if it is gone. If the device is from the
+   directory, and its ttl is over, gives the device as it was, to be used
+   while it is asked for again (stale). Otherwise, gives the entry to wait
+   on for a reply (miss), which is added if need be. */
+int _device_probe(const char *name, _device_t **pdev)
+{
+  mv_uint32_t hash = mv_hash_str(name);
+  time_t now = time(NULL);
+  int retval = _PROBE_MISS;
+  _device_t *dev = NULL;
+
+  pthread_rwlock_rdlock(&_device_lock);
+  if (_device_table)
+    dev = *_device_slot(name, hash);
+  if (dev) {
+    if (!dev->dynamic || dev->expires > now)
+      retval = _PROBE_HIT;
+    else if (!dev->gone && dev->expires)
+      retval = _PROBE_STALE;
+    if (retval != _PROBE_MISS && dev->gone)
+      dev = NULL;
   }
+  pthread_rwlock_unlock(&_device_lock);
 
-  return NULL;
+  if (retval != _PROBE_MISS) {
+    *pdev = dev;
+    return retval;
+  }
+
+  /* not known to be there, nor known not to be */
+  pthread_rwlock_wrlock(&_device_lock);
+  dev = _device_table ? *_device_slot(name, hash) : NULL;
+  if (!dev && (dev = _device_add(name, 0)) != NULL) {
+    dev->gone = 1;
+    dev->dynamic = 1;
+  }
+  else if (dev && dev->dynamic && dev->gone && dev->expires <= now) {
+    dev->expires = 0;
+  }
+  pthread_rwlock_unlock(&_device_lock);
+
+  *pdev = dev;
+  return retval;
+}
+
+/* Returns 1 if the directory replied about the device. */
+int _device_resolved(_device_t *dev)
+{
+  pthread_rwlock_rdlock(&_device_lock);
+  int retval = !dev->dynamic || dev->expires != 0;
+  pthread_rwlock_unlock(&_device_lock);
+
+  return retval;
+}
+
+/* Waits for the directory to reply about the devices, for at most
+   _DEVICE_WAIT_MS. Devices it does not reply about in time are taken to
+   be gone for a second. */
+void _device_wait(_device_t **devs, int n)
+{
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_nsec += _DEVICE_WAIT_MS * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+
+  int i = 0;
+  pthread_mutex_lock(&_device_wait_lock);
+  while (i < n) {
+    if (!devs[i] || _device_resolved(devs[i]))
+      i++;
+    else if (pthread_cond_timedwait(&_device_wait_cond, &_device_wait_lock,
+                                    &deadline) == ETIMEDOUT)
+      break;
+  }
+  pthread_mutex_unlock(&_device_wait_lock);
+
+  if (i == n)
+    return;
+
+  time_t now = time(NULL);
+  pthread_rwlock_wrlock(&_device_lock);
+  for (; i < n; i++) {
+    if (devs[i] && devs[i]->dynamic && devs[i]->expires == 0)
+      devs[i]->expires = now + 1;
+  }
+  pthread_rwlock_unlock(&_device_lock);
+}
+
+/* Applies a reply or a push from the directory. Only devices cached here
+   are updated, and not those listed in device.dat. */
+void _device_dir_update(const char *name, const char *addr, int ttl)
+{
+  mv_addr_t a = 0;
+  if (addr && MV_ADDR_INVALID(a = mv_addr(addr)))
+    return;
+
+  time_t now = time(NULL);
+  pthread_rwlock_wrlock(&_device_lock);
+  _device_t *dev = _device_table ?
+    *_device_slot(name, mv_hash_str(name)) : NULL;
+  if (dev && dev->dynamic && dev != _self) {
+    if (a) {
+      __atomic_store_n(&dev->addr, a, __ATOMIC_RELEASE);
+      dev->gone = 0;
+      dev->expires = now + (ttl > 0 ? ttl : 1);
+    }
+    else {
+      dev->gone = 1;
+      dev->expires = now + MV_DIR_TTL;
+    }
+  }
+  pthread_rwlock_unlock(&_device_lock);
+
+  pthread_mutex_lock(&_device_wait_lock);
+  pthread_cond_broadcast(&_device_wait_cond);
+  pthread_mutex_unlock(&_device_wait_lock);
 }
 
 int _device_tokenize(char *line, char **dev, char **addr)
@@ -97,43 +309,111 @@ int _device_tokenize(char *line, char **dev, char **addr)
   return 0;
 }
 
-
-/*
- * Functions for the device API.
- */
-int mv_device_module_init(const char *file)
+/* Loads the device-address table in the given file. Addresses are parsed
+   before the lock is taken. On reload, devices no longer listed are gone,
+   except the device signed on. Returns the number of devices listed, or
+   -1 on failure. */
+int _device_load(const char *file, int reload)
 {
-  _device_table_init();
-
-  /* For now, to emulate the device server, read a device-address
-     table from a file. */
   FILE *fp;
   if ((fp = fopen(file, "r")) == NULL) {
     fprintf(stderr, "Failed to open %s\n", file);
     return -1;
   }
 
+  size_t n = 0;
+  size_t max = 64;
+  char **names = malloc(max * sizeof(char *));
+  mv_addr_t *addrs = malloc(max * sizeof(mv_addr_t));
+
   char line[1024];
   char *name;
   char *addr;
-  _device_t *mvdev;
   while (fgets(line, 1024, fp)) {
     char *charp = strstr(line, "\n");
     if (charp)
       *charp = '\0';
-    _device_tokenize(line, &name, &addr);
-    
-    mvdev = _device_get_free(name);
-    if (!mvdev)
+    if (!line[0] || line[0] == '#')
       continue;
-    mvdev->name = strdup(name);
-    mvdev->addr = mv_addr(addr);
+    if (_device_tokenize(line, &name, &addr) == -1) {
+      fprintf(stderr, "Line not recognized: %s\n", line);
+      continue;
+    }
+
+    mv_addr_t a = mv_addr(addr);
+    if (MV_ADDR_INVALID(a))
+      continue;
+
+    if (n == max) {
+      max *= 2;
+      names = realloc(names, max * sizeof(char *));
+      addrs = realloc(addrs, max * sizeof(mv_addr_t));
+    }
+    names[n] = strdup(name);
+    addrs[n] = a;
+    n++;
   }
+  fclose(fp);
+
+  size_t i;
+  pthread_rwlock_wrlock(&_device_lock);
+  if (reload) {
+    for (i = 0; i < _device_table_size; i++) {
+      _device_t *dev = _device_table[i];
+      if (dev && dev != _self && !dev->dynamic)
+        dev->gone = 1;
+    }
+  }
+  for (i = 0; i < n; i++) {
+    if (reload && _self && !strcmp(names[i], _self->name))
+      continue;  /* keep the address signed on with */
+    if (_device_add(names[i], addrs[i]) == NULL)
+      fprintf(stderr, "Failed to add device: %s\n", names[i]);
+  }
+  pthread_rwlock_unlock(&_device_lock);
+
+  for (i = 0; i < n; i++)
+    free(names[i]);
+  free(names);
+  free(addrs);
+
+  return (int) n;
+}
+
+
+/*
+ * Functions for the device API.
+ */
+int mv_device_module_init(const char *file)
+{
+  /* For now, to emulate the device server, read a device-address
+     table from a file. */
+  if (_device_load(file, 0) == -1)
+    return -1;
 
   fprintf(stdout, "Device address lookup service initiated...\n");
   return 0;
 }
 
+int mv_device_reload(const char *file)
+{
+  int n;
+  if ((n = _device_load(file, 1)) == -1)
+    return -1;
+
+  fprintf(stdout, "Device address table reloaded: %d devices.\n", n);
+  return 0;
+}
+
+int mv_device_dir_connect(const char *server)
+{
+  if (mv_dirclient_connect(server, _device_dir_update) == -1)
+    return -1;
+
+  fprintf(stdout, "Device directory at %s...\n", server);
+  return 0;
+}
+
 mv_device_t mv_device_register(const char *name)
 {
   /* 
@@ -168,28 +448,45 @@ int mv_device_deregister(mv_device_t dev)
 {
   if (dev == 0)
     return -1;
-  
+
   _device_t *pdev = (_device_t *) dev;
 
-  return _device_delete(pdev);
+  pthread_rwlock_wrlock(&_device_lock);
+  pdev->gone = 1;
+  pthread_rwlock_unlock(&_device_lock);
+
+  return 0;
 }
 
-_device_t *_self = 0;
 mv_device_t mv_device_signon(const char *name, mv_addr_t addr)
 {
-  _device_t *pdev = _device_lookup(name);
-  if (!pdev) {
-    fprintf(stderr, "mv_device_signon: Failed to sign on - %s\n", name);
+  if (addr == 0) {
+    fprintf(stderr, "mv_device_signon: Invalid transport address.\n");
     return -1;
   }
 
-  if (addr == 0) {
-    fprintf(stderr, "mv_device_signon: Invalid transport address.\n");
+  /* with a directory, a device need not be listed in device.dat */
+  _device_t *pdev = NULL;
+  pthread_rwlock_wrlock(&_device_lock);
+  if (_device_table)
+    pdev = *_device_slot(name, mv_hash_str(name));
+  if (mv_dirclient_connected())
+    pdev = _device_add(name, addr);
+  else if (pdev && pdev->gone)
+    pdev = NULL;
+  if (pdev) {
+    __atomic_store_n(&pdev->addr, addr, __ATOMIC_RELEASE);
+    _self = pdev;
+  }
+  pthread_rwlock_unlock(&_device_lock);
+
+  if (!pdev) {
+    fprintf(stderr, "mv_device_signon: Failed to sign on - %s\n", name);
     return -1;
   }
-  pdev->addr = addr;
 
-  _self = pdev;
+  if (mv_dirclient_connected())
+    mv_dirclient_register(name, mv_addr_str(addr), MV_DIR_TTL);
 
   return (mv_device_t) pdev;
 }
@@ -205,8 +502,10 @@ int mv_device_signoff(mv_device_t dev)
     return -1;
   }
 
+  if (mv_dirclient_connected())
+    mv_dirclient_unregister(pdev->name);
   mv_addr_delete(pdev->addr);
-  pdev->addr = 0;
+  __atomic_store_n(&pdev->addr, 0, __ATOMIC_RELEASE);
 
   _self = 0;
 
@@ -223,6 +522,63 @@ mv_device_t mv_device_lookup(const char *name)
   return (mv_device_t) _device_lookup(name);
 }
 
+int mv_device_lookup_batch(const char **names, int n, mv_device_t *devs)
+{
+  if (!mv_dirclient_connected()) {
+    int found = 0;
+    int i;
+    for (i = 0; i < n; i++) {
+      devs[i] = (mv_device_t) _device_lookup(names[i]);
+      if (devs[i])
+        found++;
+    }
+    return found;
+  }
+
+  /* one request for everything not cached, and one wait for the misses */
+  const char **ask = malloc(n * sizeof(char *));
+  _device_t **misses = malloc(n * sizeof(_device_t *));
+  int nask = 0;
+  int nmisses = 0;
+  int i;
+  for (i = 0; i < n; i++) {
+    _device_t *dev;
+    switch (_device_probe(names[i], &dev)) {
+    case _PROBE_STALE:
+      if (_device_ask(dev))
+        ask[nask++] = names[i];
+      break;
+    case _PROBE_MISS:
+      if (_device_ask(dev))
+        ask[nask++] = names[i];
+      misses[nmisses++] = dev;
+      dev = NULL;
+      break;
+    }
+    devs[i] = (mv_device_t) dev;
+  }
+  if (nask > 0)
+    mv_dirclient_get(ask, nask);
+  if (nmisses > 0)
+    _device_wait(misses, nmisses);
+
+  int found = 0;
+  for (i = 0; i < n; i++) {
+    if (!devs[i]) {
+      _device_t *dev;
+      if (_device_probe(names[i], &dev) == _PROBE_MISS)
+        dev = NULL;
+      devs[i] = (mv_device_t) dev;
+    }
+    if (devs[i])
+      found++;
+  }
+  free(ask);
+  free(misses);
+
+  return found;
+}
+
 const char *mv_device_name(mv_device_t dev)
 {
   _device_t *pdev = (_device_t *) dev;
@@ -234,7 +590,16 @@ mv_addr_t mv_device_addr(mv_device_t dev)
 {
   _device_t *pdev = (_device_t *) dev;
 
-  return pdev->addr;
+  return __atomic_load_n(&pdev->addr, __ATOMIC_ACQUIRE);
 }
 
+const char *mv_device_addrstr(const char *name)
+{
+  _device_t *pdev = _device_lookup(name);
+  if (!pdev) {
+    fprintf(stderr, "No such device, or not known yet: %s\n", name);
+    return NULL;
+  }
 
+  return mv_addr_str(mv_device_addr((mv_device_t) pdev));
+}
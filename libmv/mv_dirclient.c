@@ -0,0 +1,276 @@
+/**
+ * @file mv_dirclient.c
+ */
+#include <stdio.h>       /* fprintf */
+#include <stdlib.h>      /* atoi */
+#include <string.h>      /* strdup */
+#include <time.h>        /* time */
+#include <poll.h>        /* poll */
+#include <pthread.h>     /* pthread_create */
+#include <unistd.h>      /* close */
+#include <sys/types.h>   /* getaddrinfo */
+#include <sys/socket.h>  /* send */
+#include <netdb.h>       /* getaddrinfo */
+#include <mv/dir.h>      /* MV_DIR_PORT */
+#include "mv_dirclient.h"
+
+
+static int _dir_fd = -1;
+static mv_dirclient_update_t _dir_update = NULL;
+
+/* The device registered, renewed by the client thread. */
+static pthread_mutex_t _dir_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *_dir_regname = NULL;
+static char *_dir_regaddr = NULL;
+static int _dir_regttl = 0;
+
+static int _dir_send(const char *msg, size_t len);
+static void _dir_heartbeat();
+static void _dir_receive(char *msg);
+static void *_dir_thread(void *arg);
+
+/* Sends without blocking: a lost request is only retried later. */
+int _dir_send(const char *msg, size_t len)
+{
+  if (send(_dir_fd, msg, len, MSG_DONTWAIT) == -1)
+    return -1;
+
+  return 0;
+}
+
+/* Renews the registration, or only asks to keep receiving pushes. */
+void _dir_heartbeat()
+{
+  char msg[MV_DIR_MAX_DATAGRAM];
+  int len;
+
+  pthread_mutex_lock(&_dir_lock);
+  if (_dir_regname)
+    len = snprintf(msg, sizeof(msg), "REG %s %s %d\n", _dir_regname,
+                   _dir_regaddr, _dir_regttl);
+  else
+    len = snprintf(msg, sizeof(msg), "WATCH\n");
+  pthread_mutex_unlock(&_dir_lock);
+
+  if (len < (int) sizeof(msg))
+    _dir_send(msg, len);
+}
+
+void _dir_receive(char *msg)
+{
+  char *save_line;
+  char *l;
+  for (l = strtok_r(msg, "\n", &save_line); l;
+       l = strtok_r(NULL, "\n", &save_line)) {
+    char *save;
+    char *cmd = strtok_r(l, " \t", &save);
+    char *name = cmd ? strtok_r(NULL, " \t", &save) : NULL;
+    if (!name)
+      continue;
+
+    if (!strcmp(cmd, "ADDR")) {
+      char *addr = strtok_r(NULL, " \t", &save);
+      char *ttl = strtok_r(NULL, " \t", &save);
+      if (addr && ttl)
+        _dir_update(name, addr, atoi(ttl));
+    }
+    else if (!strcmp(cmd, "NONE")) {
+      _dir_update(name, NULL, 0);
+    }
+  }
+}
+
+void *_dir_thread(void *arg)
+{
+  (void) arg;
+
+  struct pollfd pfd;
+  pfd.fd = _dir_fd;
+  pfd.events = POLLIN;
+  time_t lastbeat = time(NULL);
+  while (1) {
+    if (poll(&pfd, 1, 1000) > 0) {
+      char msg[MV_DIR_MAX_DATAGRAM + 1];
+      ssize_t n = recv(_dir_fd, msg, MV_DIR_MAX_DATAGRAM, 0);
+      if (n > 0) {
+        msg[n] = '\0';
+        _dir_receive(msg);
+      }
+    }
+
+    pthread_mutex_lock(&_dir_lock);
+    int period = _dir_regname ? _dir_regttl / 3 : MV_DIR_WATCH_SEC / 2;
+    pthread_mutex_unlock(&_dir_lock);
+    if (period < 1)
+      period = 1;
+    if (time(NULL) - lastbeat >= period) {
+      _dir_heartbeat();
+      lastbeat = time(NULL);
+    }
+  }
+
+  return NULL;
+}
+
+
+/*
+ * Functions for the directory client.
+ */
+int mv_dirclient_connect(const char *server, mv_dirclient_update_t update)
+{
+  if (_dir_fd != -1) {
+    fprintf(stderr, "mv_dirclient_connect: Already connected.\n");
+    return -1;
+  }
+
+  /* host:port, [v6host]:port, or host */
+  char *host = strdup(server);
+  char *port = NULL;
+  char *colon = strrchr(host, ':');
+  if (host[0] == '[') {
+    char *end = strchr(host, ']');
+    if (!end) {
+      fprintf(stderr, "mv_dirclient_connect: Malformed address: %s\n",
+              server);
+      free(host);
+      return -1;
+    }
+    *end = '\0';
+    if (end[1] == ':')
+      port = end + 2;
+    memmove(host, host + 1, strlen(host));
+  }
+  else if (colon) {
+    *colon = '\0';
+    port = colon + 1;
+  }
+
+  char portbuf[16];
+  if (!port || !*port) {
+    snprintf(portbuf, sizeof(portbuf), "%d", MV_DIR_PORT);
+    port = portbuf;
+  }
+
+  struct addrinfo hints;
+  struct addrinfo *result;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  int rv;
+  if ((rv = getaddrinfo(host, port, &hints, &result)) != 0) {
+    fprintf(stderr, "mv_dirclient_connect: %s at %s\n", gai_strerror(rv),
+            server);
+    free(host);
+    return -1;
+  }
+  free(host);
+
+  int fd = socket(result->ai_family, SOCK_DGRAM, 0);
+  if (fd == -1 || connect(fd, result->ai_addr, result->ai_addrlen) == -1) {
+    perror("socket@mv_dirclient_connect");
+    if (fd != -1)
+      close(fd);
+    freeaddrinfo(result);
+    return -1;
+  }
+  freeaddrinfo(result);
+
+  _dir_fd = fd;
+  _dir_update = update;
+
+  pthread_t thr;
+  if (pthread_create(&thr, NULL, _dir_thread, NULL) != 0) {
+    perror("pthread_create@mv_dirclient_connect");
+    close(fd);
+    _dir_fd = -1;
+    return -1;
+  }
+  pthread_detach(thr);
+  _dir_heartbeat();
+
+  return 0;
+}
+
+int mv_dirclient_connected()
+{
+  return _dir_fd != -1;
+}
+
+int mv_dirclient_get(const char **names, int n)
+{
+  char msg[MV_DIR_MAX_DATAGRAM];
+  size_t len = 0;
+  int retval = 0;
+  int i;
+
+  if (_dir_fd == -1)
+    return -1;
+
+  for (i = 0; i < n; i++) {
+    size_t namelen = strlen(names[i]);
+    if (namelen + 6 > sizeof(msg))
+      continue;
+    if (len > 0 && len + 1 + namelen + 1 > sizeof(msg)) {
+      msg[len++] = '\n';
+      if (_dir_send(msg, len) == -1)
+        retval = -1;
+      len = 0;
+    }
+    if (len == 0) {
+      memcpy(msg, "GET", 3);
+      len = 3;
+    }
+    msg[len++] = ' ';
+    memcpy(msg + len, names[i], namelen);
+    len += namelen;
+  }
+  if (len > 0) {
+    msg[len++] = '\n';
+    if (_dir_send(msg, len) == -1)
+      retval = -1;
+  }
+
+  return retval;
+}
+
+int mv_dirclient_register(const char *name, const char *addr, int ttl)
+{
+  if (_dir_fd == -1)
+    return -1;
+
+  pthread_mutex_lock(&_dir_lock);
+  free(_dir_regname);
+  free(_dir_regaddr);
+  _dir_regname = strdup(name);
+  _dir_regaddr = strdup(addr);
+  _dir_regttl = ttl;
+  pthread_mutex_unlock(&_dir_lock);
+
+  _dir_heartbeat();
+
+  return 0;
+}
+
+int mv_dirclient_unregister(const char *name)
+{
+  char msg[MV_DIR_MAX_DATAGRAM];
+  int len;
+
+  if (_dir_fd == -1)
+    return -1;
+
+  pthread_mutex_lock(&_dir_lock);
+  if (_dir_regname && !strcmp(_dir_regname, name)) {
+    free(_dir_regname);
+    free(_dir_regaddr);
+    _dir_regname = NULL;
+    _dir_regaddr = NULL;
+  }
+  pthread_mutex_unlock(&_dir_lock);
+
+  len = snprintf(msg, sizeof(msg), "UNREG %s\n", name);
+  if (len >= (int) sizeof(msg))
+    return -1;
+
+  return _dir_send(msg, len);
+}
@@ -0,0 +1,33 @@
+/**
+ * @file mv_dirclient.h
+ *
+ * @brief Client of the device directory service (see mv/dir.h). Used by
+ * the device layer only.
+ */
+#ifndef MV_DIRCLIENT_H
+#define MV_DIRCLIENT_H
+
+/* Called from the client thread for every ADDR or NONE received, whether
+   a reply or a push. The addr argument is NULL for NONE. */
+typedef void (*mv_dirclient_update_t)(const char *name, const char *addr,
+                                      int ttl);
+
+/* Connects to the directory at host:port, and starts the thread which
+   receives replies and pushes, and sends heartbeats. */
+int mv_dirclient_connect(const char *server, mv_dirclient_update_t update);
+
+/* Returns 1 if connected to a directory. */
+int mv_dirclient_connected();
+
+/* Asks for the addresses of the devices, in as few datagrams as fit. Never
+   blocks: replies come to the update function. */
+int mv_dirclient_get(const char **names, int n);
+
+/* Registers the device, and renews the registration every ttl / 3
+   seconds. Only one device is registered at a time. */
+int mv_dirclient_register(const char *name, const char *addr, int ttl);
+
+int mv_dirclient_unregister(const char *name);
+
+
+#endif /* MV_DIRCLIENT_H */
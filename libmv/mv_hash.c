@@ -0,0 +1,46 @@
+/**
+ * @file mv_hash.c
+ */
+#include <stdio.h>      /* fprintf */
+#include <stdlib.h>     /* calloc */
+#include <mv/hash.h>
+
+
+mv_uint32_t mv_hash_str(const char *s)
+{
+  return mv_hash_str_cont(MV_HASH_INIT, s);
+}
+
+mv_uint32_t mv_hash_str_cont(mv_uint32_t hash, const char *s)
+{
+  while (*s)
+    hash = (hash ^ (unsigned char) *s++) * 16777619u;
+
+  return hash;
+}
+
+void **mv_hash_table_grow(void **table, size_t size, size_t newsize,
+                          mv_uint32_t (*hashof)(const void *entry))
+{
+  void **newtable = calloc(newsize, sizeof(void *));
+  if (!newtable) {
+    fprintf(stderr, "Failed to allocate hash table of size %lu.\n",
+            (unsigned long) newsize);
+    return NULL;
+  }
+
+  size_t mask = newsize - 1;
+  size_t i;
+  for (i = 0; i < size; i++) {
+    if (!table[i])
+      continue;
+
+    size_t j = hashof(table[i]) & mask;
+    while (newtable[j])
+      j = (j + 1) & mask;
+    newtable[j] = table[i];
+  }
+  free(table);
+
+  return newtable;
+}
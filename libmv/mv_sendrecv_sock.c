@@ -27,18 +27,32 @@ typedef struct _mq {
   int size;
   int head;
   int tail;
-  char **msgs;
+  void **msgs;
 } _mq_t;
 
+/* Body of an outgoing message: the JSON text. A message sent to many
+   devices is serialized once, and its body shared by all the sends. */
+typedef struct _mq_body {
+  int refs;                     /* sends not yet written */
+  char data[];                  /* {"tag":..., "arg":..., "src":...} */
+} _mq_body_t;
+
+/* An outgoing message, on the output queue. */
+typedef struct _mq_out {
+  mv_addr_t addr;               /* destination */
+  _mq_body_t *body;             /* shared body */
+} _mq_out_t;
+
 static _mq_t *_mq_new(int size);
 static int _mq_delete(_mq_t *mq);
-static int _mq_enqueue(_mq_t *mq, char *s);
-static char *_mq_dequeue(_mq_t *mq);
+static int _mq_enqueue(_mq_t *mq, void *s);
+static void *_mq_dequeue(_mq_t *mq);
 static void *_mq_input_thread(void *arg);
 static void *_mq_output_thread(void *arg);
 static const char *_mq_selfaddr();
-static const char *_mq_getaddr(const char *str);
-static const char *_mq_getdata(const char *str);
+static _mq_body_t *_mq_body_new(mv_mtag_t tag, const char *arg_s);
+static void _mq_body_release(_mq_body_t *body);
+static int _mq_send_body(const char *adr, _mq_body_t *body);
 
 
 /* 
@@ -72,7 +86,7 @@ _mq_t *_mq_new(int size)
   mq->size = size;
   mq->head = 0;
   mq->tail = 0;
-  mq->msgs = malloc(sizeof(char *) * size);
+  mq->msgs = malloc(sizeof(void *) * size);
 
   return mq;
 }
@@ -95,7 +109,7 @@ int _mq_empty(_mq_t *mq)
   return mq->tail == mq->head;
 }
 
-int _mq_enqueue(_mq_t *mq, char *s)
+int _mq_enqueue(_mq_t *mq, void *s)
 {
   if (pthread_mutex_lock(&mq->lock) != 0) {
     perror("pthread_mutex_lock@_mq_enqueue");
@@ -120,7 +134,7 @@ int _mq_enqueue(_mq_t *mq, char *s)
   return 0;
 }
 
-char *_mq_dequeue(_mq_t *mq)
+void *_mq_dequeue(_mq_t *mq)
 {
   pthread_mutex_lock(&mq->lock);
   if (_mq_empty(mq)) {
@@ -128,7 +142,7 @@ char *_mq_dequeue(_mq_t *mq)
     return NULL;
   }
 
-  char *s = mq->msgs[mq->head];
+  void *s = mq->msgs[mq->head];
   mq->head = (mq->head + 1) % mq->size;
 
   pthread_mutex_unlock(&mq->lock);
@@ -202,71 +216,56 @@ void *_mq_output_thread(void *arg)
   _mqinfo_t *mq = (_mqinfo_t *) arg;  /* message queue */
 
   struct timespec ts;                 /* time for nanosleep */
-  struct sockaddr_in servaddr;        /* server addr */
-  char *sendstr;                      /* message to send */
+  _mq_out_t *out;                     /* message to send */
 
-  struct addrinfo hints;              /* addrinfo */
-  struct addrinfo *result, *rp;       /* getaddrinfo results */
+  struct sockaddr_storage ss;         /* resolved server addr */
+  unsigned sslen;                     /* length of ss */
   int connfd;                         /* connected description */
-  int rv;                             /* returnv value */
 
   ts.tv_sec = 0;
   ts.tv_nsec = 1000;
 
   while (1) {
 
-    if ((sendstr = _mq_dequeue(mq->omq)) == NULL) {
+    if ((out = _mq_dequeue(mq->omq)) == NULL) {
       nanosleep(&ts, NULL);
       continue;
     }
 
-    const char * sendaddr = _mq_getaddr(sendstr);
-    const char *senddata = _mq_getdata(sendstr);
-    char *addr = strstr(sendaddr, "//") + 2;
-    char *port = strstr(addr, ":") + 1;
-    char *ipaddr = strdup(addr);
-    ipaddr[port-addr-1] = '\0';
+    /* the address is resolved when first used only */
+    mv_addr_t addr = out->addr;
+    const char *sendaddr = mv_addr_str(addr);
+    const char *senddata = out->body->data;
 #if 1
-    fprintf(stdout, "Message to [%s]:[%s]: %s\n", ipaddr, port, senddata);
+    fprintf(stdout, "Message to %s: %s\n", sendaddr, senddata);
 #endif
 
-    memset(&hints, 0, sizeof(struct addrinfo));
-    hints.ai_canonname = NULL;
-    hints.ai_addr = NULL;
-    hints.ai_next = NULL;
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_flags = AI_NUMERICSERV;
-
-    if ((rv = getaddrinfo(ipaddr, port, &hints, &result)) != 0) {
-      fprintf(stderr, "getaddrinfo@_mq_output_thread: %s at [%s]:[%s]\n", 
-              gai_strerror(rv), ipaddr, port);
-      continue;
-    }
-
-    /* walk through returned list until we find an address structure that
-       can be used to succeffully connect a socket */
-    for (rp = result; rp != NULL; rp = rp->ai_next) {
-      connfd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-      if (connfd == -1)
-        continue;
-
-      if (connect(connfd, rp->ai_addr, rp->ai_addrlen) != -1)
+    int refresh;
+    connfd = -1;
+    for (refresh = 0; refresh < 2 && connfd == -1; refresh++) {
+      if (mv_addr_sockaddr(addr, &ss, &sslen, refresh) == -1)
         break;
-
-      close(connfd);
+      if ((connfd = socket(ss.ss_family, SOCK_STREAM, 0)) == -1)
+        break;
+      if (connect(connfd, (struct sockaddr *) &ss, sslen) == -1) {
+        /* the host may have moved: resolve again */
+        close(connfd);
+        connfd = -1;
+      }
     }
 
-    if (rp == NULL) {
-      fprintf(stderr, "Failed to connect socket to any address.\n");
+    if (connfd == -1) {
+      fprintf(stderr, "Failed to connect socket to %s.\n", sendaddr);
+      _mq_body_release(out->body);
+      free(out);
       continue;
     }
-    freeaddrinfo(result);
 
     mv_writemsg(connfd, senddata);
 
     close(connfd);
-    free(sendstr);
+    _mq_body_release(out->body);
+    free(out);
   }
 }
 
@@ -309,21 +308,48 @@ const char *_mq_selfaddr()
   return NULL;
 }
 
-const char *_mq_getaddr(const char *str)
+_mq_body_t *_mq_body_new(mv_mtag_t tag, const char *arg_s)
 {
-  static char addr[1024];
-  char *data = strstr(str, "{");
+  _mqinfo_t *mqinfo = _mqinfo_get();
+  if (!mqinfo)
+    return NULL;
+
+  const char *tag_s = mv_message_tagstr(tag);
+  const char *src_s = mqinfo->srcstr;
+  size_t sz = strlen(tag_s) + strlen(arg_s) + strlen(src_s) + 32;
+  _mq_body_t *body = malloc(sizeof(_mq_body_t) + sz);
+  if (!body)
+    return NULL;
 
-  unsigned len = (unsigned long) data - (unsigned long) str;
-  strncpy(addr, str, len);
-  addr[len-1] = '\0';
+  body->refs = 1;
+  snprintf(body->data, sz, "{\"tag\":\"%s\", \"arg\":%s, \"src\":%s}", 
+           tag_s, arg_s, src_s);
 
-  return &addr[0];
+  return body;
 }
 
-const char *_mq_getdata(const char *str)
+void _mq_body_release(_mq_body_t *body)
 {
-  return strstr(str, "{");
+  if (__atomic_sub_fetch(&body->refs, 1, __ATOMIC_ACQ_REL) == 0)
+    free(body);
+}
+
+/* Queues a send of the body, which holds a reference for it. */
+int _mq_send_body(const char *adr, _mq_body_t *body)
+{
+  mv_addr_t addr = mv_addr(adr);
+  _mq_out_t *out;
+  if (MV_ADDR_INVALID(addr) || (out = malloc(sizeof(_mq_out_t))) == NULL) {
+    fprintf(stderr, "Failed to send message to %s.\n", adr);
+    _mq_body_release(body);
+    return -1;
+  }
+  out->addr = addr;
+  out->body = body;
+
+  while (_mq_enqueue(_mqinfo_get()->omq, out) != 0) ;
+
+  return 0;
 }
 
 #define BACKLOG 128
@@ -349,7 +375,8 @@ _mqinfo_t *_mqinfo_init(unsigned port)
   snprintf(s, 1024, "tcp://%s:%d", _mq_selfaddr(), port);
   mq->addr = strdup(s);
 
-  const char *dev_s = mv_device_self();
+  mv_device_t self = mv_device_self();
+  const char *dev_s = MV_DEVICE_INVALID(self) ? "" : mv_device_name(self);
   sprintf(s, "{\"dev\":\"%s\", \"addr\":\"%s\"}", dev_s, mq->addr);
   mq->srcstr = strdup(s);
   
@@ -453,38 +480,45 @@ _mqinfo_t *_mqinfo_get()
  */
 int mv_message_send(const char *adr, mv_mtag_t tag, char *arg_s)
 {
-  _mqinfo_t *mqinfo = _mqinfo_get();
-  if (!mqinfo)
+  _mq_body_t *body = _mq_body_new(tag, arg_s);
+  if (!body)
     return -1;
 
-  const char *tag_s = mv_message_tagstr(tag);
-  char *src_s = _mqinfo->srcstr;
-  int sz = strlen(arg_s);
-  char *m = malloc(sz + 1024);
-  sprintf(m, "%s {\"tag\":\"%s\", \"arg\":%s, \"src\":%s}", 
-          adr, tag_s, arg_s, src_s);
+  return _mq_send_body(adr, body);
+}
 
-  while (_mq_enqueue(mqinfo->omq, m) != 0) ;
+int mv_message_send_multi(const char **adrs, int n, mv_mtag_t tag, 
+                          char *arg_s)
+{
+  if (n <= 0)
+    return 0;
 
-  return 0;
+  _mq_body_t *body = _mq_body_new(tag, arg_s);
+  if (!body)
+    return -1;
+
+  /* one reference for each send, taken before any send can finish */
+  body->refs = n;
+  int sent = 0;
+  int i;
+  for (i = 0; i < n; i++) {
+    if (_mq_send_body(adrs[i], body) == 0)
+      sent++;
+  }
+
+  return sent;
 }
 
 int mv_message_send_value(const char *adr, mv_mtag_t tag, mv_value_t arg)
 {
-  _mqinfo_t *mqinfo = _mqinfo_get();
-  if (!mqinfo)
+  char *arg_s = mv_value_to_str(arg);
+  if (!arg_s)
     return -1;
 
-  const char *tag_s = mv_message_tagstr(tag);
-  char *arg_s = mv_value_to_str(arg);
-  char *src_s = _mqinfo->srcstr;
-  int sz = strlen(arg_s);
-  char *m = malloc(sz + 1024);
-  sprintf(m, "%s {\"tag\":%s,\"arg\":%s,\"src\":%s}", adr, tag_s, arg_s, src_s);
-  
-  while (_mq_enqueue(mqinfo->omq, m) != 0) ;
+  int retval = mv_message_send(adr, tag, arg_s);
+  free(arg_s);
 
-  return 0;
+  return retval;
 }
 
 char *mv_message_recv()
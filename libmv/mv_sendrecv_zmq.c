@@ -532,6 +532,19 @@ int mv_message_send(const char *adr, mv_mtag_t tag, char *arg_s)
   return 0;
 }
 
+int mv_message_send_multi(const char **adrs, int n, mv_mtag_t tag,
+                          char *arg_s)
+{
+  int sent = 0;
+  int i;
+  for (i = 0; i < n; i++) {
+    if (mv_message_send(adrs[i], tag, arg_s) == 0)
+      sent++;
+  }
+
+  return sent;
+}
+
 int mv_message_send_value(const char *adr, mv_mtag_t tag, mv_value_t arg)
 {
   _mqinfo_t *mqinfo = _mqinfo_get();
@@ -408,6 +408,19 @@ int mv_value_eq(mv_value_t u, mv_value_t v)
 
 int mv_value_delete(mv_value_t value)
 {
+  if (MV_VALUE_INVALID(value))
+    return -1;
+
+  /* compound values may share their parts, so only primitives are freed */
+  mv_vtag_t tag = _VALUE_TAG(value);
+  if (tag != MV_VALUE_INT && tag != MV_VALUE_FLOAT && tag != MV_VALUE_STRING)
+    return 0;
+
+  _prim_t *prim = (_prim_t *) _VALUE_PTR(value);
+  if (tag == MV_VALUE_STRING)
+    free(prim->u.sval);
+  free(prim);
+
   return 0;
 }
 
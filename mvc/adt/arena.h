@@ -0,0 +1,121 @@
+/**
+ * @file arena.h
+ * @brief Header for the arena (bump pointer) allocator.
+ *
+ * An arena allocates objects one after another from large chunks, and
+ * frees them all at once when it is destroyed. Objects are never freed
+ * one by one. The destructors of objects created with create() are run
+ * at that point too, unless they are trivial.
+ */
+#ifndef MVC_ARENA_H
+#define MVC_ARENA_H
+
+#include <cstddef>    /* max_align_t */
+#include <cstdlib>    /* malloc, free */
+#include <new>        /* placement new, bad_alloc */
+#include <type_traits>
+#include <utility>    /* forward */
+
+namespace mvc {
+
+class Arena {
+public:
+  enum { CHUNK_SIZE = 64 * 1024 };
+
+public:
+  Arena() : _chunks(NULL), _ptr(NULL), _end(NULL), _cleanups(NULL),
+            _nbytes(0) { }
+  ~Arena() { clear(); }
+
+  /* Returns size bytes aligned to align, a power of two no larger than
+     that of max_align_t. */
+  void *allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+    /* a large object gets a chunk of its own */
+    if (size > CHUNK_SIZE / 4)
+      return newChunk(size);
+
+    size_t pad = -reinterpret_cast<size_t>(_ptr) & (align - 1);
+    if (!_ptr || size + pad > static_cast<size_t>(_end - _ptr)) {
+      _ptr = static_cast<char *>(newChunk(CHUNK_SIZE));
+      _end = _ptr + CHUNK_SIZE;
+      pad = 0;
+    }
+    char *p = _ptr + pad;
+    _ptr = p + size;
+    return p;
+  }
+
+  /* Constructs a T in the arena. */
+  template<typename T, typename... Args>
+  T *create(Args&&... args) {
+    void *p = allocate(sizeof(T), alignof(T));
+    T *obj = new (p) T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value) {
+      Cleanup *cleanup = static_cast<Cleanup *>(allocate(sizeof(Cleanup)));
+      cleanup->destroy = &destroy<T>;
+      cleanup->obj = obj;
+      cleanup->next = _cleanups;
+      _cleanups = cleanup;
+    }
+    return obj;
+  }
+
+  /* Destroys the objects, latest first, and frees the chunks. */
+  void clear() {
+    for (Cleanup *cleanup = _cleanups; cleanup; cleanup = cleanup->next)
+      cleanup->destroy(cleanup->obj);
+    _cleanups = NULL;
+
+    while (_chunks) {
+      Chunk *next = _chunks->next;
+      std::free(_chunks);
+      _chunks = next;
+    }
+    _ptr = _end = NULL;
+    _nbytes = 0;
+  }
+
+  /* Returns the number of bytes allocated from the system. */
+  size_t getBytes() const { return _nbytes; }
+
+private:
+  Arena(const Arena& arena) = delete;
+  Arena& operator=(const Arena& arena) = delete;
+
+  /* Returns the space of a new chunk of size bytes. */
+  void *newChunk(size_t size) {
+    Chunk *chunk = static_cast<Chunk *>(std::malloc(sizeof(Chunk) + size));
+    if (!chunk)
+      throw std::bad_alloc();
+    chunk->next = _chunks;
+    _chunks = chunk;
+    _nbytes += sizeof(Chunk) + size;
+    return chunk + 1;
+  }
+
+  template<typename T>
+  static void destroy(void *obj) { static_cast<T *>(obj)->~T(); }
+
+private:
+  /* header of a chunk, padded so that the space after it is aligned */
+  union Chunk {
+    Chunk *next;
+    std::max_align_t align;
+  };
+
+  struct Cleanup {
+    void (*destroy)(void *);
+    void *obj;
+    Cleanup *next;
+  };
+
+  Chunk *_chunks;
+  char *_ptr;
+  char *_end;
+  Cleanup *_cleanups;
+  size_t _nbytes;
+};
+
+} /* mvc */
+
+#endif /* MVC_ARENA_H */
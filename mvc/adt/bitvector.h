@@ -2,14 +2,20 @@
  * @file bitvector.h
  * @brief Header for bit vector classes (based on LLVM BitVector class).
  *
- * @todo Make bit vector is resizable.
+ * The set operations work a word at a time, in plain loops over the
+ * words, which the compiler unrolls and vectorizes. Bits past size()
+ * in the last word are kept clear, so that words are compared and
+ * counted whole.
  */
 #ifndef MVC_BITVECTOR_H
 #define MVC_BITVECTOR_H
 
-#include <cstdlib>    /* malloc, free */
+#include <algorithm>  /* min, max, swap */
+#include <cstdlib>    /* realloc, free */
+#include <cstring>    /* memset, memcpy */
 #include <climits>    /* CHAR_BIT */
 #include <cassert>    /* assert */
+#include <new>        /* bad_alloc */
 
 namespace mvc {
 
@@ -20,13 +26,36 @@ public:
   enum { BVWORD_BITS = (unsigned) sizeof(BVWord_t) * CHAR_BIT };
 
 public:
-  BitVector(size_t s, bool t = false) : _size(s) {
-    _nwords = nBVWords(s);
-    _bits = (BVWord_t *) std::malloc(_nwords * sizeof(BVWord_t));
+  BitVector() : _bits(NULL), _size(0), _nwords(0) { }
+  BitVector(size_t s, bool t = false) : _bits(NULL), _size(s), _nwords(0) {
+    grow(nBVWords(s));
     initBitVector(_bits, _nwords, t);
+    clearUnusedBits();
+  }
+  BitVector(const BitVector& rhs)
+    : _bits(NULL), _size(rhs._size), _nwords(0) {
+    grow(nBVWords(_size));
+    copyBits(rhs._bits, nBVWords(_size));
   }
   ~BitVector() { std::free(_bits); }
 
+  BitVector& operator=(const BitVector& rhs) {
+    if (this == &rhs)
+      return *this;
+    size_t nwords = nBVWords(rhs._size);
+    if (nwords > _nwords)
+      grow(nwords);
+    _size = rhs._size;
+    copyBits(rhs._bits, nwords);
+    return *this;
+  }
+
+  void swap(BitVector& rhs) {
+    std::swap(_bits, rhs._bits);
+    std::swap(_size, rhs._size);
+    std::swap(_nwords, rhs._nwords);
+  }
+
   /* Tests whether there are no bits in the bit vector. */
   bool empty() const { return _size == 0; }
 
@@ -35,8 +64,10 @@ public:
 
   /* Returns the number of bits which are set. */
   size_t count() const {
-    // not implemented yet
-    assert(0);
+    size_t n = 0;
+    for (size_t i = 0; i < nBVWords(_size); ++i)
+      n += __builtin_popcountl(_bits[i]);
+    return n;
   }
 
   /* Returns true iff any bit is set. */
@@ -50,29 +81,144 @@ public:
 
   /* Returns true iff all bits are set. */
   bool all() const {
-    for (size_t i = 0; i < nBVWords(_size); ++i) {
-      if ((_bits[i] + 1) != 0)
+    for (size_t i = 0; i < _size / BVWORD_BITS; ++i) {
+      if (_bits[i] != ~0UL)
         return false;
-      return true;
     }
+
+    /* the used bits of the last word */
+    size_t extra_bits = _size % BVWORD_BITS;
+    if (extra_bits)
+      return _bits[_size / BVWORD_BITS] == ~(~0UL << extra_bits);
+    return true;
   }
 
   /* Returns true iff none of bits are set. */
   bool none() const { return !any(); }
 
+  /* Returns the index of the first set bit, or -1 if none is set. */
+  int find_first() const {
+    for (size_t i = 0; i < nBVWords(_size); ++i) {
+      if (_bits[i] != 0)
+        return i * BVWORD_BITS + __builtin_ctzl(_bits[i]);
+    }
+    return -1;
+  }
+
+  /* Returns the index of the first set bit after prev, or -1 if none is
+     set. Iterates over the set bits as
+       for (int i = bv.find_first(); i != -1; i = bv.find_next(i)) */
+  int find_next(size_t prev) const {
+    if (++prev >= _size)
+      return -1;
+
+    size_t i = prev / BVWORD_BITS;
+    BVWord_t word = _bits[i] & (~0UL << (prev % BVWORD_BITS));
+    if (word != 0)
+      return i * BVWORD_BITS + __builtin_ctzl(word);
+
+    for (++i; i < nBVWords(_size); ++i) {
+      if (_bits[i] != 0)
+        return i * BVWORD_BITS + __builtin_ctzl(_bits[i]);
+    }
+    return -1;
+  }
+
   /* Indexing operators. */
   bool operator[](size_t idx) const {
     assert(idx < _size && "out-of-bound bitvec access");
-    BVWord_t mask = 1L << (idx % BVWORD_BITS);
-    return (_bits[idx / BVWORD_BITS] % mask) != 0;
+    BVWord_t mask = 1UL << (idx % BVWORD_BITS);
+    return (_bits[idx / BVWORD_BITS] & mask) != 0;
+  }
+
+  bool test(size_t idx) const { return (*this)[idx]; }
+
+  /* Sets all bits, or the given bit position. */
+  BitVector& set() {
+    initBitVector(_bits, nBVWords(_size), true);
+    clearUnusedBits();
+    return *this;
   }
 
-  /* Sets the given bit position. */
   BitVector& set(size_t idx) {
-    _bits[idx/BVWORD_BITS] |= 1L << (idx % BVWORD_BITS);
+    assert(idx < _size && "out-of-bound bitvec access");
+    _bits[idx/BVWORD_BITS] |= 1UL << (idx % BVWORD_BITS);
+    return *this;
+  }
+
+  /* Clears all bits, or the given bit position. */
+  BitVector& reset() {
+    initBitVector(_bits, nBVWords(_size), false);
     return *this;
   }
 
+  BitVector& reset(size_t idx) {
+    assert(idx < _size && "out-of-bound bitvec access");
+    _bits[idx/BVWORD_BITS] &= ~(1UL << (idx % BVWORD_BITS));
+    return *this;
+  }
+
+  /* Grows or shrinks the bit vector to s bits. New bits are set to t. */
+  void resize(size_t s, bool t = false) {
+    size_t old_words = nBVWords(_size);
+    size_t new_words = nBVWords(s);
+    if (new_words > _nwords)
+      grow(new_words);
+
+    /* the unused bits of the old last word become used */
+    if (t && s > _size)
+      setUnusedBits(true);
+    if (new_words > old_words)
+      initBitVector(&_bits[old_words], new_words - old_words, t);
+
+    _size = s;
+    clearUnusedBits();
+  }
+
+  /* Set algebra: union, intersection, and difference (the bits of rhs
+     are cleared, as in LLVM). A shorter vector has no bits past its
+     size; a union grows this vector to the size of rhs. */
+  BitVector& operator|=(const BitVector& rhs) {
+    if (_size < rhs._size)
+      resize(rhs._size);
+    BVWord_t *bits = _bits;
+    const BVWord_t *rbits = rhs._bits;
+    for (size_t i = 0, n = nBVWords(rhs._size); i < n; ++i)
+      bits[i] |= rbits[i];
+    return *this;
+  }
+
+  BitVector& operator&=(const BitVector& rhs) {
+    size_t n = nBVWords(_size);
+    size_t m = std::min(n, nBVWords(rhs._size));
+    BVWord_t *bits = _bits;
+    const BVWord_t *rbits = rhs._bits;
+    for (size_t i = 0; i < m; ++i)
+      bits[i] &= rbits[i];
+    for (size_t i = m; i < n; ++i)
+      bits[i] = 0;
+    return *this;
+  }
+
+  BitVector& reset(const BitVector& rhs) {
+    size_t m = std::min(nBVWords(_size), nBVWords(rhs._size));
+    BVWord_t *bits = _bits;
+    const BVWord_t *rbits = rhs._bits;
+    for (size_t i = 0; i < m; ++i)
+      bits[i] &= ~rbits[i];
+    return *this;
+  }
+
+  /* Returns true iff this vector and rhs have a bit set in common. */
+  bool anyCommon(const BitVector& rhs) const {
+    size_t m = std::min(nBVWords(_size), nBVWords(rhs._size));
+    for (size_t i = 0; i < m; ++i) {
+      if (_bits[i] & rhs._bits[i])
+        return true;
+    }
+    return false;
+  }
+
   BVWord_t *bits() const {
     return _bits;
   }
@@ -81,7 +227,7 @@ public:
   bool operator==(const BitVector& rhs) const {
     if (_size != rhs.size())
       return false;
-    
+
     size_t lhs_words = nBVWords(_size);
     size_t rhs_words = nBVWords(rhs.size());
     size_t i;
@@ -106,24 +252,39 @@ public:
     return !(*this == rhs);
   }
 
-private:
-  /* not allowed */
-  BitVector() {}
-  BitVector(const BitVector& rhs) { }
-  BitVector& operator=(const BitVector& rhs) { return *this; }
-
 private:
   /* Determines the number ofBVWord_t words needed for the vector size. */
   size_t nBVWords(size_t vecsize) const {
     return (vecsize + BVWORD_BITS - 1) / BVWORD_BITS;
   }
 
+  /* Reallocates the vector for at least nwords words, doubling its
+     capacity, so that growing a bit at a time takes amortized constant
+     time. The new words are not initialized. */
+  void grow(size_t nwords) {
+    size_t capacity = std::max(nwords, _nwords * 2);
+    if (capacity == 0)
+      return;
+    BVWord_t *bits = static_cast<BVWord_t *>(
+      std::realloc(_bits, capacity * sizeof(BVWord_t)));
+    if (!bits)
+      throw std::bad_alloc();
+    _bits = bits;
+    _nwords = capacity;
+  }
+
+  void copyBits(const BVWord_t *bits, size_t nwords) {
+    if (nwords)
+      std::memcpy(_bits, bits, nwords * sizeof(BVWord_t));
+  }
+
   /* Initializes the bit vector to 0 or 1.
      @param bits bit vector to be initialized
-     @param nwords number of words 
+     @param nwords number of words
      @param t initial value for each bit position */
   void initBitVector(BVWord_t *bits, size_t nwords, bool t) {
-    memset(bits, 0 - (int) t, nwords * sizeof(BVWord_t));
+    if (nwords)
+      std::memset(bits, 0 - (int) t, nwords * sizeof(BVWord_t));
   }
 
   /* Sets the unused bits. */
@@ -136,7 +297,7 @@ private:
     // set unused bits in the last used word
     size_t extra_bits = _size % BVWORD_BITS;
     if (extra_bits) {
-      _bits[used_words-1] &= ~(~0L << extra_bits);
+      _bits[used_words-1] &= ~(~0UL << extra_bits);
       _bits[used_words-1] |= (0 - (BVWord_t) t) << extra_bits;
     }
   }
@@ -0,0 +1,104 @@
+/**
+ * @file bench_bitvector.cc
+ *
+ * @brief Times the BitVector operations of the liveness of the coalescer:
+ * union, intersection, difference, count and iteration over the set
+ * bits, on vectors of a few sizes with a quarter of the bits set. The
+ * set operations are timed with the copy of the vector they change.
+ *
+ * Usage: bench_bitvector [iterations]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include "adt/bitvector.h"
+
+using mvc::BitVector;
+
+typedef std::chrono::steady_clock Clock;
+
+static const size_t _sizes[] = { 64, 1024, 16384 };
+
+/* the results are summed, so the loops are not optimized away */
+static volatile size_t _sink;
+
+static BitVector _random_vector(size_t size, std::mt19937& rng)
+{
+  BitVector bv(size);
+  for (size_t i = 0; i < size; i++) {
+    if (rng() % 4 == 0)
+      bv.set(i);
+  }
+
+  return bv;
+}
+
+static void _report(const char *op, size_t size, long iters,
+                    Clock::time_point start)
+{
+  double ns = std::chrono::duration<double, std::nano>(Clock::now()
+                                                       - start).count();
+  printf("%-12s %6lu bits  %10.1f ns/op\n", op,
+         static_cast<unsigned long>(size), ns / iters);
+}
+
+int main(int argc, char *argv[])
+{
+  long iters = argc > 1 ? atol(argv[1]) : 100000;
+  if (iters <= 0) {
+    fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::mt19937 rng(42);
+  for (size_t s = 0; s < sizeof(_sizes) / sizeof(_sizes[0]); s++) {
+    size_t size = _sizes[s];
+    BitVector a = _random_vector(size, rng);
+    BitVector b = _random_vector(size, rng);
+    BitVector c(size);
+    size_t sum = 0;
+
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < iters; i++) {
+      c = a;
+      c |= b;
+      sum += c.bits()[0];
+    }
+    _report("|=", size, iters, start);
+
+    start = Clock::now();
+    for (long i = 0; i < iters; i++) {
+      c = a;
+      c &= b;
+      sum += c.bits()[0];
+    }
+    _report("&=", size, iters, start);
+
+    start = Clock::now();
+    for (long i = 0; i < iters; i++) {
+      c = a;
+      c.reset(b);
+      sum += c.bits()[0];
+    }
+    _report("reset(rhs)", size, iters, start);
+
+    start = Clock::now();
+    for (long i = 0; i < iters; i++) {
+      a.bits()[0] ^= i;
+      sum += a.count();
+    }
+    _report("count", size, iters, start);
+
+    start = Clock::now();
+    for (long i = 0; i < iters; i++) {
+      for (int j = a.find_first(); j != -1; j = a.find_next(j))
+        sum += j;
+    }
+    _report("find_next", size, iters, start);
+
+    _sink = sum;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -4,6 +4,7 @@
  * @brief Performs semantics checking.
  */
 #include <cassert>
+#include <iostream>
 #include "mvc_analyzer.hh" 
 #include "mvc_exp.hh" 
 #include "mvc_stm.hh" 
@@ -19,13 +20,15 @@ namespace mvc {
 class AnalyzerImpl
 {
 public:
-  AnalyzerImpl(Module *mod, SymTab& symtab) : _mod(mod), _symtab(symtab) { }
+  AnalyzerImpl(Module *mod, SymTab& symtab, std::ostream& os)
+    : _mod(mod), _symtab(symtab), _os(os), _nerrors(0) { }
   ~AnalyzerImpl() { }
 
   int run();
   
 private:
   int buildSymtab();
+  int checkEvents(ProcdefStm *procdef);
 
   int analyze(Stm *stm);
   int analyzeVardef(VardefStm *vardef);
@@ -34,31 +37,45 @@ private:
   int analyzeEventdef(EventdefStm *eventdef);
   int analyzeStm(Stm *stm);
   int analyzeExp(Exp *exp);
+  void addLocal(SymbolExp *sym);
+  void error(const std::string& s);
 
 private:
   Module *_mod;
   SymTab& _symtab;
+  std::ostream& _os;
+  int _nerrors;
 };
 
 
 int AnalyzerImpl::run()
 {
   buildSymtab();
-  
-  return 0;
+
+  /* reactors may come before the events they react to */
+  StmList& stms = _mod->getStms();
+  StmList::iterator iter;
+  for (iter = stms.begin(); iter != stms.end(); ++iter) {
+    if ((*iter)->getTag() == ST_PROCDEF)
+      checkEvents(static_cast<ProcdefStm *>(*iter));
+  }
+
+  return _nerrors > 0 ? -1 : 0;
 }
 
 int AnalyzerImpl::buildSymtab()
 {
-  std::list<Stm *>& stms = _mod->getStms();
-  std::list<Stm *>::iterator iter;
+  StmList& stms = _mod->getStms();
+  StmList::iterator iter;
   for (iter = stms.begin(); iter != stms.end(); ++iter) {
     Stm *stm = *iter;
     
-    Util::print(std::cout, stm);
+    Util::print(_os, stm);
     if (analyze(stm) == -1)
       continue;
   }
+
+  return 0;
 }
 
 
@@ -83,18 +100,19 @@ int AnalyzerImpl::analyze(Stm *stm)
 
 int AnalyzerImpl::analyzeVardef(VardefStm *vardef)
 {
-  const std::string& name = vardef->getSym()->getName();
-  if (_symtab.lookup(name) != NULL) {
+  Ident id = vardef->getSym()->getIdent();
+  const std::string& name = *id;
+  if (_symtab.lookup(id) != NULL) {
     std::string s = Util::sformat("Property \"%s\" already defined.",
                                   name.c_str()); 
-    std::cout << s << std::endl;
+    error(s);
     return -1;
   }
 
   Prop *prop = ValueFactory::createProp(name);
-  if (_symtab.add(name, prop) == -1) {
+  if (_symtab.add(id, prop) == -1) {
     std::string s = Util::sformat("Failed to add: \"%s\".", name.c_str());
-    std::cout << s << std::endl;
+    error(s);
     return -1;
   }
   
@@ -103,18 +121,19 @@ int AnalyzerImpl::analyzeVardef(VardefStm *vardef)
 
 int AnalyzerImpl::analyzeEventdef(EventdefStm *eventdef)
 {
-  const std::string& name = eventdef->getSym()->getName();
-  if (_symtab.lookup(name) != NULL) {
+  Ident id = eventdef->getSym()->getIdent();
+  const std::string& name = *id;
+  if (_symtab.lookup(id) != NULL) {
     std::string s = Util::sformat("Event \"%s\" already defined.",
                                   name.c_str()); 
-    std::cout << s << std::endl;
+    error(s);
     return -1;
   }
 
   Event *event = ValueFactory::createEvent(name);
-  if (_symtab.add(name, event) == -1) {
+  if (_symtab.add(id, event) == -1) {
     std::string s = Util::sformat("Failed to add: \"%s\".", name.c_str());
-    std::cout << s << std::endl;
+    error(s);
     return -1;
   }
   
@@ -123,83 +142,166 @@ int AnalyzerImpl::analyzeEventdef(EventdefStm *eventdef)
 
 int AnalyzerImpl::analyzeProcdef(ProcdefStm *procdef)
 {
-  const std::string& name = procdef->getSym()->getName();
-  if (_symtab.lookup(name) != NULL) {
+  Ident id = procdef->getSym()->getIdent();
+  const std::string& name = *id;
+  if (_symtab.lookup(id) != NULL) {
     std::string s = Util::sformat("Reactor \"%s\" already defined.",
                                   name.c_str()); 
-    std::cout << s << std::endl;
+    error(s);
     return -1;
   }
 
   Reactor *reactor = ValueFactory::createReactor(name);
-  if (_symtab.add(name, reactor) == -1) {
+  if (_symtab.add(id, reactor) == -1) {
     std::string s = Util::sformat("Failed to add: \"%s\".", name.c_str());
-    std::cout << s << std::endl;
+    error(s);
     return -1;
   }
   
-  Util::print(std::cout, procdef);
-  analyzeStm(procdef->getBody());
-  return 0;
+  /* the events name their values in the body */
+  _symtab.push();
+  ExpList::iterator iter;
+  for (iter = procdef->getEvents().begin();
+       iter != procdef->getEvents().end(); ++iter) {
+    if ((*iter)->getTag() == ET_SYMBOL)
+      addLocal(static_cast<SymbolExp *>(*iter));
+  }
+
+  Util::print(_os, procdef);
+  int ret = analyzeStm(procdef->getBody());
+  _symtab.pop();
+  return ret;
+}
+
+/* Each event of the reactor is an event of the module. */
+int AnalyzerImpl::checkEvents(ProcdefStm *procdef)
+{
+  int ret = 0;
+  ExpList::iterator iter;
+  for (iter = procdef->getEvents().begin();
+       iter != procdef->getEvents().end(); ++iter) {
+    if ((*iter)->getTag() != ET_SYMBOL)
+      continue;
+    SymbolExp *sym = static_cast<SymbolExp *>(*iter);
+    const std::string& name = sym->getName();
+    Value *value = _symtab.lookup(sym->getIdent());
+    if (!value || value->getTag() != VT_EVENT) {
+      error(Util::sformat("Reactor \"%s\" on \"%s\", which is not an event.",
+                          procdef->getSym()->getName().c_str(),
+                          name.c_str()));
+      ret = -1;
+    }
+  }
+
+  return ret;
 }
 
 int AnalyzerImpl::analyzeFundef(FundefStm *fundef)
 {
-  const std::string& name = fundef->getSym()->getName();
-  if (_symtab.lookup(name) != NULL) {
+  Ident id = fundef->getSym()->getIdent();
+  const std::string& name = *id;
+  if (_symtab.lookup(id) != NULL) {
     std::string s = Util::sformat("Function \"%s\" already defined.",
                                   name.c_str()); 
-    std::cout << s << std::endl;
+    error(s);
     return -1;
   }
 
   Function *fun = ValueFactory::createFunction(name);
-  if (_symtab.add(name, fun) == -1) {
+  if (_symtab.add(id, fun) == -1) {
     std::string s = Util::sformat("Failed to add: \"%s\".", name.c_str());
-    std::cout << s << std::endl;
+    error(s);
     return -1;
   }
   
-  Util::print(std::cout, fundef);
-  analyzeStm(fundef->getBody());
-  return 0;
+  _symtab.push();
+  if (fundef->getParams()) {
+    ExpList::iterator iter;
+    for (iter = fundef->getParams()->begin();
+         iter != fundef->getParams()->end(); ++iter) {
+      if ((*iter)->getTag() == ET_SYMBOL)
+        addLocal(static_cast<SymbolExp *>(*iter));
+    }
+  }
+
+  Util::print(_os, fundef);
+  int ret = analyzeStm(fundef->getBody());
+  _symtab.pop();
+  return ret;
+}
+
+/* Adds a parameter or a local variable to the scope of the reactor or
+   function. Locals are not scoped by blocks, as in IRBuilder. */
+void AnalyzerImpl::addLocal(SymbolExp *sym)
+{
+  _symtab.add(sym->getIdent(), ValueFactory::createName(sym));
 }
 
 
 int AnalyzerImpl::analyzeStm(Stm *stm)
 {
-  std::cout << "ANALYZE_STM: ";
-  Util::print(std::cout, stm);
+  _os << "ANALYZE_STM: ";
+  Util::print(_os, stm);
+
+  /* the first assignment to a name defines a local */
+  if (stm->getTag() == ST_ASSIGN) {
+    Exp *lhs = static_cast<AssignStm *>(stm)->getLhs();
+    if (lhs->getTag() == ET_SYMBOL) {
+      SymbolExp *sym = static_cast<SymbolExp *>(lhs);
+      if (sym->isLocal() && _symtab.lookup(sym->getIdent()) == NULL)
+        addLocal(sym);
+    }
+  }
+
+  /* goes on after an error, to report the others */
+  int ret = 0;
+
+  /* in the order they run, so that the init defines the locals of the 
+     condition */
+  if (stm->getTag() == ST_FOR) {
+    ForStm *forstm = static_cast<ForStm *>(stm);
+    if (forstm->getInit() && analyzeStm(forstm->getInit()) == -1)
+      ret = -1;
+    if (forstm->getCond() && analyzeExp(forstm->getCond()) == -1)
+      ret = -1;
+    if (forstm->getBody() && analyzeStm(forstm->getBody()) == -1)
+      ret = -1;
+    if (forstm->getStep() && analyzeStm(forstm->getStep()) == -1)
+      ret = -1;
+    return ret;
+  }
 
   ExpIterator eiter(stm);
   while (eiter.hasNext()) {
     Exp *exp = eiter.getNext();
     if (analyzeExp(exp) == -1)
-      return -1;
+      ret = -1;
     eiter.next();
   }
   
   StmIterator siter(stm);
   while (siter.hasNext()) {
     Stm *stm = siter.getNext();
-    analyzeStm(stm);
+    if (analyzeStm(stm) == -1)
+      ret = -1;
     siter.next();
   }
+
+  return ret;
 }
 
 int AnalyzerImpl::analyzeExp(Exp *exp)
 {
-  std::cout << "ANALYZE_EXP: ";
-  Util::print(std::cout, exp);
-  std::cout << std::endl;
+  _os << "ANALYZE_EXP: ";
+  Util::print(_os, exp);
+  _os << std::endl;
 
   switch (exp->getTag()) {
   case ET_SYMBOL: {
     SymbolExp *sym = static_cast<SymbolExp *>(exp);
     const std::string& name = sym->getName();
-    if (_symtab.lookup(name) == NULL) {
-      std::string s = Util::sformat("No symbol found: \"%s\".", name.c_str());
-      std::cout << s << std::endl;
+    if (sym->isLocal() && _symtab.lookup(sym->getIdent()) == NULL) {
+      error(Util::sformat("No symbol found: \"%s\".", name.c_str()));
       return -1;
     }
     break;
@@ -209,10 +311,13 @@ int AnalyzerImpl::analyzeExp(Exp *exp)
     break;
   }
 
+  /* the name of a call may be a native, not in the table */
   ExpIterator eiter(exp);
   while (eiter.hasNext()) {
     Exp *subexp = eiter.getNext();
-    if (analyzeExp(subexp) == -1)
+    if ((exp->getTag() != ET_FUNCALL
+         || subexp != static_cast<FuncallExp *>(exp)->getName())
+        && analyzeExp(subexp) == -1)
       return -1;
     eiter.next();
   }
@@ -220,14 +325,20 @@ int AnalyzerImpl::analyzeExp(Exp *exp)
   return 0;
 }
 
+void AnalyzerImpl::error(const std::string& s)
+{
+  std::cerr << "error: " << s << std::endl;
+  _nerrors++;
+}
+
 
 /*
  * Analyzer
  */
-Analyzer::Analyzer(Module *mod, SymTab& symtab) :
+Analyzer::Analyzer(Module *mod, SymTab& symtab, std::ostream& os) :
   Pass(PT_PASS, PT_ANALYZE, "semcheck")
 {
-  _impl = new AnalyzerImpl(mod, symtab);
+  _impl = new AnalyzerImpl(mod, symtab, os);
 }
 
 Analyzer::~Analyzer()
@@ -6,6 +6,7 @@
 #ifndef MVC_ANALYZER_HH
 #define MVC_ANALYZER_HH
 
+#include <iostream>
 #include "mvc_module.hh"
 #include "mvc_symtab.hh"
 #include "mvc_pass.hh"
@@ -18,7 +19,8 @@ namespace mvc {
 class AnalyzerImpl;
 class Analyzer : public Pass {
 public:
-  Analyzer(Module *mod, SymTab& symtab);
+  /* Writes what it checks, and the errors found, to os. */
+  Analyzer(Module *mod, SymTab& symtab, std::ostream& os = std::cout);
   ~Analyzer();
 
 public:
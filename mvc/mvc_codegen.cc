@@ -0,0 +1,922 @@
+/**
+ * @file mvc_codegen.cc
+ */
+#include <algorithm>
+#include <climits>
+#include <map>
+#include "mvc_codegen.hh"
+#include "mvc_util.hh"
+
+namespace mvc {
+
+/* Opcodes of mvrt used by the generator, with their stack effects as in
+   mvrt/rtoper.c. */
+enum OpTag {
+  OP_ADD, OP_SUB, OP_MUL, OP_DIV,
+  OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE, OP_AND, OP_OR,
+  OP_PUSHN, OP_PUSH0, OP_PUSH1, OP_PUSHI, OP_PUSHS,
+  OP_GETARG, OP_GETF, OP_SETF, OP_CONS, OP_CAR, OP_CDR,
+  OP_PROP_GET, OP_PROP_SET, OP_EVENT_OCCUR,
+  OP_CALL_FUNC, OP_CALL_FUNC_RET, OP_CALL_REMOTE, OP_CALL_NATIVE,
+  OP_JMP, OP_BEQ, OP_BLT, OP_BLE, OP_BGT, OP_BGE, OP_RET,
+  OP_POP, OP_SAVE0, OP_SAVE1, OP_SAVE, OP_LOAD0, OP_LOAD1, OP_LOAD,
+  OP_NTAGS
+};
+
+static const struct {
+  const char *str;
+  int nargs;
+  int nrets;
+} _opinfo[] = {
+  { "add", 2, 1 }, { "sub", 2, 1 }, { "mul", 2, 1 }, { "div", 2, 1 },
+  { "eq", 2, 1 }, { "ne", 2, 1 }, { "lt", 2, 1 }, { "le", 2, 1 },
+  { "gt", 2, 1 }, { "ge", 2, 1 }, { "and", 2, 1 }, { "or", 2, 1 },
+  { "pushn", 0, 1 }, { "push0", 0, 1 }, { "push1", 0, 1 },
+  { "pushi", 0, 1 }, { "pushs", 0, 1 },
+  { "getarg", 0, 1 }, { "getf", 2, 1 }, { "setf", 3, 1 },
+  { "cons", 2, 1 }, { "car", 1, 1 }, { "cdr", 1, 1 },
+  { "prop_get", 1, 1 }, { "prop_set", 2, 0 }, { "event_occur", 2, 0 },
+  { "call_func", 2, 1 }, { "call_func_ret", 2, 1 },
+  { "call_func", 2, 0 },       /* remote, not waiting for the result */
+  { "call_native", 1, 1 },     /* plus the arguments */
+  { "jmp", 0, 0 }, { "beq", 2, 0 }, { "blt", 2, 0 }, { "ble", 2, 0 },
+  { "bgt", 2, 0 }, { "bge", 2, 0 }, { "ret", 0, 0 },
+  { "pop", 1, 0 }, { "save0", 1, 0 }, { "save1", 1, 0 }, { "save", 1, 0 },
+  { "load0", 0, 1 }, { "load1", 0, 1 }, { "load", 0, 1 }
+};
+
+/* Max number of temporaries of mvrt code (MVRT_CODE_MAX_REGS). */
+static const int _maxregs = 256;
+
+/* Depth of the stack when code starts, holding the event value
+   (MVRT_CODE_ENTRY_DEPTH). */
+static const int _entrydepth = 1;
+
+static bool _is_remote(const std::string& sym);
+
+/* A single instruction. The target of a branch is resolved to its index
+   once all blocks are laid out. */
+struct Instr {
+  OpTag op;
+  int imm;
+  std::string str;
+  BasicBlock *target;
+
+  Instr(OpTag o, int i = 0) : op(o), imm(i), target(NULL) { }
+  int nargs() { return _opinfo[op].nargs + (op == OP_CALL_NATIVE ? imm : 0); }
+  int nrets() { return _opinfo[op].nrets; }
+};
+
+/* An instruction, or a temporary which is already on the stack. */
+struct Item {
+  int resident;
+  Instr instr;
+
+  Item(int t) : resident(t), instr(OP_POP) { }
+  Item(const Instr& i) : resident(-1), instr(i) { }
+};
+
+struct QuadInfo {
+  BasicBlock *blk;
+  int idx;         /* index in the block */
+  int point;       /* index of the quad where it is computed */
+  bool inlined;    /* computed where it is used */
+};
+
+
+/**
+ * @class GraphGen
+ *
+ * @brief Generates the code of a single reactor or function.
+ */
+class GraphGen {
+public:
+  GraphGen(ControlGraph *g) : _g(g) { }
+  ~GraphGen() { }
+
+  int run(std::ostream& os);
+  CodeStats& getStats() { return _stats; }
+  std::map<BasicBlock *, CodeStats>& getBlockStats() { return _blockstats; }
+
+private:
+  void analyze();
+  bool isLocal(int t);
+  bool isRemat(int t);
+  bool isInlined(int t);
+  void inlineBlock(BasicBlock *blk);
+  bool scheduleBlock(BasicBlock *blk);
+  int allocRegs();
+
+  void flatten(Quad *q, std::vector<Item>& items, BasicBlock *next);
+  void flattenOperand(int t, std::vector<Item>& items);
+  void flattenBinary(Quad *q, std::vector<Item>& items, OpTag op);
+  void flattenBranch(Quad *q, std::vector<Item>& items, BasicBlock *next);
+  void flattenList(Quad *q, size_t first, std::vector<Item>& items);
+  int key(int t);
+
+  BasicBlock *follow(BasicBlock *blk);
+  void emitBlock(BasicBlock *blk, BasicBlock *next, std::vector<Instr>& code);
+  void countBlock(std::vector<Instr>& code, size_t first, size_t last,
+                  CodeStats& stats);
+
+private:
+  ControlGraph *_g;
+  std::map<Quad *, QuadInfo> _info;
+
+  /* per temporary */
+  std::vector<int> _ndefs;
+  std::vector<Quad *> _def;
+  std::vector<std::vector<Quad *> > _users;
+  std::vector<bool> _resident;
+  std::vector<bool> _spilled;
+  std::vector<int> _reg;
+
+  /* per block emitted, the block whose code runs first from it */
+  std::map<BasicBlock *, BasicBlock *> _follow;
+
+  CodeStats _stats;
+  std::map<BasicBlock *, CodeStats> _blockstats;
+};
+
+
+void GraphGen::analyze()
+{
+  int n = _g->getNtemps();
+  _ndefs.assign(n, 0);
+  _def.assign(n, NULL);
+  _users.assign(n, std::vector<Quad *>());
+  _resident.assign(n, false);
+  _spilled.assign(n, false);
+  _reg.assign(n, -1);
+
+  std::vector<BasicBlock *>& blocks = _g->getBlocks();
+  for (size_t i = 0; i < blocks.size(); i++) {
+    std::list<Quad *>& quads = blocks[i]->getQuads();
+    std::list<Quad *>::iterator iter;
+    int idx = 0;
+    for (iter = quads.begin(); iter != quads.end(); ++iter, ++idx) {
+      Quad *q = *iter;
+      QuadInfo& info = _info[q];
+      info.blk = blocks[i];
+      info.idx = info.point = idx;
+      info.inlined = false;
+
+      std::vector<int>& args = q->getArgs();
+      for (size_t j = 0; j < args.size(); j++)
+        _users[args[j]].push_back(q);
+      if (q->getLhs() >= 0) {
+        _ndefs[q->getLhs()]++;
+        _def[q->getLhs()] = q;
+      }
+    }
+  }
+}
+
+/* Returns true if t is defined and used once, in the same block. */
+bool GraphGen::isLocal(int t)
+{
+  if (_ndefs[t] != 1 || _users[t].size() != 1
+      || _def[t]->getTag() == QT_PHI)
+    return false;
+
+  QuadInfo& def = _info[_def[t]];
+  QuadInfo& use = _info[_users[t][0]];
+  return def.blk == use.blk && def.idx < use.idx;
+}
+
+/* Returns true if t is a constant, a string or the event value, which
+   costs no more to push again at each use than to load. */
+bool GraphGen::isRemat(int t)
+{
+  if (_ndefs[t] != 1)
+    return false;
+
+  QuadTag tag = _def[t]->getTag();
+  return tag == QT_CONST || tag == QT_STRING || tag == QT_NULL
+    || tag == QT_ARG;
+}
+
+/* Returns true if t is computed where it is used. */
+bool GraphGen::isInlined(int t)
+{
+  Quad *def = _def[t];
+  return def && _info[def].inlined && (isLocal(t) || isRemat(t));
+}
+
+/* Decides which quads are computed where their values are used: those
+   which read nothing changed in between. */
+void GraphGen::inlineBlock(BasicBlock *blk)
+{
+  std::vector<Quad *> quads(blk->getQuads().begin(), blk->getQuads().end());
+  for (int i = quads.size() - 1; i >= 0; i--) {
+    Quad *q = quads[i];
+    int t = q->getLhs();
+    if (t < 0 || !isLocal(t) || q->getEffect() == EF_WRITE)
+      continue;
+
+    QuadInfo& use = _info[_users[t][0]];
+    int point = use.inlined ? use.point : use.idx;
+    bool moved = true;
+    for (int j = i + 1; j < point && moved; j++) {
+      Quad *r = quads[j];
+      if (q->getEffect() == EF_READ && r->getEffect() == EF_WRITE)
+        moved = false;
+      std::vector<int>& args = q->getArgs();
+      for (size_t k = 0; k < args.size(); k++) {
+        if (args[k] == r->getLhs())
+          moved = false;
+      }
+    }
+    if (!moved)
+      continue;
+
+    QuadInfo& info = _info[q];
+    info.inlined = true;
+    info.point = point;
+  }
+}
+
+/* Ordering key of an operand: a value on the stack is deeper if it was
+   computed earlier. */
+int GraphGen::key(int t)
+{
+  Quad *def = _def[t];
+  if (_resident[t])
+    return _info[def].idx;
+  if (isInlined(t)) {
+    int k = INT_MAX;
+    std::vector<int>& args = def->getArgs();
+    for (size_t i = 0; i < args.size(); i++)
+      k = std::min(k, key(args[i]));
+    return k;
+  }
+
+  return INT_MAX;
+}
+
+void GraphGen::flattenOperand(int t, std::vector<Item>& items)
+{
+  if (isInlined(t)) {
+    flatten(_def[t], items, NULL);
+    return;
+  }
+  if (_resident[t]) {
+    items.push_back(Item(t));
+    return;
+  }
+
+  int r = _reg[t];
+  items.push_back(Instr(r == 0 ? OP_LOAD0 : r == 1 ? OP_LOAD1 : OP_LOAD, r));
+}
+
+/* The binary operators of mvrt compute "top OP next". Commutative and
+   mirrored operators may take the operands in either order, which lets
+   a value already on the stack stay there. */
+void GraphGen::flattenBinary(Quad *q, std::vector<Item>& items, OpTag op)
+{
+  static const OpTag mirror[] = {
+    OP_ADD, OP_NTAGS, OP_MUL, OP_NTAGS,
+    OP_EQ, OP_NE, OP_GT, OP_GE, OP_LT, OP_LE, OP_AND, OP_OR
+  };
+  int top = q->getArg(0);
+  int next = q->getArg(1);
+  if (mirror[op] != OP_NTAGS && key(top) < key(next)) {
+    std::swap(top, next);
+    op = mirror[op];
+  }
+  flattenOperand(next, items);
+  flattenOperand(top, items);
+  items.push_back(Instr(op));
+}
+
+/* Pushes the arguments from first on as a list, the way call_func passes
+   them: (a0 . (a1 . ... null)). */
+void GraphGen::flattenList(Quad *q, size_t first, std::vector<Item>& items)
+{
+  std::vector<int>& args = q->getArgs();
+  items.push_back(Instr(OP_PUSHN));
+  for (size_t i = args.size(); i > first; i--) {
+    flattenOperand(args[i - 1], items);
+    items.push_back(Instr(OP_CONS));
+  }
+}
+
+void GraphGen::flattenBranch(Quad *q, std::vector<Item>& items,
+                             BasicBlock *next)
+{
+  static const OpTag branches[] = {
+    OP_NTAGS, OP_NTAGS, OP_NTAGS, OP_NTAGS,
+    OP_BEQ, OP_NTAGS, OP_BLT, OP_BLE, OP_BGT, OP_BGE
+  };
+  static const OpTag inverses[] = {
+    OP_NTAGS, OP_NTAGS, OP_NTAGS, OP_NTAGS,
+    OP_NTAGS, OP_BEQ, OP_BGE, OP_BGT, OP_BLE, OP_BLT
+  };
+  BasicBlock *t = q->getTarget(0);
+  BasicBlock *f = q->getTarget(1);
+  int c = q->getArg(0);
+  Quad *def = _def[c];
+
+  if (def && _info[def].inlined && isLocal(c) && def->getTag() >= QT_EQ
+      && def->getTag() <= QT_GE) {
+    /* compare and branch */
+    QuadTag tag = def->getTag();
+    std::vector<Item> operands;
+    flattenBinary(def, operands, OpTag(OP_ADD + tag));
+    OpTag cmp = operands.back().instr.op;
+    operands.pop_back();
+    items.insert(items.end(), operands.begin(), operands.end());
+
+    OpTag op = branches[cmp - OP_ADD];
+    OpTag inv = inverses[cmp - OP_ADD];
+    if (follow(t) == next && inv != OP_NTAGS) {
+      items.push_back(Instr(inv));
+      items.back().instr.target = f;
+      return;
+    }
+    if (op == OP_NTAGS) {
+      /* no bne: branch on eq to the false target */
+      std::swap(t, f);
+      op = OP_BEQ;
+    }
+    items.push_back(Instr(op));
+    items.back().instr.target = t;
+    if (follow(f) != next) {
+      items.push_back(Instr(OP_JMP));
+      items.back().instr.target = f;
+    }
+    return;
+  }
+
+  /* c == 0 branches to the false target */
+  flattenOperand(c, items);
+  items.push_back(Instr(OP_PUSH0));
+  items.push_back(Instr(OP_BEQ));
+  items.back().instr.target = f;
+  if (follow(t) != next) {
+    items.push_back(Instr(OP_JMP));
+    items.back().instr.target = t;
+  }
+}
+
+void GraphGen::flatten(Quad *q, std::vector<Item>& items, BasicBlock *next)
+{
+  std::vector<int>& args = q->getArgs();
+
+  switch (q->getTag()) {
+  case QT_ADD:
+  case QT_SUB:
+  case QT_MUL:
+  case QT_DIV:
+  case QT_EQ:
+  case QT_NE:
+  case QT_LT:
+  case QT_LE:
+  case QT_GT:
+  case QT_GE:
+  case QT_AND:
+  case QT_OR:
+    flattenBinary(q, items, OpTag(OP_ADD + q->getTag()));
+    break;
+  case QT_CONST:
+    if (q->getImm() == 0)
+      items.push_back(Instr(OP_PUSH0));
+    else if (q->getImm() == 1)
+      items.push_back(Instr(OP_PUSH1));
+    else
+      items.push_back(Instr(OP_PUSHI, q->getImm()));
+    break;
+  case QT_STRING:
+    items.push_back(Instr(OP_PUSHS));
+    items.back().instr.str = q->getSym();
+    break;
+  case QT_NULL:
+    items.push_back(Instr(OP_PUSHN));
+    break;
+  case QT_COPY:
+    flattenOperand(args[0], items);
+    break;
+  case QT_ARG:
+    items.push_back(Instr(OP_GETARG));
+    break;
+  case QT_PARAM:
+    items.push_back(Instr(OP_GETARG));
+    for (int i = 0; i < q->getImm(); i++)
+      items.push_back(Instr(OP_CDR));
+    items.push_back(Instr(OP_CAR));
+    break;
+  case QT_GETF:
+    flattenOperand(args[0], items);
+    items.push_back(Instr(OP_PUSHS));
+    items.back().instr.str = q->getSym();
+    items.push_back(Instr(OP_GETF));
+    break;
+  case QT_INDEX:
+    flattenOperand(args[0], items);
+    flattenOperand(args[1], items);
+    items.push_back(Instr(OP_GETF));
+    break;
+  case QT_PROP_GET:
+    items.push_back(Instr(OP_PUSHS));
+    items.back().instr.str = q->getSym();
+    items.push_back(Instr(OP_PROP_GET));
+    break;
+  case QT_PROP_SET:
+    flattenOperand(args[0], items);
+    items.push_back(Instr(OP_PUSHS));
+    items.back().instr.str = q->getSym();
+    items.push_back(Instr(OP_PROP_SET));
+    break;
+  case QT_SETF:
+    flattenOperand(args[0], items);
+    flattenOperand(args[1], items);
+    if (args.size() > 2) {
+      flattenOperand(args[2], items);
+    }
+    else {
+      items.push_back(Instr(OP_PUSHS));
+      items.back().instr.str = q->getSym();
+    }
+    items.push_back(Instr(OP_SETF));
+    items.push_back(Instr(OP_POP));
+    break;
+  case QT_FUNCALL:
+    if (q->getImm() == CT_NATIVE) {
+      /* the arguments are passed in place */
+      for (size_t i = 0; i < args.size(); i++)
+        flattenOperand(args[i], items);
+      items.push_back(Instr(OP_PUSHS));
+      items.back().instr.str = q->getSym();
+      items.push_back(Instr(OP_CALL_NATIVE, args.size()));
+    }
+    else {
+      flattenList(q, 0, items);
+      items.push_back(Instr(OP_PUSHS));
+      items.back().instr.str = q->getSym();
+      if (q->getImm() != CT_REMOTE)
+        items.push_back(Instr(OP_CALL_FUNC));
+      else if (q->getLhs() >= 0 && !_users[q->getLhs()].empty())
+        items.push_back(Instr(OP_CALL_FUNC_RET));
+      else
+        items.push_back(Instr(OP_CALL_REMOTE));
+    }
+    if (q->getLhs() < 0 && items.back().instr.op != OP_CALL_REMOTE)
+      items.push_back(Instr(OP_POP));
+    break;
+  case QT_TRIGGER:
+    if (args.empty())
+      items.push_back(Instr(OP_PUSHN));
+    else if (args.size() == 1)
+      flattenOperand(args[0], items);
+    else
+      flattenList(q, 0, items);
+    items.push_back(Instr(OP_PUSHS));
+    items.back().instr.str = q->getSym();
+    items.push_back(Instr(OP_EVENT_OCCUR));
+    break;
+  case QT_JUMP:
+    if (follow(q->getTarget(0)) != next) {
+      items.push_back(Instr(OP_JMP));
+      items.back().instr.target = q->getTarget(0);
+    }
+    break;
+  case QT_BRANCH:
+    flattenBranch(q, items, next);
+    break;
+  case QT_RET:
+    if (!args.empty())
+      flattenOperand(args[0], items);
+    /* the last block falls off the end of code */
+    if (!args.empty() || next != NULL)
+      items.push_back(Instr(OP_RET));
+    break;
+  default:
+    break;
+  }
+}
+
+/* Checks that every value left on the stack is in place where it is
+   used. Otherwise, marks the value to be saved to a temporary, and
+   returns false. */
+bool GraphGen::scheduleBlock(BasicBlock *blk)
+{
+  std::vector<int> stack;
+  bool ok = true;
+
+  std::list<Quad *>& quads = blk->getQuads();
+  std::list<Quad *>::iterator iter;
+  for (iter = quads.begin(); iter != quads.end(); ++iter) {
+    if ((*iter)->getLhs() >= 0)
+      _resident[(*iter)->getLhs()] = false;
+  }
+
+  for (iter = quads.begin(); iter != quads.end(); ++iter) {
+    Quad *q = *iter;
+    if (_info[q].inlined)
+      continue;
+
+    std::vector<Item> items;
+    flatten(q, items, NULL);
+
+    /* values on the stack must be used first, in order */
+    size_t nres = 0;
+    while (nres < items.size() && items[nres].resident >= 0)
+      nres++;
+    for (size_t i = 0; i < items.size(); i++) {
+      int t = items[i].resident;
+      if (t < 0)
+        continue;
+      size_t pos = stack.size() - nres + i;
+      if (i >= nres || nres > stack.size() || stack[pos] != t) {
+        _spilled[t] = true;
+        ok = false;
+      }
+    }
+    if (!ok)
+      return false;
+
+    for (size_t i = nres; i < items.size(); i++) {
+      Instr& instr = items[i].instr;
+      stack.resize(stack.size() - instr.nargs());
+      for (int j = 0; j < instr.nrets(); j++)
+        stack.push_back(-1);
+    }
+
+    int t = q->getLhs();
+    if (t >= 0 && isLocal(t) && !_spilled[t]) {
+      _resident[t] = true;
+      stack.back() = t;
+    }
+  }
+
+  /* nothing is left on the stack across blocks */
+  for (size_t i = 0; i < stack.size(); i++) {
+    if (stack[i] >= 0) {
+      _spilled[stack[i]] = true;
+      ok = false;
+    }
+  }
+
+  return ok;
+}
+
+/* Assigns a temporary to every value not on the stack. Values used only
+   in the block where they are defined share temporaries. */
+int GraphGen::allocRegs()
+{
+  int n = _g->getNtemps();
+  std::vector<bool> needs(n, false);
+  std::vector<bool> shared(n, false);
+  int nregs = 0;
+
+  for (int t = 0; t < n; t++) {
+    if (_users[t].empty() || _resident[t]
+        || isInlined(t))
+      continue;
+    needs[t] = true;
+
+    shared[t] = _ndefs[t] == 1;
+    for (size_t i = 0; i < _users[t].size() && shared[t]; i++) {
+      QuadInfo& use = _info[_users[t][i]];
+      QuadInfo& def = _info[_def[t]];
+      if (use.blk != def.blk || use.point <= def.idx)
+        shared[t] = false;
+    }
+    if (!shared[t])
+      _reg[t] = nregs++;
+  }
+
+  /* linear scan over each block */
+  int maxregs = nregs;
+  std::vector<BasicBlock *>& blocks = _g->getBlocks();
+  for (size_t i = 0; i < blocks.size(); i++) {
+    std::vector<int> free;
+    std::map<int, std::vector<int> > ends;
+    int next = nregs;
+
+    std::list<Quad *>& quads = blocks[i]->getQuads();
+    std::list<Quad *>::iterator iter;
+    for (iter = quads.begin(); iter != quads.end(); ++iter) {
+      Quad *q = *iter;
+      int idx = _info[q].idx;
+      std::vector<int>& done = ends[idx];
+      for (size_t j = 0; j < done.size(); j++)
+        free.push_back(_reg[done[j]]);
+
+      int t = q->getLhs();
+      if (t < 0 || !needs[t] || !shared[t])
+        continue;
+      if (!free.empty()) {
+        _reg[t] = free.back();
+        free.pop_back();
+      }
+      else {
+        _reg[t] = next++;
+      }
+      int last = idx;
+      for (size_t j = 0; j < _users[t].size(); j++)
+        last = std::max(last, _info[_users[t][j]].point);
+      ends[last].push_back(t);
+    }
+    maxregs = std::max(maxregs, next);
+  }
+
+  return maxregs;
+}
+
+/* Returns the block whose code runs first on a jump to blk: blk itself,
+   or, if blk has no code, the block after it, or NULL at the end of the
+   code. A block not emitted yet is taken as it is. */
+BasicBlock *GraphGen::follow(BasicBlock *blk)
+{
+  std::map<BasicBlock *, BasicBlock *>::iterator iter = _follow.find(blk);
+  return iter != _follow.end() ? iter->second : blk;
+}
+
+void GraphGen::emitBlock(BasicBlock *blk, BasicBlock *next,
+                         std::vector<Instr>& code)
+{
+  std::list<Quad *>& quads = blk->getQuads();
+  std::list<Quad *>::iterator iter;
+  for (iter = quads.begin(); iter != quads.end(); ++iter) {
+    Quad *q = *iter;
+    if (_info[q].inlined)
+      continue;
+
+    std::vector<Item> items;
+    flatten(q, items, next);
+
+    int t = q->getLhs();
+    if (t >= 0 && !_resident[t]) {
+      if (!_users[t].empty())
+        items.push_back(Instr(_reg[t] == 0 ? OP_SAVE0
+                              : _reg[t] == 1 ? OP_SAVE1 : OP_SAVE, _reg[t]));
+      else if (items.back().instr.op != OP_CALL_REMOTE)
+        items.push_back(Instr(OP_POP));
+    }
+
+    for (size_t i = 0; i < items.size(); i++) {
+      if (items[i].resident < 0)
+        code.push_back(items[i].instr);
+    }
+  }
+}
+
+/* Counts the code of a block, from first up to last, as mvrt runs it.
+   Lists, fields, events and calls allocate. A remote read, or a call
+   waiting for its result, is a round trip, and allocates the
+   continuation of the reactor. */
+void GraphGen::countBlock(std::vector<Instr>& code, size_t first,
+                          size_t last, CodeStats& stats)
+{
+  int depth = _entrydepth;
+  stats.maxstack = depth;
+  for (size_t i = first; i < last; i++) {
+    Instr& instr = code[i];
+    depth += instr.nrets() - instr.nargs();
+    stats.maxstack = std::max(stats.maxstack, depth);
+    stats.ninstrs++;
+
+    /* the name is pushed right before */
+    const std::string& sym = code[i > first ? i - 1 : i].str;
+    switch (instr.op) {
+    case OP_SAVE0:
+    case OP_SAVE1:
+    case OP_SAVE:
+      stats.nsaves++;
+      break;
+    case OP_LOAD0:
+    case OP_LOAD1:
+    case OP_LOAD:
+      stats.nloads++;
+      break;
+    case OP_CONS:
+    case OP_SETF:
+    case OP_EVENT_OCCUR:
+    case OP_CALL_FUNC:
+      stats.nallocs++;
+      break;
+    case OP_PROP_GET:
+      if (_is_remote(sym)) {
+        stats.nwaits++;
+        stats.nallocs++;
+      }
+      else if (sym.find(',') != std::string::npos) {
+        /* the map of a batched read */
+        stats.nallocs++;
+      }
+      break;
+    case OP_CALL_FUNC_RET:
+      stats.nwaits++;
+      stats.nallocs++;
+      break;
+    case OP_CALL_REMOTE:
+      stats.nsends++;
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+int GraphGen::run(std::ostream& os)
+{
+  analyze();
+
+  for (int t = 0; t < _g->getNtemps(); t++) {
+    if (isRemat(t))
+      _info[_def[t]].inlined = true;
+  }
+
+  std::vector<BasicBlock *>& blocks = _g->getBlocks();
+  for (size_t i = 0; i < blocks.size(); i++) {
+    inlineBlock(blocks[i]);
+    while (!scheduleBlock(blocks[i]))
+      ;
+  }
+
+  _stats.nregs = allocRegs();
+  if (_stats.nregs > _maxregs) {
+    std::cerr << "error: Too many temporaries in \"" << _g->getName()
+              << "\"." << std::endl;
+    return -1;
+  }
+
+  /* from the last block back, so that a jump to a block which turns out
+     to have no code is dropped as well when the code after it is next */
+  std::vector<std::vector<Instr> > blockcode(blocks.size());
+  BasicBlock *next = NULL;
+  for (size_t i = blocks.size(); i > 0; i--) {
+    emitBlock(blocks[i - 1], next, blockcode[i - 1]);
+    if (!blockcode[i - 1].empty())
+      next = blocks[i - 1];
+    _follow[blocks[i - 1]] = next;
+  }
+
+  std::vector<Instr> code;
+  std::map<BasicBlock *, int> starts;
+  for (size_t i = 0; i < blocks.size(); i++) {
+    starts[blocks[i]] = code.size();
+    code.insert(code.end(), blockcode[i].begin(), blockcode[i].end());
+  }
+
+  _stats.maxstack = _entrydepth;
+  for (size_t i = 0; i < blocks.size(); i++) {
+    size_t last = i + 1 < blocks.size() ? starts[blocks[i + 1]] : code.size();
+    CodeStats& stats = _blockstats[blocks[i]];
+    countBlock(code, starts[blocks[i]], last, stats);
+    _stats.ninstrs += stats.ninstrs;
+    _stats.nsaves += stats.nsaves;
+    _stats.nloads += stats.nloads;
+    _stats.maxstack = std::max(_stats.maxstack, stats.maxstack);
+    _stats.nallocs += stats.nallocs;
+    _stats.nwaits += stats.nwaits;
+    _stats.nsends += stats.nsends;
+  }
+
+  os << "# " << _g->getName() << ": " << _stats.ninstrs << " instructions, "
+     << _stats.nsaves << " saves, " << _stats.nloads << " loads, "
+     << _stats.nregs << " temporaries" << std::endl;
+  os << (_g->getTag() == GT_REACTOR ? "reactor " : "func ") << _g->getName()
+     << std::endl << "{" << std::endl;
+  for (size_t i = 0; i < code.size(); i++) {
+    Instr& instr = code[i];
+    os << "  " << _opinfo[instr.op].str;
+    if (instr.target)
+      os << " " << starts[instr.target];
+    else if (instr.op == OP_PUSHS)
+      os << " \"" << instr.str << "\"";
+    else if (instr.op == OP_PUSHI || instr.op == OP_SAVE
+             || instr.op == OP_LOAD || instr.op == OP_CALL_NATIVE)
+      os << " " << instr.imm;
+    os << std::endl;
+  }
+  os << "}" << std::endl;
+
+  return 0;
+}
+
+
+/**
+ * @class CodeGenImpl
+ */
+class CodeGenImpl {
+public:
+  CodeGenImpl(IRModule *mod) : _mod(mod) { }
+  ~CodeGenImpl() { }
+
+  int run(std::ostream& os);
+  CodeStats getStats(const std::string& name);
+  CodeStats getStats(BasicBlock *blk) { return _blockstats[blk]; }
+
+private:
+  IRModule *_mod;
+  std::map<std::string, CodeStats> _stats;
+  std::map<BasicBlock *, CodeStats> _blockstats;
+};
+
+int CodeGenImpl::run(std::ostream& os)
+{
+  int retval = 0;
+
+  os << "# module " << _mod->getName() << ", generated by mvc" << std::endl;
+
+  std::vector<std::string>& props = _mod->getProps();
+  if (!props.empty())
+    os << std::endl << "# properties" << std::endl;
+  for (size_t i = 0; i < props.size(); i++)
+    os << "prop " << props[i] << " null" << std::endl;
+
+  std::vector<std::string>& events = _mod->getEvents();
+  if (!events.empty())
+    os << std::endl << "# events" << std::endl;
+  for (size_t i = 0; i < events.size(); i++)
+    os << "event " << events[i] << std::endl;
+
+  /* functions first, then reactors */
+  std::vector<ControlGraph *>& graphs = _mod->getGraphs();
+  for (int tag = GT_FUNCTION; tag >= GT_REACTOR; tag--) {
+    for (size_t i = 0; i < graphs.size(); i++) {
+      if (graphs[i]->getTag() != tag)
+        continue;
+      os << std::endl;
+      GraphGen gen(graphs[i]);
+      if (gen.run(os) == -1)
+        retval = -1;
+      _stats[graphs[i]->getName()] = gen.getStats();
+      _blockstats.insert(gen.getBlockStats().begin(),
+                         gen.getBlockStats().end());
+    }
+  }
+
+  os << std::endl << "# event-reactor associations" << std::endl;
+  for (size_t i = 0; i < graphs.size(); i++) {
+    if (graphs[i]->getTag() != GT_REACTOR)
+      continue;
+    std::vector<std::string>& params = graphs[i]->getParams();
+    for (size_t j = 0; j < params.size(); j++)
+      os << "assoc " << params[j] << " " << graphs[i]->getName() << std::endl;
+  }
+
+  return retval;
+}
+
+CodeStats CodeGenImpl::getStats(const std::string& name)
+{
+  if (name != "")
+    return _stats[name];
+
+  CodeStats total;
+  std::map<std::string, CodeStats>::iterator iter;
+  for (iter = _stats.begin(); iter != _stats.end(); ++iter) {
+    total.ninstrs += iter->second.ninstrs;
+    total.nsaves += iter->second.nsaves;
+    total.nloads += iter->second.nloads;
+    total.nregs += iter->second.nregs;
+    total.maxstack = std::max(total.maxstack, iter->second.maxstack);
+    total.nallocs += iter->second.nallocs;
+    total.nwaits += iter->second.nwaits;
+    total.nsends += iter->second.nsends;
+  }
+
+  return total;
+}
+
+
+/*
+ * CodeGen
+ */
+CodeGen::CodeGen(IRModule *mod)
+{
+  _impl = new CodeGenImpl(mod);
+}
+
+CodeGen::~CodeGen()
+{
+  delete _impl;
+}
+
+int CodeGen::run(std::ostream& os)
+{
+  return _impl->run(os);
+}
+
+CodeStats CodeGen::getStats(const std::string& name)
+{
+  return _impl->getStats(name);
+}
+
+CodeStats CodeGen::getStats(BasicBlock *blk)
+{
+  return _impl->getStats(blk);
+}
+
+
+/* Returns true if the name is "dev:name", as the mvrt verifier tells. */
+bool _is_remote(const std::string& sym)
+{
+  size_t colon = sym.find(':');
+  return colon != std::string::npos && colon != 0;
+}
+
+} /* mvc */
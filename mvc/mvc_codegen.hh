@@ -0,0 +1,72 @@
+/**
+ * @file mvc_codegen.hh
+ *
+ * @brief Generates mvrt code from the intermediate representation.
+ */
+#ifndef MVC_CODEGEN_HH
+#define MVC_CODEGEN_HH
+
+#include <iostream>
+#include "mvc_ir.hh"
+
+namespace mvc {
+
+/* Counts of the generated code. Saves and loads are the traffic between
+   the stack and temporaries which the scheduler could not avoid. Each
+   round trip is a message to another device whose reply the reactor is
+   suspended waiting for; a send is a message it does not wait for. */
+struct CodeStats {
+  int ninstrs;     /* instructions */
+  int nsaves;      /* save instructions */
+  int nloads;      /* load instructions */
+  int nregs;       /* temporaries */
+  int maxstack;    /* deepest evaluation stack, as the mvrt verifier finds */
+  int nallocs;     /* instructions which allocate values or contexts */
+  int nwaits;      /* round trips to other devices */
+  int nsends;      /* messages to other devices not waited for */
+
+  CodeStats()
+    : ninstrs(0), nsaves(0), nloads(0), nregs(0), maxstack(0), nallocs(0),
+      nwaits(0), nsends(0) { }
+};
+
+/**
+ * @class CodeGen
+ *
+ * @brief Writes a module in the format mvrt loads (see etc/syslib.dat):
+ * its properties, events, functions, reactors, and the associations of
+ * each reactor with its events.
+ *
+ * Temporaries of the IR are scheduled to the evaluation stack. A value
+ * used once in its block is computed right where it is used, or left on
+ * the stack if it is already in place there. Only the other values are
+ * saved to, and loaded from, mvrt temporaries.
+ */
+class CodeGenImpl;
+class CodeGen {
+public:
+  CodeGen(IRModule *mod);
+  ~CodeGen();
+
+  /* Returns 0 on success, and -1 if any code cannot be generated. */
+  int run(std::ostream& os);
+
+  /* Returns the counts of the code of the named reactor or function, or
+     of the whole module if name is empty. */
+  CodeStats getStats(const std::string& name = "");
+
+  /* Returns the counts of the code of a block, whose stack depth is that
+     of the stack on entry, where every block starts. */
+  CodeStats getStats(BasicBlock *blk);
+
+private:
+  CodeGen(const CodeGen& cg) = delete;
+  CodeGen& operator=(const CodeGen& cg) = delete;
+
+private:
+  CodeGenImpl *_impl;
+};
+
+} /* mvc */
+
+#endif /* MVC_CODEGEN_HH */
@@ -0,0 +1,419 @@
+/**
+ * @file mvc_cost.cc
+ */
+#include <climits>
+#include <iomanip>
+#include <vector>
+#include "mvc_cost.hh"
+#include "mvc_util.hh"
+
+namespace mvc {
+
+/* A definition of a temporary, and its block. */
+struct Def {
+  Quad *q;
+  BasicBlock *blk;
+
+  Def(Quad *quad, BasicBlock *b) : q(quad), blk(b) { }
+};
+
+typedef std::vector<std::vector<Def> > DefMap;
+
+static void _find_defs(ControlGraph *graph, DefMap& defs);
+static bool _const_value(DefMap& defs, int t, long long& value,
+                         int depth = 0);
+static long long _loop_bound(BasicBlock *header,
+                             std::set<BasicBlock *>& body, DefMap& defs);
+static bool _runs_always(BasicBlock *blk, BasicBlock *header,
+                         std::set<BasicBlock *>& body);
+static long long _iterations(QuadTag op, long long init, long long step,
+                             long long limit);
+static std::string _json_string(const std::string& s);
+
+/*
+ * CostModel
+ */
+void CostModel::run()
+{
+  std::vector<ControlGraph *>& graphs = _mod->getGraphs();
+  for (size_t i = 0; i < graphs.size(); i++)
+    findBounds(graphs[i]);
+
+  for (size_t i = 0; i < graphs.size(); i++) {
+    if (graphs[i]->getTag() != GT_REACTOR)
+      continue;
+    std::set<ControlGraph *> callers;
+    _worst[graphs[i]] = estimate(graphs[i], callers);
+  }
+}
+
+void CostModel::report(std::ostream& os, const std::string& file)
+{
+  os << "{" << std::endl;
+  os << "  \"module\": " << _json_string(_mod->getName()) << "," << std::endl;
+  os << "  \"source\": " << _json_string(file) << "," << std::endl;
+  os << "  \"reactors\": [";
+
+  /* counts of the worst case may exceed any integer */
+  os << std::fixed << std::setprecision(0);
+
+  const char *sep = "";
+  std::vector<ControlGraph *>& graphs = _mod->getGraphs();
+  for (size_t i = 0; i < graphs.size(); i++) {
+    ControlGraph *graph = graphs[i];
+    if (graph->getTag() != GT_REACTOR)
+      continue;
+    CodeStats stats = _codegen.getStats(graph->getName());
+
+    os << sep << std::endl << "    {" << std::endl;
+    sep = ",";
+    os << "      \"name\": " << _json_string(graph->getName()) << ","
+       << std::endl;
+    os << "      \"events\": [";
+    std::vector<std::string>& params = graph->getParams();
+    for (size_t j = 0; j < params.size(); j++)
+      os << (j > 0 ? ", " : "") << _json_string(params[j]);
+    os << "]," << std::endl;
+
+    os << "      \"instructions\": " << stats.ninstrs << "," << std::endl;
+    os << "      \"maxstack\": " << stats.maxstack << "," << std::endl;
+    os << "      \"temporaries\": " << stats.nregs << "," << std::endl;
+    os << "      \"allocations\": " << stats.nallocs << "," << std::endl;
+    os << "      \"roundtrips\": " << stats.nwaits << "," << std::endl;
+    os << "      \"sends\": " << stats.nsends << "," << std::endl;
+
+    /* loops in the order of their headers */
+    os << "      \"loops\": [";
+    std::map<BasicBlock *, long long>& bounds = _bounds[graph];
+    std::vector<BasicBlock *>& blocks = graph->getBlocks();
+    const char *lsep = "";
+    for (size_t j = 0; j < blocks.size(); j++) {
+      std::map<BasicBlock *, long long>::iterator iter
+        = bounds.find(blocks[j]);
+      if (iter == bounds.end())
+        continue;
+      os << lsep << "{ \"header\": " << blocks[j]->getId() << ", \"bound\": ";
+      if (iter->second >= 0)
+        os << iter->second;
+      else
+        os << "null";
+      os << " }";
+      lsep = ", ";
+    }
+    os << "]," << std::endl;
+
+    WorstCase& worst = _worst[graph];
+    os << "      \"worst\": ";
+    if (worst.bounded) {
+      os << "{ \"instructions\": " << worst.ninstrs
+         << ", \"allocations\": " << worst.nallocs
+         << ", \"roundtrips\": " << worst.nwaits
+         << ", \"sends\": " << worst.nsends << " }" << std::endl;
+    }
+    else {
+      os << "null" << std::endl;
+    }
+    os << "    }";
+  }
+
+  os << std::endl << "  ]" << std::endl << "}";
+}
+
+/* Bounds the iterations of each loop of the graph. */
+void CostModel::findBounds(ControlGraph *graph)
+{
+  DefMap defs;
+  _find_defs(graph, defs);
+
+  LoopMap& loops = _loops[graph];
+  graph->findLoops(loops);
+  std::map<BasicBlock *, long long>& bounds = _bounds[graph];
+  LoopMap::iterator iter;
+  for (iter = loops.begin(); iter != loops.end(); ++iter)
+    bounds[iter->first] = _loop_bound(iter->first, iter->second, defs);
+}
+
+/* Returns the counts of a run of the graph in the worst case. callers
+   are the functions being estimated, to stop at recursive calls. */
+WorstCase CostModel::estimate(ControlGraph *graph,
+                              std::set<ControlGraph *>& callers)
+{
+  WorstCase worst;
+  LoopMap& loops = _loops[graph];
+  std::map<BasicBlock *, long long>& bounds = _bounds[graph];
+
+  callers.insert(graph);
+  std::vector<BasicBlock *>& blocks = graph->getBlocks();
+  for (size_t i = 0; i < blocks.size(); i++) {
+    BasicBlock *blk = blocks[i];
+
+    /* the header tests once more than the loop iterates */
+    double times = 1;
+    LoopMap::iterator iter;
+    for (iter = loops.begin(); iter != loops.end(); ++iter) {
+      if (iter->second.count(blk) == 0)
+        continue;
+      long long bound = bounds[iter->first];
+      if (bound < 0)
+        worst.bounded = false;
+      else
+        times *= bound + (blk == iter->first ? 1 : 0);
+    }
+
+    CodeStats stats = _codegen.getStats(blk);
+    worst.ninstrs += times * stats.ninstrs;
+    worst.nallocs += times * stats.nallocs;
+    worst.nwaits += times * stats.nwaits;
+    worst.nsends += times * stats.nsends;
+
+    std::list<Quad *>::iterator qiter;
+    for (qiter = blk->getQuads().begin(); qiter != blk->getQuads().end();
+         ++qiter) {
+      Quad *q = *qiter;
+      if (q->getTag() != QT_FUNCALL || q->getImm() != CT_FUNC)
+        continue;
+      ControlGraph *func = _mod->getFunction(q->getSym());
+      if (!func)
+        continue;
+      if (callers.count(func) > 0) {
+        worst.bounded = false;
+        continue;
+      }
+      WorstCase calls = estimate(func, callers);
+      worst.bounded = worst.bounded && calls.bounded;
+      worst.ninstrs += times * calls.ninstrs;
+      worst.nallocs += times * calls.nallocs;
+      worst.nwaits += times * calls.nwaits;
+      worst.nsends += times * calls.nsends;
+    }
+  }
+  callers.erase(graph);
+
+  return worst;
+}
+
+
+void _find_defs(ControlGraph *graph, DefMap& defs)
+{
+  defs.assign(graph->getNtemps(), std::vector<Def>());
+  std::vector<BasicBlock *>& blocks = graph->getBlocks();
+  for (size_t i = 0; i < blocks.size(); i++) {
+    std::list<Quad *>::iterator iter;
+    for (iter = blocks[i]->getQuads().begin();
+         iter != blocks[i]->getQuads().end(); ++iter) {
+      if ((*iter)->getLhs() >= 0)
+        defs[(*iter)->getLhs()].push_back(Def(*iter, blocks[i]));
+    }
+  }
+}
+
+/* Returns true if the temporary is defined once, to a constant or to
+   arithmetic of constants, whose value is returned in value. Values are
+   those of mvrt integers. */
+bool _const_value(DefMap& defs, int t, long long& value, int depth)
+{
+  /* a copy may go round a loop */
+  if (defs[t].size() != 1 || depth > 8)
+    return false;
+
+  Quad *q = defs[t][0].q;
+  long long a, b;
+  switch (q->getTag()) {
+  case QT_CONST:
+    value = q->getImm();
+    return true;
+  case QT_COPY:
+    return _const_value(defs, q->getArg(0), value, depth + 1);
+  case QT_ADD:
+  case QT_SUB:
+  case QT_MUL:
+    if (!_const_value(defs, q->getArg(0), a, depth + 1)
+        || !_const_value(defs, q->getArg(1), b, depth + 1))
+      return false;
+    value = q->getTag() == QT_ADD ? a + b
+      : q->getTag() == QT_SUB ? a - b : a * b;
+    return value >= INT_MIN && value <= INT_MAX;
+  default:
+    return false;
+  }
+}
+
+/* Returns the bound of the iterations of the loop, or -1 if none is
+   found. The loop runs while the test of its header holds; other exits
+   only end it sooner. */
+long long _loop_bound(BasicBlock *header, std::set<BasicBlock *>& body,
+                      DefMap& defs)
+{
+  static const QuadTag negations[] = {
+    QT_ADD, QT_SUB, QT_MUL, QT_DIV,
+    QT_NE, QT_EQ, QT_GE, QT_GT, QT_LE, QT_LT
+  };
+  static const QuadTag mirrors[] = {
+    QT_ADD, QT_SUB, QT_MUL, QT_DIV,
+    QT_EQ, QT_NE, QT_GT, QT_GE, QT_LT, QT_LE
+  };
+
+  Quad *branch = header->getTerminator();
+  if (!branch || branch->getTag() != QT_BRANCH)
+    return -1;
+  bool stays = body.count(branch->getTarget(0)) > 0;
+  if (stays == (body.count(branch->getTarget(1)) > 0))
+    return -1;
+
+  /* the comparison tested, as "i op limit", computed in the header at
+     each test */
+  int c = branch->getArg(0);
+  while (defs[c].size() == 1 && defs[c][0].blk == header
+         && defs[c][0].q->getTag() == QT_COPY)
+    c = defs[c][0].q->getArg(0);
+  if (defs[c].size() != 1 || defs[c][0].blk != header)
+    return -1;
+  Quad *cmp = defs[c][0].q;
+  QuadTag op = cmp->getTag();
+  if (op < QT_EQ || op > QT_GE)
+    return -1;
+  if (!stays)
+    op = negations[op];
+
+  int i = cmp->getArg(0);
+  long long limit;
+  if (!_const_value(defs, cmp->getArg(1), limit)) {
+    i = cmp->getArg(1);
+    op = mirrors[op];
+    if (!_const_value(defs, cmp->getArg(0), limit))
+      return -1;
+  }
+
+  /* the same constant before the loop, and one step in it */
+  Def *step = NULL;
+  long long init = 0;
+  bool hasinit = false;
+  for (size_t j = 0; j < defs[i].size(); j++) {
+    Def& def = defs[i][j];
+    if (body.count(def.blk) > 0) {
+      if (step)
+        return -1;
+      step = &def;
+      continue;
+    }
+    long long value;
+    if (def.q->getTag() == QT_CONST)
+      value = def.q->getImm();
+    else if (def.q->getTag() != QT_COPY
+             || !_const_value(defs, def.q->getArg(0), value))
+      return -1;
+    if (hasinit && value != init)
+      return -1;
+    init = value;
+    hasinit = true;
+  }
+  if (!step || !hasinit || !_runs_always(step->blk, header, body))
+    return -1;
+
+  /* i = i + k, or i = t with t = i + k in the same block */
+  Quad *q = step->q;
+  if (q->getTag() == QT_COPY) {
+    int t = q->getArg(0);
+    if (defs[t].size() != 1 || defs[t][0].blk != step->blk)
+      return -1;
+    q = defs[t][0].q;
+  }
+  if (q->getTag() != QT_ADD && q->getTag() != QT_SUB)
+    return -1;
+  int t;
+  if (q->getArg(0) == i)
+    t = q->getArg(1);
+  else if (q->getTag() == QT_ADD && q->getArg(1) == i)
+    t = q->getArg(0);
+  else
+    return -1;
+  long long k;
+  if (!_const_value(defs, t, k))
+    return -1;
+  if (q->getTag() == QT_SUB)
+    k = -k;
+
+  return _iterations(op, init, k, limit);
+}
+
+/* Returns true if every iteration of the loop runs the block: the header
+   is not reached again from itself, but through the block. */
+bool _runs_always(BasicBlock *blk, BasicBlock *header,
+                  std::set<BasicBlock *>& body)
+{
+  if (blk == header)
+    return true;
+
+  std::set<BasicBlock *> reached;
+  std::vector<BasicBlock *> work(1, header);
+  while (!work.empty()) {
+    BasicBlock *b = work.back();
+    work.pop_back();
+    std::vector<BasicBlock *>& succs = b->getSuccs();
+    for (size_t i = 0; i < succs.size(); i++) {
+      if (succs[i] == header)
+        return false;
+      if (succs[i] != blk && body.count(succs[i]) > 0
+          && reached.insert(succs[i]).second)
+        work.push_back(succs[i]);
+    }
+  }
+
+  return true;
+}
+
+/* Returns how many times "i op limit" holds for i from init on, by step,
+   or -1 if it may hold forever. */
+long long _iterations(QuadTag op, long long init, long long step,
+                      long long limit)
+{
+  bool holds;
+  switch (op) {
+  case QT_EQ: holds = init == limit; break;
+  case QT_NE: holds = init != limit; break;
+  case QT_LT: holds = init < limit; break;
+  case QT_LE: holds = init <= limit; break;
+  case QT_GT: holds = init > limit; break;
+  case QT_GE: holds = init >= limit; break;
+  default: return -1;
+  }
+  if (!holds)
+    return 0;
+
+  switch (op) {
+  case QT_EQ:
+    return step != 0 ? 1 : -1;
+  case QT_NE:
+    if (step == 0 || (limit - init) % step != 0 || (limit - init) / step < 0)
+      return -1;
+    return (limit - init) / step;
+  case QT_LT:
+    return step > 0 ? (limit - init + step - 1) / step : -1;
+  case QT_LE:
+    return step > 0 ? (limit - init) / step + 1 : -1;
+  case QT_GT:
+    return step < 0 ? (init - limit - step - 1) / -step : -1;
+  case QT_GE:
+    return step < 0 ? (init - limit) / -step + 1 : -1;
+  default:
+    return -1;
+  }
+}
+
+std::string _json_string(const std::string& s)
+{
+  std::string json = "\"";
+  for (size_t i = 0; i < s.size(); i++) {
+    unsigned char c = s[i];
+    if (c == '"' || c == '\\')
+      json += std::string("\\") + s[i];
+    else if (c < 0x20)
+      json += Util::sformat("\\u%04x", c);
+    else
+      json += s[i];
+  }
+
+  return json + "\"";
+}
+
+} /* mvc */
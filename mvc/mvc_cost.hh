@@ -0,0 +1,83 @@
+/**
+ * @file mvc_cost.hh
+ *
+ * @brief Static cost of reactors, for checking in advance that each one
+ * finishes within the period of its events.
+ */
+#ifndef MVC_COST_HH
+#define MVC_COST_HH
+
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include "mvc_ir.hh"
+#include "mvc_codegen.hh"
+
+namespace mvc {
+
+/* Counts of a run of a reactor in the worst case. A run is unbounded if
+   a loop it may run has no bound found, or a function it calls may call
+   itself. */
+struct WorstCase {
+  bool bounded;
+  double ninstrs;    /* instructions */
+  double nallocs;    /* instructions which allocate */
+  double nwaits;     /* round trips, each a suspension of the reactor */
+  double nsends;     /* messages not waited for */
+
+  WorstCase()
+    : bounded(true), ninstrs(0), nallocs(0), nwaits(0), nsends(0) { }
+};
+
+/**
+ * @class CostModel
+ *
+ * @brief Estimates the cost of each reactor of a module from its code:
+ * the counts of the code itself (see CodeStats), the iterations of its
+ * loops, and the counts of a run in the worst case.
+ *
+ * The iterations of a loop are bounded if its header tests a variable
+ * against a constant, and the variable starts at a constant, and is
+ * stepped by a constant once in every iteration, as in
+ *
+ *   for (i = 0; i < 8; i = i + 1) ...
+ *
+ * In the worst case, every block runs as many times as the loops it is
+ * in iterate, and the functions of the module a reactor calls are run
+ * with it, as the Placer counts them.
+ */
+class CostModel {
+public:
+  CostModel(IRModule *mod, CodeGen& codegen)
+    : _mod(mod), _codegen(codegen) { }
+
+  void run();
+
+  /* Writes the costs of the reactors as a JSON object, for file the
+     source of the module. */
+  void report(std::ostream& os, const std::string& file);
+
+private:
+  void findBounds(ControlGraph *graph);
+  WorstCase estimate(ControlGraph *graph, std::set<ControlGraph *>& callers);
+
+private:
+  CostModel(const CostModel& model) = delete;
+  CostModel& operator=(const CostModel& model) = delete;
+
+private:
+  IRModule *_mod;
+  CodeGen& _codegen;
+
+  /* loops of each graph, and the bound of the iterations of each loop by
+     header, or -1 if none is found */
+  std::map<ControlGraph *, LoopMap> _loops;
+  std::map<ControlGraph *, std::map<BasicBlock *, long long> > _bounds;
+
+  std::map<ControlGraph *, WorstCase> _worst;
+};
+
+} /* mvc */
+
+#endif /* MVC_COST_HH */
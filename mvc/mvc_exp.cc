@@ -7,97 +7,78 @@
 namespace mvc {
 
 
-SymbolExp::SymbolExp(const std::string& sym) : Exp(ET_SYMBOL)
-{
-  std::size_t pos = sym.find(":");
-  if (pos != std::string::npos) {
-    _dev = sym.substr(0, pos);
-    _name = sym.substr(pos + 1);
-  }
-  else 
-    _name = sym;
-}
-
-
 /*
  * ExpFactory
  */
-ExpFactory *ExpFactory::_instance = NULL;
-ExpFactory *ExpFactory::getInstance()
-{
-  if (!_instance)
-    _instance = new ExpFactory();
-
-  return _instance;
-}
-
-ExpFactory::ExpFactory()
-{
-}
-
-ExpFactory::~ExpFactory()
-{
-}
 
+/* Names are "name", or "dev:name" for the objects of a device. */
 SymbolExp *ExpFactory::createSymbol(const std::string& name)
 {
-  SymbolExp *symbol = new SymbolExp(name);
+  SymbolExp *symbol = NULL;
+  std::size_t pos = name.find(":");
+  if (pos != std::string::npos)
+    symbol = _arena.create<SymbolExp>(_idents.intern(name.substr(0, pos)),
+                                      _idents.intern(name.substr(pos + 1)));
+  else
+    symbol = _arena.create<SymbolExp>(_idents.intern(""),
+                                      _idents.intern(name));
   
   return symbol;
 }
 
 FieldrefExp *ExpFactory::createFieldref(Exp *varref, const std::string& field) 
 {
-  FieldrefExp *fieldref = new FieldrefExp(varref, field);
+  FieldrefExp *fieldref = _arena.create<FieldrefExp>(varref,
+                                                     _idents.intern(field));
   
   return fieldref;
 }
 
 ArrayrefExp *ExpFactory::createArrayref(Exp *varref, Exp *index) 
 {
-  ArrayrefExp *arrayref = new ArrayrefExp(varref, index);
+  ArrayrefExp *arrayref = _arena.create<ArrayrefExp>(varref, index);
   
   return arrayref;
 }
 
 IntegerExp *ExpFactory::createInteger(int v)
 {
-  IntegerExp *intexp = new IntegerExp(v);
+  IntegerExp *intexp = _arena.create<IntegerExp>(v);
   
   return intexp;
 }
 
 FloatExp *ExpFactory::createFloat(float v)
 {
-  FloatExp *floatexp = new FloatExp(v);
+  FloatExp *floatexp = _arena.create<FloatExp>(v);
   
   return floatexp;
 }
 
 StringExp *ExpFactory::createString(const std::string& v)
 {
-  StringExp *strexp = new StringExp(v);
+  StringExp *strexp = _arena.create<StringExp>(_idents.intern(v));
   
   return strexp;
 }
 
 UnaryExp *ExpFactory::createUnary(UnaryTag utag, Exp *exp)
 {
-  UnaryExp *unary = new UnaryExp(utag, exp);
+  UnaryExp *unary = _arena.create<UnaryExp>(utag, exp);
   
   return unary;
 }
 
 BinaryExp *ExpFactory::createBinary(BinaryTag btag, Exp *lexp, Exp *rexp)
 {
-  BinaryExp *binary = new BinaryExp(btag, lexp, rexp);
+  BinaryExp *binary = _arena.create<BinaryExp>(btag, lexp, rexp);
   
   return binary;
 }
 
-FuncallExp *ExpFactory::createFuncall(SymbolExp *name, std::list<Exp *> *args)
+FuncallExp *ExpFactory::createFuncall(SymbolExp *name, ExpList *args)
 {
-  FuncallExp *call = new FuncallExp(name, args);
+  FuncallExp *call = _arena.create<FuncallExp>(name, args);
 
   return call;
 }
@@ -105,10 +86,17 @@ FuncallExp *ExpFactory::createFuncall(SymbolExp *name, std::list<Exp *> *args)
 TimeExp *ExpFactory::createTime(size_t d, size_t h, size_t m, size_t s, 
                                 size_t ms)
 {
-  TimeExp *timexp = new TimeExp(d, h, m, s, ms);
+  TimeExp *timexp = _arena.create<TimeExp>(d, h, m, s, ms);
 
   return timexp;
 }
 
+ExpList *ExpFactory::createList()
+{
+  ExpList *list = _arena.create<ExpList>();
+
+  return list;
+}
+
 
 } /* mvc */
@@ -7,9 +7,11 @@
 #define MVC_EXP_HH
 
 #include <string>
-#include <list>
 #include <vector>
 #include <mv/defs.h>
+#include "adt/arena.h"
+#include "adt/ilist.h"
+#include "mvc_ident.hh"
 #include "mvc_visitor.hh"
 
 namespace mvc {
@@ -63,17 +65,24 @@ enum BinaryTag {
 
 /**
  * @class Exp
+ *
+ * @brief Expressions are allocated in the arena of their module, and
+ * destroyed with it, never deleted one by one.
  */
 class ExpVisitor;
-class Exp {
+class Exp : public ilist_node<Exp> {
 public:
   Exp(ExpTag t) : _tag(t) { }
-  virtual ~Exp() { }
 
   ExpTag getTag() { return _tag; }
 
   virtual void accept(ExpVisitor& v) = 0;
 
+protected:
+  /* not virtual, nor anything to destroy: the arena frees expressions
+     without running their destructors */
+  ~Exp() = default;
+
 private:
   Exp(const Exp& exp) = delete;
   Exp& operator=(const Exp& exp) = delete;
@@ -82,25 +91,28 @@ protected:
   ExpTag _tag;
 };
 
+typedef ilist<Exp> ExpList;
+
 /**
  * @class SymbolExp
  */
 class SymbolExp : public Exp {
 public:
-  SymbolExp(const std::string& sym);
-  ~SymbolExp() { }
+  SymbolExp(Ident dev, Ident name)
+    : Exp(ET_SYMBOL), _dev(dev), _name(name) { }
 
-  std::string& getDev() { return _dev; }
-  std::string& getName() { return _name; }
+  const std::string& getDev() { return *_dev; }
+  const std::string& getName() { return *_name; }
+  Ident getIdent() { return _name; }
   
   void accept(ExpVisitor& v) { v.visitSymbolExp(this); }
 
   /** Returns true iff symbol denotes a local object. */
-  bool isLocal() { return (_dev == "") ? true : false; }
+  bool isLocal() { return _dev->empty(); }
 
 private:
-  std::string _dev;
-  std::string _name;
+  Ident _dev;
+  Ident _name;
 };
 
 /**
@@ -108,18 +120,17 @@ private:
  */
 class FieldrefExp : public Exp {
 public:
-  FieldrefExp(Exp *varref, const std::string& field) 
+  FieldrefExp(Exp *varref, Ident field) 
     : Exp(ET_FIELDREF), _varref(varref), _field(field) { }
-  ~FieldrefExp() { }
 
   Exp *getVarref() { return _varref; }
-  const std::string& getField() { return _field; }
+  const std::string& getField() { return *_field; }
   
   void accept(ExpVisitor& v) { v.visitFieldrefExp(this); }
 
 private:
   Exp *_varref;
-  std::string _field;
+  Ident _field;
 };
 
 /**
@@ -128,8 +139,7 @@ private:
 class ArrayrefExp : public Exp {
 public:
   ArrayrefExp(Exp *varref, Exp *index) 
-    : Exp(ET_FIELDREF), _varref(varref), _index(index) { }
-  ~ArrayrefExp() { }
+    : Exp(ET_ARRAYREF), _varref(varref), _index(index) { }
 
   Exp *getVarref() { return _varref; }
   Exp *getIndex() { return _index; }
@@ -147,7 +157,6 @@ private:
 class IntegerExp : public Exp {
 public:
   IntegerExp(int v) : Exp(ET_INTEGER), _value(v) { }
-  ~IntegerExp() { }
 
   const int getValue() { return _value; }
 
@@ -163,7 +172,6 @@ private:
 class FloatExp : public Exp {
 public:
   FloatExp(float v) : Exp(ET_FLOAT), _value(v) { }
-  ~FloatExp() { }
 
   const float getValue() { return _value; }
 
@@ -178,15 +186,14 @@ private:
  */
 class StringExp : public Exp {
 public:
-  StringExp(const std::string& v) : Exp(ET_STRING), _value(v) { }
-  ~StringExp() { }
+  StringExp(Ident v) : Exp(ET_STRING), _value(v) { }
 
-  const std::string getValue() { return _value; }
+  const std::string& getValue() { return *_value; }
 
   void accept(ExpVisitor& v) { v.visitStringExp(this); }
 
 private:
-  std::string _value;
+  Ident _value;
 };
 
 /**
@@ -195,7 +202,6 @@ private:
 class UnaryExp : public Exp {
 public:
   UnaryExp(UnaryTag utag, Exp *exp) : Exp(ET_UNARY), _utag(utag), _exp(exp) { }
-  ~UnaryExp() { }
 
   UnaryTag getUnaryTag()  { return _utag; }
   
@@ -217,7 +223,6 @@ public:
 public:
   BinaryExp(BinaryTag btag, Exp *lexp, Exp *rexp) 
     : Exp(ET_BINARY), _btag(btag), _lexp(lexp), _rexp(rexp) { }
-  ~BinaryExp() { }
 
   Exp *getLexp() { return _lexp; }
   Exp *getRexp() { return _rexp; }
@@ -237,18 +242,17 @@ private:
  */
 class FuncallExp : public Exp {
 public:
-  FuncallExp(SymbolExp *name, std::list<Exp *> *args) 
+  FuncallExp(SymbolExp *name, ExpList *args) 
     : Exp(ET_FUNCALL), _name(name), _args(args) { }
-  ~FuncallExp() { }
 
   SymbolExp *getName() { return _name; }
-  std::list<Exp *> *getArgs() { return _args; }
+  ExpList *getArgs() { return _args; }
   
   void accept(ExpVisitor& v) { v.visitFuncallExp(this); }
 
 private:
   SymbolExp *_name;
-  std::list<Exp *> *_args;
+  ExpList *_args;
 };
 
 /**
@@ -264,7 +268,6 @@ public:
     _msec += (hr * 60 * 60 * 1000);
     _msec += (day * 24 * 60 * 60 * 1000);
   }
-  ~TimeExp() { }
   
   size_t getMilliseconds() { return _msec; }
 
@@ -278,12 +281,16 @@ private:
 
 /**
  * @class ExpFactory
+ *
+ * @brief Creates the expressions of a module, in its arena, with their
+ * names and strings interned in its identifiers.
  */
 class ExpFactory {
 public:
-  static ExpFactory *getInstance();
+  ExpFactory(Arena& arena, IdentTab& idents)
+    : _arena(arena), _idents(idents) { }
+  ~ExpFactory() { }
 
-public:
   SymbolExp *createSymbol(const std::string& name);
   FieldrefExp *createFieldref(Exp *varref, const std::string& field);
   ArrayrefExp *createArrayref(Exp *varref, Exp *index);
@@ -294,15 +301,18 @@ public:
   UnaryExp *createUnary(UnaryTag utag, Exp *exp);
   BinaryExp *createBinary(BinaryTag btag, Exp *lexp, Exp *rexp);
   
-  FuncallExp *createFuncall(SymbolExp *name, std::list<Exp *> *args);
+  FuncallExp *createFuncall(SymbolExp *name, ExpList *args);
   TimeExp *createTime(size_t d, size_t h, size_t m, size_t s, size_t ms);
 
-protected:
-  ExpFactory();
-  virtual ~ExpFactory();
+  ExpList *createList();
+
+private:
+  ExpFactory(const ExpFactory& factory) = delete;
+  ExpFactory& operator=(const ExpFactory& factory) = delete;
 
 private:
-  static ExpFactory *_instance;
+  Arena& _arena;
+  IdentTab& _idents;
 };
 
 } /* mv */
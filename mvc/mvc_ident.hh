@@ -0,0 +1,52 @@
+/**
+ * @file mvc_ident.hh
+ *
+ * @brief Interface to interned identifiers.
+ */
+#ifndef MVC_IDENT_HH
+#define MVC_IDENT_HH
+
+#include <string>
+#include <unordered_set>
+
+namespace mvc {
+
+/* An interned identifier. Equal names are the same Ident, so they are
+   compared and hashed as pointers. */
+typedef const std::string *Ident;
+
+/**
+ * @class IdentTab
+ *
+ * @brief Interns identifiers. The Idents live as long as the table.
+ */
+class IdentTab {
+public:
+  IdentTab() { }
+  ~IdentTab() { }
+
+  Ident intern(const std::string& name) {
+    return &*_idents.insert(name).first;
+  }
+
+  /* Returns the Ident of the name, or NULL if it is not interned. */
+  Ident find(const std::string& name) {
+    std::unordered_set<std::string>::iterator iter = _idents.find(name);
+    if (iter == _idents.end())
+      return NULL;
+
+    return &*iter;
+  }
+
+private:
+  IdentTab(const IdentTab& tab) = delete;
+  IdentTab& operator=(const IdentTab& tab) = delete;
+
+private:
+  /* nodes do not move, even when rehashed */
+  std::unordered_set<std::string> _idents;
+};
+
+} /* mvc */
+
+#endif /* MVC_IDENT_HH */
@@ -0,0 +1,962 @@
+/**
+ * @file mvc_ir.cc
+ *
+ * @brief Intermediate representation, and lowering of reactors and
+ * functions from statements to quads.
+ */
+#include <algorithm>
+#include <map>
+#include <set>
+#include "mvc_ir.hh"
+#include "mvc_util.hh"
+
+namespace mvc {
+
+static void _find_loops(BasicBlock *blk, std::set<BasicBlock *>& visited,
+                        std::set<BasicBlock *>& onstack, LoopMap& loops);
+
+/*
+ * Quad
+ */
+static const char *_qtagstr[] = {
+  "add", "sub", "mul", "div",
+  "eq", "ne", "lt", "le", "gt", "ge", "and", "or",
+  "const", "string", "null",
+  "copy", "arg", "param", "getf", "index", "prop_get",
+  "prop_set", "setf", "call", "trigger",
+  "jump", "branch", "ret",
+  "phi"
+};
+
+const char *Quad::getTagstr(QuadTag tag)
+{
+  return _qtagstr[tag];
+}
+
+EffectTag Quad::getEffect()
+{
+  if (isSuspension())
+    return EF_WRITE;
+
+  switch (_tag) {
+  case QT_GETF:
+  case QT_INDEX:
+  case QT_PROP_GET:
+    return EF_READ;
+  case QT_PROP_SET:
+  case QT_SETF:
+  case QT_FUNCALL:
+  case QT_TRIGGER:
+  case QT_JUMP:
+  case QT_BRANCH:
+  case QT_RET:
+    return EF_WRITE;
+  default:
+    break;
+  }
+
+  return EF_PURE;
+}
+
+bool Quad::isSuspension()
+{
+  if (_tag == QT_PROP_GET)
+    return _sym.find(':') != std::string::npos;
+  if (_tag == QT_FUNCALL)
+    return _imm == CT_REMOTE && _lhs >= 0;
+
+  return false;
+}
+
+void Quad::print(std::ostream& os)
+{
+  if (_lhs >= 0)
+    os << "t" << _lhs << " = ";
+  os << getTagstr(_tag);
+
+  switch (_tag) {
+  case QT_CONST:
+  case QT_PARAM:
+    os << " " << _imm;
+    break;
+  case QT_STRING:
+  case QT_GETF:
+  case QT_PROP_GET:
+  case QT_PROP_SET:
+  case QT_SETF:
+  case QT_FUNCALL:
+  case QT_TRIGGER:
+    os << " \"" << _sym << "\"";
+    break;
+  default:
+    break;
+  }
+
+  for (size_t i = 0; i < _args.size(); i++) {
+    os << (i == 0 ? " " : ", ") << "t" << _args[i];
+    if (i < _sources.size())
+      os << " (B" << _sources[i]->getId() << ")";
+  }
+
+  if (_targets[0])
+    os << " -> B" << _targets[0]->getId();
+  if (_targets[1])
+    os << ", B" << _targets[1]->getId();
+}
+
+
+/*
+ * BasicBlock
+ */
+BasicBlock::~BasicBlock()
+{
+  std::list<Quad *>::iterator iter;
+  for (iter = _quads.begin(); iter != _quads.end(); ++iter)
+    delete *iter;
+}
+
+void BasicBlock::print(std::ostream& os)
+{
+  os << "B" << _id << ":";
+  if (!_preds.empty()) {
+    os << "    ; preds";
+    for (size_t i = 0; i < _preds.size(); i++)
+      os << " B" << _preds[i]->getId();
+  }
+  os << std::endl;
+
+  std::list<Quad *>::iterator iter;
+  for (iter = _quads.begin(); iter != _quads.end(); ++iter) {
+    os << "  ";
+    (*iter)->print(os);
+    os << std::endl;
+  }
+}
+
+
+/*
+ * ControlGraph
+ */
+ControlGraph::~ControlGraph()
+{
+  for (size_t i = 0; i < _blocks.size(); i++)
+    delete _blocks[i];
+}
+
+BasicBlock *ControlGraph::newBlock()
+{
+  BasicBlock *blk = new BasicBlock(_blocks.size());
+  _blocks.push_back(blk);
+
+  return blk;
+}
+
+void ControlGraph::addBlock(BasicBlock *blk)
+{
+  blk->setId(_blocks.size());
+  _blocks.push_back(blk);
+}
+
+int ControlGraph::newTemp(const std::string& name)
+{
+  _tempnames.push_back(name);
+
+  return _tempnames.size() - 1;
+}
+
+void ControlGraph::link()
+{
+  std::set<BasicBlock *> reached;
+  std::vector<BasicBlock *> work;
+  work.push_back(getEntry());
+  reached.insert(getEntry());
+  while (!work.empty()) {
+    BasicBlock *blk = work.back();
+    work.pop_back();
+
+    Quad *term = blk->getTerminator();
+    for (int i = 0; term && i < 2; i++) {
+      BasicBlock *succ = term->getTarget(i);
+      if (succ && reached.insert(succ).second)
+        work.push_back(succ);
+    }
+  }
+
+  std::vector<BasicBlock *> blocks;
+  for (size_t i = 0; i < _blocks.size(); i++) {
+    BasicBlock *blk = _blocks[i];
+    if (!reached.count(blk)) {
+      delete blk;
+      continue;
+    }
+    blk->setId(blocks.size());
+    blk->getPreds().clear();
+    blk->getSuccs().clear();
+    blocks.push_back(blk);
+  }
+  _blocks.swap(blocks);
+
+  for (size_t i = 0; i < _blocks.size(); i++) {
+    BasicBlock *blk = _blocks[i];
+    Quad *term = blk->getTerminator();
+    for (int j = 0; term && j < 2; j++) {
+      BasicBlock *succ = term->getTarget(j);
+      if (!succ || (j == 1 && succ == term->getTarget(0)))
+        continue;
+      blk->getSuccs().push_back(succ);
+      succ->getPreds().push_back(blk);
+    }
+  }
+
+  for (size_t i = 0; i < _blocks.size(); i++) {
+    std::vector<BasicBlock *>& preds = _blocks[i]->getPreds();
+    std::list<Quad *>& quads = _blocks[i]->getQuads();
+    std::list<Quad *>::iterator iter;
+    for (iter = quads.begin(); iter != quads.end(); ++iter) {
+      Quad *q = *iter;
+      if (q->getTag() != QT_PHI)
+        break;
+
+      std::vector<BasicBlock *>& sources = q->getSources();
+      std::vector<int>& args = q->getArgs();
+      for (size_t j = sources.size(); j > 0; j--) {
+        if (std::find(preds.begin(), preds.end(), sources[j - 1])
+            == preds.end()) {
+          sources.erase(sources.begin() + j - 1);
+          args.erase(args.begin() + j - 1);
+        }
+      }
+    }
+  }
+}
+
+void ControlGraph::findLoops(LoopMap& loops)
+{
+  std::set<BasicBlock *> visited, onstack;
+  _find_loops(getEntry(), visited, onstack, loops);
+}
+
+int ControlGraph::getNquads()
+{
+  int n = 0;
+  for (size_t i = 0; i < _blocks.size(); i++)
+    n += _blocks[i]->getQuads().size();
+
+  return n;
+}
+
+void ControlGraph::print(std::ostream& os)
+{
+  os << (_tag == GT_REACTOR ? "reactor " : "function ") << _name << " (";
+  for (size_t i = 0; i < _params.size(); i++)
+    os << (i == 0 ? "" : ", ") << _params[i];
+  os << ")" << std::endl;
+
+  /* the variables which are still defined */
+  std::set<int> defined;
+  for (size_t i = 0; i < _blocks.size(); i++) {
+    std::list<Quad *>& quads = _blocks[i]->getQuads();
+    std::list<Quad *>::iterator iter;
+    for (iter = quads.begin(); iter != quads.end(); ++iter) {
+      if ((*iter)->getLhs() >= 0)
+        defined.insert((*iter)->getLhs());
+    }
+  }
+  for (int t = 0; t < getNtemps(); t++) {
+    if (_tempnames[t] != "" && defined.count(t))
+      os << "  ; t" << t << " is " << _tempnames[t] << std::endl;
+  }
+
+  for (size_t i = 0; i < _blocks.size(); i++)
+    _blocks[i]->print(os);
+}
+
+
+/*
+ * IRModule
+ */
+IRModule::~IRModule()
+{
+  for (size_t i = 0; i < _graphs.size(); i++)
+    delete _graphs[i];
+}
+
+ControlGraph *IRModule::getFunction(const std::string& name)
+{
+  for (size_t i = 0; i < _graphs.size(); i++) {
+    if (_graphs[i]->getTag() == GT_FUNCTION && _graphs[i]->getName() == name)
+      return _graphs[i];
+  }
+
+  return NULL;
+}
+
+int IRModule::getNquads()
+{
+  int n = 0;
+  for (size_t i = 0; i < _graphs.size(); i++)
+    n += _graphs[i]->getNquads();
+
+  return n;
+}
+
+void IRModule::print(std::ostream& os)
+{
+  os << "module " << _name << std::endl;
+  for (size_t i = 0; i < _graphs.size(); i++) {
+    os << std::endl;
+    _graphs[i]->print(os);
+  }
+}
+
+
+/**
+ * @class IRBuilderImpl
+ */
+class IRBuilderImpl {
+public:
+  IRBuilderImpl(SymTab& symtab) : _symtab(symtab) { }
+  ~IRBuilderImpl() { }
+
+  IRModule *build(Module *mod);
+
+private:
+  ControlGraph *buildProcdef(ProcdefStm *procdef);
+  ControlGraph *buildFundef(FundefStm *fundef);
+  void buildBody(Stm *body);
+
+  void buildStm(Stm *stm);
+  void buildAssign(AssignStm *stm);
+  void buildIf(Exp *cond, Stm *then, Stm *elsee);
+  void buildLoop(Stm *init, Exp *cond, Stm *step, Stm *body);
+  void buildTrigger(TriggerStm *stm);
+  void buildCond(Exp *exp, BasicBlock *t, BasicBlock *f);
+
+  int buildExp(Exp *exp);
+  int buildSymbol(SymbolExp *sym);
+  Quad *buildCall(FuncallExp *call, int lhs);
+
+  Quad *emit(QuadTag tag, int lhs = -1);
+  void jump(BasicBlock *target);
+  void startBlock(BasicBlock *blk);
+  int lookupVar(const std::string& name, bool create);
+
+  void error(const std::string& s);
+
+private:
+  SymTab& _symtab;
+  int _nerrors;
+
+  /* graph being built */
+  ControlGraph *_graph;
+  BasicBlock *_cur;
+  std::map<std::string, int> _vars;
+
+  /* targets of break and continue */
+  std::vector<BasicBlock *> _breaks;
+  std::vector<BasicBlock *> _continues;
+};
+
+
+IRModule *IRBuilderImpl::build(Module *mod)
+{
+  _nerrors = 0;
+
+  IRModule *irmod = new IRModule(mod->getName()->getName());
+  StmList& stms = mod->getStms();
+  StmList::iterator iter;
+  for (iter = stms.begin(); iter != stms.end(); ++iter) {
+    Stm *stm = *iter;
+    switch (stm->getTag()) {
+    case ST_VARDEF:
+    case ST_EVENTDEF: {
+      /* redefinitions are reported by the analyzer */
+      std::vector<std::string>& names = (stm->getTag() == ST_VARDEF)
+        ? irmod->getProps() : irmod->getEvents();
+      const std::string& name = (stm->getTag() == ST_VARDEF)
+        ? static_cast<VardefStm *>(stm)->getSym()->getName()
+        : static_cast<EventdefStm *>(stm)->getSym()->getName();
+      if (std::find(names.begin(), names.end(), name) == names.end())
+        names.push_back(name);
+      break;
+    }
+    case ST_PROCDEF:
+      irmod->getGraphs().push_back(
+        buildProcdef(static_cast<ProcdefStm *>(stm)));
+      break;
+    case ST_FUNDEF:
+      irmod->getGraphs().push_back(
+        buildFundef(static_cast<FundefStm *>(stm)));
+      break;
+    default:
+      break;
+    }
+  }
+
+  if (_nerrors > 0) {
+    delete irmod;
+    return NULL;
+  }
+
+  return irmod;
+}
+
+ControlGraph *IRBuilderImpl::buildProcdef(ProcdefStm *procdef)
+{
+  _graph = new ControlGraph(GT_REACTOR, procdef->getSym()->getName());
+
+  ExpList& events = procdef->getEvents();
+  ExpList::iterator iter;
+  for (iter = events.begin(); iter != events.end(); ++iter) {
+    SymbolExp *sym = static_cast<SymbolExp *>(*iter);
+    _graph->getParams().push_back(sym->getName());
+  }
+  buildBody(procdef->getBody());
+
+  return _graph;
+}
+
+ControlGraph *IRBuilderImpl::buildFundef(FundefStm *fundef)
+{
+  _graph = new ControlGraph(GT_FUNCTION, fundef->getSym()->getName());
+
+  ExpList::iterator iter;
+  for (iter = fundef->getParams()->begin();
+       iter != fundef->getParams()->end(); ++iter) {
+    SymbolExp *sym = static_cast<SymbolExp *>(*iter);
+    _graph->getParams().push_back(sym->getName());
+  }
+  buildBody(fundef->getBody());
+
+  return _graph;
+}
+
+void IRBuilderImpl::buildBody(Stm *body)
+{
+  _vars.clear();
+  _breaks.clear();
+  _continues.clear();
+
+  _cur = NULL;
+  startBlock(new BasicBlock(0));
+  buildStm(body);
+  if (!_cur->getTerminator())
+    emit(QT_RET);
+
+  _graph->link();
+}
+
+void IRBuilderImpl::buildStm(Stm *stm)
+{
+  /* code after return, break or continue is unreachable, and is removed
+     by ControlGraph::link() */
+  if (_cur->getTerminator())
+    startBlock(new BasicBlock(0));
+
+  switch (stm->getTag()) {
+  case ST_BLOCK: {
+    StmList& body = static_cast<BlockStm *>(stm)->getBody();
+    StmList::iterator iter;
+    for (iter = body.begin(); iter != body.end(); ++iter)
+      buildStm(*iter);
+    break;
+  }
+  case ST_VARDEF: {
+    int var = lookupVar(static_cast<VardefStm *>(stm)->getSym()->getName(),
+                        true);
+    emit(QT_NULL, var);
+    break;
+  }
+  case ST_IF: {
+    IfStm *ifstm = static_cast<IfStm *>(stm);
+    buildIf(ifstm->getCond(), ifstm->getStm(), NULL);
+    break;
+  }
+  case ST_IFELSE: {
+    IfElseStm *ifelse = static_cast<IfElseStm *>(stm);
+    buildIf(ifelse->getCond(), ifelse->getThenStm(), ifelse->getElseStm());
+    break;
+  }
+  case ST_WHILE: {
+    WhileStm *whilestm = static_cast<WhileStm *>(stm);
+    buildLoop(NULL, whilestm->getCond(), NULL, whilestm->getBody());
+    break;
+  }
+  case ST_FOR: {
+    ForStm *forstm = static_cast<ForStm *>(stm);
+    buildLoop(forstm->getInit(), forstm->getCond(), forstm->getStep(),
+              forstm->getBody());
+    break;
+  }
+  case ST_ASSIGN:
+    buildAssign(static_cast<AssignStm *>(stm));
+    break;
+  case ST_FUNCALL:
+    buildCall(static_cast<FuncallStm *>(stm)->getCall(), -1);
+    break;
+  case ST_TRIGGER:
+    buildTrigger(static_cast<TriggerStm *>(stm));
+    break;
+  case ST_RETURN: {
+    Exp *exp = static_cast<ReturnStm *>(stm)->getExp();
+    if (exp && _graph->getTag() == GT_REACTOR) {
+      error("Reactor \"" + _graph->getName() + "\" returns a value.");
+      exp = NULL;
+    }
+    int t = exp ? buildExp(exp) : -1;
+    Quad *ret = emit(QT_RET);
+    if (t >= 0)
+      ret->addArg(t);
+    break;
+  }
+  case ST_BREAK:
+  case ST_CONTINUE: {
+    std::vector<BasicBlock *>& targets =
+      (stm->getTag() == ST_BREAK) ? _breaks : _continues;
+    if (targets.empty()) {
+      error(Util::sformat("\"%s\" outside of a loop in \"%s\".",
+                          stm->getTag() == ST_BREAK ? "break" : "continue",
+                          _graph->getName().c_str()));
+      break;
+    }
+    jump(targets.back());
+    break;
+  }
+  default:
+    error(Util::sformat("Statement not allowed in \"%s\".",
+                        _graph->getName().c_str()));
+    break;
+  }
+}
+
+void IRBuilderImpl::buildAssign(AssignStm *stm)
+{
+  Exp *lhs = stm->getLhs();
+  switch (lhs->getTag()) {
+  case ET_SYMBOL: {
+    SymbolExp *sym = static_cast<SymbolExp *>(lhs);
+    const std::string& name = sym->getName();
+    Value *value = sym->isLocal() ? _symtab.lookup(sym->getIdent()) : NULL;
+    if (!sym->isLocal()) {
+      error("Assignment to a remote object: " + sym->getDev() + ":" + name);
+    }
+    else if (value && value->getTag() == VT_PROP && !_vars.count(name)) {
+      int t = buildExp(stm->getRhs());
+      Quad *set = emit(QT_PROP_SET);
+      set->setSym(name);
+      set->addArg(t);
+    }
+    else {
+      std::vector<std::string>& params = _graph->getParams();
+      for (size_t i = 0; i < params.size(); i++) {
+        if (params[i] == name) {
+          error("Assignment to parameter: " + name);
+          return;
+        }
+      }
+      int t = buildExp(stm->getRhs());
+      emit(QT_COPY, lookupVar(name, true))->addArg(t);
+    }
+    break;
+  }
+  case ET_FIELDREF: {
+    FieldrefExp *ref = static_cast<FieldrefExp *>(lhs);
+    int rec = buildExp(ref->getVarref());
+    int t = buildExp(stm->getRhs());
+    Quad *setf = emit(QT_SETF);
+    setf->setSym(ref->getField());
+    setf->addArg(rec);
+    setf->addArg(t);
+    break;
+  }
+  case ET_ARRAYREF: {
+    ArrayrefExp *ref = static_cast<ArrayrefExp *>(lhs);
+    int rec = buildExp(ref->getVarref());
+    int key = buildExp(ref->getIndex());
+    int t = buildExp(stm->getRhs());
+    Quad *setf = emit(QT_SETF);
+    setf->addArg(rec);
+    setf->addArg(t);
+    setf->addArg(key);
+    break;
+  }
+  default:
+    error("Invalid left-hand side of assignment.");
+    break;
+  }
+}
+
+void IRBuilderImpl::buildIf(Exp *cond, Stm *then, Stm *elsee)
+{
+  BasicBlock *thenblk = new BasicBlock(0);
+  BasicBlock *elseblk = elsee ? new BasicBlock(0) : NULL;
+  BasicBlock *joinblk = new BasicBlock(0);
+
+  buildCond(cond, thenblk, elseblk ? elseblk : joinblk);
+  startBlock(thenblk);
+  buildStm(then);
+  if (elseblk) {
+    jump(joinblk);
+    startBlock(elseblk);
+    buildStm(elsee);
+  }
+  startBlock(joinblk);
+}
+
+void IRBuilderImpl::buildLoop(Stm *init, Exp *cond, Stm *step, Stm *body)
+{
+  BasicBlock *headblk = new BasicBlock(0);
+  BasicBlock *bodyblk = new BasicBlock(0);
+  BasicBlock *stepblk = step ? new BasicBlock(0) : headblk;
+  BasicBlock *exitblk = new BasicBlock(0);
+
+  if (init)
+    buildStm(init);
+  startBlock(headblk);
+  if (cond)
+    buildCond(cond, bodyblk, exitblk);
+
+  startBlock(bodyblk);
+  _breaks.push_back(exitblk);
+  _continues.push_back(stepblk);
+  buildStm(body);
+  _breaks.pop_back();
+  _continues.pop_back();
+
+  if (step) {
+    startBlock(stepblk);
+    buildStm(step);
+  }
+  jump(headblk);
+  startBlock(exitblk);
+}
+
+void IRBuilderImpl::buildTrigger(TriggerStm *stm)
+{
+  ExpList& events = stm->getEvents();
+  ExpList::iterator eiter;
+  for (eiter = events.begin(); eiter != events.end(); ++eiter) {
+    Exp *event = *eiter;
+    SymbolExp *sym = NULL;
+    FuncallExp *call = NULL;
+    if (event->getTag() == ET_SYMBOL)
+      sym = static_cast<SymbolExp *>(event);
+    else if (event->getTag() == ET_FUNCALL) {
+      call = static_cast<FuncallExp *>(event);
+      sym = call->getName();
+    }
+    else {
+      error("Invalid event to trigger.");
+      continue;
+    }
+
+    Value *value = sym->isLocal() ? _symtab.lookup(sym->getIdent()) : NULL;
+    if (value && value->getTag() != VT_EVENT) {
+      error("Not an event: " + sym->getName());
+      continue;
+    }
+
+    std::vector<int> args;
+    if (call) {
+      ExpList::iterator iter;
+      for (iter = call->getArgs()->begin(); iter != call->getArgs()->end();
+           ++iter)
+        args.push_back(buildExp(*iter));
+    }
+    Quad *trigger = emit(QT_TRIGGER);
+    trigger->setSym(sym->isLocal() ? sym->getName()
+                    : sym->getDev() + ":" + sym->getName());
+    for (size_t j = 0; j < args.size(); j++)
+      trigger->addArg(args[j]);
+  }
+}
+
+/* Branches to t if exp holds, and to f otherwise. && and || are
+   short-circuited. */
+void IRBuilderImpl::buildCond(Exp *exp, BasicBlock *t, BasicBlock *f)
+{
+  if (exp->getTag() == ET_BINARY) {
+    BinaryExp *bexp = static_cast<BinaryExp *>(exp);
+    BinaryTag btag = bexp->getBinaryTag();
+    if (btag == BOT_AND || btag == BOT_OR) {
+      BasicBlock *rhsblk = new BasicBlock(0);
+      if (btag == BOT_AND)
+        buildCond(bexp->getLexp(), rhsblk, f);
+      else
+        buildCond(bexp->getLexp(), t, rhsblk);
+      startBlock(rhsblk);
+      buildCond(bexp->getRexp(), t, f);
+      return;
+    }
+  }
+
+  int c = buildExp(exp);
+  Quad *branch = emit(QT_BRANCH);
+  branch->addArg(c);
+  branch->setTarget(0, t);
+  branch->setTarget(1, f);
+}
+
+int IRBuilderImpl::buildExp(Exp *exp)
+{
+  int t = -1;
+
+  switch (exp->getTag()) {
+  case ET_INTEGER:
+    t = _graph->newTemp();
+    emit(QT_CONST, t)->setImm(static_cast<IntegerExp *>(exp)->getValue());
+    break;
+  case ET_TIME:
+    t = _graph->newTemp();
+    emit(QT_CONST, t)->setImm(
+      static_cast<TimeExp *>(exp)->getMilliseconds());
+    break;
+  case ET_STRING: {
+    /* the scanner keeps the quotes */
+    std::string s = static_cast<StringExp *>(exp)->getValue();
+    if (s.size() >= 2 && s[0] == '"')
+      s = s.substr(1, s.size() - 2);
+    if (s.find_first_of(" \t\"") != std::string::npos)
+      error("String with blanks or quotes is not supported: " + s);
+    t = _graph->newTemp();
+    emit(QT_STRING, t)->setSym(s);
+    break;
+  }
+  case ET_FLOAT:
+    error("Float is not supported by the runtime.");
+    t = _graph->newTemp();
+    emit(QT_NULL, t);
+    break;
+  case ET_SYMBOL:
+    t = buildSymbol(static_cast<SymbolExp *>(exp));
+    break;
+  case ET_FIELDREF: {
+    FieldrefExp *ref = static_cast<FieldrefExp *>(exp);
+    int rec = buildExp(ref->getVarref());
+    t = _graph->newTemp();
+    Quad *getf = emit(QT_GETF, t);
+    getf->setSym(ref->getField());
+    getf->addArg(rec);
+    break;
+  }
+  case ET_ARRAYREF: {
+    ArrayrefExp *ref = static_cast<ArrayrefExp *>(exp);
+    int rec = buildExp(ref->getVarref());
+    int key = buildExp(ref->getIndex());
+    t = _graph->newTemp();
+    Quad *index = emit(QT_INDEX, t);
+    index->addArg(rec);
+    index->addArg(key);
+    break;
+  }
+  case ET_UNARY: {
+    /* -e is 0 - e */
+    UnaryExp *uexp = static_cast<UnaryExp *>(exp);
+    int zero = _graph->newTemp();
+    emit(QT_CONST, zero)->setImm(0);
+    int e = buildExp(uexp->getExp());
+    t = _graph->newTemp();
+    Quad *sub = emit(QT_SUB, t);
+    sub->addArg(zero);
+    sub->addArg(e);
+    break;
+  }
+  case ET_BINARY: {
+    static const QuadTag qtags[] = {
+      QT_ADD, QT_SUB, QT_MUL, QT_DIV, QT_NTAGS, QT_NTAGS, QT_OR, QT_AND,
+      QT_EQ, QT_NE, QT_LT, QT_LE, QT_GT, QT_GE
+    };
+    BinaryExp *bexp = static_cast<BinaryExp *>(exp);
+    QuadTag qtag = qtags[bexp->getBinaryTag()];
+    if (qtag == QT_NTAGS) {
+      error("Shift operators are not supported by the runtime.");
+      qtag = QT_ADD;
+    }
+    int l = buildExp(bexp->getLexp());
+    int r = buildExp(bexp->getRexp());
+    t = _graph->newTemp();
+    Quad *quad = emit(qtag, t);
+    quad->addArg(l);
+    quad->addArg(r);
+    break;
+  }
+  case ET_FUNCALL:
+    t = _graph->newTemp();
+    buildCall(static_cast<FuncallExp *>(exp), t);
+    break;
+  default:
+    error("Invalid expression.");
+    t = _graph->newTemp();
+    emit(QT_NULL, t);
+    break;
+  }
+
+  return t;
+}
+
+int IRBuilderImpl::buildSymbol(SymbolExp *sym)
+{
+  const std::string& name = sym->getName();
+  int t;
+
+  if (!sym->isLocal()) {
+    /* a property of another device */
+    t = _graph->newTemp();
+    emit(QT_PROP_GET, t)->setSym(sym->getDev() + ":" + name);
+    return t;
+  }
+
+  if (_vars.count(name))
+    return _vars[name];
+
+  std::vector<std::string>& params = _graph->getParams();
+  for (size_t i = 0; i < params.size(); i++) {
+    if (params[i] != name)
+      continue;
+    t = _graph->newTemp();
+    if (_graph->getTag() == GT_REACTOR)
+      emit(QT_ARG, t);
+    else
+      emit(QT_PARAM, t)->setImm(i);
+    return t;
+  }
+
+  Value *value = _symtab.lookup(sym->getIdent());
+  t = _graph->newTemp();
+  if (!value) {
+    error(Util::sformat("No symbol found: \"%s\" in \"%s\".", name.c_str(),
+                        _graph->getName().c_str()));
+    emit(QT_NULL, t);
+  }
+  else if (value->getTag() == VT_PROP) {
+    emit(QT_PROP_GET, t)->setSym(name);
+  }
+  else {
+    /* events and functions are passed by name */
+    emit(QT_STRING, t)->setSym(name);
+  }
+
+  return t;
+}
+
+Quad *IRBuilderImpl::buildCall(FuncallExp *call, int lhs)
+{
+  std::vector<int> args;
+  ExpList::iterator iter;
+  for (iter = call->getArgs()->begin(); iter != call->getArgs()->end();
+       ++iter)
+    args.push_back(buildExp(*iter));
+
+  SymbolExp *sym = call->getName();
+  Quad *quad = emit(QT_FUNCALL, lhs);
+  if (!sym->isLocal()) {
+    quad->setSym(sym->getDev() + ":" + sym->getName());
+    quad->setImm(CT_REMOTE);
+  }
+  else {
+    Value *value = _symtab.lookup(sym->getIdent());
+    quad->setSym(sym->getName());
+    quad->setImm((value && value->getTag() == VT_FUNC) ? CT_FUNC : CT_NATIVE);
+  }
+  for (size_t i = 0; i < args.size(); i++)
+    quad->addArg(args[i]);
+
+  return quad;
+}
+
+Quad *IRBuilderImpl::emit(QuadTag tag, int lhs)
+{
+  Quad *quad = new Quad(tag, lhs);
+  _cur->addQuad(quad);
+
+  return quad;
+}
+
+void IRBuilderImpl::jump(BasicBlock *target)
+{
+  emit(QT_JUMP)->setTarget(0, target);
+}
+
+/* Lays out the block next, falling through from the current block. */
+void IRBuilderImpl::startBlock(BasicBlock *blk)
+{
+  if (_cur && !_cur->getTerminator())
+    jump(blk);
+  _graph->addBlock(blk);
+  _cur = blk;
+}
+
+int IRBuilderImpl::lookupVar(const std::string& name, bool create)
+{
+  std::map<std::string, int>::iterator iter = _vars.find(name);
+  if (iter != _vars.end())
+    return iter->second;
+  if (!create)
+    return -1;
+
+  int t = _graph->newTemp(name);
+  _vars[name] = t;
+
+  return t;
+}
+
+void IRBuilderImpl::error(const std::string& s)
+{
+  std::cerr << "error: " << s << std::endl;
+  _nerrors++;
+}
+
+
+/*
+ * IRBuilder
+ */
+IRBuilder::IRBuilder(SymTab& symtab)
+{
+  _impl = new IRBuilderImpl(symtab);
+}
+
+IRBuilder::~IRBuilder()
+{
+  delete _impl;
+}
+
+IRModule *IRBuilder::build(Module *mod)
+{
+  return _impl->build(mod);
+}
+
+
+/* Finds the back edges of a depth-first search, and adds the blocks of
+   the loop of each back edge to the loop of its header. */
+void _find_loops(BasicBlock *blk, std::set<BasicBlock *>& visited,
+                 std::set<BasicBlock *>& onstack, LoopMap& loops)
+{
+  visited.insert(blk);
+  onstack.insert(blk);
+  std::vector<BasicBlock *>& succs = blk->getSuccs();
+  for (size_t i = 0; i < succs.size(); i++) {
+    BasicBlock *succ = succs[i];
+    if (onstack.count(succ) > 0) {
+      /* the blocks which reach blk without passing the header */
+      std::set<BasicBlock *>& body = loops[succ];
+      body.insert(succ);
+      std::vector<BasicBlock *> work;
+      if (body.insert(blk).second)
+        work.push_back(blk);
+      while (!work.empty()) {
+        BasicBlock *b = work.back();
+        work.pop_back();
+        std::vector<BasicBlock *>& preds = b->getPreds();
+        for (size_t j = 0; j < preds.size(); j++) {
+          if (body.insert(preds[j]).second)
+            work.push_back(preds[j]);
+        }
+      }
+    }
+    else if (visited.count(succ) == 0)
+      _find_loops(succ, visited, onstack, loops);
+  }
+  onstack.erase(blk);
+}
+
+} /* mvc */
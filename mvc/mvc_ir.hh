@@ -2,35 +2,141 @@
  * @file mvc_ir.hh
  *
  * @brief Intermediate representation.
+ *
+ * The body of each reactor and function is lowered to a ControlGraph of
+ * BasicBlocks, each of which is a list of Quads. Operands of a quad are
+ * temporaries, numbered from 0 in each graph. A temporary is defined by
+ * a single quad, except the temporaries which hold local variables.
+ * In SSA form (see mvc_opt.hh), every temporary is defined once.
  */
 #ifndef MVC_IR_HH
 #define MVC_IR_HH
 
+#include <iostream>
 #include <list>
-#include "mvc_name.hh"
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+#include "mvc_module.hh"
 #include "mvc_symtab.hh"
 
 
 namespace mvc {
 
 enum QuadTag {
+  /* t = a OP b */
   QT_ADD,        /* add */
   QT_SUB,        /* subtract */
   QT_MUL,        /* multiply */
   QT_DIV,        /* divide */
-  QT_FUNCALL,    /* function call */
+  QT_EQ,         /* equal */
+  QT_NE,         /* not equal */
+  QT_LT,         /* less than */
+  QT_LE,         /* less than or equal */
+  QT_GT,         /* greater than */
+  QT_GE,         /* greater than or equal */
+  QT_AND,        /* logical and */
+  QT_OR,         /* logical or */
+
+  /* t = constant */
+  QT_CONST,      /* integer */
+  QT_STRING,     /* string */
+  QT_NULL,       /* null */
+
+  /* t = value */
+  QT_COPY,       /* t = a */
+  QT_ARG,        /* t = value of the event of the reactor */
+  QT_PARAM,      /* t = imm-th parameter of the function */
+  QT_GETF,       /* t = a.sym */
+  QT_INDEX,      /* t = a[b] */
+  QT_PROP_GET,   /* t = prop sym, local or dev:name */
+
+  /* side effects */
+  QT_PROP_SET,   /* prop sym = a */
+  QT_SETF,       /* a.sym = b */
+  QT_FUNCALL,    /* [t =] sym(args) */
+  QT_TRIGGER,    /* -> sym(args) */
+
+  /* terminators */
+  QT_JUMP,       /* goto target0 */
+  QT_BRANCH,     /* if a goto target0 else goto target1 */
+  QT_RET,        /* return [a] */
+
   QT_PHI,        /* phi-function */
   QT_NTAGS       /* number of tags */
 };
 
+/* How a function is called. */
+enum CallTag {
+  CT_FUNC,       /* function defined in the module */
+  CT_NATIVE,     /* native function of the local device */
+  CT_REMOTE,     /* function of another device */
+  CT_NTAGS
+};
+
+/* Effect of a quad, used to decide how far it can be moved. */
+enum EffectTag {
+  EF_PURE,       /* depends only on its operands */
+  EF_READ,       /* reads properties or records */
+  EF_WRITE,      /* writes, calls or transfers control */
+  EF_NTAGS
+};
+
+class BasicBlock;
 
 /**
  * @class Quad
  */
 class Quad {
 public:
-  Quad(QuadTag tag, Name *lhs, Name *arg0, Name *arg1);
-  ~Quad();
+  Quad(QuadTag tag, int lhs = -1)
+    : _tag(tag), _lhs(lhs), _imm(0) {
+    _targets[0] = _targets[1] = NULL;
+  }
+  ~Quad() { }
+
+  QuadTag getTag() { return _tag; }
+  void setTag(QuadTag tag) { _tag = tag; }
+
+  /* temporary defined, or -1 */
+  int getLhs() { return _lhs; }
+  void setLhs(int lhs) { _lhs = lhs; }
+
+  /* temporaries used */
+  std::vector<int>& getArgs() { return _args; }
+  int getArg(size_t i) { return _args[i]; }
+  void setArg(size_t i, int t) { _args[i] = t; }
+  void addArg(int t) { _args.push_back(t); }
+
+  /* predecessors the arguments of a phi-function come from */
+  std::vector<BasicBlock *>& getSources() { return _sources; }
+
+  /* name of a property, field, function or event, or a string */
+  const std::string& getSym() { return _sym; }
+  void setSym(const std::string& sym) { _sym = sym; }
+
+  /* integer, parameter index, or CallTag */
+  int getImm() { return _imm; }
+  void setImm(int imm) { _imm = imm; }
+
+  BasicBlock *getTarget(int i) { return _targets[i]; }
+  void setTarget(int i, BasicBlock *blk) { _targets[i] = blk; }
+
+  EffectTag getEffect();
+
+  /* Returns true if the reactor may be suspended here, waiting for another
+     device: at a remote property read, or at a remote call whose result
+     is used. Other reactors may run while it is suspended. */
+  bool isSuspension();
+
+  bool isTerminator() {
+    return _tag == QT_JUMP || _tag == QT_BRANCH || _tag == QT_RET;
+  }
+
+  void print(std::ostream& os);
+
+  static const char *getTagstr(QuadTag tag);
 
 private:
   Quad(const Quad& quad) = delete;
@@ -38,9 +144,12 @@ private:
 
 private:
   QuadTag _tag;
-  Name *_lhs;
-  Name *_arg0;
-  Name *_arg1;
+  int _lhs;
+  std::vector<int> _args;
+  std::vector<BasicBlock *> _sources;
+  std::string _sym;
+  int _imm;
+  BasicBlock *_targets[2];
 };
 
 
@@ -49,51 +158,158 @@ private:
  */
 class BasicBlock {
 public:
-  BasicBlock();
+  BasicBlock(int id) : _id(id) { }
   ~BasicBlock();
 
-  int addQuad(Quad *qad);
-  std::vector<Quad *>& getQuads() { return _quads; }
+  int getId() { return _id; }
+  void setId(int id) { _id = id; }
+
+  void addQuad(Quad *quad) { _quads.push_back(quad); }
+  std::list<Quad *>& getQuads() { return _quads; }
+
+  /* Returns the terminator, or NULL if the block is not terminated. */
+  Quad *getTerminator() {
+    if (_quads.empty() || !_quads.back()->isTerminator())
+      return NULL;
+    return _quads.back();
+  }
+
+  std::vector<BasicBlock *>& getPreds() { return _preds; }
+  std::vector<BasicBlock *>& getSuccs() { return _succs; }
+
+  void print(std::ostream& os);
 
 private:
-  Basicblock(const BasicBlock& blk) = delete;
-  Basicblock& operator=(const BasicBlock& blk) = delete;
-  
+  BasicBlock(const BasicBlock& blk) = delete;
+  BasicBlock& operator=(const BasicBlock& blk) = delete;
+
 private:
+  int _id;
   std::list<Quad *> _quads;
+  std::vector<BasicBlock *> _preds;
+  std::vector<BasicBlock *> _succs;
 };
 
 
+/* blocks of the natural loops of a graph, by header */
+typedef std::map<BasicBlock *, std::set<BasicBlock *> > LoopMap;
+
+enum GraphTag {
+  GT_REACTOR,
+  GT_FUNCTION,
+  GT_NTAGS
+};
+
 /**
  * @class ControlGraph
+ *
+ * @brief Body of a reactor or a function. The first block is the entry,
+ * and blocks are laid out in the order of the vector.
  */
 class ControlGraph {
+public:
+  ControlGraph(GraphTag tag, const std::string& name)
+    : _tag(tag), _name(name) { }
+  ~ControlGraph();
+
+  GraphTag getTag() { return _tag; }
+  const std::string& getName() { return _name; }
+
+  /* events of a reactor, or parameters of a function */
+  std::vector<std::string>& getParams() { return _params; }
+
+  /* Appends a new or a detached block to the layout. */
+  BasicBlock *newBlock();
+  void addBlock(BasicBlock *blk);
+  std::vector<BasicBlock *>& getBlocks() { return _blocks; }
+  BasicBlock *getEntry() { return _blocks.front(); }
+
+  /* Returns a new temporary. A named temporary holds a local variable. */
+  int newTemp(const std::string& name = "");
+  int getNtemps() { return _tempnames.size(); }
+  const std::string& getTempName(int t) { return _tempnames[t]; }
+
+  /* Recomputes predecessors and successors, and removes the blocks
+     unreachable from the entry, and the arguments of phi-functions which
+     come from them. */
+  void link();
+
+  /* Finds the loops of a linked graph, from the back edges of a
+     depth-first search. Loops with the same header are one loop. */
+  void findLoops(LoopMap& loops);
+
+  int getNquads();
+
+  void print(std::ostream& os);
+
+private:
+  ControlGraph(const ControlGraph& g) = delete;
+  ControlGraph& operator=(const ControlGraph& g) = delete;
+
+private:
+  GraphTag _tag;
+  std::string _name;
+  std::vector<std::string> _params;
+  std::vector<BasicBlock *> _blocks;
+  std::vector<std::string> _tempnames;
 };
 
+
 /**
  * @class IRModule
- */ 
+ */
 class IRModule {
 public:
-  IRModule();
+  IRModule(const std::string& name) : _name(name) { }
   ~IRModule();
-  
+
+  const std::string& getName() { return _name; }
+
+  std::vector<std::string>& getProps() { return _props; }
+  std::vector<std::string>& getEvents() { return _events; }
+  std::vector<ControlGraph *>& getGraphs() { return _graphs; }
+
+  /* Returns the function of the module, or NULL if there is none. */
+  ControlGraph *getFunction(const std::string& name);
+
+  int getNquads();
+
+  void print(std::ostream& os);
+
+private:
+  IRModule(const IRModule& m) = delete;
+  IRModule& operator=(const IRModule& m) = delete;
+
 private:
-  SymTab _symtab;
+  std::string _name;
+  std::vector<std::string> _props;
+  std::vector<std::string> _events;
+  std::vector<ControlGraph *> _graphs;
 };
 
 
 /**
  * @class IRBuilder
  */
+class IRBuilderImpl;
 class IRBuilder {
 public:
-  IRBuilder();
+  IRBuilder(SymTab& symtab);
+  ~IRBuilder();
 
+  /* Lowers the reactors and functions of the module. Returns NULL if any
+     of them has errors, which are reported to stderr. */
   IRModule *build(Module *mod);
+
+private:
+  IRBuilder(const IRBuilder& b) = delete;
+  IRBuilder& operator=(const IRBuilder& b) = delete;
+
+private:
+  IRBuilderImpl *_impl;
 };
 
 
-} /* mv */
+} /* mvc */
 
 #endif /* MVC_IR_HH */
@@ -18,7 +18,7 @@ StmIterator::StmIterator(Stm *stm) : _stm(stm), _sptr(NULL)
   switch (stm->getTag()) {
   case ST_BLOCK: {
     BlockStm *block = static_cast<BlockStm *>(stm);
-    std::list<Stm *>& _stms = block->getBody();
+    StmList& _stms = block->getBody();
     _iter = _stms.begin();
     if (_iter == _stms.end())
       _sptr = NULL;
@@ -79,7 +79,7 @@ StmIterator& StmIterator::next()
   switch (_stm->getTag()) {
   case ST_BLOCK: {
     BlockStm *block = static_cast<BlockStm *>(_stm);
-    std::list<Stm *>& _stms = block->getBody();
+    StmList& _stms = block->getBody();
     ++_iter;
     if (_iter == _stms.end())
       _sptr = NULL;
@@ -95,17 +95,19 @@ StmIterator& StmIterator::next()
     IfElseStm *ifelse = static_cast<IfElseStm *>(_stm);
     if (_sptr == ifelse->getThenStm())
       _sptr = ifelse->getElseStm();
+    else if (_sptr == ifelse->getElseStm())
+      _sptr = NULL;
     else
       assert(0);
     break;
   }
   case ST_FOR: {
     ForStm *fors = static_cast<ForStm *>(_stm);
-    if (_sptr = fors->getInit())
+    if (_sptr == fors->getInit())
       _sptr = fors->getBody();
-    else if (_sptr = fors->getBody())
+    else if (_sptr == fors->getBody())
       _sptr = fors->getStep();
-    else if (_sptr = fors->getStep())
+    else if (_sptr == fors->getStep())
       _sptr = NULL;
     else
       assert(0);
@@ -202,7 +204,10 @@ ExpIterator::ExpIterator(Stm *stm) :_stm(stm), _exp(NULL), _eptr(NULL)
     break;
   }
   case ST_TRIGGER: {
-    assert(0 && "Not implemented");
+    TriggerStm *trigger = static_cast<TriggerStm *>(stm);
+    _iter = trigger->getEvents().begin();
+    if (_iter != trigger->getEvents().end())
+      _eptr = *_iter;
     break;
   }
   case ST_RETURN: {
@@ -254,7 +259,11 @@ ExpIterator& ExpIterator::next()
       break;
     }
     case ST_TRIGGER: {
-      assert(0 && "Not implemented");
+      TriggerStm *trigger = static_cast<TriggerStm *>(_stm);
+      if (++_iter != trigger->getEvents().end())
+        _eptr = *_iter;
+      else
+        _eptr = NULL;
       break;
     }
     case ST_RETURN: {
@@ -302,8 +311,8 @@ ExpIterator& ExpIterator::next()
     }
     case ET_FUNCALL: {
       FuncallExp *funcall = static_cast<FuncallExp *>(_exp);
-      std::list<Exp *> *args = funcall->getArgs();
-      if (_eptr = funcall->getName()) {
+      ExpList *args = funcall->getArgs();
+      if (_eptr == funcall->getName()) {
         _iter = args->begin();
         if (_iter != args->end())
           _eptr = *_iter;
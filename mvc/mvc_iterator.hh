@@ -33,7 +33,7 @@ private:
 
   Stm *_sptr;
 
-  std::list<Stm *>::iterator _iter;
+  StmList::iterator _iter;
 };
 
 class ExpIterator {
@@ -53,7 +53,7 @@ private:
   Exp *_exp;
 
   Exp *_eptr;
-  std::list<Exp *>::iterator _iter;
+  ExpList::iterator _iter;
 };
 
 
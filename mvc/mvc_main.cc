@@ -5,36 +5,462 @@
  */
 #include <cstdio>             /* fprintf */
 #include <cstdlib>            /* exit */
+#include <cerrno>
+#include <unistd.h>           /* getopt */
+#include <sys/stat.h>         /* mkdir */
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <mutex>
+#include <thread>
 #include "mvc_base.hh"
 #include "mvc_exp.hh"
 #include "mvc_stm.hh"
 #include "mvc_parser.hh"
 #include "mvc_analyzer.hh"
+#include "mvc_ir.hh"
+#include "mvc_opt.hh"
+#include "mvc_place.hh"
+#include "mvc_codegen.hh"
+#include "mvc_cost.hh"
 #include "mvc_util.hh"
 
 using namespace mvc;
 
-/* 
+/* Options of a compilation, the same for every module. */
+struct Options {
+  bool printir;
+  int level;
+  std::map<std::string, double> latencies;
+  double deflatency;
+  std::string topofile;       /* placement report, if not empty */
+  std::string costfile;       /* cost report, if not empty */
+  std::string cachedir;       /* cache of the code, if not empty */
+  std::string buildkey;       /* build of mvc, for the cache */
+
+  Options() : printir(false), level(1), deflatency(1.0) { }
+};
+
+/* A module to compile, and what its compilation writes to stdout, which
+   is written once all modules are compiled, in the order given. */
+struct Job {
+  int id;
+  std::string infile;
+  std::string outfile;
+  std::ostringstream log;
+  std::ostringstream costs;   /* the module in the cost report */
+  int result;
+
+  Job(int i, const std::string& in, const std::string& out)
+    : id(i), infile(in), outfile(out), result(0) { }
+};
+
+/* Jobs shared by the threads, each of which takes the next one left. */
+struct JobQueue {
+  std::vector<Job *> jobs;
+  size_t next;
+  std::mutex lock;
+  const Options *opts;
+
+  JobQueue() : next(0), opts(NULL) { }
+};
+
+static void _usage(const char *prog);
+static int _read_latencies(const std::string& file,
+                           std::map<std::string, double>& latencies,
+                           double& deflatency);
+static unsigned long long _fnv64(const std::string& s);
+static std::string _build_key();
+static int _cache_key(const std::string& file, const Options& opts,
+                      std::string& key);
+static int _copy_file(const std::string& from, const std::string& to);
+static int _write_costs(const std::string& file, std::vector<Job *>& jobs);
+static int _compile(Job& job, const Options& opts);
+static void _work(JobQueue *queue);
+
+void _usage(const char *prog)
+{
+  fprintf(stdout, "Usage: %s [-i] [-c cache-dir] [-j jobs] [-l latency-file] "
+          "[-O level]\n          [-o dat-file] [-p topology-file] "
+          "[-r cost-file] [mvc-file...]\n", prog);
+  fprintf(stdout, "  -i  print the intermediate representation\n");
+  fprintf(stdout, "  -c  reuse the code of unchanged modules, kept in "
+          "cache-dir\n");
+  fprintf(stdout, "  -j  compile up to jobs modules in parallel (one per "
+          "processor)\n");
+  fprintf(stdout, "  -l  read the latencies of devices from latency-file\n");
+  fprintf(stdout, "  -O  optimize (level 1, the default), or not (level 0)\n");
+  fprintf(stdout, "  -o  write the code to dat-file, instead of mvc-file "
+          "with .dat suffix\n");
+  fprintf(stdout, "  -p  report where the reactors send the fewest messages, "
+          "in the\n      devices of topology-file\n");
+  fprintf(stdout, "  -r  write the static cost of each reactor, and of a run "
+          "in the worst\n      case, to cost-file as JSON\n");
+}
+
+/* Reads the latencies of devices, in milliseconds, one "device latency"
+   per line, with "*" for the devices not listed. Lines starting with #
+   are comments. Returns -1 on errors. */
+int _read_latencies(const std::string& file,
+                    std::map<std::string, double>& latencies,
+                    double& deflatency)
+{
+  std::ifstream is(file.c_str());
+  if (!is) {
+    fprintf(stderr, "Cannot open %s.\n", file.c_str());
+    return -1;
+  }
+
+  std::string line;
+  for (int lineno = 1; std::getline(is, line); lineno++) {
+    std::istringstream ls(line);
+    std::string dev;
+    double latency;
+    if (!(ls >> dev) || dev[0] == '#')
+      continue;
+    if (!(ls >> latency) || latency < 0) {
+      fprintf(stderr, "%s:%d: Invalid latency.\n", file.c_str(), lineno);
+      return -1;
+    }
+    if (dev == "*")
+      deflatency = latency;
+    else
+      latencies[dev] = latency;
+  }
+
+  return 0;
+}
+
+/* 64-bit FNV-1a */
+unsigned long long _fnv64(const std::string& s)
+{
+  unsigned long long hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < s.size(); i++)
+    hash = (hash ^ static_cast<unsigned char>(s[i])) * 1099511628211ULL;
+
+  return hash;
+}
+
+/* Returns a hash of the mvc executable, which changes whenever any of its
+   sources does, or the time this file was built where it cannot be read.
+   */
+std::string _build_key()
+{
+  std::ifstream is("/proc/self/exe", std::ios::binary);
+  std::ostringstream exe;
+  if (!is || !(exe << is.rdbuf()))
+    return __DATE__ " " __TIME__;
+
+  return Util::sformat("%016llx", _fnv64(exe.str()));
+}
+
+/* Returns in key a hash of the contents of the file, the options which
+   change the code, and the build of mvc. Returns -1 if the file cannot
+   be read. */
+int _cache_key(const std::string& file, const Options& opts,
+               std::string& key)
+{
+  std::ifstream is(file.c_str(), std::ios::binary);
+  if (!is)
+    return -1;
+
+  std::ostringstream data;
+  data << "mvc " << opts.buildkey << "\n";
+  data << "O" << opts.level << " * " << opts.deflatency << "\n";
+  std::map<std::string, double>::const_iterator iter;
+  for (iter = opts.latencies.begin(); iter != opts.latencies.end(); ++iter)
+    data << iter->first << " " << iter->second << "\n";
+  data << is.rdbuf();
+
+  key = Util::sformat("%016llx", _fnv64(data.str()));
+
+  return 0;
+}
+
+int _copy_file(const std::string& from, const std::string& to)
+{
+  std::ifstream is(from.c_str(), std::ios::binary);
+  if (!is)
+    return -1;
+  std::ofstream os(to.c_str(), std::ios::binary);
+  if (!os || !(os << is.rdbuf()))
+    return -1;
+
+  return 0;
+}
+
+/* Compiles a module, writing what it prints to the log of the job.
+   Returns -1 on errors. */
+int _compile(Job& job, const Options& opts)
+{
+  std::ostream& log = job.log;
+
+  /* the code of the same module compiled before; not with the reports,
+     which need the compilation */
+  std::string key;
+  if (opts.cachedir != "" && !opts.printir && opts.topofile == ""
+      && opts.costfile == ""
+      && _cache_key(job.infile, opts, key) == 0
+      && _copy_file(opts.cachedir + "/" + key + ".dat", job.outfile) == 0) {
+    log << job.outfile << ": unchanged, from " << opts.cachedir << std::endl;
+    return 0;
+  }
+
+  Module *mod = Parser::parse(SCT_FILE, job.infile);
+  if (!mod)
+    return -1;
+  Util::print(log, mod);
+
+  SymTab symtab(mod->getIdents());
+
+  /* semantic checking */
+  Analyzer analysis(mod, symtab, log);
+  if (analysis.run() == -1) {
+    delete mod;
+    return -1;
+  }
+
+  /* IR generation; the IR copies what it needs of the module, whose
+     arena is freed at once */
+  IRBuilder builder(symtab);
+  IRModule *irmod = builder.build(mod);
+  delete mod;
+  if (!irmod)
+    return -1;
+
+  /* mvrt does not call the functions of a module */
+  PassMgr inliner(irmod);
+  inliner.addPass(new Inliner(irmod));
+  if (inliner.run() == -1) {
+    delete irmod;
+    return -1;
+  }
+  if (opts.printir)
+    irmod->print(log);
+
+  /* optimization, in SSA form */
+  if (opts.level > 0) {
+    int before = irmod->getNquads();
+    PassMgr passes(irmod);
+    passes.addPass(new PropCacher());
+    passes.addPass(new RemoteBatcher(opts.latencies, opts.deflatency));
+    passes.addPass(new SSABuilder());
+    PassGroup *optimize = new PassGroup("optimize");
+    optimize->addPass(new ConstFolder());
+    optimize->addPass(new CopyPropagator());
+    optimize->addPass(new CSEliminator());
+    optimize->addPass(new DCEliminator());
+    passes.addPass(optimize);
+    passes.addPass(new SSADestructor());
+    if (passes.run() == -1) {
+      delete irmod;
+      return -1;
+    }
+    if (opts.printir)
+      irmod->print(log);
+    log << job.infile << ": " << before << " quads, " << irmod->getNquads()
+        << " after optimization" << std::endl;
+  }
+
+  /* placement of the reactors */
+  if (opts.topofile != "") {
+    Topology topo;
+    if (topo.read(opts.topofile) == -1) {
+      delete irmod;
+      return -1;
+    }
+    Placer placer(irmod, topo);
+    placer.run();
+    placer.report(log);
+  }
+
+  /* code generation */
+  std::ofstream os(job.outfile.c_str());
+  if (!os) {
+    fprintf(stderr, "Cannot open %s.\n", job.outfile.c_str());
+    delete irmod;
+    return -1;
+  }
+
+  CodeGen codegen(irmod);
+  if (codegen.run(os) == -1) {
+    os.close();
+    remove(job.outfile.c_str());
+    delete irmod;
+    return -1;
+  }
+  os.close();
+
+  CodeStats stats = codegen.getStats();
+  log << job.outfile << ": " << stats.ninstrs << " instructions, "
+      << stats.nsaves << " saves, " << stats.nloads << " loads" << std::endl;
+
+  /* cost of the reactors, from the code */
+  if (opts.costfile != "") {
+    CostModel model(irmod, codegen);
+    model.run();
+    model.report(job.costs, job.infile);
+  }
+
+  delete irmod;
+
+  /* written aside and renamed, not to leave a partial file in the cache */
+  if (key != "") {
+    std::string file = opts.cachedir + "/" + key + ".dat";
+    std::string tmpfile = Util::sformat("%s.%d.%d", file.c_str(), getpid(),
+                                        job.id);
+    if (_copy_file(job.outfile, tmpfile) == -1
+        || rename(tmpfile.c_str(), file.c_str()) == -1) {
+      fprintf(stderr, "Cannot write %s.\n", file.c_str());
+      remove(tmpfile.c_str());
+    }
+  }
+
+  return 0;
+}
+
+/* Writes the cost reports of the modules compiled, in the order given,
+   as a JSON array. Returns -1 on errors. */
+int _write_costs(const std::string& file, std::vector<Job *>& jobs)
+{
+  std::ofstream os(file.c_str());
+  if (!os) {
+    fprintf(stderr, "Cannot open %s.\n", file.c_str());
+    return -1;
+  }
+
+  os << "[";
+  const char *sep = "";
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (jobs[i]->result == -1)
+      continue;
+    os << sep << std::endl << jobs[i]->costs.str();
+    sep = ",";
+  }
+  os << std::endl << "]" << std::endl;
+
+  if (!os) {
+    fprintf(stderr, "Cannot write %s.\n", file.c_str());
+    return -1;
+  }
+
+  return 0;
+}
+
+void _work(JobQueue *queue)
+{
+  while (true) {
+    Job *job;
+    {
+      std::lock_guard<std::mutex> guard(queue->lock);
+      if (queue->next == queue->jobs.size())
+        return;
+      job = queue->jobs[queue->next++];
+    }
+    job->result = _compile(*job, *queue->opts);
+  }
+}
+
+/*
  * the main entry point
  */
 int main(int argc, char *argv[])
 {
-  if (argc < 2) {
-    fprintf(stdout, "Usage: %s [mvc-file]\n", argv[0]);
+  Options opts;
+  std::string outfile;
+  int njobs = std::thread::hardware_concurrency();
+  int opt;
+  while ((opt = getopt(argc, argv, "ic:j:l:O:o:p:r:")) != -1) {
+    switch (opt) {
+    case 'i':
+      opts.printir = true;
+      break;
+    case 'c':
+      opts.cachedir = optarg;
+      break;
+    case 'j':
+      njobs = atoi(optarg);
+      break;
+    case 'l':
+      if (_read_latencies(optarg, opts.latencies, opts.deflatency) == -1)
+        exit(EXIT_FAILURE);
+      break;
+    case 'O':
+      opts.level = atoi(optarg);
+      break;
+    case 'o':
+      outfile = optarg;
+      break;
+    case 'p':
+      opts.topofile = optarg;
+      break;
+    case 'r':
+      opts.costfile = optarg;
+      break;
+    default:
+      _usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (optind >= argc) {
+    _usage(argv[0]);
     exit(EXIT_SUCCESS);
   }
+  if (outfile != "" && argc - optind > 1) {
+    fprintf(stderr, "-o needs a single mvc-file.\n");
+    exit(EXIT_FAILURE);
+  }
 
-  Module *mod = Parser::parse(SCT_FILE, std::string(argv[1]));
-  Util::print(std::cout, mod);
+  /* check the files once, not in every job */
+  if (opts.topofile != "") {
+    Topology topo;
+    if (topo.read(opts.topofile) == -1)
+      exit(EXIT_FAILURE);
+  }
+  if (opts.cachedir != "" && mkdir(opts.cachedir.c_str(), 0755) == -1
+      && errno != EEXIST) {
+    fprintf(stderr, "Cannot create %s.\n", opts.cachedir.c_str());
+    exit(EXIT_FAILURE);
+  }
+  if (opts.cachedir != "")
+    opts.buildkey = _build_key();
 
-  SymTab symtab;
+  JobQueue queue;
+  queue.opts = &opts;
+  for (int i = optind; i < argc; i++) {
+    std::string infile(argv[i]);
+    if (outfile == "") {
+      size_t dot = infile.rfind('.');
+      std::string out = (dot == std::string::npos
+                         || infile.find('/', dot) != std::string::npos)
+        ? infile : infile.substr(0, dot);
+      queue.jobs.push_back(new Job(i - optind, infile, out + ".dat"));
+    }
+    else
+      queue.jobs.push_back(new Job(i - optind, infile, outfile));
+  }
 
-  /* semantic checking */
-  Analyzer analysis(mod, symtab);
-  analysis.run();
+  /* the factory is created on first use, so before the threads */
+  ModuleFactory::getInstance();
 
-  /* IR generation */
-  
+  /* this thread works too */
+  std::vector<std::thread> threads;
+  for (int i = 1; i < njobs && i < static_cast<int>(queue.jobs.size()); i++)
+    threads.push_back(std::thread(_work, &queue));
+  _work(&queue);
+  for (size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
 
-  return 0;
+  int result = EXIT_SUCCESS;
+  if (opts.costfile != "" && _write_costs(opts.costfile, queue.jobs) == -1)
+    result = EXIT_FAILURE;
+  for (size_t i = 0; i < queue.jobs.size(); i++) {
+    std::cout << queue.jobs[i]->log.str();
+    if (queue.jobs[i]->result == -1)
+      result = EXIT_FAILURE;
+    delete queue.jobs[i];
+  }
+
+  return result;
 }
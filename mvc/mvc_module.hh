@@ -5,9 +5,10 @@
 #define MVC_MODULE_HH
 
 #include <string>
-#include <list>
 #include <vector>
 #include <mv/defs.h>
+#include "adt/arena.h"
+#include "mvc_ident.hh"
 #include "mvc_exp.hh"
 #include "mvc_stm.hh"
 
@@ -15,23 +16,42 @@ namespace mvc {
 
 /**
  * @class Module
+ *
+ * @brief A parsed module. Its expressions, statements and lists are
+ * allocated in the arena of the module, and its names and strings are
+ * interned in its identifiers; all are freed at once when it is deleted.
  */
 class Module {
 public:
-  Module() : _name(NULL) { }
+  Module()
+    : _expFactory(_arena, _idents), _stmFactory(_arena), _name(NULL) { }
   ~Module() { }
 
+  Arena& getArena() { return _arena; }
+  IdentTab& getIdents() { return _idents; }
+  ExpFactory *getExpFactory() { return &_expFactory; }
+  StmFactory *getStmFactory() { return &_stmFactory; }
+
   void setName(SymbolExp *name) { _name = name; }
   SymbolExp *getName() { return _name; }
   
   void addStm(Stm *stm) {
     _stms.push_front(stm);
   }
-  std::list<Stm *>& getStms() { return _stms; }
+  StmList& getStms() { return _stms; }
+
+private:
+  Module(const Module& module) = delete;
+  Module& operator=(const Module& module) = delete;
 
 private:
+  Arena _arena;
+  IdentTab _idents;
+  ExpFactory _expFactory;
+  StmFactory _stmFactory;
+
   SymbolExp *_name;
-  std::list<Stm *> _stms;
+  StmList _stms;
 };
 
 /**
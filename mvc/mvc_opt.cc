@@ -0,0 +1,1321 @@
+/**
+ * @file mvc_opt.cc
+ *
+ * @brief Optimization passes over the intermediate representation.
+ */
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include "adt/bitvector.h"
+#include "mvc_opt.hh"
+
+namespace mvc {
+
+/**
+ * @class DomTree
+ *
+ * @brief Dominator tree and dominance frontiers of a linked graph, after
+ * Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm".
+ * Blocks are numbered in reverse postorder; the entry is 0.
+ */
+class DomTree {
+public:
+  DomTree(ControlGraph *g);
+
+  int size() { return _blocks.size(); }
+  BasicBlock *getBlock(int i) { return _blocks[i]; }
+  int getIndex(BasicBlock *blk) { return _index[blk]; }
+
+  std::vector<int>& getChildren(int i) { return _children[i]; }
+  std::set<int>& getFrontier(int i) { return _frontiers[i]; }
+
+private:
+  void visit(BasicBlock *blk, std::set<BasicBlock *>& visited);
+  int intersect(int a, int b);
+
+private:
+  std::vector<BasicBlock *> _blocks;
+  std::map<BasicBlock *, int> _index;
+  std::vector<int> _idom;
+  std::vector<std::vector<int> > _children;
+  std::vector<std::set<int> > _frontiers;
+};
+
+DomTree::DomTree(ControlGraph *g)
+{
+  std::set<BasicBlock *> visited;
+  visit(g->getEntry(), visited);
+  std::reverse(_blocks.begin(), _blocks.end());
+  for (size_t i = 0; i < _blocks.size(); i++)
+    _index[_blocks[i]] = i;
+
+  int n = _blocks.size();
+  _idom.assign(n, -1);
+  _idom[0] = 0;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int i = 1; i < n; i++) {
+      std::vector<BasicBlock *>& preds = _blocks[i]->getPreds();
+      int idom = -1;
+      for (size_t j = 0; j < preds.size(); j++) {
+        int p = _index[preds[j]];
+        if (_idom[p] != -1)
+          idom = (idom == -1) ? p : intersect(p, idom);
+      }
+      if (idom != _idom[i]) {
+        _idom[i] = idom;
+        changed = true;
+      }
+    }
+  }
+
+  _children.assign(n, std::vector<int>());
+  for (int i = 1; i < n; i++)
+    _children[_idom[i]].push_back(i);
+
+  _frontiers.assign(n, std::set<int>());
+  for (int i = 0; i < n; i++) {
+    std::vector<BasicBlock *>& preds = _blocks[i]->getPreds();
+    if (preds.size() < 2)
+      continue;
+    for (size_t j = 0; j < preds.size(); j++) {
+      for (int r = _index[preds[j]]; r != _idom[i]; r = _idom[r])
+        _frontiers[r].insert(i);
+    }
+  }
+}
+
+void DomTree::visit(BasicBlock *blk, std::set<BasicBlock *>& visited)
+{
+  visited.insert(blk);
+  std::vector<BasicBlock *>& succs = blk->getSuccs();
+  for (size_t i = 0; i < succs.size(); i++) {
+    if (!visited.count(succs[i]))
+      visit(succs[i], visited);
+  }
+  _blocks.push_back(blk);
+}
+
+int DomTree::intersect(int a, int b)
+{
+  while (a != b) {
+    while (a > b)
+      a = _idom[a];
+    while (b > a)
+      b = _idom[b];
+  }
+
+  return a;
+}
+
+
+/* Returns the quad defining each temporary in SSA form, or NULL. */
+static void _find_defs(ControlGraph *g, std::vector<Quad *>& defs)
+{
+  defs.assign(g->getNtemps(), NULL);
+
+  std::vector<BasicBlock *>& blocks = g->getBlocks();
+  for (size_t i = 0; i < blocks.size(); i++) {
+    std::list<Quad *>& quads = blocks[i]->getQuads();
+    std::list<Quad *>::iterator iter;
+    for (iter = quads.begin(); iter != quads.end(); ++iter) {
+      if ((*iter)->getLhs() >= 0)
+        defs[(*iter)->getLhs()] = *iter;
+    }
+  }
+}
+
+/* Inserts a quad at the end of the block, before its terminator. */
+static void _append_quad(BasicBlock *blk, Quad *q)
+{
+  std::list<Quad *>& quads = blk->getQuads();
+  std::list<Quad *>::iterator pos = quads.end();
+  if (blk->getTerminator())
+    --pos;
+  quads.insert(pos, q);
+}
+
+
+/*
+ * SSABuilder
+ */
+class SSARenamer {
+public:
+  SSARenamer(ControlGraph *g, DomTree& dom, std::vector<bool>& vars,
+             std::map<Quad *, int>& phis)
+    : _g(g), _dom(dom), _vars(vars), _phis(phis),
+      _stacks(vars.size(), std::vector<int>()) { }
+
+  void rename(int b);
+
+private:
+  bool isVar(int t) {
+    return t < static_cast<int>(_vars.size()) && _vars[t];
+  }
+  int top(int v) { return _stacks[v].empty() ? v : _stacks[v].back(); }
+
+private:
+  ControlGraph *_g;
+  DomTree& _dom;
+  std::vector<bool>& _vars;
+  std::map<Quad *, int>& _phis;
+  std::vector<std::vector<int> > _stacks;
+};
+
+/* Renames the definitions of the variables in the block b, and their
+   uses which b dominates. A use reached by no definition keeps the
+   original temporary, which is never defined. */
+void SSARenamer::rename(int b)
+{
+  BasicBlock *blk = _dom.getBlock(b);
+  std::vector<int> pushed;
+
+  std::list<Quad *>& quads = blk->getQuads();
+  std::list<Quad *>::iterator iter;
+  for (iter = quads.begin(); iter != quads.end(); ++iter) {
+    Quad *q = *iter;
+    if (q->getTag() != QT_PHI) {
+      std::vector<int>& args = q->getArgs();
+      for (size_t i = 0; i < args.size(); i++) {
+        if (isVar(args[i]))
+          args[i] = top(args[i]);
+      }
+    }
+
+    int v = (q->getTag() == QT_PHI) ? _phis[q] : q->getLhs();
+    if (v < 0 || !isVar(v))
+      continue;
+    int t = _g->newTemp(_g->getTempName(v));
+    q->setLhs(t);
+    _stacks[v].push_back(t);
+    pushed.push_back(v);
+  }
+
+  std::vector<BasicBlock *>& succs = blk->getSuccs();
+  for (size_t i = 0; i < succs.size(); i++) {
+    std::list<Quad *>& squads = succs[i]->getQuads();
+    for (iter = squads.begin(); iter != squads.end(); ++iter) {
+      Quad *phi = *iter;
+      if (phi->getTag() != QT_PHI)
+        break;
+      phi->addArg(top(_phis[phi]));
+      phi->getSources().push_back(blk);
+    }
+  }
+
+  std::vector<int>& children = _dom.getChildren(b);
+  for (size_t i = 0; i < children.size(); i++)
+    rename(children[i]);
+
+  for (size_t i = 0; i < pushed.size(); i++)
+    _stacks[pushed[i]].pop_back();
+}
+
+/* Every temporary which holds a local variable is renamed, including
+   those defined once, since a use in a loop may come before the
+   definition. Returns the number of phi-functions inserted. The entry
+   has no predecessors, as the builder starts loops in blocks of their
+   own. */
+int SSABuilder::run()
+{
+  _graph->link();
+  DomTree dom(_graph);
+
+  int n = _graph->getNtemps();
+  std::vector<bool> vars(n, false);
+  std::vector<std::set<int> > defsites(n, std::set<int>());
+  for (int b = 0; b < dom.size(); b++) {
+    std::list<Quad *>& quads = dom.getBlock(b)->getQuads();
+    std::list<Quad *>::iterator iter;
+    for (iter = quads.begin(); iter != quads.end(); ++iter) {
+      int t = (*iter)->getLhs();
+      if (t >= 0 && _graph->getTempName(t) != "") {
+        vars[t] = true;
+        defsites[t].insert(b);
+      }
+    }
+  }
+
+  /* phi-functions at the iterated dominance frontiers of definitions */
+  std::map<Quad *, int> phis;
+  for (int v = 0; v < n; v++) {
+    if (!vars[v])
+      continue;
+    std::set<int> placed;
+    std::vector<int> work(defsites[v].begin(), defsites[v].end());
+    while (!work.empty()) {
+      int b = work.back();
+      work.pop_back();
+      std::set<int>& frontier = dom.getFrontier(b);
+      std::set<int>::iterator iter;
+      for (iter = frontier.begin(); iter != frontier.end(); ++iter) {
+        if (!placed.insert(*iter).second)
+          continue;
+        Quad *phi = new Quad(QT_PHI, v);
+        dom.getBlock(*iter)->getQuads().push_front(phi);
+        phis[phi] = v;
+        if (!defsites[v].count(*iter))
+          work.push_back(*iter);
+      }
+    }
+  }
+
+  SSARenamer renamer(_graph, dom, vars, phis);
+  renamer.rename(0);
+
+  return phis.size();
+}
+
+
+/*
+ * SSADestructor
+ */
+class Coalescer {
+public:
+  Coalescer(ControlGraph *g) : _g(g) { }
+
+  int run();
+
+private:
+  void computeLiveness(std::vector<BitVector>& liveout);
+  void addInterference(int a, int b);
+  int find(int t);
+
+private:
+  ControlGraph *_g;
+  std::vector<BitVector> _adj;      /* interference, a row per temporary */
+  std::vector<int> _parent;
+};
+
+/* Computes the temporaries live out of each block, backwards until no
+   set changes, with a bit per temporary. */
+void Coalescer::computeLiveness(std::vector<BitVector>& liveout)
+{
+  std::vector<BasicBlock *>& blocks = _g->getBlocks();
+  size_t n = blocks.size();
+  size_t ntemps = _g->getNtemps();
+  std::vector<BitVector> uses(n, BitVector(ntemps));
+  std::vector<BitVector> defs(n, BitVector(ntemps));
+  std::vector<BitVector> livein(n, BitVector(ntemps));
+  for (size_t i = 0; i < n; i++) {
+    std::list<Quad *>& quads = blocks[i]->getQuads();
+    std::list<Quad *>::iterator iter;
+    for (iter = quads.begin(); iter != quads.end(); ++iter) {
+      std::vector<int>& args = (*iter)->getArgs();
+      for (size_t j = 0; j < args.size(); j++) {
+        if (!defs[i][args[j]])
+          uses[i].set(args[j]);
+      }
+      if ((*iter)->getLhs() >= 0)
+        defs[i].set((*iter)->getLhs());
+    }
+  }
+
+  liveout.assign(n, BitVector(ntemps));
+  BitVector in(ntemps), out(ntemps);
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = n; i > 0; i--) {
+      BasicBlock *blk = blocks[i - 1];
+      out.reset();
+      std::vector<BasicBlock *>& succs = blk->getSuccs();
+      for (size_t j = 0; j < succs.size(); j++)
+        out |= livein[succs[j]->getId()];
+
+      in = out;
+      in.reset(defs[i - 1]);
+      in |= uses[i - 1];
+      if (in != livein[i - 1] || out != liveout[i - 1]) {
+        livein[i - 1].swap(in);
+        liveout[i - 1].swap(out);
+        changed = true;
+      }
+    }
+  }
+}
+
+void Coalescer::addInterference(int a, int b)
+{
+  if (a == b)
+    return;
+  _adj[a].set(b);
+  _adj[b].set(a);
+}
+
+int Coalescer::find(int t)
+{
+  while (_parent[t] != t)
+    t = _parent[t] = _parent[_parent[t]];
+
+  return t;
+}
+
+/* Merges the temporaries of each copy which do not interfere, and
+   removes the copies which become redundant. Returns their number. */
+int Coalescer::run()
+{
+  int n = _g->getNtemps();
+  _adj.assign(n, BitVector(n));
+  _parent.resize(n);
+  for (int t = 0; t < n; t++)
+    _parent[t] = t;
+
+  std::vector<BitVector> liveout;
+  computeLiveness(liveout);
+
+  std::vector<BasicBlock *>& blocks = _g->getBlocks();
+  std::vector<Quad *> copies;
+  BitVector live(n);
+  for (size_t i = 0; i < blocks.size(); i++) {
+    live = liveout[i];
+    std::list<Quad *>& quads = blocks[i]->getQuads();
+    std::list<Quad *>::reverse_iterator iter;
+    for (iter = quads.rbegin(); iter != quads.rend(); ++iter) {
+      Quad *q = *iter;
+      int t = q->getLhs();
+      bool copy = q->getTag() == QT_COPY;
+      if (t >= 0) {
+        for (int l = live.find_first(); l != -1; l = live.find_next(l)) {
+          if (!copy || l != q->getArg(0))
+            addInterference(t, l);
+        }
+        live.reset(t);
+      }
+      if (copy)
+        copies.push_back(q);
+
+      std::vector<int>& args = q->getArgs();
+      for (size_t j = 0; j < args.size(); j++)
+        live.set(args[j]);
+    }
+  }
+
+  for (size_t i = 0; i < copies.size(); i++) {
+    int a = find(copies[i]->getLhs());
+    int b = find(copies[i]->getArg(0));
+    if (a == b || _adj[a][b])
+      continue;
+    if (b < a)
+      std::swap(a, b);
+
+    /* b joins a */
+    _parent[b] = a;
+    BitVector& badj = _adj[b];
+    for (int t = badj.find_first(); t != -1; t = badj.find_next(t)) {
+      _adj[t].reset(b);
+      _adj[t].set(a);
+    }
+    _adj[a] |= badj;
+    badj.reset();
+  }
+
+  int removed = 0;
+  for (size_t i = 0; i < blocks.size(); i++) {
+    std::list<Quad *>& quads = blocks[i]->getQuads();
+    std::list<Quad *>::iterator iter = quads.begin();
+    while (iter != quads.end()) {
+      Quad *q = *iter;
+      if (q->getLhs() >= 0)
+        q->setLhs(find(q->getLhs()));
+      std::vector<int>& args = q->getArgs();
+      for (size_t j = 0; j < args.size(); j++)
+        args[j] = find(args[j]);
+
+      if (q->getTag() == QT_COPY && q->getLhs() == q->getArg(0)) {
+        delete q;
+        iter = quads.erase(iter);
+        removed++;
+        continue;
+      }
+      ++iter;
+    }
+  }
+
+  return removed;
+}
+
+/* Each phi-function t = phi(a1, ..., an) becomes t = t', where t' is a
+   new temporary, and each predecessor i ends with t' = ai. As t' is new,
+   the copies of the phi-functions of a block do not overwrite each
+   other's arguments. */
+int SSADestructor::run()
+{
+  std::vector<BasicBlock *>& blocks = _graph->getBlocks();
+  for (size_t i = 0; i < blocks.size(); i++) {
+    std::list<Quad *>& quads = blocks[i]->getQuads();
+    std::list<Quad *>::iterator iter;
+    for (iter = quads.begin(); iter != quads.end(); ++iter) {
+      Quad *phi = *iter;
+      if (phi->getTag() != QT_PHI)
+        break;
+
+      int t = _graph->newTemp(_graph->getTempName(phi->getLhs()));
+      std::vector<BasicBlock *>& sources = phi->getSources();
+      for (size_t j = 0; j < sources.size(); j++) {
+        Quad *copy = new Quad(QT_COPY, t);
+        copy->addArg(phi->getArg(j));
+        _append_quad(sources[j], copy);
+      }
+      phi->setTag(QT_COPY);
+      phi->getArgs().assign(1, t);
+      sources.clear();
+    }
+  }
+
+  Coalescer coalescer(_graph);
+  return coalescer.run();
+}
+
+
+/*
+ * Inliner
+ */
+
+/* Replaces the call with a copy of the body of the callee, and returns
+   the block of the quads after the call, which the returns of the copy
+   jump to. The parameters of the callee become copies of the arguments,
+   or null for those missing, and its temporaries new ones of the graph,
+   named after the callee. The returns assign a variable, as there may
+   be several of them, which the rest of the block copies to the result
+   of the call. */
+BasicBlock *Inliner::inlineCall(BasicBlock *blk,
+                                std::list<Quad *>::iterator call,
+                                ControlGraph *callee)
+{
+  Quad *q = *call;
+  const std::string& name = callee->getName();
+
+  std::vector<int> temps(callee->getNtemps());
+  for (size_t t = 0; t < temps.size(); t++) {
+    const std::string& tname = callee->getTempName(t);
+    temps[t] = _graph->newTemp(tname == "" ? "" : name + "." + tname);
+  }
+  int result = q->getLhs() >= 0 ? _graph->newTemp(name + ".return") : -1;
+
+  /* the copy, and the rest of the block, go after the block */
+  std::vector<BasicBlock *>& blocks = callee->getBlocks();
+  std::map<BasicBlock *, BasicBlock *> copies;
+  std::vector<BasicBlock *> added;
+  for (size_t i = 0; i < blocks.size(); i++) {
+    copies[blocks[i]] = new BasicBlock(0);
+    added.push_back(copies[blocks[i]]);
+  }
+  BasicBlock *rest = new BasicBlock(0);
+  added.push_back(rest);
+  std::list<Quad *>& quads = blk->getQuads();
+  rest->getQuads().splice(rest->getQuads().end(), quads, std::next(call),
+                          quads.end());
+  if (result >= 0) {
+    Quad *copy = new Quad(QT_COPY, q->getLhs());
+    copy->addArg(result);
+    rest->getQuads().push_front(copy);
+  }
+
+  for (size_t i = 0; i < blocks.size(); i++) {
+    BasicBlock *copy = copies[blocks[i]];
+    std::list<Quad *>::iterator iter;
+    for (iter = blocks[i]->getQuads().begin();
+         iter != blocks[i]->getQuads().end(); ++iter) {
+      Quad *from = *iter;
+      Quad *to;
+      if (from->getTag() == QT_PARAM) {
+        size_t k = from->getImm();
+        to = new Quad(k < q->getArgs().size() ? QT_COPY : QT_NULL,
+                      temps[from->getLhs()]);
+        if (k < q->getArgs().size())
+          to->addArg(q->getArg(k));
+        copy->addQuad(to);
+        continue;
+      }
+      if (from->getTag() == QT_RET) {
+        if (result >= 0) {
+          to = new Quad(from->getArgs().empty() ? QT_NULL : QT_COPY, result);
+          if (!from->getArgs().empty())
+            to->addArg(temps[from->getArg(0)]);
+          copy->addQuad(to);
+        }
+        to = new Quad(QT_JUMP);
+        to->setTarget(0, rest);
+        copy->addQuad(to);
+        continue;
+      }
+
+      to = new Quad(from->getTag(),
+                    from->getLhs() < 0 ? -1 : temps[from->getLhs()]);
+      for (size_t j = 0; j < from->getArgs().size(); j++)
+        to->addArg(temps[from->getArg(j)]);
+      for (size_t j = 0; j < from->getSources().size(); j++)
+        to->getSources().push_back(copies[from->getSources()[j]]);
+      to->setSym(from->getSym());
+      to->setImm(from->getImm());
+      for (int j = 0; j < 2; j++) {
+        if (from->getTarget(j))
+          to->setTarget(j, copies[from->getTarget(j)]);
+      }
+      copy->addQuad(to);
+    }
+  }
+
+  quads.erase(call);
+  delete q;
+  Quad *jump = new Quad(QT_JUMP);
+  jump->setTarget(0, copies[callee->getEntry()]);
+  blk->addQuad(jump);
+
+  std::vector<BasicBlock *>& layout = _graph->getBlocks();
+  layout.insert(std::find(layout.begin(), layout.end(), blk) + 1,
+                added.begin(), added.end());
+
+  return rest;
+}
+
+int Inliner::run()
+{
+  int changes = 0;
+
+  /* the functions each block is inlined from, innermost last, to find
+     the calls of a function from its own body */
+  std::map<BasicBlock *, std::vector<std::string> > chains;
+  std::vector<BasicBlock *> work(_graph->getBlocks().rbegin(),
+                                 _graph->getBlocks().rend());
+  while (!work.empty()) {
+    BasicBlock *blk = work.back();
+    work.pop_back();
+
+    std::list<Quad *>& quads = blk->getQuads();
+    std::list<Quad *>::iterator iter;
+    for (iter = quads.begin(); iter != quads.end(); ++iter) {
+      Quad *q = *iter;
+      if (q->getTag() == QT_FUNCALL && q->getImm() == CT_FUNC)
+        break;
+    }
+    if (iter == quads.end())
+      continue;
+
+    std::string name = (*iter)->getSym();
+    std::vector<std::string> chain = chains[blk];
+    if (name == _graph->getName()
+        || std::find(chain.begin(), chain.end(), name) != chain.end()) {
+      std::cerr << "error: Recursive call of \"" << name << "\" in \""
+                << _graph->getName() << "\", which cannot be inlined."
+                << std::endl;
+      return -1;
+    }
+    ControlGraph *callee = _mod->getFunction(name);
+    if (!callee) {
+      std::cerr << "error: No function \"" << name << "\" to inline."
+                << std::endl;
+      return -1;
+    }
+
+    /* the copy is searched for calls from the callee, and the rest of
+       the block for the calls after this one */
+    size_t nblocks = _graph->getBlocks().size();
+    BasicBlock *rest = inlineCall(blk, iter, callee);
+    std::vector<BasicBlock *>& layout = _graph->getBlocks();
+    size_t first = std::find(layout.begin(), layout.end(), blk)
+      - layout.begin() + 1;
+    size_t ncopies = layout.size() - nblocks - 1;
+    chains[rest] = chain;
+    work.push_back(rest);
+    chain.push_back(name);
+    for (size_t i = first; i < first + ncopies; i++) {
+      chains[layout[i]] = chain;
+      work.push_back(layout[i]);
+    }
+    changes++;
+  }
+
+  if (changes > 0)
+    _graph->link();
+
+  return changes;
+}
+
+
+/*
+ * PropCacher
+ */
+class PropCacheImpl {
+public:
+  PropCacheImpl(ControlGraph *g) : _g(g), _changes(0) { }
+
+  int run();
+
+private:
+  bool isBarrier(Quad *q) {
+    return q->isSuspension() || q->getTag() == QT_RET
+      || (q->getTag() == QT_FUNCALL && q->getImm() == CT_FUNC);
+  }
+  void walk(BasicBlock *blk, std::vector<bool>& avail, bool rewrite);
+  void walkBack(BasicBlock *blk, std::vector<bool>& over, bool rewrite);
+
+private:
+  ControlGraph *_g;
+  std::map<std::string, int> _index;
+  std::vector<int> _vars;
+  int _changes;
+};
+
+/* Computes which values are available at the end of the block, from
+   those available at its start. If rewrite is true, reads of available
+   values become copies, and each value read or written is copied to the
+   variable of its property. */
+void PropCacheImpl::walk(BasicBlock *blk, std::vector<bool>& avail,
+                         bool rewrite)
+{
+  std::list<Quad *>& quads = blk->getQuads();
+  std::list<Quad *>::iterator iter;
+  for (iter = quads.begin(); iter != quads.end(); ++iter) {
+    Quad *q = *iter;
+    QuadTag tag = q->getTag();
+    if (tag != QT_PROP_GET && tag != QT_PROP_SET) {
+      if (isBarrier(q))
+        avail.assign(avail.size(), false);
+      continue;
+    }
+
+    int p = _index[q->getSym()];
+    if (tag == QT_PROP_GET && avail[p]) {
+      if (rewrite) {
+        q->setTag(QT_COPY);
+        q->setSym("");
+        q->addArg(_vars[p]);
+        _changes++;
+      }
+      continue;
+    }
+
+    if (q->isSuspension())
+      avail.assign(avail.size(), false);
+    avail[p] = true;
+    if (rewrite) {
+      Quad *copy = new Quad(QT_COPY, _vars[p]);
+      copy->addArg(tag == QT_PROP_GET ? q->getLhs() : q->getArg(0));
+      iter = quads.insert(++iter, copy);
+    }
+  }
+}
+
+/* Computes which properties are written again, before anything can see
+   them, at the start of the block from those at its end. If rewrite is
+   true, removes the writes which are written again. */
+void PropCacheImpl::walkBack(BasicBlock *blk, std::vector<bool>& over,
+                             bool rewrite)
+{
+  std::list<Quad *>& quads = blk->getQuads();
+  std::list<Quad *>::iterator iter = quads.end();
+  while (iter != quads.begin()) {
+    Quad *q = *--iter;
+    if (isBarrier(q)) {
+      over.assign(over.size(), false);
+      continue;
+    }
+    if (q->getTag() == QT_PROP_GET) {
+      over[_index[q->getSym()]] = false;
+    }
+    else if (q->getTag() == QT_PROP_SET) {
+      int p = _index[q->getSym()];
+      if (rewrite && over[p]) {
+        delete q;
+        iter = quads.erase(iter);
+        _changes++;
+      }
+      over[p] = true;
+    }
+  }
+}
+
+/* Reads are cached along every path (a forward must-analysis), then
+   writes overwritten along every path are removed (a backward
+   must-analysis). The other writes stay where they are: the value to
+   write is on the stack there, and moving the write to the end of the
+   path would cost a save and a load. */
+int PropCacheImpl::run()
+{
+  std::vector<BasicBlock *>& blocks = _g->getBlocks();
+  for (size_t i = 0; i < blocks.size(); i++) {
+    std::list<Quad *>& quads = blocks[i]->getQuads();
+    std::list<Quad *>::iterator iter;
+    for (iter = quads.begin(); iter != quads.end(); ++iter) {
+      QuadTag tag = (*iter)->getTag();
+      const std::string& sym = (*iter)->getSym();
+      if ((tag != QT_PROP_GET && tag != QT_PROP_SET) || _index.count(sym))
+        continue;
+      _index[sym] = _vars.size();
+      _vars.push_back(_g->newTemp(sym));
+    }
+  }
+  size_t nprops = _vars.size();
+  if (nprops == 0)
+    return 0;
+
+  /* optimistic, except at the entry */
+  size_t n = blocks.size();
+  std::vector<std::vector<bool> > in(n, std::vector<bool>(nprops, true));
+  std::vector<std::vector<bool> > out(n, std::vector<bool>(nprops, true));
+  in[0].assign(nprops, false);
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = 0; i < n; i++) {
+      std::vector<BasicBlock *>& preds = blocks[i]->getPreds();
+      for (size_t j = 0; j < preds.size(); j++) {
+        std::vector<bool>& pout = out[preds[j]->getId()];
+        for (size_t p = 0; p < nprops; p++)
+          in[i][p] = in[i][p] && pout[p];
+      }
+      std::vector<bool> avail = in[i];
+      walk(blocks[i], avail, false);
+      if (avail != out[i]) {
+        out[i].swap(avail);
+        changed = true;
+      }
+    }
+  }
+  for (size_t i = 0; i < n; i++)
+    walk(blocks[i], in[i], true);
+
+  /* optimistic, since every path ends with a barrier */
+  in.assign(n, std::vector<bool>(nprops, true));
+  out.assign(n, std::vector<bool>(nprops, true));
+  changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = n; i > 0; i--) {
+      std::vector<BasicBlock *>& succs = blocks[i - 1]->getSuccs();
+      for (size_t j = 0; j < succs.size(); j++) {
+        std::vector<bool>& sin = in[succs[j]->getId()];
+        for (size_t p = 0; p < nprops; p++)
+          out[i - 1][p] = out[i - 1][p] && sin[p];
+      }
+      std::vector<bool> over = out[i - 1];
+      walkBack(blocks[i - 1], over, false);
+      if (over != in[i - 1]) {
+        in[i - 1].swap(over);
+        changed = true;
+      }
+    }
+  }
+  for (size_t i = 0; i < n; i++)
+    walkBack(blocks[i], out[i], true);
+
+  return _changes;
+}
+
+int PropCacher::run()
+{
+  _graph->link();
+  PropCacheImpl impl(_graph);
+
+  return impl.run();
+}
+
+
+/*
+ * RemoteBatcher
+ */
+
+/* estimated time of an mvrt instruction, in milliseconds */
+static const double _instr_time = 0.001;
+
+/* Returns the device of a remote property read, or "". */
+static std::string _remote_dev(Quad *q)
+{
+  if (q->getTag() != QT_PROP_GET)
+    return "";
+  size_t colon = q->getSym().find(':');
+  if (colon == std::string::npos || colon == 0)
+    return "";
+
+  return q->getSym().substr(0, colon);
+}
+
+/* Returns true if a remote read may not be moved across q, which is not
+   a remote read. Calls and triggers are fences, as well as the points
+   where the reactor may be suspended. */
+static bool _is_fence(Quad *q)
+{
+  if (q->isSuspension())
+    return true;
+
+  switch (q->getTag()) {
+  case QT_PROP_GET:
+    return _remote_dev(q) == "";
+  case QT_PROP_SET:
+  case QT_FUNCALL:
+  case QT_TRIGGER:
+    return true;
+  default:
+    break;
+  }
+
+  return false;
+}
+
+double RemoteBatcher::getLatency(const std::string& dev)
+{
+  std::map<std::string, double>::iterator iter = _latencies.find(dev);
+  if (iter == _latencies.end())
+    return _deflatency;
+
+  return iter->second;
+}
+
+/* Replaces the reads with a batched read at the first of them, and each
+   read with a getf from the map, where the read was. Returns the number
+   of round trips saved. */
+int RemoteBatcher::batch(BasicBlock *blk, std::vector<Quad *>& reads)
+{
+  size_t k = reads.size();
+  if (k < 2)
+    return 0;
+
+  /* "pushs; prop_get" for each read, against "pushs; prop_get; save"
+     and "load; pushs; getf" for each read */
+  std::string dev = _remote_dev(reads[0]);
+  double saved = (k - 1) * getLatency(dev);
+  double cost = (k + 3) * _instr_time;
+  if (saved <= cost)
+    return 0;
+
+  std::vector<std::string> names;
+  for (size_t i = 0; i < k; i++) {
+    std::string name = reads[i]->getSym().substr(dev.size() + 1);
+    if (std::find(names.begin(), names.end(), name) == names.end())
+      names.push_back(name);
+  }
+  std::string sym = dev + ":";
+  for (size_t i = 0; i < names.size(); i++)
+    sym += (i == 0 ? "" : ",") + names[i];
+
+  int map = _graph->newTemp();
+  Quad *get = new Quad(QT_PROP_GET, map);
+  get->setSym(sym);
+  std::list<Quad *>& quads = blk->getQuads();
+  quads.insert(std::find(quads.begin(), quads.end(), reads[0]), get);
+
+  /* a single name is answered with its value */
+  for (size_t i = 0; i < k; i++) {
+    Quad *q = reads[i];
+    q->setTag(names.size() == 1 ? QT_COPY : QT_GETF);
+    q->setSym(names.size() == 1 ? "" : q->getSym().substr(dev.size() + 1));
+    q->addArg(map);
+  }
+
+  return k - 1;
+}
+
+int RemoteBatcher::run()
+{
+  int saved = 0;
+  std::vector<BasicBlock *>& blocks = _graph->getBlocks();
+  for (size_t i = 0; i < blocks.size(); i++) {
+    /* the reads of a device since the last fence. Each read suspends
+       the reactor, so the read of another device ends the group, and
+       so does a property read again: the value may have changed while
+       the reactor was suspended at the reads between. */
+    std::vector<Quad *> group;
+    std::set<std::string> names;
+
+    std::vector<Quad *> quads(blocks[i]->getQuads().begin(),
+                              blocks[i]->getQuads().end());
+    for (size_t j = 0; j < quads.size(); j++) {
+      Quad *q = quads[j];
+      std::string dev = _remote_dev(q);
+      if (dev != "") {
+        if (!group.empty() && (_remote_dev(group[0]) != dev
+                               || names.count(q->getSym()))) {
+          saved += batch(blocks[i], group);
+          group.clear();
+          names.clear();
+        }
+        group.push_back(q);
+        names.insert(q->getSym());
+        continue;
+      }
+      if (!_is_fence(q))
+        continue;
+      saved += batch(blocks[i], group);
+      group.clear();
+      names.clear();
+    }
+    saved += batch(blocks[i], group);
+  }
+
+  return saved;
+}
+
+
+/*
+ * ConstFolder
+ */
+
+/* Truth of a constant as in mvrt: null, zero and the empty string are
+   false. Returns -1 if q is not a constant. */
+static int _truth(Quad *q)
+{
+  if (!q)
+    return -1;
+  switch (q->getTag()) {
+  case QT_CONST:
+    return q->getImm() != 0;
+  case QT_STRING:
+    return q->getSym() != "";
+  case QT_NULL:
+    return 0;
+  default:
+    break;
+  }
+
+  return -1;
+}
+
+/* Evaluates a OP b. Returns false if mvrt would fail, or if the result
+   overflows. */
+static bool _fold(QuadTag tag, int a, int b, int *result)
+{
+  long long r;
+  switch (tag) {
+  case QT_ADD: r = static_cast<long long>(a) + b; break;
+  case QT_SUB: r = static_cast<long long>(a) - b; break;
+  case QT_MUL: r = static_cast<long long>(a) * b; break;
+  case QT_DIV:
+    if (b == 0 || (a == INT_MIN && b == -1))
+      return false;
+    r = a / b;
+    break;
+  case QT_EQ: r = a == b; break;
+  case QT_NE: r = a != b; break;
+  case QT_LT: r = a < b; break;
+  case QT_LE: r = a <= b; break;
+  case QT_GT: r = a > b; break;
+  case QT_GE: r = a >= b; break;
+  default:
+    return false;
+  }
+  if (r < INT_MIN || r > INT_MAX)
+    return false;
+  *result = r;
+
+  return true;
+}
+
+int ConstFolder::run()
+{
+  std::vector<Quad *> defs;
+  _find_defs(_graph, defs);
+
+  int changes = 0;
+  bool relink = false;
+  std::vector<BasicBlock *>& blocks = _graph->getBlocks();
+  for (size_t i = 0; i < blocks.size(); i++) {
+    std::list<Quad *>& quads = blocks[i]->getQuads();
+    std::list<Quad *>::iterator iter;
+    for (iter = quads.begin(); iter != quads.end(); ++iter) {
+      Quad *q = *iter;
+      QuadTag tag = q->getTag();
+      std::vector<int>& args = q->getArgs();
+
+      if (tag == QT_BRANCH) {
+        int truth = _truth(defs[args[0]]);
+        if (truth == -1 && q->getTarget(0) != q->getTarget(1))
+          continue;
+        if (truth == 0)
+          q->setTarget(0, q->getTarget(1));
+        q->setTarget(1, NULL);
+        q->setTag(QT_JUMP);
+        args.clear();
+        relink = true;
+        changes++;
+        continue;
+      }
+
+      if (tag > QT_OR || args.size() != 2)
+        continue;
+      Quad *a = defs[args[0]];
+      Quad *b = defs[args[1]];
+      int result;
+      if (tag == QT_AND || tag == QT_OR) {
+        int ta = _truth(a);
+        int tb = _truth(b);
+        if (ta == -1 || tb == -1)
+          continue;
+        result = (tag == QT_AND) ? (ta & tb) : (ta | tb);
+      }
+      else if (!a || !b || a->getTag() != QT_CONST || b->getTag() != QT_CONST
+               || !_fold(tag, a->getImm(), b->getImm(), &result)) {
+        continue;
+      }
+
+      q->setTag(QT_CONST);
+      q->setImm(result);
+      args.clear();
+      changes++;
+    }
+  }
+
+  if (relink)
+    _graph->link();
+
+  return changes;
+}
+
+
+/*
+ * CopyPropagator
+ */
+int CopyPropagator::run()
+{
+  int n = _graph->getNtemps();
+  std::vector<int> repl(n);
+  for (int t = 0; t < n; t++)
+    repl[t] = t;
+
+  /* chains of copies are resolved as they are found, so that a cycle of
+     phi-functions is never replaced with itself */
+  std::vector<BasicBlock *>& blocks = _graph->getBlocks();
+  std::set<Quad *> dead;
+  bool found = true;
+  while (found) {
+    found = false;
+    for (size_t i = 0; i < blocks.size(); i++) {
+      std::list<Quad *>& quads = blocks[i]->getQuads();
+      std::list<Quad *>::iterator iter;
+      for (iter = quads.begin(); iter != quads.end(); ++iter) {
+        Quad *q = *iter;
+        int t = q->getLhs();
+        if ((q->getTag() != QT_COPY && q->getTag() != QT_PHI)
+            || dead.count(q))
+          continue;
+
+        int value = -1;
+        std::vector<int>& args = q->getArgs();
+        for (size_t j = 0; j < args.size(); j++) {
+          int a = args[j];
+          while (repl[a] != a)
+            a = repl[a];
+          if (a == t)
+            continue;
+          if (value != -1 && value != a) {
+            value = -2;
+            break;
+          }
+          value = a;
+        }
+        if (value < 0)
+          continue;
+
+        repl[t] = value;
+        dead.insert(q);
+        found = true;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < blocks.size(); i++) {
+    std::list<Quad *>& quads = blocks[i]->getQuads();
+    std::list<Quad *>::iterator iter = quads.begin();
+    while (iter != quads.end()) {
+      Quad *q = *iter;
+      if (dead.count(q)) {
+        delete q;
+        iter = quads.erase(iter);
+        continue;
+      }
+
+      std::vector<int>& args = q->getArgs();
+      for (size_t j = 0; j < args.size(); j++) {
+        while (repl[args[j]] != args[j])
+          args[j] = repl[args[j]];
+      }
+      ++iter;
+    }
+  }
+
+  return dead.size();
+}
+
+
+/*
+ * CSEliminator
+ */
+class ValueNumbering {
+public:
+  ValueNumbering(ControlGraph *g, DomTree& dom)
+    : _dom(dom), _changes(0) {
+    _vn.resize(g->getNtemps());
+    for (size_t t = 0; t < _vn.size(); t++)
+      _vn[t] = t;
+  }
+
+  void number(int b);
+  int getChanges() { return _changes; }
+
+private:
+  bool key(Quad *q, std::string& key);
+
+private:
+  DomTree& _dom;
+  std::vector<int> _vn;
+  std::map<std::string, int> _table;
+  int _changes;
+};
+
+/* Makes the key of the value computed by q, with the operands of
+   commutative and mirrored operators in a canonical order. Returns false
+   if the value is not a candidate. */
+bool ValueNumbering::key(Quad *q, std::string& key)
+{
+  QuadTag tag = q->getTag();
+  if (q->getLhs() < 0 || q->getEffect() != EF_PURE || tag == QT_COPY
+      || tag == QT_PHI)
+    return false;
+
+  std::vector<int> args;
+  for (size_t i = 0; i < q->getArgs().size(); i++)
+    args.push_back(_vn[q->getArg(i)]);
+
+  if (args.size() == 2) {
+    if (tag == QT_GT || tag == QT_GE) {
+      tag = (tag == QT_GT) ? QT_LT : QT_LE;
+      std::swap(args[0], args[1]);
+    }
+    else if ((tag == QT_ADD || tag == QT_MUL || tag == QT_EQ || tag == QT_NE
+              || tag == QT_AND || tag == QT_OR) && args[0] > args[1]) {
+      std::swap(args[0], args[1]);
+    }
+  }
+
+  std::ostringstream os;
+  os << tag << " " << q->getImm() << " " << q->getSym();
+  for (size_t i = 0; i < args.size(); i++)
+    os << " " << args[i];
+  key = os.str();
+
+  return true;
+}
+
+/* Walks the dominator tree from the block b, with the values of the
+   dominating blocks in the table. Constants, strings, the event value and
+   the parameters are only numbered: pushing them again costs about as
+   much as saving and loading them. */
+void ValueNumbering::number(int b)
+{
+  std::vector<std::string> added;
+
+  std::list<Quad *>& quads = _dom.getBlock(b)->getQuads();
+  std::list<Quad *>::iterator iter;
+  for (iter = quads.begin(); iter != quads.end(); ++iter) {
+    Quad *q = *iter;
+    std::string k;
+    if (!key(q, k))
+      continue;
+
+    int t = q->getLhs();
+    std::map<std::string, int>::iterator found = _table.find(k);
+    if (found == _table.end()) {
+      _table[k] = t;
+      added.push_back(k);
+      continue;
+    }
+
+    int e = found->second;
+    _vn[t] = _vn[e];
+    QuadTag tag = q->getTag();
+    if (tag == QT_CONST || tag == QT_STRING || tag == QT_NULL
+        || tag == QT_ARG || tag == QT_PARAM)
+      continue;
+    q->setTag(QT_COPY);
+    q->getArgs().assign(1, e);
+    q->setImm(0);
+    q->setSym("");
+    _changes++;
+  }
+
+  std::vector<int>& children = _dom.getChildren(b);
+  for (size_t i = 0; i < children.size(); i++)
+    number(children[i]);
+
+  for (size_t i = 0; i < added.size(); i++)
+    _table.erase(added[i]);
+}
+
+int CSEliminator::run()
+{
+  DomTree dom(_graph);
+  ValueNumbering vn(_graph, dom);
+  vn.number(0);
+
+  return vn.getChanges();
+}
+
+
+/*
+ * DCEliminator
+ */
+int DCEliminator::run()
+{
+  std::vector<Quad *> defs;
+  _find_defs(_graph, defs);
+
+  /* quads with side effects are live, and so are the values they use */
+  std::vector<bool> live(_graph->getNtemps(), false);
+  std::vector<int> work;
+  std::vector<BasicBlock *>& blocks = _graph->getBlocks();
+  for (size_t i = 0; i < blocks.size(); i++) {
+    std::list<Quad *>& quads = blocks[i]->getQuads();
+    std::list<Quad *>::iterator iter;
+    for (iter = quads.begin(); iter != quads.end(); ++iter) {
+      if ((*iter)->getEffect() != EF_WRITE)
+        continue;
+      std::vector<int>& args = (*iter)->getArgs();
+      work.insert(work.end(), args.begin(), args.end());
+    }
+  }
+  while (!work.empty()) {
+    int t = work.back();
+    work.pop_back();
+    if (live[t])
+      continue;
+    live[t] = true;
+    if (defs[t]) {
+      std::vector<int>& args = defs[t]->getArgs();
+      work.insert(work.end(), args.begin(), args.end());
+    }
+  }
+
+  int changes = 0;
+  for (size_t i = 0; i < blocks.size(); i++) {
+    std::list<Quad *>& quads = blocks[i]->getQuads();
+    std::list<Quad *>::iterator iter = quads.begin();
+    while (iter != quads.end()) {
+      Quad *q = *iter;
+      int t = q->getLhs();
+      if (t < 0 || live[t]) {
+        ++iter;
+        continue;
+      }
+
+      changes++;
+      if (q->getEffect() == EF_WRITE) {
+        /* a call whose result is not used */
+        q->setLhs(-1);
+        ++iter;
+        continue;
+      }
+      delete q;
+      iter = quads.erase(iter);
+    }
+  }
+
+  return changes;
+}
+
+} /* mvc */
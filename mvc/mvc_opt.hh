@@ -0,0 +1,166 @@
+/**
+ * @file mvc_opt.hh
+ *
+ * @brief Optimization passes over the intermediate representation.
+ *
+ * SSABuilder puts a graph in SSA form, where every temporary is defined
+ * by a single quad, and the values of a local variable which meet at a
+ * block are merged by a phi-function. The optimizations assume SSA form.
+ * SSADestructor replaces phi-functions with copies again, and coalesces
+ * the temporaries of the copies which are not live at the same time.
+ */
+#ifndef MVC_OPT_HH
+#define MVC_OPT_HH
+
+#include <list>
+#include <map>
+#include "mvc_pass.hh"
+
+namespace mvc {
+
+/**
+ * @class SSABuilder
+ */
+class SSABuilder : public GraphPass {
+public:
+  SSABuilder() : GraphPass("ssa") { }
+  int run();
+};
+
+/**
+ * @class SSADestructor
+ */
+class SSADestructor : public GraphPass {
+public:
+  SSADestructor() : GraphPass("unssa") { }
+  int run();
+};
+
+/**
+ * @class Inliner
+ *
+ * @brief Replaces each call of a function of the module with the body of
+ * the function. mvrt does not evaluate the functions of a module, so it
+ * runs at every level of optimization. A function which calls itself,
+ * directly or through others, is reported as an error.
+ */
+class Inliner : public GraphPass {
+public:
+  Inliner(IRModule *mod) : GraphPass("inline"), _mod(mod) { }
+  int run();
+
+private:
+  BasicBlock *inlineCall(BasicBlock *blk, std::list<Quad *>::iterator call,
+                         ControlGraph *callee);
+
+private:
+  IRModule *_mod;
+};
+
+/**
+ * @class PropCacher
+ *
+ * @brief Keeps the values of properties in local variables, so that a
+ * property is read once, and removes the writes of properties which are
+ * written again before anything can see them.
+ *
+ * A reactor runs atomically, except where it is suspended waiting for
+ * another device (Quad::isSuspension), and other reactors may run. The
+ * cached values, local or remote, are dropped at each suspension point
+ * and each call of a function of the module, which may use properties,
+ * and the writes before them stay. A remote property is read again only
+ * after a suspension point. Runs before SSABuilder, whose copy
+ * propagation removes the variables.
+ */
+class PropCacher : public GraphPass {
+public:
+  PropCacher() : GraphPass("propcache") { }
+  int run();
+};
+
+/**
+ * @class RemoteBatcher
+ *
+ * @brief Combines the reads of properties of the same device in a block
+ * into a single request, "dev:name1,name2,...", answered with a map from
+ * the names to the values. The later reads are hoisted to the first one,
+ * across computations, but not across anything which may change what the
+ * device returns, or what it sees of this device: property accesses,
+ * calls and triggers. Nor across a point where the reactor may be
+ * suspended, and other reactors run (Quad::isSuspension), such as the
+ * read of another device. As every remote read is such a point, a
+ * property read twice is still read twice.
+ *
+ * A batch saves a round trip to the device for each read but the first,
+ * and costs a few instructions for each read to pick its value from the
+ * map. Reads are batched only when the latency of the device, taken from
+ * the table or the default, outweighs the instructions.
+ */
+class RemoteBatcher : public GraphPass {
+public:
+  /* latencies of devices in milliseconds */
+  RemoteBatcher(const std::map<std::string, double>& latencies,
+                double deflatency = 1.0)
+    : GraphPass("batch"), _latencies(latencies), _deflatency(deflatency) { }
+  int run();
+
+private:
+  double getLatency(const std::string& dev);
+  int batch(BasicBlock *blk, std::vector<Quad *>& reads);
+
+private:
+  std::map<std::string, double> _latencies;
+  double _deflatency;
+};
+
+/**
+ * @class ConstFolder
+ *
+ * @brief Evaluates the operators on constants, the way mvrt does, and
+ * turns branches on constants into jumps.
+ */
+class ConstFolder : public GraphPass {
+public:
+  ConstFolder() : GraphPass("constfold") { }
+  int run();
+};
+
+/**
+ * @class CopyPropagator
+ *
+ * @brief Replaces the uses of copies, and of phi-functions which merge a
+ * single value, with the values copied.
+ */
+class CopyPropagator : public GraphPass {
+public:
+  CopyPropagator() : GraphPass("copyprop") { }
+  int run();
+};
+
+/**
+ * @class CSEliminator
+ *
+ * @brief Replaces a pure computation with a copy of the same computation
+ * in a dominating block.
+ */
+class CSEliminator : public GraphPass {
+public:
+  CSEliminator() : GraphPass("cse") { }
+  int run();
+};
+
+/**
+ * @class DCEliminator
+ *
+ * @brief Removes the quads whose values are never used, unless they have
+ * side effects.
+ */
+class DCEliminator : public GraphPass {
+public:
+  DCEliminator() : GraphPass("dce") { }
+  int run();
+};
+
+} /* mvc */
+
+#endif /* MVC_OPT_HH */
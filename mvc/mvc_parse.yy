@@ -20,7 +20,6 @@
    bison-generated file mvc_parse.hh. */
 %code requires {
   #include <string>
-  #include <list>
   #include <vector>
   #include "mvc_exp.hh"
   #include "mvc_stm.hh"
@@ -32,9 +31,11 @@
   }
 }
 
-/* parsing context */
+/* parsing context, and the state of the reentrant scanner */
 %parse-param { mvc::ParserDriver& driver }
+%parse-param { void *scanner }
 %lex-param { mvc::ParserDriver& driver }
+%lex-param { void *scanner }
 
 /* code to be included in the bison-generated file mvc_parse.cc */
 %code {
@@ -52,14 +53,14 @@
   int ival;
   bool bval;
   char cval;
-  std::string *strval;
+  mvc::Ident strval;          /* interned in the module */
 
   /* expressions */
-  std::list<mvc::Exp *> *explval;
+  mvc::ExpList *explval;
   mvc::Exp *expval;
 
   /* statements */
-  std::list<mvc::Stm *> *stmlval;
+  mvc::StmList *stmlval;
   mvc::Stm *stmval;
 
   /* module */
@@ -120,8 +121,10 @@
 %token MVC_TOK_BREAK
 
 /* operator precedence */
-%left MVC_TOK_LE MVC_TOK_LT MVC_TOK_GT MVC_TOK_GE MVC_TOK_EQ MVC_TOK_NE
-%left MVC_TOK_AND MVC_TOK_OR
+%left MVC_TOK_OR
+%left MVC_TOK_AND
+%left MVC_TOK_EQ MVC_TOK_NE
+%left MVC_TOK_LE MVC_TOK_LT MVC_TOK_GT MVC_TOK_GE
 %left MVC_TOK_PLUS MVC_TOK_MINUS
 %left MVC_TOK_TIMES MVC_TOK_DIV
 %left MVC_TOK_UMINUS
@@ -162,7 +165,7 @@ module:
   | stmdef
     {
       Module *module = driver.getModule();
-      ExpFactory *ef = ExpFactory::getInstance();
+      ExpFactory *ef = driver.getExpFactory();
       SymbolExp *name = ef->createSymbol("unnamed");
       module->setName(name);
       module->addStm($<stmval>1);
@@ -262,7 +265,7 @@ stm:
 stm_eventdef:
     MVC_TOK_EVENT name MVC_TOK_SEMICOLON
     { 
-      mvc::StmFactory *sf = StmFactory::getInstance();
+      mvc::StmFactory *sf = driver.getStmFactory();
       $<stmval>$ = sf->createEventdef(static_cast<SymbolExp *>($<expval>2));
     }
   ;
@@ -273,7 +276,7 @@ stm_eventdef:
 stm_vardef:
     MVC_TOK_PROP name MVC_TOK_SEMICOLON
     { 
-      mvc::StmFactory *sf = StmFactory::getInstance();
+      mvc::StmFactory *sf = driver.getStmFactory();
       $<stmval>$ = sf->createVardef(static_cast<SymbolExp *>($<expval>2));
     }
   ;
@@ -285,7 +288,7 @@ stm_fundef:
     MVC_TOK_FUNCTION name MVC_TOK_LPAREN name_list MVC_TOK_RPAREN 
     stm_block MVC_TOK_SEMICOLON
     { 
-      mvc::StmFactory *sf = StmFactory::getInstance();
+      mvc::StmFactory *sf = driver.getStmFactory();
       mvc::FundefStm *fundef = NULL;
       fundef = sf->createFundef(static_cast<SymbolExp *>($<expval>2),
                                 $<explval>4, static_cast<Stm *>($<stmval>6));
@@ -300,12 +303,11 @@ stm_procdef:
     MVC_TOK_REACTOR name MVC_TOK_LPAREN name_list MVC_TOK_RPAREN
     stm_block MVC_TOK_SEMICOLON
     { 
-      mvc::StmFactory *sf = StmFactory::getInstance();
+      mvc::StmFactory *sf = driver.getStmFactory();
       mvc::ProcdefStm *procdef = NULL;
       procdef = sf->createProcdef(static_cast<SymbolExp *>($<expval>2),
                                   $<explval>4,
                                   static_cast<BlockStm *>($<stmval>6));
-      delete $<explval>3;
       $<stmval>$ = procdef;
     }
   ;
@@ -316,11 +318,9 @@ stm_procdef:
 stm_block:
     MVC_TOK_LBRACE one_or_more_blkstms MVC_TOK_RBRACE
     {
-      mvc::StmFactory *sf = StmFactory::getInstance();
+      mvc::StmFactory *sf = driver.getStmFactory();
       mvc::BlockStm *blkstm = sf->createBlock();
-      std::list<Stm *>& blkbody = blkstm->getBody();
-      blkbody.assign($<stmlval>2->begin(), $<stmlval>2->end());
-      delete $<stmlval>2;
+      blkstm->getBody().splice(blkstm->getBody().end(), *$<stmlval>2);
       $<stmval>$ = blkstm;
     }
   ; 
@@ -328,13 +328,13 @@ stm_block:
 one_or_more_blkstms:
     stm
     {
-      std::list<mvc::Stm *> *stms = new std::list<mvc::Stm *>;
+      mvc::StmList *stms = driver.getStmFactory()->createList();
       stms->push_front($<stmval>1);
       $<stmlval>$ = stms;
     }
   | stm_vardef
     {
-      std::list<mvc::Stm *> *stms = new std::list<mvc::Stm *>;
+      mvc::StmList *stms = driver.getStmFactory()->createList();
       stms->push_front($<stmval>1);
       $<stmlval>$ = stms;
     }
@@ -356,7 +356,7 @@ one_or_more_blkstms:
 stm_if:
     MVC_TOK_IF MVC_TOK_LPAREN exp MVC_TOK_RPAREN stm
     {
-      mvc::StmFactory *sf = StmFactory::getInstance();
+      mvc::StmFactory *sf = driver.getStmFactory();
       $<stmval>$ = sf->createIf($<expval>3, $<stmval>5);
     }
   ;
@@ -367,7 +367,7 @@ stm_if:
 stm_ifelse:
     MVC_TOK_IF MVC_TOK_LPAREN exp MVC_TOK_RPAREN stm MVC_TOK_ELSE stm
     {
-      mvc::StmFactory *sf = StmFactory::getInstance();
+      mvc::StmFactory *sf = driver.getStmFactory();
       $<stmval>$ = sf->createIfElse($<expval>3, $<stmval>5, $<stmval>7);
     }
   ;
@@ -378,7 +378,7 @@ stm_ifelse:
 stm_while:
     MVC_TOK_WHILE MVC_TOK_LPAREN exp MVC_TOK_RPAREN stm
     {
-      mvc::StmFactory *sf = StmFactory::getInstance();
+      mvc::StmFactory *sf = driver.getStmFactory();
       $<stmval>$ = sf->createWhile($<expval>3, $<stmval>5);
     }
   ;
@@ -390,7 +390,7 @@ stm_for:
     MVC_TOK_FOR MVC_TOK_LPAREN assign_opt MVC_TOK_SEMICOLON 
     exp_opt MVC_TOK_SEMICOLON assign_opt MVC_TOK_RPAREN stm
     {
-      mvc::StmFactory *sf = StmFactory::getInstance();
+      mvc::StmFactory *sf = driver.getStmFactory();
       $<stmval>$ = sf->createFor($<stmval>3, $<expval>5, $<stmval>7,$<stmval>9);
     }
   ;
@@ -419,7 +419,7 @@ stm_assign:
 assign:
     exp MVC_TOK_ASSIGN exp 
     {
-      mvc::StmFactory *sf = StmFactory::getInstance();
+      mvc::StmFactory *sf = driver.getStmFactory();
       $<stmval>$ = sf->createAssign($<expval>1, $<expval>3);
     }
   ;
@@ -430,7 +430,7 @@ assign:
 stm_funcall:
    exp_funcall MVC_TOK_SEMICOLON
    {
-      mvc::StmFactory *sf = StmFactory::getInstance();
+      mvc::StmFactory *sf = driver.getStmFactory();
       FuncallExp *call = static_cast<FuncallExp *>($<expval>1);
       $<stmval>$ = sf->createFuncall(call);
    }
@@ -442,8 +442,10 @@ stm_funcall:
 stm_trigger:
     MVC_TOK_TRIGGER exp MVC_TOK_SEMICOLON
     {
-      mvc::StmFactory *sf = StmFactory::getInstance();
-      $<stmval>$ = sf->createTrigger();
+      mvc::StmFactory *sf = driver.getStmFactory();
+      mvc::TriggerStm *trigger = sf->createTrigger();
+      trigger->getEvents().push_back($<expval>2);
+      $<stmval>$ = trigger;
     }
   ;
 
@@ -453,7 +455,7 @@ stm_trigger:
 stm_return:
     MVC_TOK_RETURN exp_opt MVC_TOK_SEMICOLON
     {
-      mvc::StmFactory *sf = StmFactory::getInstance();
+      mvc::StmFactory *sf = driver.getStmFactory();
       $<stmval>$ = sf->createReturn($<expval>2);
     }
   ;
@@ -464,7 +466,7 @@ stm_return:
 stm_continue:
     MVC_TOK_CONTINUE MVC_TOK_SEMICOLON
     {
-      mvc::StmFactory *sf = StmFactory::getInstance();
+      mvc::StmFactory *sf = driver.getStmFactory();
       $<stmval>$ = sf->createContinue();
     }
   ;
@@ -475,7 +477,7 @@ stm_continue:
 stm_break:
     MVC_TOK_BREAK exp MVC_TOK_SEMICOLON
     {
-      mvc::StmFactory *sf = StmFactory::getInstance();
+      mvc::StmFactory *sf = driver.getStmFactory();
       $<stmval>$ = sf->createBreak();
     }
   ;
@@ -532,14 +534,14 @@ exp_varref:
     }
   | exp MVC_TOK_DOT name %prec MVC_TOK_DOT
     {
-      mvc::ExpFactory *ef = ExpFactory::getInstance();
+      mvc::ExpFactory *ef = driver.getExpFactory();
       SymbolExp *symbol = static_cast<SymbolExp *>($<expval>3);
       const std::string& name = symbol->getName();
       $<expval>$ = ef->createFieldref($<expval>1, name);
     }
   | exp MVC_TOK_LBRACK exp MVC_TOK_RBRACK
     {
-      mvc::ExpFactory *ef = ExpFactory::getInstance();
+      mvc::ExpFactory *ef = driver.getExpFactory();
       $<expval>$ = ef->createArrayref($<expval>1, $<expval>3);
     }
   ;
@@ -561,57 +563,78 @@ exp_string:
 exp_unary:
     MVC_TOK_MINUS exp %prec MVC_TOK_UMINUS
     {
-      $<expval>$ = new UnaryExp(mvc::UOT_MINUS, $<expval>2);
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createUnary(mvc::UOT_MINUS, $<expval>2);
     }
   ;
 
 exp_binary:
     exp MVC_TOK_PLUS exp
     {
-      $<expval>$ = new BinaryExp(mvc::BOT_ADD, $<expval>1, $<expval>3);
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createBinary(mvc::BOT_ADD, $<expval>1, $<expval>3);
     }
   | exp MVC_TOK_MINUS exp
     {
-      $<expval>$ = new BinaryExp(mvc::BOT_SUB, $<expval>1, $<expval>3);
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createBinary(mvc::BOT_SUB, $<expval>1, $<expval>3);
     }
   | exp MVC_TOK_TIMES exp
     {
-      $<expval>$ = new BinaryExp(mvc::BOT_MUL, $<expval>1, $<expval>3);
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createBinary(mvc::BOT_MUL, $<expval>1, $<expval>3);
     }
   | exp MVC_TOK_DIV exp
     {
-      $<expval>$ = new BinaryExp(mvc::BOT_DIV, $<expval>1, $<expval>3);
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createBinary(mvc::BOT_DIV, $<expval>1, $<expval>3);
     }
   | exp MVC_TOK_EQ exp
     {
-      $<expval>$ = new BinaryExp(mvc::BOT_EQ, $<expval>1, $<expval>3);
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createBinary(mvc::BOT_EQ, $<expval>1, $<expval>3);
+    }
+  | exp MVC_TOK_NE exp
+    {
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createBinary(mvc::BOT_NE, $<expval>1, $<expval>3);
     }
   | exp MVC_TOK_LT exp
     {
-      $<expval>$ = new BinaryExp(mvc::BOT_LT, $<expval>1, $<expval>3);
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createBinary(mvc::BOT_LT, $<expval>1, $<expval>3);
     }
   | exp MVC_TOK_LE exp
     {
-      $<expval>$ = new BinaryExp(mvc::BOT_LE, $<expval>1, $<expval>3);
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createBinary(mvc::BOT_LE, $<expval>1, $<expval>3);
     }
   | exp MVC_TOK_GT exp
     {
-      $<expval>$ = new BinaryExp(mvc::BOT_GT, $<expval>1, $<expval>3);
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createBinary(mvc::BOT_GT, $<expval>1, $<expval>3);
     }
   | exp MVC_TOK_GE exp
     {
-      $<expval>$ = new BinaryExp(mvc::BOT_GE, $<expval>1, $<expval>3);
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createBinary(mvc::BOT_GE, $<expval>1, $<expval>3);
     }
   | exp MVC_TOK_AND exp
     {
-      $<expval>$ = new BinaryExp(mvc::BOT_AND, $<expval>1, $<expval>3);
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createBinary(mvc::BOT_AND, $<expval>1, $<expval>3);
+    }
+  | exp MVC_TOK_OR exp
+    {
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createBinary(mvc::BOT_OR, $<expval>1, $<expval>3);
     }
   ;
 
 exp_funcall:
     name MVC_TOK_LPAREN exp_list MVC_TOK_RPAREN
     {
-      mvc::ExpFactory *ef = ExpFactory::getInstance();
+      mvc::ExpFactory *ef = driver.getExpFactory();
       SymbolExp *symbol = static_cast<SymbolExp *>($<expval>1);
       $<expval>$ = ef->createFuncall(symbol, $<explval>3);
     }
@@ -627,7 +650,7 @@ exp_list:
 one_or_more_exps:
     exp
     {
-      std::list<mvc::Exp *> *exps = new std::list<mvc::Exp *>;
+      mvc::ExpList *exps = driver.getExpFactory()->createList();
       SymbolExp *name = static_cast<SymbolExp *>($<expval>1);
       exps->push_back(name);
       $<explval>$ = exps;
@@ -650,7 +673,7 @@ name_list:
 one_or_more_names:
     name
     {
-      std::list<mvc::Exp *> *exps = new std::list<mvc::Exp *>;
+      mvc::ExpList *exps = driver.getExpFactory()->createList();
       SymbolExp *name = static_cast<SymbolExp *>($<expval>1);
       exps->push_back(name);
       $<explval>$ = exps;
@@ -666,9 +689,8 @@ one_or_more_names:
 name:
     MVC_TOK_NAME
     {
-      mvc::ExpFactory *ef = ExpFactory::getInstance();
+      mvc::ExpFactory *ef = driver.getExpFactory();
       SymbolExp *symbol = ef->createSymbol(*$<strval>1);
-      delete $<strval>1;
       $<expval>$ = symbol;
     }
   ;
@@ -676,15 +698,16 @@ name:
 number:
     MVC_TOK_NUMBER
     {
-      $<expval>$ = new mvc::IntegerExp($<ival>1);
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createInteger($<ival>1);
     }
   ;
 
 string:
     MVC_TOK_STRING
     {
-      $<expval>$ = new mvc::StringExp(*$<strval>1);
-      delete $<strval>1;
+      mvc::ExpFactory *ef = driver.getExpFactory();
+      $<expval>$ = ef->createString(*$<strval>1);
     }
   ;
 
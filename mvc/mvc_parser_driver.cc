@@ -9,13 +9,11 @@
 #include "mvc_parser_driver.hh"
 #include "mvc_scan.hh"           /* generated by flex */
 
-
-extern FILE *yyin;
-
 namespace mvc {
 
 ParserDriver::ParserDriver() 
-  : _source(SCT_NONE), _result(0), _traceScanner(false), _traceParser(false)
+  : _source(SCT_NONE), _scanner(NULL), _module(NULL), _result(0),
+    _traceScanner(false), _traceParser(false)
 {
 }
 
@@ -29,49 +27,58 @@ Module *ParserDriver::parse(SourceTag source, const std::string& file)
   _file = file;
   
   /* setup scanner */
-  YY_BUFFER_STATE yy_strbuf;
+  FILE *fp = NULL;
+  YY_BUFFER_STATE yy_strbuf = NULL;
   switch (_source) {
   case SCT_FILE:
-    if (!(yyin = fopen(_file.c_str(), "r"))) {
+    if (!(fp = fopen(_file.c_str(), "r"))) {
       error("Failed to open " + _file + ": " + strerror(errno));
       return NULL;
     }
     break;
   case SCT_STDIN:
-    yyin = stdin;
+    fp = stdin;
     break;
   case SCT_STRING:
-    fprintf(stdout, "STRING: %s\n", _file.c_str());
-    yy_strbuf = yy_scan_string(_file.c_str());
-    yy_switch_to_buffer(yy_strbuf);
     break;
   default:
     assert(0);
     break;
   }
 
+  if (yylex_init(&_scanner) != 0) {
+    error("Failed to create the scanner: " + std::string(strerror(errno)));
+    if (_source == SCT_FILE)
+      fclose(fp);
+    return NULL;
+  }
+  if (fp)
+    yyset_in(fp, _scanner);
+  else {
+    fprintf(stdout, "STRING: %s\n", _file.c_str());
+    yy_strbuf = yy_scan_string(_file.c_str(), _scanner);
+  }
+
   /* create module to be populated */
   ModuleFactory *mf = ModuleFactory::getInstance();
-  if ((_module = mf->createModule()) == NULL)
-    return NULL;
-  
-  /* parse */
-  yy::Parser parser(*this);
-  _result = parser.parse();
+  if ((_module = mf->createModule()) != NULL) {
+    /* parse */
+    yy::Parser parser(*this, _scanner);
+    _result = parser.parse();
+  }
 
   /* shutdown scanner */
-  switch (_source) {
-  case SCT_FILE:
-    fclose(yyin);
-    break;
-  case SCT_STDIN:
-    break;
-  case SCT_STRING:
-    yy_delete_buffer(yy_strbuf);
-    break;
-  default:
-    assert(0);
-    break;
+  if (yy_strbuf)
+    yy_delete_buffer(yy_strbuf, _scanner);
+  yylex_destroy(_scanner);
+  _scanner = NULL;
+  if (_source == SCT_FILE)
+    fclose(fp);
+
+  /* the module is incomplete after a syntax error */
+  if (_result != 0) {
+    delete _module;
+    _module = NULL;
   }
 
   return _module;
@@ -7,7 +7,6 @@
 #ifndef MVC_PARSER_DRIVER_HH
 #define MVC_PARSER_DRIVER_HH
 
-#include <list>
 #include "mvc_base.hh"
 #include "mvc_module.hh"
 #include "mvc_parse.hh"   /* generated by bison */
@@ -16,12 +15,13 @@ namespace mvc {
 
 /* Declaration of scanning function. Flex expects the signature of yylex 
    in the YY_DECL, and the C++ parser expects it to be declared. 
-   We can factor both as follows ... */
+   We can factor both as follows ... The scanner is reentrant, and
+   yyscanner is its state (yyscan_t). */
 #define YY_DECL                                       \
   extern "C" mvc::yy::Parser::token_type              \
   yylex(mvc::yy::Parser::semantic_type *yylval,       \
         mvc::yy::Parser::location_type *yylloc,       \
-        mvc::ParserDriver& driver)
+        mvc::ParserDriver& driver, void *yyscanner)
 
 /* ... and declare it for the parser's sake. */
 YY_DECL;
@@ -37,7 +37,8 @@ YY_DECL;
  *      |
  *      +------<Stm list>----> ParserDriver ---<Stm list>---> ParserServer
  *
- * @TODO Make multiple parser threads and dispatch parsing jobs concurrently.
+ * Each driver has a scanner of its own, so drivers may parse in parallel,
+ * one per thread.
  */
 class ParserDriver {
 public:
@@ -54,13 +55,24 @@ public:
 
   Module *getModule() { return _module; }
 
+  /* The parser allocates in the arena of the module being parsed, and
+     interns in its identifiers. */
+  IdentTab& getIdents() { return _module->getIdents(); }
+  ExpFactory *getExpFactory() { return _module->getExpFactory(); }
+  StmFactory *getStmFactory() { return _module->getStmFactory(); }
+
   /* Error handling. */
   void error(const yy::location& l, const std::string& m);
   void error(const std::string& m);
 
+private:
+  ParserDriver(const ParserDriver& driver) = delete;
+  ParserDriver& operator=(const ParserDriver& driver) = delete;
+
 private:
   SourceTag _source;
   std::string _file;
+  void *_scanner;           /* yyscan_t */
   Module *_module;
 
   int _result;
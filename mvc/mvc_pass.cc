@@ -0,0 +1,86 @@
+/**
+ * @file mvc_pass.cc
+ *
+ * @brief Passes for the MVC compiler.
+ */
+#include "mvc_pass.hh"
+
+namespace mvc {
+
+/* a safety net against passes which undo each other */
+static const int _maxrounds = 16;
+
+/*
+ * PassGroup
+ */
+PassGroup::~PassGroup()
+{
+  std::list<GraphPass *>::iterator iter;
+  for (iter = _subpasses.begin(); iter != _subpasses.end(); ++iter)
+    delete *iter;
+}
+
+void PassGroup::setGraph(ControlGraph *graph)
+{
+  GraphPass::setGraph(graph);
+
+  std::list<GraphPass *>::iterator iter;
+  for (iter = _subpasses.begin(); iter != _subpasses.end(); ++iter)
+    (*iter)->setGraph(graph);
+}
+
+int PassGroup::run()
+{
+  int total = 0;
+  for (int round = 0; round < _maxrounds; round++) {
+    int changes = 0;
+    std::list<GraphPass *>::iterator iter;
+    for (iter = _subpasses.begin(); iter != _subpasses.end(); ++iter) {
+      int n = (*iter)->run();
+      if (n == -1)
+        return -1;
+      changes += n;
+    }
+    if (changes == 0)
+      break;
+    total += changes;
+  }
+
+  return total;
+}
+
+
+/*
+ * PassMgr
+ */
+PassMgr::~PassMgr()
+{
+  std::list<GraphPass *>::iterator iter;
+  for (iter = _passes.begin(); iter != _passes.end(); ++iter)
+    delete *iter;
+}
+
+void PassMgr::addPass(GraphPass *pass)
+{
+  _passes.push_back(pass);
+}
+
+int PassMgr::run()
+{
+  std::vector<ControlGraph *>& graphs = _mod->getGraphs();
+  for (size_t i = 0; i < graphs.size(); i++) {
+    std::list<GraphPass *>::iterator iter;
+    for (iter = _passes.begin(); iter != _passes.end(); ++iter) {
+      (*iter)->setGraph(graphs[i]);
+      if ((*iter)->run() == -1) {
+        std::cerr << "error: Pass " << (*iter)->getName() << " failed on \""
+                  << graphs[i]->getName() << "\"." << std::endl;
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+} /* mvc */
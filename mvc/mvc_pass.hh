@@ -1,11 +1,15 @@
 /**
- * @file mvc_pass.hh 
+ * @file mvc_pass.hh
  *
  * @brief Passes for the MVC compiler.
  */
 #ifndef MVC_PASS_HH
 #define MVC_PASS_HH
 
+#include <list>
+#include <string>
+#include "mvc_ir.hh"
+
 namespace mvc {
 
 enum PassTag {
@@ -27,14 +31,13 @@ public:
     _tag(tag), _type(type), _name(name) { }
   virtual ~Pass() { }
 
+  /* Returns -1 on errors, and otherwise the number of changes made. */
   virtual int run() = 0;
 
+  PassTag getTag() { return _tag; }
+  PassTypeTag getType() { return _type; }
   const std::string& getName() { return _name; }
 
-  /*
-    void addRequired(Pass *pass);
-  */
-
 private:
   Pass(const Pass&) = delete;
   Pass& operator=(const Pass&) = delete;
@@ -44,18 +47,68 @@ private:
   PassTypeTag _type;
 
   std::string _name;
-  std::list<Pass *> *_subpasses;
+};
+
+/**
+ * @class GraphPass
+ *
+ * @brief Pass over the control graph of a single reactor or function.
+ */
+class GraphPass : public Pass {
+public:
+  GraphPass(const std::string& name, PassTag tag = PT_PASS) :
+    Pass(tag, PT_OPTIMIZE, name), _graph(NULL) { }
+  virtual ~GraphPass() { }
+
+  virtual void setGraph(ControlGraph *graph) { _graph = graph; }
+
+protected:
+  ControlGraph *_graph;
+};
+
+/**
+ * @class PassGroup
+ *
+ * @brief Runs its subpasses over and over, until none of them changes
+ * the graph any more.
+ */
+class PassGroup : public GraphPass {
+public:
+  PassGroup(const std::string& name) : GraphPass(name, PT_CONTAINER) { }
+  ~PassGroup();
+
+  void addPass(GraphPass *pass) { _subpasses.push_back(pass); }
+
+  void setGraph(ControlGraph *graph);
+  int run();
+
+private:
+  std::list<GraphPass *> _subpasses;
 };
 
 /**
  * @class PassMgr
+ *
+ * @brief Runs its passes, in the order they are added, over every
+ * reactor and function of a module. It owns the passes.
  */
 class PassMgr {
 public:
-  void addPass(Pass *pass);
+  PassMgr(IRModule *mod) : _mod(mod) { }
+  ~PassMgr();
+
+  void addPass(GraphPass *pass);
+
+  /* Returns -1 if any pass fails, and 0 otherwise. */
+  int run();
+
+private:
+  PassMgr(const PassMgr&) = delete;
+  PassMgr& operator=(const PassMgr&) = delete;
 
 private:
-  std::list<Pass *> _passes;
+  IRModule *_mod;
+  std::list<GraphPass *> _passes;
 };
 
 } /* mvc */
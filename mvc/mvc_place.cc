@@ -0,0 +1,307 @@
+/**
+ * @file mvc_place.cc
+ */
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include "mvc_place.hh"
+
+namespace mvc {
+
+/* assumed iterations of a loop */
+static const double _loop_iters = 10.0;
+
+static void _loop_weights(ControlGraph *graph,
+                          std::map<BasicBlock *, double>& weights);
+static std::string _remote_dev(const std::string& sym);
+
+/*
+ * Topology
+ */
+int Topology::read(const std::string& file)
+{
+  std::ifstream is(file.c_str());
+  if (!is) {
+    std::cerr << "Cannot open " << file << "." << std::endl;
+    return -1;
+  }
+
+  std::string line;
+  for (int lineno = 1; std::getline(is, line); lineno++) {
+    std::istringstream ls(line);
+    std::string key;
+    if (!(ls >> key) || key[0] == '#')
+      continue;
+
+    bool valid = true;
+    if (key == "home") {
+      valid = static_cast<bool>(ls >> _home);
+      _devices[0] = _home;
+    }
+    else if (key == "device") {
+      std::string dev;
+      while (ls >> dev) {
+        std::vector<std::string>::iterator iter
+          = std::find(_devices.begin(), _devices.end(), dev);
+        if (iter == _devices.end())
+          _devices.push_back(dev);
+      }
+    }
+    else if (key == "link") {
+      std::string dev1, dev2;
+      double cost;
+      valid = (ls >> dev1 >> dev2 >> cost) && cost >= 0;
+      if (valid)
+        _links[dev1][dev2] = _links[dev2][dev1] = cost;
+    }
+    else if (key == "default")
+      valid = (ls >> _defcost) && _defcost >= 0;
+    else
+      valid = false;
+
+    if (!valid) {
+      std::cerr << file << ":" << lineno << ": Invalid line." << std::endl;
+      return -1;
+    }
+  }
+  _paths.clear();
+
+  return 0;
+}
+
+double Topology::getCost(const std::string& dev1, const std::string& dev2)
+{
+  if (dev1 == dev2)
+    return 0;
+
+  /* Dijkstra from dev1, over the few links there are */
+  if (_paths.find(dev1) == _paths.end()) {
+    std::map<std::string, double>& dist = _paths[dev1];
+    std::set<std::string> done;
+    dist[dev1] = 0;
+    while (true) {
+      std::string next;
+      std::map<std::string, double>::iterator iter;
+      for (iter = dist.begin(); iter != dist.end(); ++iter) {
+        if (done.count(iter->first) == 0
+            && (next == "" || iter->second < dist[next]))
+          next = iter->first;
+      }
+      if (next == "")
+        break;
+      done.insert(next);
+
+      std::map<std::string, double>& links = _links[next];
+      for (iter = links.begin(); iter != links.end(); ++iter) {
+        double d = dist[next] + iter->second;
+        if (dist.find(iter->first) == dist.end() || d < dist[iter->first])
+          dist[iter->first] = d;
+      }
+    }
+  }
+
+  std::map<std::string, double>& dist = _paths[dev1];
+  if (dist.find(dev2) == dist.end())
+    return _defcost;
+
+  return dist[dev2];
+}
+
+
+/*
+ * Placer
+ */
+void Placer::run()
+{
+  std::vector<std::string>& devices = _topo.getDevices();
+  std::vector<ControlGraph *>& graphs = _mod->getGraphs();
+  for (size_t i = 0; i < graphs.size(); i++) {
+    if (graphs[i]->getTag() != GT_REACTOR)
+      continue;
+
+    const std::string& name = graphs[i]->getName();
+    std::string best;
+    for (size_t j = 0; j < devices.size(); j++) {
+      std::set<ControlGraph *> callers;
+      Traffic traffic = estimate(graphs[i], devices[j], callers);
+
+      /* the event, forwarded from home */
+      addMessages(traffic, 1, 1.0, _topo.getHome(), devices[j]);
+
+      _traffic[name][devices[j]] = traffic;
+      if (best == "" || traffic.cost < _traffic[name][best].cost)
+        best = devices[j];
+    }
+    _placement[name] = best;
+  }
+}
+
+const std::string& Placer::getDevice(const std::string& reactor)
+{
+  std::map<std::string, std::string>::iterator iter
+    = _placement.find(reactor);
+  if (iter == _placement.end())
+    return _topo.getHome();
+
+  return iter->second;
+}
+
+void Placer::report(std::ostream& os)
+{
+  const std::string& home = _topo.getHome();
+  os << "placement of module " << _mod->getName() << ", home "
+     << home << ":" << std::endl;
+
+  Traffic before, after;
+  std::map<std::string, std::string>::iterator iter;
+  for (iter = _placement.begin(); iter != _placement.end(); ++iter) {
+    const std::string& name = iter->first;
+    os << "  reactor " << name << ":" << std::endl;
+
+    std::map<std::string, Traffic>& traffic = _traffic[name];
+    std::map<std::string, Traffic>::iterator titer;
+    for (titer = traffic.begin(); titer != traffic.end(); ++titer) {
+      os << "    " << std::left << std::setw(16) << titer->first
+         << std::right << std::setw(8) << titer->second.nmsgs
+         << " messages, cost " << titer->second.cost << std::endl;
+    }
+
+    os << "    -> " << iter->second;
+    if (iter->second != home) {
+      std::set<std::string> funcs;
+      for (size_t i = 0; i < _mod->getGraphs().size(); i++) {
+        if (_mod->getGraphs()[i]->getName() == name)
+          getFunctions(_mod->getGraphs()[i], funcs);
+      }
+      os << ", shipped with 1 REACT_ADD and " << funcs.size()
+         << " FUNC_ADD";
+    }
+    os << std::endl;
+
+    before.nmsgs += traffic[home].nmsgs;
+    before.cost += traffic[home].cost;
+    after.nmsgs += traffic[iter->second].nmsgs;
+    after.cost += traffic[iter->second].cost;
+  }
+
+  os << "  per run of every reactor: " << before.nmsgs << " messages, cost "
+     << before.cost << ", at home; " << after.nmsgs << " messages, cost "
+     << after.cost << ", placed" << std::endl;
+}
+
+/* Returns the messages of a run of the graph on the device. callers are
+   the functions being estimated, to stop at recursive calls. */
+Traffic Placer::estimate(ControlGraph *graph, const std::string& dev,
+                         std::set<ControlGraph *>& callers)
+{
+  const std::string& home = _topo.getHome();
+  Traffic traffic;
+
+  callers.insert(graph);
+  std::map<BasicBlock *, double> weights;
+  _loop_weights(graph, weights);
+  std::vector<BasicBlock *>& blocks = graph->getBlocks();
+  for (size_t i = 0; i < blocks.size(); i++) {
+    double weight = weights[blocks[i]];
+    std::list<Quad *>::iterator iter;
+    for (iter = blocks[i]->getQuads().begin();
+         iter != blocks[i]->getQuads().end(); ++iter) {
+      Quad *q = *iter;
+      std::string target = _remote_dev(q->getSym());
+      switch (q->getTag()) {
+      case QT_PROP_GET:
+        addMessages(traffic, 2, weight, dev, target == "" ? home : target);
+        break;
+      case QT_PROP_SET:
+      case QT_TRIGGER:
+        addMessages(traffic, 1, weight, dev, home);
+        break;
+      case QT_FUNCALL:
+        if (q->getImm() == CT_FUNC) {
+          ControlGraph *func = _mod->getFunction(q->getSym());
+          if (func && callers.count(func) == 0) {
+            Traffic calls = estimate(func, dev, callers);
+            traffic.nmsgs += weight * calls.nmsgs;
+            traffic.cost += weight * calls.cost;
+          }
+        }
+        else {
+          addMessages(traffic, q->getLhs() >= 0 ? 2 : 1, weight, dev,
+                      q->getImm() == CT_REMOTE ? target : home);
+        }
+        break;
+      default:
+        break;
+      }
+    }
+  }
+  callers.erase(graph);
+
+  return traffic;
+}
+
+void Placer::addMessages(Traffic& traffic, double nmsgs, double weight,
+                         const std::string& from, const std::string& to)
+{
+  if (from == to)
+    return;
+
+  traffic.nmsgs += weight * nmsgs;
+  traffic.cost += weight * nmsgs * _topo.getCost(from, to);
+}
+
+/* Adds the functions of the module the graph calls, directly or not. */
+void Placer::getFunctions(ControlGraph *graph, std::set<std::string>& funcs)
+{
+  std::vector<BasicBlock *>& blocks = graph->getBlocks();
+  for (size_t i = 0; i < blocks.size(); i++) {
+    std::list<Quad *>::iterator iter;
+    for (iter = blocks[i]->getQuads().begin();
+         iter != blocks[i]->getQuads().end(); ++iter) {
+      Quad *q = *iter;
+      if (q->getTag() != QT_FUNCALL || q->getImm() != CT_FUNC
+          || funcs.count(q->getSym()) > 0)
+        continue;
+      ControlGraph *func = _mod->getFunction(q->getSym());
+      if (func) {
+        funcs.insert(q->getSym());
+        getFunctions(func, funcs);
+      }
+    }
+  }
+}
+
+
+/* Weighs each block by the assumed iterations of the loops it is in. */
+void _loop_weights(ControlGraph *graph,
+                   std::map<BasicBlock *, double>& weights)
+{
+  LoopMap loops;
+  graph->findLoops(loops);
+
+  std::map<BasicBlock *, int> depths;
+  LoopMap::iterator iter;
+  for (iter = loops.begin(); iter != loops.end(); ++iter) {
+    std::set<BasicBlock *>::iterator biter;
+    for (biter = iter->second.begin(); biter != iter->second.end(); ++biter)
+      depths[*biter]++;
+  }
+
+  std::vector<BasicBlock *>& blocks = graph->getBlocks();
+  for (size_t i = 0; i < blocks.size(); i++)
+    weights[blocks[i]] = pow(_loop_iters, depths[blocks[i]]);
+}
+
+/* Returns the device of a remote name "dev:name", or "". */
+std::string _remote_dev(const std::string& sym)
+{
+  size_t colon = sym.find(':');
+  if (colon == std::string::npos)
+    return "";
+
+  return sym.substr(0, colon);
+}
+
+} /* mvc */
@@ -0,0 +1,124 @@
+/**
+ * @file mvc_place.hh
+ *
+ * @brief Placement of reactors on devices.
+ *
+ * A reactor of a module runs on the device the module is loaded on, its
+ * home. Each access to another device is a message. A reactor which
+ * mostly talks to another device sends fewer messages if it runs there
+ * instead, shipped with REACT_ADD, and the functions of the module it
+ * calls with FUNC_ADD. Then the properties, natives and events of the
+ * module are the remote ones.
+ */
+#ifndef MVC_PLACE_HH
+#define MVC_PLACE_HH
+
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "mvc_ir.hh"
+
+namespace mvc {
+
+/**
+ * @class Topology
+ *
+ * @brief Devices a reactor can run on, and the cost of a message between
+ * two devices, read from a file of lines:
+ *
+ *   home dev            the device the module is loaded on ("self")
+ *   device dev...       devices which run mvrt
+ *   link dev1 dev2 cost cost of a message either way
+ *   default cost        cost between devices with no path of links (1)
+ *
+ * Lines starting with # are comments. The cost between two devices is
+ * that of the cheapest path of links.
+ */
+class Topology {
+public:
+  Topology() : _home("self"), _defcost(1.0) { _devices.push_back(_home); }
+
+  /* Returns -1 on errors. */
+  int read(const std::string& file);
+
+  const std::string& getHome() { return _home; }
+
+  /* home first */
+  std::vector<std::string>& getDevices() { return _devices; }
+
+  double getCost(const std::string& dev1, const std::string& dev2);
+
+private:
+  Topology(const Topology& topo) = delete;
+  Topology& operator=(const Topology& topo) = delete;
+
+private:
+  std::string _home;
+  std::vector<std::string> _devices;
+  std::map<std::string, std::map<std::string, double> > _links;
+  double _defcost;
+
+  /* cheapest paths from each device asked */
+  std::map<std::string, std::map<std::string, double> > _paths;
+};
+
+/* Messages per run of a reactor on a device, each weighted by the cost
+   of its link in cost. */
+struct Traffic {
+  double nmsgs;
+  double cost;
+
+  Traffic() : nmsgs(0), cost(0) { }
+};
+
+/**
+ * @class Placer
+ *
+ * @brief Estimates the messages of each reactor of a module on each
+ * device of a topology, and chooses the device with the least cost.
+ *
+ * Messages are counted as mvrt sends them: two for a read of a remote
+ * property and for a call which waits for its result, and one for a
+ * write, a call which does not, and an event. A reactor away from home
+ * is also sent each event it reacts to. Every block of a reactor is
+ * counted, so conditional code is counted as if it always runs, and a
+ * loop as if it runs 10 times per nesting level. The functions of the
+ * module a reactor calls are counted as run with it.
+ */
+class Placer {
+public:
+  Placer(IRModule *mod, Topology& topo) : _mod(mod), _topo(topo) { }
+
+  void run();
+
+  /* Returns the device chosen for the reactor. */
+  const std::string& getDevice(const std::string& reactor);
+
+  /* Writes the estimates, and the placement chosen. */
+  void report(std::ostream& os);
+
+private:
+  Traffic estimate(ControlGraph *graph, const std::string& dev,
+                   std::set<ControlGraph *>& callers);
+  void addMessages(Traffic& traffic, double nmsgs, double weight,
+                   const std::string& from, const std::string& to);
+  void getFunctions(ControlGraph *graph, std::set<std::string>& funcs);
+
+private:
+  Placer(const Placer& placer) = delete;
+  Placer& operator=(const Placer& placer) = delete;
+
+private:
+  IRModule *_mod;
+  Topology& _topo;
+
+  /* estimates of each reactor on each device, and the device chosen */
+  std::map<std::string, std::map<std::string, Traffic> > _traffic;
+  std::map<std::string, std::string> _placement;
+};
+
+} /* mvc */
+
+#endif /* MVC_PLACE_HH */
@@ -96,8 +96,8 @@ public:
     Util::print(_os, e->getName(), 0); 
 
     _os << "(";
-    std::list<Exp *> *args = e->getArgs();
-    std::list<Exp *>::iterator iter;
+    ExpList *args = e->getArgs();
+    ExpList::iterator iter;
     for (iter = args->begin(); iter != args->end(); ) {
       Exp *arg = static_cast<Exp *>(*iter);
       Util::print(_os, arg, 0); 
@@ -145,8 +145,8 @@ public:
     _os << "reactor ";
     Util::print(_os, s->getSym(), getIndent());
     _os << "(";
-    std::list<Exp *>& events = s->getEvents();
-    std::list<Exp *>::iterator iter;
+    ExpList& events = s->getEvents();
+    ExpList::iterator iter;
     for (iter = events.begin(); iter != events.end(); ) {
       Exp *event = static_cast<Exp *>(*iter);
       Util::print(_os, event, 0); 
@@ -166,8 +166,8 @@ public:
     Util::print(_os, s->getSym(), getIndent());
 
     _os << "(";
-    std::list<Exp *> *params = s->getParams();
-    std::list<Exp *>::iterator iter;
+    ExpList *params = s->getParams();
+    ExpList::iterator iter;
     for (iter = params->begin(); iter != params->end(); ) {
       Exp *param = static_cast<Exp *>(*iter);
       Util::print(_os, param, 0); 
@@ -185,8 +185,8 @@ public:
     indent();
     _os << "{" << std::endl;
     incIndent();
-    std::list<Stm *>& body = s->getBody();
-    std::list<Stm *>::iterator iter;
+    StmList& body = s->getBody();
+    StmList::iterator iter;
     for (iter = body.begin(); iter != body.end(); ++iter) {
       Util::print(_os, *iter, getIndent());
     }
@@ -345,8 +345,8 @@ void Util::print(std::ostream& os, Module *mod)
   Util::print(os, mod->getName(), 0);
   os << " {" << std::endl;
 
-  std::list<Stm *>& stms = mod->getStms();
-  std::list<Stm *>::iterator iter;
+  StmList& stms = mod->getStms();
+  StmList::iterator iter;
   for (iter = stms.begin(); iter != stms.end(); ++iter) {
     Stm *stm = *iter;
     Util::print(os, stm, INDENT_SIZE);
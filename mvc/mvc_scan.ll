@@ -19,15 +19,16 @@ typedef mvc::yy::Parser::token token;
 
 /* Workaround for incompatibility in flex (2.5.31 through 2.5.33). */
 #undef yywrap
-#define yywrap() 1
+#define yywrap(yyscanner) 1
 
 /* By default, yylex returns int, we use token_type. Unfortunately,
    yyterminate by default returns 0, which is not of token_type. */
 #define yyterminate() return token::MVC_TOK_END
 %}
 
-/* options: reentrant option is not usable as long as yyin needs to set 
-   in epl_driver */
+/* options: reentrant, so that modules can be parsed in parallel, each
+   with the scanner of its ParserDriver */
+%option reentrant
 %option yylineno
 %option full
 %option noyywrap 
@@ -118,12 +119,12 @@ newline [\n]
                           }
 
 {name}                    { 
-                            yylval->strval = new std::string(yytext);
+                            yylval->strval = driver.getIdents().intern(yytext);
                             return token::MVC_TOK_NAME; 
                           }
 
 {string}                  {  
-                            yylval->strval = new std::string(yytext);
+                            yylval->strval = driver.getIdents().intern(yytext);
                             return token::MVC_TOK_STRING; 
                           }
 
@@ -8,117 +8,106 @@ namespace mvc {
 /*
  * StmFactory
  */
-StmFactory *StmFactory::_instance = NULL;
-StmFactory *StmFactory::getInstance() 
-{
-  if (!_instance) {
-    _instance = new StmFactory();
-  }
-  return _instance;
-}
-
-StmFactory::StmFactory()
-{
-}
-
-StmFactory::~StmFactory()
-{
-}
-
 EventdefStm *StmFactory::createEventdef(SymbolExp *exp)
 {
-  EventdefStm *evdef = new EventdefStm(exp);
+  EventdefStm *evdef = _arena.create<EventdefStm>(exp);
   
   return evdef;
 }
 
 VardefStm *StmFactory::createVardef(SymbolExp *exp)
 {
-  VardefStm *vardef = new VardefStm(exp);
+  VardefStm *vardef = _arena.create<VardefStm>(exp);
   
   return vardef;
 }
 
 ProcdefStm *StmFactory::createProcdef(SymbolExp *name, 
-                                          std::list<Exp *> *events, 
+                                          ExpList *events, 
                                           Stm *body)
 {
-  ProcdefStm *proc = new ProcdefStm(name, events, body);
+  ProcdefStm *proc = _arena.create<ProcdefStm>(name, events, body);
   return proc;
 }
 
 FundefStm *StmFactory::createFundef(SymbolExp *name,
-                                    std::list<Exp *> *params, 
+                                    ExpList *params, 
                                     Stm *body)
 {
-  FundefStm *proc = new FundefStm(name, params, body);
+  FundefStm *proc = _arena.create<FundefStm>(name, params, body);
   return proc;
 }
 
 BlockStm *StmFactory::createBlock()
 {
-  BlockStm *block = new BlockStm();
+  BlockStm *block = _arena.create<BlockStm>();
   return block;
 }
 
 IfStm *StmFactory::createIf(Exp *cond, Stm *stm)
 {
-  IfStm *ifstm = new IfStm(cond, stm);
+  IfStm *ifstm = _arena.create<IfStm>(cond, stm);
   return ifstm;
 }
 
 IfElseStm *StmFactory::createIfElse(Exp *cond, Stm *then, Stm *elsee)
 {
-  IfElseStm *ifelse = new IfElseStm(cond, then, elsee);
+  IfElseStm *ifelse = _arena.create<IfElseStm>(cond, then, elsee);
   return ifelse;
 }
 
 WhileStm *StmFactory::createWhile(Exp *cond, Stm *body)
 {
-  WhileStm *whiles = new WhileStm(cond, body);
+  WhileStm *whiles = _arena.create<WhileStm>(cond, body);
   return whiles;
 }
 
 ForStm *StmFactory::createFor(Stm *init, Exp *cond, Stm *step, Stm *body)
 {
-  ForStm *fors = new ForStm(init, cond, step, body);
+  ForStm *fors = _arena.create<ForStm>(init, cond, step, body);
   return fors;
 }
 
 AssignStm *StmFactory::createAssign(Exp *lhs, Exp *rhs)
 {
-  AssignStm *assign = new AssignStm(lhs, rhs);
+  AssignStm *assign = _arena.create<AssignStm>(lhs, rhs);
   return assign;
 }
 
 FuncallStm *StmFactory::createFuncall(FuncallExp *call)
 {
-  FuncallStm *callstm = new FuncallStm(call);
+  FuncallStm *callstm = _arena.create<FuncallStm>(call);
   return callstm;
 }
 
 TriggerStm *StmFactory::createTrigger()
 {
-  TriggerStm *trigger = new TriggerStm();
+  TriggerStm *trigger = _arena.create<TriggerStm>();
   return trigger;
 }
 
 ReturnStm *StmFactory::createReturn(Exp *exp)
 {
-  ReturnStm *returns = new ReturnStm(exp);
+  ReturnStm *returns = _arena.create<ReturnStm>(exp);
   return returns;
 }
 
 ContinueStm *StmFactory::createContinue()
 {
-  ContinueStm *continues = new ContinueStm();
+  ContinueStm *continues = _arena.create<ContinueStm>();
   return continues;
 }
 
 BreakStm *StmFactory::createBreak()
 {
-  BreakStm *breaks = new BreakStm();
+  BreakStm *breaks = _arena.create<BreakStm>();
   return breaks;
 }
 
+StmList *StmFactory::createList()
+{
+  StmList *list = _arena.create<StmList>();
+  return list;
+}
+
 } /* mvc */
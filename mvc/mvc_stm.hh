@@ -6,8 +6,9 @@
 #ifndef MVC_STM_HH
 #define MVC_STM_HH
 
-#include <list>
 #include <vector>
+#include "adt/arena.h"
+#include "adt/ilist.h"
 #include "mvc_exp.hh"
 
 namespace mvc {
@@ -38,16 +39,21 @@ enum StmTag {
 
 /**
  * @class Stm
+ *
+ * @brief Statements are allocated in the arena of their module, as
+ * expressions are.
  */
-class Stm {
+class Stm : public ilist_node<Stm> {
 public:
   Stm(StmTag t) : _tag(t) { }
-  virtual ~Stm() { }
 
   StmTag getTag() { return _tag; }
 
   virtual void accept(StmVisitor& v) = 0;
 
+protected:
+  ~Stm() = default;
+
 private:
   Stm(const Stm& stm) = delete;
   Stm& operator=(const Stm& stm) = delete;
@@ -56,6 +62,8 @@ protected:
   StmTag _tag;
 };
 
+typedef ilist<Stm> StmList;
+
 /**
  * @class EventdefStm
  */
@@ -63,7 +71,6 @@ class EventdefStm : public Stm {
 public:
   EventdefStm(SymbolExp *name) 
     : Stm(ST_EVENTDEF), _name(name) { }
-  ~EventdefStm() { }
 
   SymbolExp *getSym() { return _name; }
 
@@ -80,7 +87,6 @@ class VardefStm : public Stm {
 public:
   VardefStm(SymbolExp *name)
     : Stm(ST_VARDEF), _name(name) { }
-  ~VardefStm() { }
 
   SymbolExp *getSym() { return _name; }
 
@@ -95,21 +101,20 @@ private:
  */
 class ProcdefStm : public Stm {
 public:
-  ProcdefStm(SymbolExp *name, std::list<Exp *> *events, Stm *body) 
+  ProcdefStm(SymbolExp *name, ExpList *events, Stm *body) 
     : Stm(ST_PROCDEF), _name(name), _body(body) {
-    _events.assign(events->begin(), events->end());
+    _events.splice(_events.end(), *events);
   }
-  ~ProcdefStm() { }
 
   void accept(StmVisitor& v) { v.visitProcdefStm(this); }
 
   SymbolExp *getSym() { return _name; }
-  std::list<Exp *>& getEvents() { return _events; }
+  ExpList& getEvents() { return _events; }
   Stm *getBody() { return _body; }
 
 private:
   SymbolExp *_name;
-  std::list<Exp *> _events;
+  ExpList _events;
   Stm *_body;
 };
 
@@ -118,22 +123,19 @@ private:
  */
 class FundefStm : public Stm {
 public:
-  FundefStm(SymbolExp *name, std::list<Exp *> *params, Stm *body) 
+  FundefStm(SymbolExp *name, ExpList *params, Stm *body) 
     : Stm(ST_FUNDEF), _name(name), _params(params), _body(body) {
   }
-  ~FundefStm() { 
-    delete _params;
-  }
 
   void accept(StmVisitor& v) { v.visitFundefStm(this); }
 
   SymbolExp *getSym() { return _name; }
-  std::list<Exp *> *getParams() { return _params; }
+  ExpList *getParams() { return _params; }
   Stm *getBody() { return _body; }
 
 private:
   SymbolExp *_name;
-  std::list<Exp *> *_params;
+  ExpList *_params;
   Stm *_body;
 };
 
@@ -143,15 +145,14 @@ private:
 class BlockStm : public Stm {
 public:
   BlockStm() : Stm(ST_BLOCK) { }
-  ~BlockStm() { }
 
   void accept(StmVisitor& v) { v.visitBlockStm(this); }
 
-  std::list<Stm *>& getBody() { return _body; }
+  StmList& getBody() { return _body; }
   void addToBody(Stm *stm) { _body.push_back(stm); }
 
 private:
-  std::list<Stm *> _body;
+  StmList _body;
 };
 
 /** 
@@ -160,7 +161,6 @@ private:
 class IfStm : public Stm {
 public:
   IfStm(Exp *cond, Stm *stm) : Stm(ST_IF), _cond(cond), _stm(stm) { }
-  ~IfStm() { }
 
   void accept(StmVisitor& v) { v.visitIfStm(this); }
 
@@ -179,7 +179,6 @@ class IfElseStm : public Stm {
 public:
   IfElseStm(Exp *cond, Stm *then, Stm *elsee) 
     : Stm(ST_IFELSE), _cond(cond), _then(then), _else(elsee) { }
-  ~IfElseStm() { }
 
   void accept(StmVisitor& v) { v.visitIfElseStm(this); }
 
@@ -200,7 +199,6 @@ class WhileStm : public Stm {
 public:
   WhileStm(Exp *cond, Stm *body) 
     : Stm(ST_WHILE), _cond(cond), _body(body) { }
-  ~WhileStm() { }
 
   void accept(StmVisitor& v) { v.visitWhileStm(this); }
 
@@ -218,8 +216,7 @@ private:
 class ForStm : public Stm {
 public:
   ForStm(Stm *init, Exp *cond, Stm *step, Stm *body) 
-    : Stm(ST_IFELSE), _init(init), _cond(cond), _step(step), _body(body) { }
-  ~ForStm() { }
+    : Stm(ST_FOR), _init(init), _cond(cond), _step(step), _body(body) { }
 
   void accept(StmVisitor& v) { v.visitForStm(this); }
 
@@ -241,7 +238,6 @@ private:
 class AssignStm : public Stm {
 public:
   AssignStm(Exp *lhs, Exp *rhs) : Stm(ST_ASSIGN), _lhs(lhs), _rhs(rhs) { }
-  ~AssignStm() { }
 
   void accept(StmVisitor& v) { v.visitAssignStm(this); }
   
@@ -259,7 +255,6 @@ private:
 class FuncallStm : public Stm {
 public:
   FuncallStm(FuncallExp *call) : Stm(ST_FUNCALL), _call(call) { }
-  ~FuncallStm() { }
 
   void accept(StmVisitor& v) { v.visitFuncallStm(this); }
   
@@ -275,14 +270,13 @@ private:
 class TriggerStm : public Stm {
 public:
   TriggerStm() : Stm(ST_TRIGGER) { }
-  ~TriggerStm() { }
 
   void accept(StmVisitor& v) { v.visitTriggerStm(this); }
 
-  std::vector<Exp *>& getEvents() { return _events; }
+  ExpList& getEvents() { return _events; }
 
 private:
-  std::vector<Exp *> _events;
+  ExpList _events;
 };
 
 /**
@@ -291,7 +285,6 @@ private:
 class ReturnStm : public Stm {
 public:
   ReturnStm(Exp *exp) : Stm(ST_RETURN), _exp(exp) { }
-  ~ReturnStm() { }
 
   void accept(StmVisitor& v) { v.visitReturnStm(this); }
 
@@ -307,7 +300,6 @@ private:
 class ContinueStm : public Stm {
 public:
   ContinueStm() : Stm(ST_CONTINUE) { }
-  ~ContinueStm() { }
 
   void accept(StmVisitor& v) { v.visitContinueStm(this); }
 };
@@ -318,7 +310,6 @@ public:
 class BreakStm : public Stm {
 public:
   BreakStm() : Stm(ST_BREAK) { }
-  ~BreakStm() { }
 
   void accept(StmVisitor& v) { v.visitBreakStm(this); }
 };
@@ -330,7 +321,6 @@ class DefineStm : public Stm {
 public:
   DefineStm(SymbolExp *name, Exp *def) 
     : Stm(ST_DEFINE), _name(name), _def(def) { }
-  ~DefineStm() { }
 
   SymbolExp *getSym() { return _name; }
   Exp *getDef() { return _def; }
@@ -344,17 +334,19 @@ private:
 
 /**
  * @class StmFactory
+ *
+ * @brief Creates the statements of a module, in its arena.
  */
 class StmFactory {
 public:
-  static StmFactory *getInstance();
-  static void shutdown();
+  StmFactory(Arena& arena) : _arena(arena) { }
+  ~StmFactory() { }
 
   /* definitions */
   EventdefStm *createEventdef(SymbolExp *exp);
   VardefStm *createVardef(SymbolExp *exp);
-  ProcdefStm *createProcdef(SymbolExp *s, std::list<Exp *> *events, Stm *stm);
-  FundefStm *createFundef(SymbolExp *s, std::list<Exp *> *params, Stm *stm);
+  ProcdefStm *createProcdef(SymbolExp *s, ExpList *events, Stm *stm);
+  FundefStm *createFundef(SymbolExp *s, ExpList *params, Stm *stm);
 
   /* statements */
   BlockStm *createBlock();
@@ -369,12 +361,14 @@ public:
   ContinueStm *createContinue();
   BreakStm *createBreak();
 
-protected:
-  StmFactory();
-  ~StmFactory();
-  
+  StmList *createList();
+
+private:
+  StmFactory(const StmFactory& factory) = delete;
+  StmFactory& operator=(const StmFactory& factory) = delete;
+
 private:
-  static StmFactory *_instance;
+  Arena& _arena;
 };
 
 } /* mvc */
@@ -0,0 +1,91 @@
+/**
+ * @file mvc_symtab.cc
+ */
+#include <cassert>
+#include "mvc_symtab.hh"
+
+namespace mvc {
+
+/* buckets for the names of a large module, not to rehash while adding */
+static const size_t _nbuckets = 4096;
+
+SymTab::SymTab(IdentTab& idents)
+  : _idents(idents)
+{
+  _bindings.reserve(_nbuckets);
+  _scopes.push_back(std::vector<Ident>());
+}
+
+SymTab::~SymTab()
+{
+  while (getDepth() > 0)
+    pop();
+
+  std::vector<Ident>& globals = _scopes.back();
+  for (size_t i = 0; i < globals.size(); i++)
+    delete _bindings[globals[i]];
+}
+
+void SymTab::push()
+{
+  _scopes.push_back(std::vector<Ident>());
+}
+
+void SymTab::pop()
+{
+  assert(getDepth() > 0 && "pop: No scope to leave");
+
+  std::vector<Ident>& scope = _scopes.back();
+  for (size_t i = 0; i < scope.size(); i++) {
+    std::unordered_map<Ident, Binding *>::iterator iter
+      = _bindings.find(scope[i]);
+    Binding *binding = iter->second;
+    if (binding->shadowed)
+      iter->second = binding->shadowed;
+    else
+      _bindings.erase(iter);
+    delete binding;
+  }
+  _scopes.pop_back();
+}
+
+Value *SymTab::lookup(Ident id)
+{
+  std::unordered_map<Ident, Binding *>::iterator iter = _bindings.find(id);
+  if (iter != _bindings.end())
+    return iter->second->value;
+
+  return NULL;
+}
+
+Value *SymTab::lookup(const std::string& name)
+{
+  Ident id = _idents.find(name);
+  if (!id)
+    return NULL;
+
+  return lookup(id);
+}
+
+int SymTab::add(Ident id, Value *value)
+{
+  Binding *&binding = _bindings[id];
+  if (binding && binding->depth == getDepth())
+    return -1;
+
+  Binding *shadowed = binding;
+  binding = new Binding;
+  binding->value = value;
+  binding->depth = getDepth();
+  binding->shadowed = shadowed;
+  _scopes.back().push_back(id);
+
+  return 0;
+}
+
+int SymTab::add(const std::string& name, Value *value)
+{
+  return add(_idents.intern(name), value);
+}
+
+} /* mvc */
@@ -7,7 +7,9 @@
 #define MVC_SYMTAB_HH
 
 #include <string>
-#include <map>
+#include <vector>
+#include <unordered_map>
+#include "mvc_ident.hh"
 #include "mvc_exp.hh"
 #include "mvc_value.hh"
 
@@ -15,32 +17,54 @@ namespace mvc {
 
 /**
  * @class SymTab
+ *
+ * @brief Symbols of a module, in nested scopes, over the identifiers the
+ * module is interned in, so that the Ident of a SymbolExp is its key.
+ * The global scope is always there; the scopes of reactors, functions
+ * and blocks are pushed over it, and popped when they end.
+ *
+ * Each name maps to its innermost binding, which links to the bindings
+ * it shadows, so that a lookup is a single hash of a pointer whatever
+ * the depth, and a pop undoes the bindings of its scope only.
  */
 class SymTab {
 public:
-  SymTab() { }
-  ~SymTab() { }
+  SymTab(IdentTab& idents);
+  ~SymTab();
+
+  IdentTab& getIdents() { return _idents; }
 
-  Value *lookup(const std::string& name) {
-    std::map<std::string, Value *>::iterator iter = _map.find(name);
-    if (iter == _map.end())
-      return NULL;
+  /* Enters, and leaves, a scope. */
+  void push();
+  void pop();
+  size_t getDepth() { return _scopes.size() - 1; }
 
-    return iter->second;
-  }
-  
-  int add(const std::string& name, Value *value) {
-    if (lookup(name) != NULL)
-      return -1;
+  /* Returns the value of the name in the innermost scope which has it,
+     or NULL. */
+  Value *lookup(Ident id);
+  Value *lookup(const std::string& name);
 
-    _map[name] = value;
-    return 0;
-  }
+  /* Adds the name to the innermost scope. Returns -1 if it is there
+     already. */
+  int add(Ident id, Value *value);
+  int add(const std::string& name, Value *value);
 
 private:
-  std::map<std::string, Value *> _map;
+  SymTab(const SymTab& symtab) = delete;
+  SymTab& operator=(const SymTab& symtab) = delete;
+
+private:
+  struct Binding {
+    Value *value;
+    size_t depth;
+    Binding *shadowed;
+  };
+
+  IdentTab& _idents;
+  std::unordered_map<Ident, Binding *> _bindings;
 
-  /* std::map<Name *, Value *> _map; */
+  /* names bound in each scope, the global scope first */
+  std::vector<std::vector<Ident> > _scopes;
 };
 
 } /* mvc */
@@ -0,0 +1,165 @@
+/**
+ * @file test_bitvector.cc
+ *
+ * @brief Checks BitVector against std::vector<bool>, over random
+ * operations on vectors whose sizes fall on and around word boundaries.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "adt/bitvector.h"
+
+using mvc::BitVector;
+
+typedef std::vector<bool> Model;
+
+static const size_t _sizes[] = {
+  0, 1, 2, 31, 32, 33, 63, 64, 65, 127, 128, 129, 200, 1000
+};
+static const int _nsizes = sizeof(_sizes) / sizeof(_sizes[0]);
+static const int _nrounds = 2000;
+
+static std::mt19937 _rng(42);
+static int _nfailed = 0;
+
+static size_t _random(size_t n)
+{
+  return n == 0 ? 0 : _rng() % n;
+}
+
+static size_t _random_size()
+{
+  return _sizes[_random(_nsizes)];
+}
+
+/* Returns a random vector, and the same in the model. */
+static void _random_vector(BitVector& bv, Model& m)
+{
+  size_t size = _random_size();
+  bool t = _random(2);
+  bv = BitVector(size, t);
+  m.assign(size, t);
+  for (size_t n = _random(size + 1); n > 0; n--) {
+    size_t i = _random(size);
+    if (_random(2)) {
+      bv.set(i);
+      m[i] = true;
+    }
+    else {
+      bv.reset(i);
+      m[i] = false;
+    }
+  }
+}
+
+static void _check(const char *op, const BitVector& bv, const Model& m)
+{
+  bool ok = bv.size() == m.size();
+  size_t n = 0;
+  for (size_t i = 0; ok && i < m.size(); i++) {
+    ok = bv[i] == m[i];
+    n += m[i];
+  }
+  ok = ok && bv.count() == n && bv.any() == (n > 0)
+    && bv.none() == (n == 0) && bv.all() == (n == m.size())
+    && bv.empty() == m.empty();
+
+  /* the iteration visits the set bits in order */
+  size_t prev = 0;
+  bool first = true;
+  for (int i = bv.find_first(); ok && i != -1; i = bv.find_next(i)) {
+    ok = (first || static_cast<size_t>(i) > prev)
+      && static_cast<size_t>(i) < m.size() && m[i];
+    prev = i;
+    first = false;
+    n--;
+  }
+  ok = ok && n == 0;
+
+  if (!ok) {
+    fprintf(stderr, "FAILED: %s on %lu bits\n", op,
+            static_cast<unsigned long>(m.size()));
+    _nfailed++;
+  }
+}
+
+int main()
+{
+  for (int round = 0; round < _nrounds; round++) {
+    BitVector a, b;
+    Model ma, mb;
+    _random_vector(a, ma);
+    _random_vector(b, mb);
+    _check("set", a, ma);
+
+    BitVector c(a);
+    Model mc(ma);
+    c |= b;
+    if (mc.size() < mb.size())
+      mc.resize(mb.size());
+    for (size_t i = 0; i < mb.size(); i++)
+      mc[i] = mc[i] || mb[i];
+    _check("|=", c, mc);
+
+    c = a;
+    mc = ma;
+    c &= b;
+    for (size_t i = 0; i < mc.size(); i++)
+      mc[i] = mc[i] && i < mb.size() && mb[i];
+    _check("&=", c, mc);
+
+    c = a;
+    mc = ma;
+    c.reset(b);
+    for (size_t i = 0; i < mc.size() && i < mb.size(); i++)
+      mc[i] = mc[i] && !mb[i];
+    _check("reset(rhs)", c, mc);
+
+    bool common = false;
+    for (size_t i = 0; i < ma.size() && i < mb.size(); i++)
+      common = common || (ma[i] && mb[i]);
+    if (a.anyCommon(b) != common) {
+      fprintf(stderr, "FAILED: anyCommon\n");
+      _nfailed++;
+    }
+
+    if ((a == b) != (ma == mb) || (a != b) == (ma == mb)) {
+      fprintf(stderr, "FAILED: ==\n");
+      _nfailed++;
+    }
+
+    /* shrinking clears the bits past the size, and growing sets the new
+       bits only */
+    size_t size = _random_size();
+    bool t = _random(2);
+    c = a;
+    mc = ma;
+    c.resize(size, t);
+    mc.resize(size, t);
+    _check("resize", c, mc);
+    size = _random_size();
+    c.resize(size, !t);
+    mc.resize(size, !t);
+    _check("resize again", c, mc);
+
+    c.set();
+    mc.assign(mc.size(), true);
+    _check("set()", c, mc);
+    c.reset();
+    mc.assign(mc.size(), false);
+    _check("reset()", c, mc);
+
+    c.swap(a);
+    mc.swap(ma);
+    _check("swap", c, mc);
+    _check("swap", a, ma);
+  }
+
+  if (_nfailed > 0) {
+    fprintf(stderr, "%d checks failed\n", _nfailed);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
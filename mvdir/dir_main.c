@@ -0,0 +1,290 @@
+/**
+ * @file dir_main.c
+ *
+ * @brief Device directory service. Devices register their addresses, and
+ * look up each other, as described in mv/dir.h. It keeps everything in
+ * memory, so it can be started locally for testing:
+ *
+ *   mvdir -p 5556
+ */
+#include <stdio.h>           /* fprintf */
+#include <stdlib.h>          /* malloc */
+#include <string.h>          /* strcmp */
+#include <unistd.h>          /* getopt */
+#include <time.h>            /* time */
+#include <poll.h>            /* poll */
+#include <sys/types.h>       /* socket */
+#include <sys/socket.h>      /* socket */
+#include <netinet/in.h>      /* struct sockaddr_in6 */
+#include <mv/dir.h>          /* MV_DIR_PORT */
+#include <mv/hash.h>         /* mv_hash_str */
+
+
+/* A registered device. */
+typedef struct _entry {
+  char *name;                   /* device name */
+  char *addr;                   /* transport address */
+  time_t expires;               /* registration ends */
+  struct _entry *next;          /* hash chain */
+} _entry_t;
+
+/* A client to push updates to. */
+typedef struct _watcher {
+  struct sockaddr_storage ss;   /* client address */
+  socklen_t sslen;              /* length of ss */
+  time_t seen;                  /* last datagram from the client */
+  struct _watcher *next;
+} _watcher_t;
+
+#define _DIR_BUCKETS  4096
+static _entry_t *_dir_table[_DIR_BUCKETS];
+static _watcher_t *_dir_watchers = NULL;
+static int _dir_fd = -1;
+static int _dir_verbose = 0;
+
+static _entry_t **_dir_find(const char *name);
+static void _dir_push(const char *line);
+static void _dir_seen(struct sockaddr_storage *ss, socklen_t sslen);
+static void _dir_expire();
+static void _dir_reply_line(char *reply, size_t *len, const char *line,
+                            struct sockaddr_storage *ss, socklen_t sslen);
+static void _dir_handle(char *msg, struct sockaddr_storage *ss,
+                        socklen_t sslen);
+
+/* Returns the link to the entry with the given name, or the link at the
+   end of its chain. */
+_entry_t **_dir_find(const char *name)
+{
+  _entry_t **link = _dir_table + (mv_hash_str(name) % _DIR_BUCKETS);
+  while (*link && strcmp((*link)->name, name))
+    link = &(*link)->next;
+
+  return link;
+}
+
+/* Sends the line to every watcher. Watchers silent for too long are
+   forgotten. */
+void _dir_push(const char *line)
+{
+  time_t now = time(NULL);
+  _watcher_t **link = &_dir_watchers;
+  while (*link) {
+    _watcher_t *w = *link;
+    if (now - w->seen > MV_DIR_WATCH_SEC * 2) {
+      *link = w->next;
+      free(w);
+      continue;
+    }
+    sendto(_dir_fd, line, strlen(line), 0, (struct sockaddr *) &w->ss,
+           w->sslen);
+    link = &w->next;
+  }
+}
+
+void _dir_seen(struct sockaddr_storage *ss, socklen_t sslen)
+{
+  _watcher_t *w;
+  for (w = _dir_watchers; w; w = w->next) {
+    if (w->sslen == sslen && !memcmp(&w->ss, ss, sslen))
+      break;
+  }
+  if (!w) {
+    w = malloc(sizeof(_watcher_t));
+    memcpy(&w->ss, ss, sslen);
+    w->sslen = sslen;
+    w->next = _dir_watchers;
+    _dir_watchers = w;
+  }
+  w->seen = time(NULL);
+}
+
+/* Removes registrations which were not renewed in time. */
+void _dir_expire()
+{
+  time_t now = time(NULL);
+  char line[MV_DIR_MAX_DATAGRAM];
+  int i;
+  for (i = 0; i < _DIR_BUCKETS; i++) {
+    _entry_t **link = _dir_table + i;
+    while (*link) {
+      _entry_t *e = *link;
+      if (e->expires > now) {
+        link = &e->next;
+        continue;
+      }
+      if (_dir_verbose)
+        fprintf(stdout, "expired: %s\n", e->name);
+      snprintf(line, sizeof(line), "NONE %s\n", e->name);
+      _dir_push(line);
+
+      *link = e->next;
+      free(e->name);
+      free(e->addr);
+      free(e);
+    }
+  }
+}
+
+/* Appends the line to the reply, sending the reply first if the line
+   would not fit. A NULL line sends what is left. */
+void _dir_reply_line(char *reply, size_t *len, const char *line,
+                     struct sockaddr_storage *ss, socklen_t sslen)
+{
+  size_t n = line ? strlen(line) : 0;
+  if (*len > 0 && (!line || *len + n > MV_DIR_MAX_DATAGRAM)) {
+    sendto(_dir_fd, reply, *len, 0, (struct sockaddr *) ss, sslen);
+    *len = 0;
+  }
+  if (line && n <= MV_DIR_MAX_DATAGRAM) {
+    memcpy(reply + *len, line, n);
+    *len += n;
+  }
+}
+
+void _dir_handle(char *msg, struct sockaddr_storage *ss, socklen_t sslen)
+{
+  char reply[MV_DIR_MAX_DATAGRAM];
+  char line[MV_DIR_MAX_DATAGRAM];
+  size_t len = 0;
+  time_t now = time(NULL);
+  char *save_line;
+  char *l;
+
+  _dir_seen(ss, sslen);
+
+  for (l = strtok_r(msg, "\n", &save_line); l;
+       l = strtok_r(NULL, "\n", &save_line)) {
+    char *save;
+    char *cmd = strtok_r(l, " \t", &save);
+    if (!cmd)
+      continue;
+
+    if (!strcmp(cmd, "REG")) {
+      char *name = strtok_r(NULL, " \t", &save);
+      char *addr = strtok_r(NULL, " \t", &save);
+      char *ttl_s = strtok_r(NULL, " \t", &save);
+      int ttl = ttl_s ? atoi(ttl_s) : MV_DIR_TTL;
+      if (!name || !addr || ttl <= 0)
+        continue;
+
+      _entry_t **link = _dir_find(name);
+      _entry_t *e = *link;
+      if (!e) {
+        e = calloc(1, sizeof(_entry_t));
+        e->name = strdup(name);
+        *link = e;
+      }
+      e->expires = now + ttl;
+      if (e->addr && !strcmp(e->addr, addr))
+        continue;  /* heartbeat */
+
+      free(e->addr);
+      e->addr = strdup(addr);
+      if (_dir_verbose)
+        fprintf(stdout, "registered: %s %s\n", name, addr);
+      snprintf(line, sizeof(line), "ADDR %s %s %d\n", name, addr, ttl);
+      _dir_push(line);
+    }
+    else if (!strcmp(cmd, "UNREG")) {
+      char *name = strtok_r(NULL, " \t", &save);
+      if (!name)
+        continue;
+
+      _entry_t **link = _dir_find(name);
+      _entry_t *e = *link;
+      if (!e)
+        continue;
+      *link = e->next;
+      free(e->name);
+      free(e->addr);
+      free(e);
+      if (_dir_verbose)
+        fprintf(stdout, "unregistered: %s\n", name);
+      snprintf(line, sizeof(line), "NONE %s\n", name);
+      _dir_push(line);
+    }
+    else if (!strcmp(cmd, "GET")) {
+      char *name;
+      while ((name = strtok_r(NULL, " \t", &save)) != NULL) {
+        _entry_t *e = *_dir_find(name);
+        if (e)
+          snprintf(line, sizeof(line), "ADDR %s %s %ld\n", name, e->addr,
+                   (long) (e->expires - now));
+        else
+          snprintf(line, sizeof(line), "NONE %s\n", name);
+        _dir_reply_line(reply, &len, line, ss, sslen);
+      }
+    }
+    else if (strcmp(cmd, "WATCH")) {
+      fprintf(stderr, "Request not recognized: %s\n", cmd);
+    }
+  }
+  _dir_reply_line(reply, &len, NULL, ss, sslen);
+}
+
+
+/*
+ * the main entry point
+ */
+int main(int argc, char *argv[])
+{
+  int port = MV_DIR_PORT;
+  int opt;
+  while ((opt = getopt(argc, argv, "p:v")) != -1) {
+    switch (opt) {
+    case 'p':
+      port = atoi(optarg);
+      break;
+    case 'v':
+      _dir_verbose = 1;
+      break;
+    default:
+      fprintf(stdout, "Usage: %s [-p port] [-v]\n", argv[0]);
+      exit(1);
+    }
+  }
+
+  /* a dual-stack socket takes both IPv4 and IPv6 clients */
+  struct sockaddr_in6 sa;
+  int off = 0;
+  if ((_dir_fd = socket(AF_INET6, SOCK_DGRAM, 0)) == -1) {
+    perror("socket@main");
+    exit(1);
+  }
+  setsockopt(_dir_fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+  memset(&sa, 0, sizeof(sa));
+  sa.sin6_family = AF_INET6;
+  sa.sin6_addr = in6addr_any;
+  sa.sin6_port = htons(port);
+  if (bind(_dir_fd, (struct sockaddr *) &sa, sizeof(sa)) == -1) {
+    perror("bind@main");
+    exit(1);
+  }
+  fprintf(stdout, "Device directory listening on port %d...\n", port);
+  fflush(stdout);
+
+  struct pollfd pfd;
+  pfd.fd = _dir_fd;
+  pfd.events = POLLIN;
+  time_t lastexpire = time(NULL);
+  while (1) {
+    if (poll(&pfd, 1, 1000) > 0) {
+      char msg[MV_DIR_MAX_DATAGRAM + 1];
+      struct sockaddr_storage ss;
+      socklen_t sslen = sizeof(ss);
+      ssize_t n = recvfrom(_dir_fd, msg, MV_DIR_MAX_DATAGRAM, 0,
+                           (struct sockaddr *) &ss, &sslen);
+      if (n > 0) {
+        msg[n] = '\0';
+        _dir_handle(msg, &ss, sslen);
+      }
+    }
+
+    if (time(NULL) != lastexpire) {
+      _dir_expire();
+      lastexpire = time(NULL);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,196 @@
+/**
+ * @file rtbench.c
+ *
+ * @brief Benchmarks of the runtime: the cost of object lookups, and of 
+ * fanning out events to subscribers. 
+ *
+ * Usage: rtbench objs|pubsub
+ */
+#include <stdio.h>           /* printf */
+#include <stdlib.h>          /* mkstemp */
+#include <string.h>          /* strcmp */
+#include <unistd.h>          /* unlink */
+#include <time.h>            /* clock_gettime */
+#include <mv/device.h>       /* mv_device_module_init */
+#include <mv/value.h>        /* mv_value_t */
+#include "rtevent.h"         /* mvrt_event_new */
+#include "rtsub.h"           /* mvrt_subscribe */
+#include "rtobj.h"           /* mvrt_obj_lookup */
+
+static double _elapsed_ms(struct timespec *from, struct timespec *to);
+static void _bench_objs();
+static void _bench_pubsub();
+
+double _elapsed_ms(struct timespec *from, struct timespec *to)
+{
+  return (to->tv_sec - from->tv_sec) * 1e3 
+    + (to->tv_nsec - from->tv_nsec) / 1e6;
+}
+
+/* Prints the cost of object lookups, hits and misses, as the object table
+   grows from 100 to 100k objects. Every fourth object is on a device. */
+#define _BENCH_MAXOBJS  100000
+#define _BENCH_NAMELEN  24
+void _bench_objs()
+{
+  static const int sizes[] = { 100, 1000, 10000, _BENCH_MAXOBJS };
+  static char names[2][_BENCH_MAXOBJS][_BENCH_NAMELEN];
+  const int nlookups = 1000000;
+  int nobjs = 0;
+  int i, s;
+
+  for (i = 0; i < _BENCH_MAXOBJS; i++) {
+    snprintf(names[0][i], _BENCH_NAMELEN, "bench.obj%d", i);
+    snprintf(names[1][i], _BENCH_NAMELEN, "bench.none%d", i);
+  }
+
+  fprintf(stdout, "%8s %12s %12s\n", "objects", "hit (ns)", "miss (ns)");
+  for (s = 0; s < (int) (sizeof(sizes) / sizeof(sizes[0])); s++) {
+    for (; nobjs < sizes[s]; nobjs++)
+      mvrt_obj_new(names[0][nobjs], (nobjs % 4) ? NULL : "bench.dev");
+
+    double ns[2];
+    int miss;
+    for (miss = 0; miss < 2; miss++) {
+      struct timespec t0, t1;
+      int found = 0;
+      clock_gettime(CLOCK_MONOTONIC, &t0);
+      for (i = 0; i < nlookups; i++) {
+        int k = i % nobjs;
+        found += (mvrt_obj_lookup(names[miss][k], 
+                                  (k % 4) ? NULL : "bench.dev") != NULL);
+      }
+      clock_gettime(CLOCK_MONOTONIC, &t1);
+      if (found != (miss ? 0 : nlookups))
+        fprintf(stderr, "bench: %d lookups found.\n", found);
+      ns[miss] = _elapsed_ms(&t0, &t1) * 1e6 / nlookups;
+    }
+    fprintf(stdout, "%8d %12.1f %12.1f\n", nobjs, ns[0], ns[1]);
+  }
+}
+
+/* Prints the cost to the publisher of fanning out an event, for 1 to 1000
+   subscribers with no filter and with filters which 10% of occurrences
+   pass: evaluating the filters, and serializing the message once for each
+   send, as remote events are, or once for all sends. Messages are not
+   sent. */
+#define _BENCH_MAXSUBS  1000
+void _bench_pubsub()
+{
+  static const int sizes[] = { 1, 10, 100, _BENCH_MAXSUBS };
+  static const char *addrs[_BENCH_MAXSUBS];
+  char file[] = "/tmp/mvrt-bench-XXXXXX";
+  char name[_BENCH_NAMELEN];
+  const int npubs = 2000;
+  int i, s, filtered;
+
+  int fd = mkstemp(file);
+  FILE *fp = fd == -1 ? NULL : fdopen(fd, "w");
+  if (!fp) {
+    perror("mkstemp@_bench_pubsub");
+    return;
+  }
+  for (i = 0; i < _BENCH_MAXSUBS; i++)
+    fprintf(fp, "bench.dev%d tcp://127.0.0.1:%d\n", i, 10000 + i);
+  fclose(fp);
+  mv_device_module_init(file);
+  unlink(file);
+
+  mv_value_t field_v = mv_value_string("celsius");
+  mv_value_t values[10];
+  for (i = 0; i < 10; i++) {
+    values[i] = mv_value_map();
+    mv_value_map_add(values[i], field_v, mv_value_int(i));
+  }
+
+  fprintf(stdout, "%6s %6s %10s %14s %14s %10s\n", "subs", "pass", 
+          "match (ns)", "per-send (ns)", "shared (ns)", "events/s");
+  for (filtered = 0; filtered < 2; filtered++) {
+    for (s = 0; s < (int) (sizeof(sizes) / sizeof(sizes[0])); s++) {
+      snprintf(name, _BENCH_NAMELEN, "bench.ev%d.%d", filtered, sizes[s]);
+      mvrt_event_t *ev = mvrt_event_new(name, NULL);
+      for (i = 0; i < sizes[s]; i++) {
+        char dev[_BENCH_NAMELEN];
+        mv_value_t filter = mv_value_null();
+        snprintf(dev, _BENCH_NAMELEN, "bench.dev%d", i);
+        if (filtered) {
+          filter = mv_value_map();
+          mv_value_map_add(filter, mv_value_string("field"), field_v);
+          mv_value_map_add(filter, mv_value_string("op"), 
+                           mv_value_string("=="));
+          mv_value_map_add(filter, mv_value_string("value"), 
+                           mv_value_int(i % 10));
+        }
+        mvrt_subscribe(name, dev, filter);
+      }
+
+      struct timespec t0, t1;
+      double ns[3] = { 0, 0, 0 };
+      long sends = 0;
+      int p;
+      for (p = 0; p < npubs; p++) {
+        mv_value_t value = values[p % 10];
+        char arg[256];
+        char msg[512];
+        char *value_s;
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int n = mvrt_sub_match(ev, value, addrs, _BENCH_MAXSUBS);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        ns[0] += _elapsed_ms(&t0, &t1) * 1e6;
+        sends += n;
+
+        /* the message of every send made from scratch */
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (i = 0; i < n; i++) {
+          value_s = mv_value_to_str(value);
+          snprintf(arg, sizeof(arg), "{\"name\":\"%s\", \"value\":%s}", 
+                   name, value_s);
+          snprintf(msg, sizeof(msg), "%s {\"tag\":\"EVENT_OCCUR\", "
+                   "\"arg\":%s, \"src\":{}}", addrs[i], arg);
+          free(value_s);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        ns[1] += _elapsed_ms(&t0, &t1) * 1e6;
+
+        /* one message shared by all the sends */
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        if (n > 0) {
+          value_s = mv_value_to_str(value);
+          snprintf(arg, sizeof(arg), "{\"name\":\"%s\", \"value\":%s}", 
+                   name, value_s);
+          snprintf(msg, sizeof(msg), "{\"tag\":\"EVENT_OCCUR\", "
+                   "\"arg\":%s, \"src\":{}}", arg);
+          free(value_s);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        ns[2] += _elapsed_ms(&t0, &t1) * 1e6;
+      }
+
+      fprintf(stdout, "%6d %5ld%% %10.0f %14.0f %14.0f %10.0f\n", sizes[s],
+              sends * 100 / ((long) npubs * sizes[s]), ns[0] / npubs, 
+              ns[1] / npubs, ns[2] / npubs, 
+              npubs / ((ns[0] + ns[2]) * 1e-9));
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc != 2 
+      || (strcmp(argv[1], "objs") != 0 && strcmp(argv[1], "pubsub") != 0)) {
+    fprintf(stderr, "Usage: %s objs|pubsub\n", argv[0]);
+    fprintf(stderr, "  - objs:   print the cost of object lookups.\n");
+    fprintf(stderr, "  - pubsub: print the cost of fanning out events "
+            "to subscribers.\n");
+    exit(1);
+  }
+
+  mvrt_obj_module_init();
+  if (!strcmp(argv[1], "objs"))
+    _bench_objs();
+  else
+    _bench_pubsub();
+
+  return EXIT_SUCCESS;
+}
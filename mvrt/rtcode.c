@@ -5,12 +5,30 @@
 #include <stdlib.h>     /* malloc */
 #include <string.h>     /* strchr */
 #include <assert.h>     /* assert */
+#include <mv/value.h>   /* mv_value_string */
+#include <mv/device.h>  /* mv_device_lookup_batch */
+#include "rtobj.h"      /* mvrt_ref_t */
 #include "rtcode.h"
 
 
 static mvrt_code_t *_rtcode_parse(FILE *fp);
 static int _rtcode_token_tag(const char *token);
 static int _rtcode_parse_nargs(int op);
+static void _rtcode_grow(mvrt_code_t *code, int n, int *cap);
+static int _rtcode_add_const(mvrt_code_t *code, mv_ptr_t value, int *cap);
+static int _rtcode_verify_nrets(mvrt_code_t *code, int ip);
+static int _rtcode_verify_reg(mvrt_instr_t *instr);
+static int _rtcode_verify_error(mvrt_code_t *code, int ip, const char *msg);
+static int _rtcode_is_branch(int op);
+static int _rtcode_super_ref(int op, unsigned *tag);
+static int _rtcode_has_ref(int op);
+static char *_rtcode_local_name(char *name);
+static int _rtcode_fuse_match(mvrt_code_t *code, int ip, int *target,
+                              mvrt_instr_t *super);
+static int _rtcode_fuse(mvrt_code_t *code);
+static int _rtcode_const_kind(int op);
+static int _rtcode_const_kinds(mvrt_code_t *code, int *kinds);
+static int _rtcode_lookup_devices(mvrt_code_t *code);
 
 enum {
   _TOKEN_INVALID = 0,
@@ -21,6 +39,14 @@ enum {
   _TOKEN_NTAGS   = 6
 };
 
+/* kinds of constant pool entries, as written to images */
+enum {
+  _CONST_UNUSED = 0,
+  _CONST_STRING = 1,
+  _CONST_INT    = 2,
+  _CONST_REF    = 3
+};
+
 enum {
   _STATE_EXPECT_LPAREN         = 2,
   _STATE_EXPECT_OPER_OR_RPAREN = 3,
@@ -55,7 +81,16 @@ int _rtcode_parse_nargs(int op)
   switch (op) {
   case MVRT_OP_PUSHS:
   case MVRT_OP_PUSHI:
+  case MVRT_OP_JMP:
   case MVRT_OP_BEQ:
+  case MVRT_OP_BLT:
+  case MVRT_OP_BLE:
+  case MVRT_OP_BGT:
+  case MVRT_OP_BGE:
+  case MVRT_OP_SAVE:
+  case MVRT_OP_LOAD:
+  case MVRT_OP_CALL_NATIVE:
+  case MVRT_OP_CALL_BATCH:
     return 1;
   default:
     break;
@@ -64,6 +99,38 @@ int _rtcode_parse_nargs(int op)
   return 0;
 }
 
+/* Makes room for instruction n, doubling the capacity as needed. */
+void _rtcode_grow(mvrt_code_t *code, int n, int *cap)
+{
+  if (n < *cap)
+    return;
+
+  int newcap = (*cap > 0) ? *cap * 2 : 16;
+  code->instrs = realloc(code->instrs, sizeof(mvrt_instr_t) * newcap);
+  if (!code->instrs) {
+    fprintf(stderr, "Out of memory for code.\n");
+    exit(1);
+  }
+  *cap = newcap;
+}
+
+/* Appends the value to the constant pool and returns its index. */
+int _rtcode_add_const(mvrt_code_t *code, mv_ptr_t value, int *cap)
+{
+  if (code->nconsts == *cap) {
+    int newcap = (*cap > 0) ? *cap * 2 : 8;
+    code->consts = realloc(code->consts, sizeof(mv_ptr_t) * newcap);
+    if (!code->consts) {
+      fprintf(stderr, "Out of memory for constants.\n");
+      exit(1);
+    }
+    *cap = newcap;
+  }
+  code->consts[code->nconsts] = value;
+
+  return code->nconsts++;
+}
+
 #define MAX_CODE_LINE 1024
 mvrt_code_t *_rtcode_parse(FILE *fp)
 {
@@ -79,6 +146,8 @@ mvrt_code_t *_rtcode_parse(FILE *fp)
   int toktag;
   int optag;
   int nopers = 0;
+  int icap = 0;
+  int ccap = 0;
   int state = _STATE_EXPECT_LPAREN;
   mvrt_code_t *code = NULL;
 
@@ -120,19 +189,53 @@ mvrt_code_t *_rtcode_parse(FILE *fp)
           {
             char *arg = strdup(token+1);
             arg[strlen(arg)-1] = '\0';
+#ifndef NDEBUG
             fprintf(stdout, "\treactor[%d]: %s \"%s\"\n", nopers,  
                     mvrt_opcode_str(code->instrs[nopers].opcode), arg);
-            code->instrs[nopers].ptr = (mv_ptr_t) arg;
+#endif
+            mv_ptr_t arg_v = (mv_ptr_t) mv_value_string(arg);
+            code->instrs[nopers].operand = 
+              _rtcode_add_const(code, arg_v, &ccap);
+            free(arg);
             nopers++;
           }
           break;
         case MVRT_OP_PUSHI:
+          {
+            int arg = atoi(token);
+#ifndef NDEBUG
+            fprintf(stdout, "\treactor[%d]: %s %d\n", nopers,  
+                    mvrt_opcode_str(code->instrs[nopers].opcode), arg);
+#endif
+            if (arg >= MVRT_OPERAND_MIN && arg <= MVRT_OPERAND_MAX) {
+              code->instrs[nopers].operand = arg & 0xffffff;
+            }
+            else {
+              code->instrs[nopers].opcode = MVRT_OP_PUSHIL;
+              code->instrs[nopers].operand = 
+                _rtcode_add_const(code, (mv_ptr_t) arg, &ccap);
+            }
+            nopers++;
+          }
+          break;
+        case MVRT_OP_JMP:
         case MVRT_OP_BEQ:
+        case MVRT_OP_BLT:
+        case MVRT_OP_BLE:
+        case MVRT_OP_BGT:
+        case MVRT_OP_BGE:
+        case MVRT_OP_SAVE:
+        case MVRT_OP_LOAD:
+        case MVRT_OP_CALL_NATIVE:
+        case MVRT_OP_CALL_BATCH:
           {
             int arg = atoi(token);
+#ifndef NDEBUG
             fprintf(stdout, "\treactor[%d]: %s %d\n", nopers,  
                     mvrt_opcode_str(code->instrs[nopers].opcode), arg);
-            code->instrs[nopers].ptr = (mv_ptr_t) arg;
+#endif
+            /* out of range values are caught by the verifier */
+            code->instrs[nopers].operand = arg & 0xffffff;
             nopers++;
           }
           break;
@@ -147,21 +250,33 @@ mvrt_code_t *_rtcode_parse(FILE *fp)
             fprintf(stderr, "Invalid operator -- \"%s\"", token);
             exit(1);
           }
-          else
+          else {
+            _rtcode_grow(code, nopers, &icap);
             code->instrs[nopers].opcode = optag;
+            code->instrs[nopers].operand = 0;
+          }
 
           if (_rtcode_parse_nargs(optag) > 0) {
             state = _STATE_EXPECT_ARG;
           }
           else {
             state = _STATE_EXPECT_OPER_OR_RPAREN;
+#ifndef NDEBUG
             fprintf(stdout, "\treactor[%d]: %s\n", nopers,  
                     mvrt_opcode_str(code->instrs[nopers].opcode));
+#endif
             nopers++;
           }
         }
         else if (toktag == _TOKEN_RPAREN) {
+          /* shrink to fit */
           code->size = nopers;
+          if (nopers > 0)
+            code->instrs = realloc(code->instrs, 
+                                   sizeof(mvrt_instr_t) * nopers);
+          if (code->nconsts > 0)
+            code->consts = realloc(code->consts, 
+                                   sizeof(mv_ptr_t) * code->nconsts);
           state = _STATE_DONE;
         }
         else {
@@ -180,25 +295,621 @@ mvrt_code_t *_rtcode_parse(FILE *fp)
   return code;
 }
 
+/* Returns the number of values pushed by the instruction at ip. Calling a
+   remote function with call_func does not push anything, since the call
+   does not wait for the return value. call_batch pushes a result for each
+   argument. */
+int _rtcode_verify_nrets(mvrt_code_t *code, int ip)
+{
+  mvrt_instr_t *instr = code->instrs + ip;
+
+  if (instr->opcode == MVRT_OP_CALL_BATCH)
+    return instr->operand;
+
+  if (instr->opcode == MVRT_OP_CALL_FUNC && ip > 0
+      && (instr - 1)->opcode == MVRT_OP_PUSHS) {
+    char *func_s = mv_value_string_get(mvrt_code_const(code, instr - 1));
+    char *charp = strchr(func_s, ':');
+    if (charp && charp != func_s)
+      return 0;
+  }
+
+  return mvrt_opcode_nrets(instr->opcode);
+}
+
+/* Returns the temporary used by the instruction, or -1 if none is used. */
+int _rtcode_verify_reg(mvrt_instr_t *instr)
+{
+  switch (instr->opcode) {
+  case MVRT_OP_SAVE0:
+  case MVRT_OP_LOAD0:
+    return 0;
+  case MVRT_OP_SAVE1:
+  case MVRT_OP_LOAD1:
+    return 1;
+  case MVRT_OP_SAVE:
+  case MVRT_OP_LOAD:
+    return (int) instr->operand;
+  default:
+    break;
+  }
+
+  return -1;
+}
+
+int _rtcode_verify_error(mvrt_code_t *code, int ip, const char *msg)
+{
+  const char *opstr = "";
+  if (ip < code->size && code->instrs[ip].opcode < MVRT_OP_NTAGS)
+    opstr = mvrt_opcode_str(code->instrs[ip].opcode);
+  fprintf(stderr, "Verify error at [%d] %s: %s.\n", ip, opstr, msg);
+
+  return -1;
+}
+
+int mvrt_code_verify(mvrt_code_t *code, int depth0)
+{
+  /* depth[ip] is the stack depth before evaluating the instruction at ip, 
+     or -1 if ip is not reached yet. Each ip is pushed to the worklist only
+     once, when it is first reached. */
+  int *depth = malloc(sizeof(int) * (code->size + 1));
+  int *work = malloc(sizeof(int) * (code->size + 1));
+  int nwork = 0;
+  int maxstack = depth0;
+  int nregs = 0;
+  int retval = 0;
+  int i;
+
+  for (i = 0; i <= code->size; i++)
+    depth[i] = -1;
+  depth[0] = depth0;
+  work[nwork++] = 0;
+
+  while (nwork > 0 && retval == 0) {
+    int ip = work[--nwork];
+    if (ip == code->size)
+      continue;
+
+    mvrt_instr_t *instr = code->instrs + ip;
+    if (instr->opcode >= MVRT_OP_NTAGS) {
+      retval = _rtcode_verify_error(code, ip, "invalid opcode");
+      break;
+    }
+
+    int nargs = mvrt_opcode_nargs(instr->opcode);
+    if (instr->opcode == MVRT_OP_CALL_NATIVE 
+        || instr->opcode == MVRT_OP_CALL_BATCH)
+      nargs += instr->operand;
+    int nrets = _rtcode_verify_nrets(code, ip);
+    if (nrets == -1) {
+      retval = _rtcode_verify_error(code, ip, "opcode not supported");
+      break;
+    }
+    if (depth[ip] < nargs) {
+      retval = _rtcode_verify_error(code, ip, "stack underflow");
+      break;
+    }
+
+    int reg = _rtcode_verify_reg(instr);
+    if (reg >= MVRT_CODE_MAX_REGS) {
+      retval = _rtcode_verify_error(code, ip, "temporary out of range");
+      break;
+    }
+    if (reg + 1 > nregs)
+      nregs = reg + 1;
+
+    int d = depth[ip] - nargs + nrets;
+    if (d > maxstack)
+      maxstack = d;
+
+    /* successors */
+    int next[2];
+    int nnext = 0;
+    switch (instr->opcode) {
+    case MVRT_OP_RET:
+      break;
+    case MVRT_OP_JMP:
+      next[nnext++] = (int) instr->operand;
+      break;
+    case MVRT_OP_BEQ:
+    case MVRT_OP_BLT:
+    case MVRT_OP_BLE:
+    case MVRT_OP_BGT:
+    case MVRT_OP_BGE:
+      next[nnext++] = (int) instr->operand;
+      next[nnext++] = ip + 1;
+      break;
+    default:
+      next[nnext++] = ip + 1;
+      break;
+    }
+
+    for (i = 0; i < nnext; i++) {
+      if (next[i] < 0 || next[i] > code->size) {
+        retval = _rtcode_verify_error(code, ip, "branch target out of code");
+        break;
+      }
+      if (depth[next[i]] == -1) {
+        depth[next[i]] = d;
+        work[nwork++] = next[i];
+      }
+      else if (depth[next[i]] != d) {
+        retval = _rtcode_verify_error(code, next[i], 
+                                      "stack depth differs between paths");
+        break;
+      }
+    }
+  }
+
+  if (retval == 0) {
+    code->maxstack = maxstack;
+    code->nregs = nregs;
+  }
+
+  free(depth);
+  free(work);
+
+  return retval;
+}
+
+int _rtcode_is_branch(int op)
+{
+  switch (op) {
+  case MVRT_OP_JMP:
+  case MVRT_OP_BEQ:
+  case MVRT_OP_BLT:
+  case MVRT_OP_BLE:
+  case MVRT_OP_BGT:
+  case MVRT_OP_BGE:
+    return 1;
+  default:
+    break;
+  }
+
+  return 0;
+}
+
+/* Returns the name part of a local "name" or ":name", or NULL if the name
+   belongs to another device. */
+char *_rtcode_local_name(char *name)
+{
+  char *charp = strchr(name, ':');
+  if (!charp)
+    return name;
+  if (charp == name)
+    return name + 1;
+
+  return NULL;
+}
+
+/* Returns the superinstruction for "pushs <name>; op", or -1 if none. 
+   Sets *tag to the tag of the object the name refers to. */
+int _rtcode_super_ref(int op, unsigned *tag)
+{
+  switch (op) {
+  case MVRT_OP_PROP_GET:
+    *tag = MVRT_OBJ_PROP;
+    return MVRT_OP_PROP_GETK;
+  case MVRT_OP_PROP_SET:
+    *tag = MVRT_OBJ_PROP;
+    return MVRT_OP_PROP_SETK;
+  case MVRT_OP_CALL_FUNC:
+  case MVRT_OP_CALL_FUNC_RET:
+    *tag = MVRT_OBJ_FUNC;
+    return MVRT_OP_CALL_FUNCK;
+  case MVRT_OP_TIMER_START:
+    *tag = MVRT_OBJ_EVENT;
+    return MVRT_OP_TIMER_STARTK;
+  case MVRT_OP_TIMER_STOP:
+    *tag = MVRT_OBJ_EVENT;
+    return MVRT_OP_TIMER_STOPK;
+  case MVRT_OP_TIMER_RESET:
+    *tag = MVRT_OBJ_EVENT;
+    return MVRT_OP_TIMER_RESETK;
+  case MVRT_OP_EVENT_OCCUR:
+    *tag = MVRT_OBJ_EVENT;
+    return MVRT_OP_EVENT_OCCURK;
+  default:
+    break;
+  }
+
+  return -1;
+}
+
+/* Returns 1 if the operand of the instruction is a reference. */
+int _rtcode_has_ref(int op)
+{
+  return (op >= MVRT_OP_SUPER_FIRST && op != MVRT_OP_GETARGF 
+          && op != MVRT_OP_PUSHIL);
+}
+
+/* Returns the number of instructions at ip fused into *super, or 0 if no
+   superinstruction applies. Instructions after the first one must not be
+   branch targets. Names of local objects become references, which are 
+   bound when first evaluated, so the objects need not exist yet. */
+int _rtcode_fuse_match(mvrt_code_t *code, int ip, int *target,
+                       mvrt_instr_t *super)
+{
+  mvrt_instr_t *instr = code->instrs + ip;
+  int left = code->size - ip;
+  char *name;
+  unsigned tag;
+  int op;
+
+  if (left >= 3 && instr[0].opcode == MVRT_OP_GETARG 
+      && instr[1].opcode == MVRT_OP_PUSHS && instr[2].opcode == MVRT_OP_GETF
+      && !target[ip + 1] && !target[ip + 2]) {
+    /* the key is the string value already in the pool */
+    super->opcode = MVRT_OP_GETARGF;
+    super->operand = instr[1].operand;
+    return 3;
+  }
+
+  if (left < 2 || instr[0].opcode != MVRT_OP_PUSHS || target[ip + 1])
+    return 0;
+  name = mv_value_string_get(mvrt_code_const(code, instr));
+  if ((name = _rtcode_local_name(name)) == NULL)
+    return 0;
+  if ((op = _rtcode_super_ref(instr[1].opcode, &tag)) == -1)
+    return 0;
+
+  /* the reference takes over the pool entry of the name */
+  mv_value_t name_v = (mv_value_t) mvrt_code_const(code, instr);
+  super->opcode = op;
+  super->operand = instr[0].operand;
+  mvrt_code_const(code, instr) = (mv_ptr_t) mvrt_ref_new(name, tag);
+  mv_value_delete(name_v);
+
+  return 2;
+}
+
+/* Replace common sequences with superinstructions, and relocate branch
+   targets. Must run after the verifier, which relies on the unfused
+   sequences; fusing never deepens the stack, so code->maxstack holds. */
+int _rtcode_fuse(mvrt_code_t *code)
+{
+  int *target = calloc(code->size + 1, sizeof(int));
+  int *newip = malloc(sizeof(int) * (code->size + 1));
+  int ip = 0;
+  int nip = 0;
+  int i;
+
+  for (i = 0; i < code->size; i++) {
+    if (_rtcode_is_branch(code->instrs[i].opcode))
+      target[code->instrs[i].operand] = 1;
+  }
+
+  while (ip < code->size) {
+    mvrt_instr_t super;
+    int n = _rtcode_fuse_match(code, ip, target, &super);
+    if (n > 0) {
+      for (i = 0; i < n; i++)
+        newip[ip + i] = nip;
+      code->instrs[nip++] = super;
+      ip += n;
+    }
+    else {
+      newip[ip] = nip;
+      code->instrs[nip++] = code->instrs[ip++];
+    }
+  }
+  newip[code->size] = nip;
+
+  for (i = 0; i < nip; i++) {
+    if (_rtcode_is_branch(code->instrs[i].opcode))
+      code->instrs[i].operand = newip[code->instrs[i].operand];
+  }
+  code->size = nip;
+  if (nip > 0)
+    code->instrs = realloc(code->instrs, sizeof(mvrt_instr_t) * nip);
+
+  free(target);
+  free(newip);
+
+  return 0;
+}
+
+/* Returns the kind of the constant the operand of op refers to, or 
+   _CONST_UNUSED if the operand is not a constant pool index. */
+int _rtcode_const_kind(int op)
+{
+  switch (op) {
+  case MVRT_OP_PUSHS:
+  case MVRT_OP_GETARGF:
+    return _CONST_STRING;
+  case MVRT_OP_PUSHIL:
+    return _CONST_INT;
+  default:
+    break;
+  }
+
+  return _rtcode_has_ref(op) ? _CONST_REF : _CONST_UNUSED;
+}
+
+/* Sets kinds[i] to the kind of the i-th constant, as used by the code. 
+   Returns -1 if an opcode is invalid, or an operand is not an index of
+   the pool, or two instructions share a constant. */
+int _rtcode_const_kinds(mvrt_code_t *code, int *kinds)
+{
+  int i;
+  for (i = 0; i < code->nconsts; i++)
+    kinds[i] = _CONST_UNUSED;
+
+  for (i = 0; i < code->size; i++) {
+    mvrt_instr_t *instr = code->instrs + i;
+    if (instr->opcode >= MVRT_OP_NTAGS)
+      return -1;
+
+    int kind = _rtcode_const_kind(instr->opcode);
+    if (kind == _CONST_UNUSED)
+      continue;
+    if ((int) instr->operand >= code->nconsts 
+        || kinds[instr->operand] != _CONST_UNUSED)
+      return -1;
+    kinds[instr->operand] = kind;
+  }
+
+  return 0;
+}
+
 mvrt_code_t *mvrt_code_new()
 {
   mvrt_code_t *code = malloc(sizeof(mvrt_code_t));
   code->size = 0;
+  code->maxstack = 0;
+  code->nregs = 0;
+  code->nconsts = 0;
+  code->mapped = 0;
+  code->instrs = NULL;
+  code->consts = NULL;
 
   return code;
 }
 
+/* Looks up the devices of the names the code sends to, "dev" of a 
+   "pushs dev:name" before an operation on name, so that they are known
+   by the time the code runs. With a directory, a device not cached yet
+   is only known once the directory replies, and the operation on it 
+   would fail, so this waits for the reply. Returns the number of devices
+   found. */
+int _rtcode_lookup_devices(mvrt_code_t *code)
+{
+  const char **names = malloc(sizeof(char *) * (code->size + 1));
+  int found = 0;
+  int n = 0;
+  int ip;
+  int i;
+  for (ip = 0; ip + 1 < code->size; ip++) {
+    mvrt_instr_t *instr = code->instrs + ip;
+    unsigned tag;
+    if (instr->opcode != MVRT_OP_PUSHS
+        || _rtcode_super_ref(instr[1].opcode, &tag) == -1)
+      continue;
+
+    char *name = mv_value_string_get(mvrt_code_const(code, instr));
+    char *charp = strchr(name, ':');
+    if (!charp || charp == name)
+      continue;
+    char *dev = strndup(name, charp - name);
+    for (i = 0; i < n && strcmp(names[i], dev); i++)
+      ;
+    if (i < n)
+      free(dev);
+    else
+      names[n++] = dev;
+  }
+
+  if (n > 0) {
+    mv_device_t *devs = malloc(sizeof(mv_device_t) * n);
+    found = mv_device_lookup_batch(names, n, devs);
+    free(devs);
+  }
+  for (i = 0; i < n; i++)
+    free((char *) names[i]);
+  free(names);
+
+  return found;
+}
+
 mvrt_code_t *mvrt_code_load_file(FILE *fp)
 {
-  return _rtcode_parse(fp);
+  mvrt_code_t *code = _rtcode_parse(fp);
+  if (!code)
+    return NULL;
+
+  if (mvrt_code_verify(code, MVRT_CODE_ENTRY_DEPTH) == -1) {
+    mvrt_code_delete(code);
+    return NULL;
+  }
+  _rtcode_fuse(code);
+  _rtcode_lookup_devices(code);
+
+  return code;
+}
+
+int mvrt_code_save_image(mvrt_code_t *code, FILE *fp)
+{
+  int *kinds = malloc(sizeof(int) * (code->nconsts + 1));
+  int retval = 0;
+  int i;
+
+  if (_rtcode_const_kinds(code, kinds) == -1
+      || mvrt_image_put_u32(fp, code->size) == -1
+      || mvrt_image_put_u32(fp, code->nconsts) == -1
+      || mvrt_image_put_bytes(fp, code->instrs, 
+                              sizeof(mvrt_instr_t) * code->size) == -1)
+    retval = -1;
+
+  for (i = 0; i < code->nconsts && retval == 0; i++) {
+    mv_ptr_t value = code->consts[i];
+    if (mvrt_image_put_u32(fp, kinds[i]) == -1) {
+      retval = -1;
+      break;
+    }
+
+    switch (kinds[i]) {
+    case _CONST_STRING:
+      retval = mvrt_image_put_str(fp, mv_value_string_get(value));
+      break;
+    case _CONST_INT:
+      retval = mvrt_image_put_u32(fp, (mv_uint32_t) (int) value);
+      break;
+    case _CONST_REF:
+      {
+        mvrt_ref_t *ref = (mvrt_ref_t *) value;
+        if (mvrt_image_put_u32(fp, ref->tag) == -1
+            || mvrt_image_put_str(fp, ref->name) == -1)
+          retval = -1;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  free(kinds);
+
+  return retval;
+}
+
+mvrt_code_t *mvrt_code_load_image(mvrt_image_t *img)
+{
+  mv_uint32_t size;
+  mv_uint32_t nconsts;
+  const void *instrs;
+  if (mvrt_image_get_u32(img, &size) == -1
+      || mvrt_image_get_u32(img, &nconsts) == -1
+      || size > MVRT_OPERAND_MAX || nconsts > MVRT_OPERAND_MAX
+      || mvrt_image_get_bytes(img, sizeof(mvrt_instr_t) * size, 
+                              &instrs) == -1) {
+    fprintf(stderr, "Malformed code section in image.\n");
+    return NULL;
+  }
+
+  mvrt_code_t *code = mvrt_code_new();
+  code->size = size;
+  code->mapped = 1;
+  code->instrs = (mvrt_instr_t *) instrs;
+  if (nconsts > 0)
+    code->consts = malloc(sizeof(mv_ptr_t) * nconsts);
+
+  /* kinds[] as written to the image, and used[] as used by the code */
+  int *kinds = malloc(sizeof(int) * (nconsts + 1));
+  int *used = malloc(sizeof(int) * (nconsts + 1));
+  int retval = 0;
+  int i;
+  for (i = 0; i < (int) nconsts && retval == 0; i++) {
+    mv_uint32_t kind;
+    mv_uint32_t value;
+    const char *str;
+    if (mvrt_image_get_u32(img, &kind) == -1) {
+      retval = -1;
+      break;
+    }
+
+    code->consts[i] = 0;
+    switch (kind) {
+    case _CONST_UNUSED:
+      break;
+    case _CONST_STRING:
+      if (mvrt_image_get_str(img, &str) == -1 || !str)
+        retval = -1;
+      else
+        code->consts[i] = (mv_ptr_t) mv_value_string(str);
+      break;
+    case _CONST_INT:
+      if (mvrt_image_get_u32(img, &value) == -1)
+        retval = -1;
+      else
+        code->consts[i] = (mv_ptr_t) (int) value;
+      break;
+    case _CONST_REF:
+      if (mvrt_image_get_u32(img, &value) == -1 || value >= MVRT_OBJ_NTAGS
+          || mvrt_image_get_str(img, &str) == -1 || !str)
+        retval = -1;
+      else
+        code->consts[i] = (mv_ptr_t) mvrt_ref_new(str, value);
+      break;
+    default:
+      retval = -1;
+      break;
+    }
+    if (retval == 0) {
+      kinds[i] = kind;
+      code->nconsts = i + 1;
+    }
+  }
+
+  if (retval == 0 && (_rtcode_const_kinds(code, used) == -1 
+                      || memcmp(kinds, used, sizeof(int) * nconsts)))
+    retval = -1;
+
+  if (retval == -1) {
+    fprintf(stderr, "Malformed constant pool in image.\n");
+    for (i = 0; i < code->nconsts; i++) {
+      if (kinds[i] == _CONST_REF)
+        mvrt_ref_delete((mvrt_ref_t *) code->consts[i]);
+      else if (kinds[i] == _CONST_STRING)
+        mv_value_delete((mv_value_t) code->consts[i]);
+    }
+    free(code->consts);
+    free(code);
+    code = NULL;
+  }
+  else if (mvrt_code_verify(code, MVRT_CODE_ENTRY_DEPTH) == -1) {
+    mvrt_code_delete(code);
+    code = NULL;
+  }
+  else {
+    _rtcode_lookup_devices(code);
+  }
+  free(kinds);
+  free(used);
+
+  return code;
 }
 
 int mvrt_code_delete(mvrt_code_t *code)
 {
+  int i;
+  for (i = 0; i < code->size; i++) {
+    mvrt_instr_t *instr = code->instrs + i;
+    if (_rtcode_has_ref(instr->opcode))
+      mvrt_ref_delete((mvrt_ref_t *) mvrt_code_const(code, instr));
+    else if (_rtcode_const_kind(instr->opcode) == _CONST_STRING)
+      mv_value_delete((mv_value_t) mvrt_code_const(code, instr));
+  }
+  if (!code->mapped)
+    free(code->instrs);
+  free(code->consts);
   free(code);
   return 0;
 }
 
+size_t mvrt_code_memsize(mvrt_code_t *code)
+{
+  size_t size = sizeof(mvrt_code_t) + sizeof(mv_ptr_t) * code->nconsts;
+
+  /* mapped instructions are shared with other processes */
+  if (!code->mapped)
+    size += sizeof(mvrt_instr_t) * code->size;
+
+  int i;
+  for (i = 0; i < code->size; i++) {
+    mvrt_instr_t *instr = code->instrs + i;
+    if (_rtcode_has_ref(instr->opcode)) {
+      mvrt_ref_t *ref = (mvrt_ref_t *) mvrt_code_const(code, instr);
+      size += sizeof(mvrt_ref_t) + strlen(ref->name) + 1;
+    }
+    else if (instr->opcode == MVRT_OP_PUSHS 
+             || instr->opcode == MVRT_OP_GETARGF) {
+      mv_value_t str_v = (mv_value_t) mvrt_code_const(code, instr);
+      size += strlen(mv_value_string_get(str_v)) + 1;
+    }
+  }
+
+  return size;
+}
+
 
 void mvrt_code_print(mvrt_code_t *code)
 {
@@ -9,26 +9,64 @@
 
 
 #include "rtoper.h"    /* mvrt_instr_t */
+#include "rtimage.h"   /* mvrt_image_t */
 
-#define MAX_CODE_SIZE 1024
 typedef struct mvrt_code {
-  int size;
-  mvrt_instr_t instrs[MAX_CODE_SIZE];
+  int size;               /* number of instructions */
+  int maxstack;           /* max stack depth, computed by the verifier */
+  int nregs;              /* number of temporaries used by save/load */
+  int nconsts;            /* number of constants */
+  int mapped;             /* instructions are in a read-only image */
+  mvrt_instr_t *instrs;   /* instructions, sized to fit */
+  mv_ptr_t *consts;       /* constant pool, sized to fit */
 } mvrt_code_t;
 
+/* Returns the constant pool entry named by the operand of instr. */
+#define mvrt_code_const(code, instr) ((code)->consts[(instr)->operand])
+
+/* Stack depth on entry to code: the argument of the reactor/function. */
+#define MVRT_CODE_ENTRY_DEPTH 1
+
+/* Max number of temporaries (local variables) a code can use. */
+#define MVRT_CODE_MAX_REGS 256
+
 
 /* Create an empty code struct. */
 extern mvrt_code_t *mvrt_code_new();
 
 /* Load a single definition of code from a file. The file position of fp 
    should be be set at the line "{", which starts the body of a function
-   or a reactor */
+   or a reactor. The loaded code is verified, and NULL is returned if the
+   verification fails. The devices the code sends to are looked up, which
+   waits for the directory if they are not cached yet. */
 extern mvrt_code_t *mvrt_code_load_file(FILE *fp);
 
+/* Verify the code, assuming the given stack depth on entry: all opcodes
+   are supported by the evaluator, branch targets are within the code, the
+   stack never underflows, and every path to an instruction reaches it with
+   the same stack depth. Temporaries must be less than MVRT_CODE_MAX_REGS.
+   On success, sets code->maxstack and code->nregs, and returns 0.
+   Otherwise, returns -1. */
+extern int mvrt_code_verify(mvrt_code_t *code, int depth);
+
+/* Writes the code as a section of a binary image. Returns 0 on success
+   and -1 on failure. */
+extern int mvrt_code_save_image(mvrt_code_t *code, FILE *fp);
+
+/* Loads a code section at the read position of the image. Instructions are
+   used in place; only the constant pool is built. The loaded code is 
+   verified, and NULL is returned if the verification fails. The devices
+   are looked up as by mvrt_code_load_file. */
+extern mvrt_code_t *mvrt_code_load_image(mvrt_image_t *img);
+
+/* Frees the code, with its constant pool. */
 extern int mvrt_code_delete(mvrt_code_t *code);
 
 extern char *mvrt_code_save_str(mvrt_code_t *code);
 
 extern void mvrt_code_print(mvrt_code_t *code);
 
+/* Returns the number of bytes used by the code, including its constants. */
+extern size_t mvrt_code_memsize(mvrt_code_t *code);
+
 #endif /* MVRT_CODE_H */
@@ -11,9 +11,9 @@ static mvrt_stack_t *_rtstack_copy(mvrt_stack_t *stack);
 
 mvrt_stack_t *_rtstack_copy(mvrt_stack_t *stack)
 {
-  mvrt_stack_t *copy = mvrt_stack_new();
+  mvrt_stack_t *copy = mvrt_stack_new(stack->size);
   int i;
-  for (i = 0; i < stack->sptr; i++) {
+  for (i = 0; i <= stack->sptr; i++) {
     copy->values[i] = stack->values[i];
   }
   copy->sptr = stack->sptr;
@@ -25,10 +25,12 @@ mvrt_stack_t *_rtstack_copy(mvrt_stack_t *stack)
 /*
  * Functions for context.
  */
-mvrt_stack_t *mvrt_stack_new()
+mvrt_stack_t *mvrt_stack_new(size_t size)
 {
-  mvrt_stack_t *stack = malloc(sizeof(mvrt_stack_t));
+  mvrt_stack_t *stack = malloc(sizeof(mvrt_stack_t) 
+                               + sizeof(mv_value_t) * (size + 1));
   stack->sptr = 0;
+  stack->size = size;
   stack->values[0] = mv_value_null();
 
   return stack;
@@ -56,7 +58,7 @@ mv_value_t mvrt_stack_top(mvrt_stack_t *stack)
 
 int mvrt_stack_push(mvrt_stack_t *stack, mv_value_t value)
 {
-  assert(stack->sptr < MAX_STACK_SIZE - 1);
+  assert(stack->sptr < stack->size);
   stack->values[++stack->sptr] = value;
 
   return stack->sptr;
@@ -68,6 +70,14 @@ mvrt_context_t *mvrt_context_new(mvrt_code_t *code)
   ctx->code = code;
   ctx->iptr = 0;
   ctx->stack = NULL;
+  ctx->regs = NULL;
+
+  if (code && code->nregs > 0) {
+    ctx->regs = malloc(sizeof(mv_value_t) * code->nregs);
+    int i;
+    for (i = 0; i < code->nregs; i++)
+      ctx->regs[i] = mv_value_null();
+  }
 
   return ctx;
 }
@@ -76,6 +86,8 @@ int mvrt_context_delete(mvrt_context_t *ctx)
 {
   if (ctx->stack)
     mvrt_stack_delete(ctx->stack);
+  if (ctx->regs)
+    free(ctx->regs);
   free(ctx);
 
   return 0;
@@ -97,6 +109,11 @@ int mvrt_continuation_new(mvrt_context_t *ctx)
   cont->ctx = mvrt_context_new(ctx->code);
   cont->ctx->stack = _rtstack_copy(ctx->stack);
   cont->ctx->iptr = ctx->iptr + 1;
+  cont->ctx->arg = ctx->arg;
+
+  int i;
+  for (i = 0; i < ctx->code->nregs; i++)
+    cont->ctx->regs[i] = ctx->regs[i];
 
   return cont->id;
 }
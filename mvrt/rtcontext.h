@@ -12,10 +12,10 @@
 /*
  * Stack
  */
-#define MAX_STACK_SIZE 1024
 typedef struct mvrt_stack {
   size_t sptr;
-  mv_value_t values[MAX_STACK_SIZE];
+  size_t size;           /* max number of values */
+  mv_value_t values[];   /* values[0] is a dummy; values[sptr] is top */
 } mvrt_stack_t;
 
 /*
@@ -26,6 +26,7 @@ typedef struct mvrt_context {
   int iptr;              /* index to code array */
   mvrt_stack_t *stack;   /* stack */
   mv_value_t arg;        /* argument to reactor/function */
+  mv_value_t *regs;      /* temporaries (local variables), code->nregs */
 } mvrt_context_t;
 
 
@@ -41,13 +42,18 @@ typedef struct mvrt_continue {
 extern mvrt_code_t *mvrt_code_new();
 extern int mvrt_code_delete(mvrt_code_t *code);
 
-extern mvrt_stack_t *mvrt_stack_new();
+/* Create a stack which can hold up to the given number of values. Code
+   evaluated on it should need no more than size, which is guaranteed by
+   allocating code->maxstack for verified code. */
+extern mvrt_stack_t *mvrt_stack_new(size_t size);
 extern int mvrt_stack_delete(mvrt_stack_t *stk);
 extern mv_value_t mvrt_stack_top(mvrt_stack_t *stk);
 extern mv_value_t mvrt_stack_pop(mvrt_stack_t *stk);
 extern int mvrt_stack_push(mvrt_stack_t *stk, mv_value_t value);
 
-extern mvrt_context_t *mvrt_context_new();
+/* Create a context for evaluating the given code. The temporaries of the
+   code are allocated and set to null. */
+extern mvrt_context_t *mvrt_context_new(mvrt_code_t *code);
 extern int mvrt_context_delete(mvrt_context_t *ctx);
 
 /* Creates a continuation using the given context. Returns a unique id which
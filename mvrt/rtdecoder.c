@@ -11,6 +11,7 @@
 #include <mv/message.h>   /* mv_message_t */
 #include "rtprop.h"       /* mvrt_prop_t */
 #include "rtfunc.h"       /* mvrt_func_t */
+#include "rtsub.h"        /* mvrt_subscribe */
 #include "rtdecoder.h"
 
 
@@ -20,7 +21,7 @@ typedef struct {
 } _decoder_t;
 
 static void *_decoder_thread(void *arg);
-static mvrt_eventinst_t *_decoder_decode(mv_message_t *mvmsg);
+static int _decoder_decode(mv_message_t *mvmsg, mvrt_eventinst_t **evinst);
 
 
 void *_decoder_thread(void *arg)
@@ -55,13 +56,14 @@ void *_decoder_thread(void *arg)
       continue;
     }
 
-    evinst = _decoder_decode(mvmsg);
-    if (!evinst) {
+    if (_decoder_decode(mvmsg, &evinst) == -1) {
       fprintf(stderr, "Failed to decode message: %s\n", str);
       continue;
     }
 
     free(str);
+    if (!evinst)
+      continue;   /* handled by the decoder */
 
     while (mvrt_evqueue_full(evq)) {
       nanosleep(&ts, NULL);
@@ -77,6 +79,7 @@ enum {
   _V_STRING_ARG    = 1,
   _V_STRING_FUNARG = 2,
   _V_STRING_DEV    = 3,
+  _V_STRING_FILTER = 4,
   _V_NTAGS
 };
 static mv_value_t _values[_V_NTAGS];
@@ -90,14 +93,15 @@ void _decoder_init()
   _values[_V_STRING_NAME] = mv_value_string("name");
   _values[_V_STRING_ARG] = mv_value_string("arg");
   _values[_V_STRING_FUNARG] = mv_value_string("funarg");
-  _values[_V_STRING_FUNARG] = mv_value_string("dev");
+  _values[_V_STRING_DEV] = mv_value_string("dev");
+  _values[_V_STRING_FILTER] = mv_value_string("filter");
   _decoder_init_done = 1;
 }
 
-mvrt_eventinst_t *_decoder_decode(mv_message_t *mvmsg)
+/* Decodes the message into an event instance. Messages handled by the
+   decoder itself give no event instance. Returns -1 on failure. */
+int _decoder_decode(mv_message_t *mvmsg, mvrt_eventinst_t **evinst)
 {
-  mvrt_eventinst_t *evinst;     /* event instance */
-
   mv_value_t arg_v;             /* arg field value of the message */
   mv_value_t src_v;             /* src field value of the message */
   mv_value_t name_v;            /* name */
@@ -111,27 +115,57 @@ mvrt_eventinst_t *_decoder_decode(mv_message_t *mvmsg)
   char *name_s;                 /* name string */
   char *dev_s;                  /* dev string */
 
+  *evinst = NULL;
   switch (mvmsg->tag) {
+  case MV_MESSAGE_EVENT_SUB:
+  case MV_MESSAGE_EVENT_UNSUB:
+    /* 
+       { 
+         tag: "EVENT_SUB",
+         arg: { "name": "temperature", "dev": "phone",
+                "filter": { "field": "celsius", "op": ">", "value": 30 } } 
+       }
+    */
+    arg_v = mvmsg->arg;
+    name_v = mv_value_map_lookup(arg_v, _values[_V_STRING_NAME]);
+    dev_v = mv_value_map_lookup(arg_v, _values[_V_STRING_DEV]);
+    if (mv_value_tag(name_v) != MV_VALUE_STRING
+        || mv_value_tag(dev_v) != MV_VALUE_STRING) {
+      fprintf(stderr, "Subscription needs \"name\" and \"dev\".\n");
+      return -1;
+    }
+    name_s = mv_value_string_get(name_v);
+    dev_s = mv_value_string_get(dev_v);
+    if (mvmsg->tag == MV_MESSAGE_EVENT_UNSUB)
+      return mvrt_unsubscribe(name_s, dev_s);
+    return mvrt_subscribe(name_s, dev_s,
+                          mv_value_map_lookup(arg_v,
+                                              _values[_V_STRING_FILTER]));
   case MV_MESSAGE_EVENT_OCCUR:
     /* 
        { 
          tag: "EVENT_OCCUR",
-         arg: { "name": "adjust_volume", "volume": 12 } 
+         arg: { "name": "adjust_volume", "dev": "tv", "value": 12 } 
        }
+
+       The device raising the event is "dev" of the arg, if any, or of
+       the src.
     */
     arg_v = mvmsg->arg;
     src_v = mvmsg->src;
     name_v = mv_value_map_lookup(arg_v, _values[_V_STRING_NAME]);
     name_s = mv_value_string_get(name_v);
-    dev_v = mv_value_map_lookup(src_v, _values[_V_STRING_DEV]);
+    dev_v = mv_value_map_lookup(arg_v, _values[_V_STRING_DEV]);
+    if (mv_value_tag(dev_v) != MV_VALUE_STRING)
+      dev_v = mv_value_map_lookup(src_v, _values[_V_STRING_DEV]);
     dev_s = mv_value_string_get(dev_v);
-    event = mvrt_event_lookup(dev_s, name_s);
+    event = mvrt_event_lookup(name_s, dev_s);
     if (!event) {
       fprintf(stderr, "Failed to find the event handle for %s.\n", name_s);
-      return NULL;
+      return -1;
     }
-    evinst = mvrt_eventinst_new(event, arg_v);
-    return evinst;
+    *evinst = mvrt_eventinst_new(event, arg_v);
+    return 0;
   case MV_MESSAGE_PROP_ADD:
     /* 
        { 
@@ -145,35 +179,35 @@ mvrt_eventinst_t *_decoder_decode(mv_message_t *mvmsg)
     prop = mvrt_prop_new(name_s);
     if (!prop) {
       fprintf(stderr, "ERROR: Failed to create property: %s.\n", name_s);
-      return NULL;
+      return -1;
     }
-    break;
+    return 0;
   case MV_MESSAGE_PROP_SET:
     arg_v = mvmsg->arg;
     event = mvrt_event_lookup("_E_prop_set", NULL);
-    evinst = mvrt_eventinst_new(event, arg_v);
-    return evinst;
+    *evinst = mvrt_eventinst_new(event, arg_v);
+    return 0;
   case MV_MESSAGE_PROP_GET:
     arg_v = mvmsg->arg;
     event = mvrt_event_lookup("_E_prop_get", NULL);
-    evinst = mvrt_eventinst_new(event, arg_v);
-    return evinst;
+    *evinst = mvrt_eventinst_new(event, arg_v);
+    return 0;
   case MV_MESSAGE_FUNC_CALL:
     arg_v = mvmsg->arg;
     event = mvrt_event_lookup("_E_func_call", NULL);
-    evinst = mvrt_eventinst_new(event, arg_v);
-    return evinst;
+    *evinst = mvrt_eventinst_new(event, arg_v);
+    return 0;
   case MV_MESSAGE_REPLY:
     arg_v = mvmsg->arg;
     event = mvrt_event_lookup("_E_reply", NULL);
-    evinst = mvrt_eventinst_new(event, arg_v);
-    return evinst;
+    *evinst = mvrt_eventinst_new(event, arg_v);
+    return 0;
   default:
     break;
   }
 
   assert(0 && "Unimplemented or invalid message tag in _decoder_decode");
-  return NULL;
+  return -1;
 }
 
 /*
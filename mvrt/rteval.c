@@ -4,32 +4,64 @@
 #include <stdio.h>       /* fprintf */
 #include <stdlib.h>      /* malloc */
 #include <string.h>      /* strstr */
-#include <dlfcn.h>       /* dlopen */
+#include <time.h>        /* nanosleep */
 #include <assert.h>      /* assert */
 #include <mv/message.h>  /* mv_message_send */
 #include <mv/device.h>   /* mv_device_t */
 #include "rtprop.h"      /* mvrt_prop_t */
 #include "rtfunc.h"      /* mvrt_func_t */
 #include "rtcontext.h"   /* mvrt_stack_t */
+#include "rtevqueue.h"   /* mvrt_evqueue_put */
+#include "rtobj.h"       /* mvrt_ref_t */
 #include "rteval.h"
 
 
 static int _eval(mvrt_code_t *code, mvrt_context_t *ctx);
 static int _eval_instr(mvrt_instr_t *instr, mvrt_context_t *ctx);
 static int _eval_arithmetic(mvrt_instr_t *instr, mvrt_context_t *ctx);
+static int _eval_logical(mvrt_instr_t *instr, mvrt_context_t *ctx);
+static int _eval_compare(mvrt_instr_t *instr, mvrt_context_t *ctx);
+static int _eval_predicate(mvrt_instr_t *instr, mvrt_context_t *ctx);
 static int _eval_branch(mvrt_instr_t *instr, mvrt_context_t *ctx);
 static int _eval_push(mvrt_instr_t *instr, mvrt_context_t *ctx);
+static int _eval_pair(mvrt_instr_t *instr, mvrt_context_t *ctx);
+static int _eval_map(mvrt_instr_t *instr, mvrt_context_t *ctx);
 static int _eval_cons(mvrt_instr_t *instr, mvrt_context_t *ctx);
 static int _eval_stackop(mvrt_instr_t *instr, mvrt_context_t *ctx);
+static int _eval_regop(mvrt_instr_t *instr, mvrt_context_t *ctx);
+static int _eval_sleep(mvrt_instr_t *instr, mvrt_context_t *ctx);
+static int _eval_event_occur(mvrt_instr_t *instr, mvrt_context_t *ctx);
+static int _eval_prop_get(mvrt_instr_t *instr, mvrt_context_t *ctx);
+static int _eval_prop_set(mvrt_instr_t *instr, mvrt_context_t *ctx);
+static mv_value_t _eval_prop_value(const char *name);
+static mv_value_t _eval_prop_batch(const char *names);
+static int _eval_super(mvrt_instr_t *instr, mvrt_context_t *ctx);
+static int _eval_timer(mvrt_instr_t *instr, mvrt_context_t *ctx);
+static int _eval_timer_apply(int op, mvrt_event_t *timer);
+static int _eval_event_raise(mvrt_event_t *event, mv_value_t value);
 static int _eval_call_func(mvrt_instr_t *instr, mvrt_context_t *ctx);
 static int _eval_call_native(mvrt_func_t *f, mv_value_t a, mvrt_context_t *c);
+static int _eval_call_native_n(mvrt_instr_t *instr, mvrt_context_t *ctx);
+static mvrt_native_t *_eval_native_lookup(const char *name);
 static int _eval_call_return(mvrt_instr_t *instr, mvrt_context_t *ctx);
 static int _eval_call_continue(mvrt_instr_t *instr, mvrt_context_t *ctx);
 static char *_eval_getdev(char *s);
 static char *_eval_getname(char *s);
+static int _eval_test(int op, mv_value_t u, mv_value_t v);
+static int _eval_truth(mv_value_t v);
+static int _eval_takes_name(int op);
 
 extern char *dest;
 
+#ifdef MVRT_PROFILE
+/* number of evaluations of each opcode, and of each pair of consecutive
+   opcodes -- frequent pairs are candidates for superinstructions. Counted
+   with relaxed atomic adds, as reactors are evaluated in several threads
+   and printed from the main thread. */
+static unsigned long _eval_count[MVRT_OP_NTAGS];
+static unsigned long _eval_pair_count[MVRT_OP_NTAGS][MVRT_OP_NTAGS];
+#endif
+
 typedef enum {
   _EVAL_FAILURE = -1,
   _EVAL_SUSPEND = -2,
@@ -41,15 +73,26 @@ int _eval(mvrt_code_t *code, mvrt_context_t* ctx)
   mvrt_instr_t *instr = code->instrs + ctx->iptr;
   mvrt_continue_t *cont = NULL;
   int next_ip = 0;
+#ifdef MVRT_PROFILE
+  int prev_op = -1;
+#endif
   while (instr && ctx->iptr < code->size) {
-    const char *opstr = mvrt_opcode_str(instr->opcode);
-
-
-      fprintf(stdout, "\tEVAL[%2d]: %s\n", ctx->iptr, opstr);
+#ifndef NDEBUG
+    fprintf(stdout, "\tEVAL[%2d]: %s\n", 
+            ctx->iptr, mvrt_opcode_str(instr->opcode));
+#endif
+#ifdef MVRT_PROFILE
+    __atomic_add_fetch(&_eval_count[instr->opcode], 1, __ATOMIC_RELAXED);
+    if (prev_op != -1)
+      __atomic_add_fetch(&_eval_pair_count[prev_op][instr->opcode], 1,
+                         __ATOMIC_RELAXED);
+    prev_op = instr->opcode;
+#endif
 
     next_ip = _eval_instr(instr, ctx);
     if (next_ip == _EVAL_FAILURE) {
-      fprintf(stderr, "Evaluation error at %s.\n", opstr);
+      fprintf(stderr, "Evaluation error at %s.\n", 
+              mvrt_opcode_str(instr->opcode));
       break;
     }
     else if (next_ip == _EVAL_SUSPEND) {
@@ -75,6 +118,11 @@ int _eval_instr(mvrt_instr_t *instr, mvrt_context_t *ctx)
 
   int retval;
   switch (instr->opcode) {
+  case MVRT_OP_NOP:
+    return ip + 1;
+  case MVRT_OP_SLEEP:
+    return _eval_sleep(instr, ctx);
+
   /* arithmetic */
   case MVRT_OP_ADD:
   case MVRT_OP_SUB:
@@ -82,9 +130,35 @@ int _eval_instr(mvrt_instr_t *instr, mvrt_context_t *ctx)
   case MVRT_OP_DIV:
     return _eval_arithmetic(instr, ctx);
 
+  /* logical */
+  case MVRT_OP_NOT:
+  case MVRT_OP_AND:
+  case MVRT_OP_OR:
+    return _eval_logical(instr, ctx);
+
+  /* comparison, predicates */
+  case MVRT_OP_EQ:
+  case MVRT_OP_NE:
+  case MVRT_OP_GT:
+  case MVRT_OP_GE:
+  case MVRT_OP_LT:
+  case MVRT_OP_LE:
+    return _eval_compare(instr, ctx);
+  case MVRT_OP_INTEGER_P:
+  case MVRT_OP_FLOAT_P:
+  case MVRT_OP_STRING_P:
+  case MVRT_OP_MAP_P:
+  case MVRT_OP_FUNCTION_P:
+  case MVRT_OP_EVENT_P:
+    return _eval_predicate(instr, ctx);
+
   /* flow control */
   case MVRT_OP_JMP:
   case MVRT_OP_BEQ:
+  case MVRT_OP_BLT:
+  case MVRT_OP_BLE:
+  case MVRT_OP_BGT:
+  case MVRT_OP_BGE:
   case MVRT_OP_RET:
     return _eval_branch(instr, ctx);
   case MVRT_OP_PUSHN:
@@ -92,12 +166,20 @@ int _eval_instr(mvrt_instr_t *instr, mvrt_context_t *ctx)
   case MVRT_OP_PUSH1:
   case MVRT_OP_PUSHI:
   case MVRT_OP_PUSHS:
+  case MVRT_OP_PUSHIL:
     return _eval_push(instr, ctx);
   case MVRT_OP_POP:
     mvrt_stack_pop(stack);
     return ip + 1;
 
   /* value builder */
+  case MVRT_OP_PAIR_NEW:
+  case MVRT_OP_PAIR_FIRST:
+  case MVRT_OP_PAIR_SECOND:
+    return _eval_pair(instr, ctx);
+  case MVRT_OP_MAP_NEW:
+  case MVRT_OP_MAP_ADD:
+    return _eval_map(instr, ctx);
   case MVRT_OP_CONS_NEW:
   case MVRT_OP_CONS_CAR:
   case MVRT_OP_CONS_CDR:
@@ -110,6 +192,17 @@ int _eval_instr(mvrt_instr_t *instr, mvrt_context_t *ctx)
   case MVRT_OP_GETF:
   case MVRT_OP_SETF:
     return _eval_stackop(instr, ctx);
+  case MVRT_OP_SAVE0:
+  case MVRT_OP_SAVE1:
+  case MVRT_OP_SAVE:
+  case MVRT_OP_LOAD0:
+  case MVRT_OP_LOAD1:
+  case MVRT_OP_LOAD:
+    return _eval_regop(instr, ctx);
+
+  /* events */
+  case MVRT_OP_EVENT_OCCUR:
+    return _eval_event_occur(instr, ctx);
 
   /* properties */
   case MVRT_OP_PROP_GET:
@@ -117,14 +210,34 @@ int _eval_instr(mvrt_instr_t *instr, mvrt_context_t *ctx)
   case MVRT_OP_PROP_SET:
     return _eval_prop_set(instr, ctx);
 
+  /* timers */
+  case MVRT_OP_TIMER_START:
+  case MVRT_OP_TIMER_STOP:
+  case MVRT_OP_TIMER_RESET:
+    return _eval_timer(instr, ctx);
+
   /* function calls */
   case MVRT_OP_CALL_FUNC:
   case MVRT_OP_CALL_FUNC_RET:
     return _eval_call_func(instr, ctx);
+  case MVRT_OP_CALL_NATIVE:
+  case MVRT_OP_CALL_BATCH:
+    return _eval_call_native_n(instr, ctx);
   case MVRT_OP_CALL_RETURN:
     return _eval_call_return(instr, ctx);
   case MVRT_OP_CALL_CONTINUE:
     return _eval_call_continue(instr, ctx);
+
+  /* superinstructions */
+  case MVRT_OP_PROP_GETK:
+  case MVRT_OP_PROP_SETK:
+  case MVRT_OP_GETARGF:
+  case MVRT_OP_CALL_FUNCK:
+  case MVRT_OP_TIMER_STARTK:
+  case MVRT_OP_TIMER_STOPK:
+  case MVRT_OP_TIMER_RESETK:
+  case MVRT_OP_EVENT_OCCURK:
+    return _eval_super(instr, ctx);
   default:
     break;
   }
@@ -170,29 +283,133 @@ int _eval_arithmetic(mvrt_instr_t *instr, mvrt_context_t *ctx)
   return ip + 1;
 }
 
+int _eval_logical(mvrt_instr_t *instr, mvrt_context_t *ctx)
+{
+  mvrt_stack_t *stack = ctx->stack;
+  int ip = ctx->iptr;
+
+  mv_value_t val0 = mvrt_stack_pop(stack);
+  int result;
+  switch (instr->opcode) {
+  case MVRT_OP_NOT:
+    result = !_eval_truth(val0);
+    break;
+  case MVRT_OP_AND:
+    result = _eval_truth(val0) & _eval_truth(mvrt_stack_pop(stack));
+    break;
+  case MVRT_OP_OR:
+    result = _eval_truth(val0) | _eval_truth(mvrt_stack_pop(stack));
+    break;
+  default:
+    assert(0 && "Invalid opcode.");
+    return _EVAL_FAILURE;
+  }
+
+  mvrt_stack_push(stack, mv_value_int(result));
+
+  return ip + 1;
+}
+
+int _eval_compare(mvrt_instr_t *instr, mvrt_context_t *ctx)
+{
+  mvrt_stack_t *stack = ctx->stack;
+  int ip = ctx->iptr;
+
+  mv_value_t val0 = mvrt_stack_pop(stack);
+  mv_value_t val1 = mvrt_stack_pop(stack);
+  int result = _eval_test(instr->opcode, val0, val1);
+  if (result == -1) {
+    fprintf(stderr, "Values are not comparable.\n");
+    return _EVAL_FAILURE;
+  }
+
+  mvrt_stack_push(stack, mv_value_int(result));
+
+  return ip + 1;
+}
+
+int _eval_predicate(mvrt_instr_t *instr, mvrt_context_t *ctx)
+{
+  mvrt_stack_t *stack = ctx->stack;
+  int ip = ctx->iptr;
+
+  mv_value_t val0 = mvrt_stack_pop(stack);
+  mv_vtag_t tag = mv_value_tag(val0);
+  int result = 0;
+  switch (instr->opcode) {
+  case MVRT_OP_INTEGER_P:
+    result = (tag == MV_VALUE_INT);
+    break;
+  case MVRT_OP_FLOAT_P:
+    result = (tag == MV_VALUE_FLOAT);
+    break;
+  case MVRT_OP_STRING_P:
+    result = (tag == MV_VALUE_STRING);
+    break;
+  case MVRT_OP_MAP_P:
+    result = (tag == MV_VALUE_MAP);
+    break;
+  case MVRT_OP_FUNCTION_P:
+    /* a string naming a local function */
+    if (tag == MV_VALUE_STRING) {
+      char *func_s = mv_value_string_get(val0);
+      char *dev_s = _eval_getdev(func_s);
+      result = (!dev_s && mvrt_func_lookup(_eval_getname(func_s)) != NULL);
+      free(dev_s);
+    }
+    break;
+  case MVRT_OP_EVENT_P:
+    /* a string naming a known event */
+    if (tag == MV_VALUE_STRING) {
+      char *event_s = mv_value_string_get(val0);
+      char *dev_s = _eval_getdev(event_s);
+      result = (mvrt_event_lookup(_eval_getname(event_s), dev_s) != NULL);
+      free(dev_s);
+    }
+    break;
+  default:
+    assert(0 && "Invalid opcode.");
+    return _EVAL_FAILURE;
+  }
+
+  mvrt_stack_push(stack, mv_value_int(result));
+
+  return ip + 1;
+}
+
 int _eval_branch(mvrt_instr_t *instr, mvrt_context_t *ctx)
 {
   mvrt_stack_t *stack = ctx->stack;
   int ip = ctx->iptr;
 
   /* 
-     BEQ <branch ip>
+     B[EQ|LT|LE|GT|GE] <branch ip>
 
-     Pop two scalar values from the stack and compare. If they are equal,
-     jump to <branch ip>. Otherwise, just increase the ip by 2.
+     Pop two scalar values from the stack and compare. If "top OP next"
+     holds, jump to <branch ip>. Otherwise, just increase the ip by 1.
    */
   int jmpval;
+  int result;
   mv_value_t val0;
   mv_value_t val1;
   switch (instr->opcode) {
   case MVRT_OP_JMP:
-    jmpval = (int) instr->ptr;
+    jmpval = (int) instr->operand;
     return jmpval;
   case MVRT_OP_BEQ:
-    jmpval = (int) instr->ptr;
+  case MVRT_OP_BLT:
+  case MVRT_OP_BLE:
+  case MVRT_OP_BGT:
+  case MVRT_OP_BGE:
+    jmpval = (int) instr->operand;
     val0 = mvrt_stack_pop(stack);
     val1 = mvrt_stack_pop(stack);
-    if (mv_value_eq(val0, val1))
+    result = _eval_test(instr->opcode, val0, val1);
+    if (result == -1) {
+      fprintf(stderr, "Values are not comparable.\n");
+      return _EVAL_FAILURE;
+    }
+    if (result)
       return jmpval;
     break;
   case MVRT_OP_RET:
@@ -222,17 +439,36 @@ int _eval_push(mvrt_instr_t *instr, mvrt_context_t *ctx)
       mvrt_stack_push(stack, mv_value_null());
     }
     break;
+  case MVRT_OP_PUSH0:
+  case MVRT_OP_PUSH1:
+    {
+      int intval = (instr->opcode == MVRT_OP_PUSH1) ? 1 : 0;
+      mvrt_stack_push(stack, mv_value_int(intval));
+    }
+    break;
   case MVRT_OP_PUSHI:
     {
-      int intval = (int) instr->ptr;
+      int intval = mvrt_instr_simm(instr);
+      mv_value_t intval_v = mv_value_int(intval);
+      mvrt_stack_push(stack, intval_v);
+    }
+    break;
+  case MVRT_OP_PUSHIL:
+    {
+      int intval = (int) mvrt_code_const(ctx->code, instr);
       mv_value_t intval_v = mv_value_int(intval);
       mvrt_stack_push(stack, intval_v);
     }
     break;
   case MVRT_OP_PUSHS:
     {
-      char *strval = (char *) instr->ptr;
-      mv_value_t str_v = mv_value_string(strval);
+      /* the string value is built once, at load time, and freed with the
+         code. Unless the next instruction takes it as a name, it may end
+         up in a property, a map or an event, which outlive the code, so
+         a copy is pushed. */
+      mv_value_t str_v = (mv_value_t) mvrt_code_const(ctx->code, instr);
+      if (ip + 1 >= ctx->code->size || !_eval_takes_name(instr[1].opcode))
+        str_v = mv_value_string(mv_value_string_get(str_v));
       mvrt_stack_push(stack, str_v);
     }
     break;
@@ -242,6 +478,74 @@ int _eval_push(mvrt_instr_t *instr, mvrt_context_t *ctx)
   return ip + 1;
 }
 
+int _eval_pair(mvrt_instr_t *instr, mvrt_context_t *ctx)
+{
+  mvrt_stack_t *stack = ctx->stack;
+  int ip = ctx->iptr;
+
+  mv_value_t val0 = mvrt_stack_pop(stack);
+  mv_value_t val1;
+  switch (instr->opcode) {
+  case MVRT_OP_PAIR_NEW:
+    val1 = mvrt_stack_pop(stack);
+    mvrt_stack_push(stack, mv_value_pair(val0, val1));
+    break;
+  case MVRT_OP_PAIR_FIRST:
+  case MVRT_OP_PAIR_SECOND:
+    if (mv_value_tag(val0) != MV_VALUE_PAIR) {
+      fprintf(stderr, "Value is not a pair.\n");
+      return _EVAL_FAILURE;
+    }
+    if (instr->opcode == MVRT_OP_PAIR_FIRST)
+      mvrt_stack_push(stack, mv_value_pair_first(val0));
+    else
+      mvrt_stack_push(stack, mv_value_pair_second(val0));
+    break;
+  default:
+    assert(0 && "Invalid opcode.");
+    return _EVAL_FAILURE;
+  }
+
+  return ip + 1;
+}
+
+int _eval_map(mvrt_instr_t *instr, mvrt_context_t *ctx)
+{
+  mvrt_stack_t *stack = ctx->stack;
+  int ip = ctx->iptr;
+
+  /*
+     MAP_ADD
+
+     Pop key, value and map from the stack, and push the map with the
+     binding added.
+   */
+  mv_value_t key_v;
+  mv_value_t value_v;
+  mv_value_t map_v;
+  switch (instr->opcode) {
+  case MVRT_OP_MAP_NEW:
+    mvrt_stack_push(stack, mv_value_map());
+    break;
+  case MVRT_OP_MAP_ADD:
+    key_v = mvrt_stack_pop(stack);
+    value_v = mvrt_stack_pop(stack);
+    map_v = mvrt_stack_pop(stack);
+    if (mv_value_tag(map_v) != MV_VALUE_MAP) {
+      fprintf(stderr, "Value is not a map.\n");
+      return _EVAL_FAILURE;
+    }
+    mv_value_map_add(map_v, key_v, value_v);
+    mvrt_stack_push(stack, map_v);
+    break;
+  default:
+    assert(0 && "Invalid opcode.");
+    return _EVAL_FAILURE;
+  }
+
+  return ip + 1;
+}
+
 int _eval_cons(mvrt_instr_t *instr, mvrt_context_t *ctx)
 {
   mvrt_stack_t *stack = ctx->stack;
@@ -324,6 +628,134 @@ int _eval_stackop(mvrt_instr_t *instr, mvrt_context_t *ctx)
   return ip + 1;
 }
 
+int _eval_regop(mvrt_instr_t *instr, mvrt_context_t *ctx)
+{
+  mvrt_stack_t *stack = ctx->stack;
+  int ip = ctx->iptr;
+
+  /*
+     SAVE <n>, LOAD <n>
+
+     Move the stack top to temporary n, or push temporary n. The verifier
+     has checked that n < code->nregs.
+   */
+  switch (instr->opcode) {
+  case MVRT_OP_SAVE0:
+    ctx->regs[0] = mvrt_stack_pop(stack);
+    break;
+  case MVRT_OP_SAVE1:
+    ctx->regs[1] = mvrt_stack_pop(stack);
+    break;
+  case MVRT_OP_SAVE:
+    ctx->regs[instr->operand] = mvrt_stack_pop(stack);
+    break;
+  case MVRT_OP_LOAD0:
+    mvrt_stack_push(stack, ctx->regs[0]);
+    break;
+  case MVRT_OP_LOAD1:
+    mvrt_stack_push(stack, ctx->regs[1]);
+    break;
+  case MVRT_OP_LOAD:
+    mvrt_stack_push(stack, ctx->regs[instr->operand]);
+    break;
+  default:
+    assert(0 && "Invalid opcode.");
+    return _EVAL_FAILURE;
+  }
+
+  return ip + 1;
+}
+
+int _eval_sleep(mvrt_instr_t *instr, mvrt_context_t *ctx)
+{
+  mvrt_stack_t *stack = ctx->stack;
+  int ip = ctx->iptr;
+
+  /*
+     SLEEP
+
+     Pop msec from the stack and sleep. This blocks the scheduler, so use
+     a oneshot timer for anything longer than a short delay.
+   */
+  mv_value_t msec_v = mvrt_stack_pop(stack);
+  if (mv_value_tag(msec_v) != MV_VALUE_INT) {
+    fprintf(stderr, "SLEEP requires an integer.\n");
+    return _EVAL_FAILURE;
+  }
+
+  int msec = mv_value_int_get(msec_v);
+  if (msec > 0) {
+    struct timespec ts;
+    ts.tv_sec = msec / 1000;
+    ts.tv_nsec = (msec % 1000) * 1000000;
+    nanosleep(&ts, NULL);
+  }
+
+  return ip + 1;
+}
+
+int _eval_event_occur(mvrt_instr_t *instr, mvrt_context_t *ctx)
+{
+  mvrt_stack_t *stack = ctx->stack;
+  int ip = ctx->iptr;
+
+  /*
+     EVENT_OCCUR
+
+     Pop the event name and the event value from the stack, and raise the
+     event. A local event is put to the event queue; an event of another
+     device is sent to that device.
+   */
+  mv_value_t event_v = mvrt_stack_pop(stack);
+  mv_value_t value_v = mvrt_stack_pop(stack);
+  char *event_s = mv_value_string_get(event_v);
+
+  char *dev_s = _eval_getdev(event_s);
+  char *name_s = _eval_getname(event_s);
+
+  if (dev_s) {
+    static char arg[4096];
+    const char *destaddr = mv_device_addrstr(dev_s);
+    if (!destaddr) {
+      free(dev_s);
+      return _EVAL_FAILURE;
+    }
+    sprintf(arg, "{\"name\":\"%s\", \"value\":%s}",
+            name_s, mv_value_to_str(value_v));
+    fprintf(stdout, "MQSEND: EVENT_OCCUR %s\n", arg);
+    mv_message_send(destaddr, MV_MESSAGE_EVENT_OCCUR, arg);
+
+    free(dev_s);
+    return ip + 1;
+  }
+
+  mvrt_event_t *event = mvrt_event_lookup(name_s, NULL);
+  if (!event) {
+    fprintf(stderr, "No such event: %s.\n", name_s);
+    return _EVAL_FAILURE;
+  }
+
+  if (_eval_event_raise(event, value_v) == -1)
+    return _EVAL_FAILURE;
+
+  return ip + 1;
+}
+
+/* Puts an instance of the local event to the current event queue. */
+int _eval_event_raise(mvrt_event_t *event, mv_value_t value)
+{
+  /* we run on the thread draining the queue, so never wait for room */
+  mvrt_evqueue_t *evq = mvrt_evqueue_getcurrent();
+  if (!evq || mvrt_evqueue_full(evq)) {
+    fprintf(stderr, "Event queue full: %s dropped.\n", 
+            ((mvrt_obj_t *) event)->name);
+    return -1;
+  }
+  mvrt_evqueue_put(evq, mvrt_eventinst_new(event, value));
+
+  return 0;
+}
+
 int _eval_prop_get(mvrt_instr_t *instr, mvrt_context_t *ctx)
 {
   mvrt_stack_t *stack = ctx->stack;
@@ -337,7 +769,11 @@ int _eval_prop_get(mvrt_instr_t *instr, mvrt_context_t *ctx)
 
   if (dev_s) {
     static char arg[4096];
-    const char *destaddr = mv_device_addr(dev_s);
+    const char *destaddr = mv_device_addrstr(dev_s);
+    if (!destaddr) {
+      free(dev_s);
+      return _EVAL_FAILURE;
+    }
     int retid = mvrt_continuation_new(ctx);
     sprintf(arg, "{\"name\":\"%s\", \"retid\":%d, \"retaddr\":\"%s\"}",
             name_s, retid, mv_message_selfaddr());
@@ -347,26 +783,51 @@ int _eval_prop_get(mvrt_instr_t *instr, mvrt_context_t *ctx)
     free(dev_s);
     return _EVAL_SUSPEND;
   }
+  else if (strchr(name_s, ',')) {
+    /* batched read, as sent by mvc for several properties of a device */
+    mvrt_stack_push(stack, _eval_prop_batch(name_s));
+    return ip + 1;
+  }
   else {
     /* local prop */
-    mvrt_prop_t *mvprop = mvrt_prop_lookup(name_s);
-    if (mvprop) {
-      mv_value_t value_v = mvrt_prop_getvalue(mvprop);
-      mvrt_stack_push(stack, value_v);
-      
-#if 0
-      fprintf(stdout, "\t=> PROP_GET: "); mv_value_print(value_v);
-#endif
-    }
-    else {
-      /* failed to find the property; process error */
-      mv_value_t value_v = mv_value_string("E:NO_SUCH_PROP");
-      mvrt_stack_push(stack, value_v);
-    }
+    mvrt_stack_push(stack, _eval_prop_value(name_s));
     return ip + 1;
   }
 }
 
+/* Returns the value of the local property, or "E:NO_SUCH_PROP". */
+mv_value_t _eval_prop_value(const char *name)
+{
+  mvrt_prop_t *mvprop = mvrt_prop_lookup(name);
+  if (!mvprop)
+    return mv_value_string("E:NO_SUCH_PROP");
+
+  return mvrt_prop_getvalue(mvprop);
+}
+
+/* Returns a map from each name of "name1,name2,..." to the value of the
+   local property. */
+mv_value_t _eval_prop_batch(const char *names)
+{
+  char name[256];
+  mv_value_t map_v = mv_value_map();
+
+  const char *p = names;
+  while (*p) {
+    size_t len = strcspn(p, ",");
+    if (len > 0 && len < sizeof(name)) {
+      memcpy(name, p, len);
+      name[len] = '\0';
+      mv_value_map_add(map_v, mv_value_string(name), _eval_prop_value(name));
+    }
+    p += len;
+    if (*p == ',')
+      p++;
+  }
+
+  return map_v;
+}
+
 int _eval_prop_set(mvrt_instr_t *instr, mvrt_context_t *ctx)
 {
   mvrt_stack_t *stack = ctx->stack;
@@ -386,6 +847,121 @@ int _eval_prop_set(mvrt_instr_t *instr, mvrt_context_t *ctx)
   return ip + 1;
 }
 
+int _eval_super(mvrt_instr_t *instr, mvrt_context_t *ctx)
+{
+  mvrt_stack_t *stack = ctx->stack;
+  int ip = ctx->iptr;
+
+  /*
+     Superinstructions carry a reference to the local object as operand,
+     so no string is pushed, split or looked up here unless an object was
+     added or deleted since the reference was last bound.
+   */
+  if (instr->opcode == MVRT_OP_GETARGF) {
+    mv_value_t key_v = (mv_value_t) mvrt_code_const(ctx->code, instr);
+    mvrt_stack_push(stack, mv_value_map_lookup(ctx->arg, key_v));
+    return ip + 1;
+  }
+
+  mvrt_ref_t *ref = (mvrt_ref_t *) mvrt_code_const(ctx->code, instr);
+  mvrt_obj_t *obj = mvrt_ref_get(ref);
+  mv_value_t value_v;
+  switch (instr->opcode) {
+  case MVRT_OP_PROP_GETK:
+    if (obj)
+      value_v = mvrt_prop_getvalue((mvrt_prop_t *) obj);
+    else
+      value_v = mv_value_string("E:NO_SUCH_PROP");
+    mvrt_stack_push(stack, value_v);
+    break;
+  case MVRT_OP_PROP_SETK:
+    value_v = mvrt_stack_pop(stack);
+    if (!obj || mvrt_prop_setvalue((mvrt_prop_t *) obj, value_v) == -1) {
+      fprintf(stderr, "PROP_SET failed: %s.\n", ref->name);
+      return _EVAL_FAILURE;
+    }
+    break;
+  case MVRT_OP_CALL_FUNCK:
+    value_v = mvrt_stack_pop(stack);
+    if (!obj || !mvrt_func_isnative((mvrt_func_t *) obj)) {
+      fprintf(stderr, "No such native function: %s.\n", ref->name);
+      return _EVAL_FAILURE;
+    }
+    return _eval_call_native((mvrt_func_t *) obj, value_v, ctx);
+  case MVRT_OP_TIMER_STARTK:
+  case MVRT_OP_TIMER_STOPK:
+  case MVRT_OP_TIMER_RESETK:
+    if (!obj) {
+      fprintf(stderr, "No such timer: %s.\n", ref->name);
+      return _EVAL_FAILURE;
+    }
+    if (_eval_timer_apply(instr->opcode, (mvrt_event_t *) obj) == -1)
+      return _EVAL_FAILURE;
+    break;
+  case MVRT_OP_EVENT_OCCURK:
+    value_v = mvrt_stack_pop(stack);
+    if (!obj) {
+      fprintf(stderr, "No such event: %s.\n", ref->name);
+      return _EVAL_FAILURE;
+    }
+    if (_eval_event_raise((mvrt_event_t *) obj, value_v) == -1)
+      return _EVAL_FAILURE;
+    break;
+  default:
+    assert(0 && "Invalid opcode.");
+    return _EVAL_FAILURE;
+  }
+
+  return ip + 1;
+}
+
+int _eval_timer(mvrt_instr_t *instr, mvrt_context_t *ctx)
+{
+  mvrt_stack_t *stack = ctx->stack;
+  int ip = ctx->iptr;
+
+  /*
+     TIMER_[START|STOP|RESET]
+
+     Pop the name of a local timer from the stack and start, stop, or 
+     restart it.
+   */
+  mv_value_t timer_v = mvrt_stack_pop(stack);
+  char *timer_s = mv_value_string_get(timer_v);
+
+  mvrt_event_t *timer = mvrt_event_lookup(timer_s, NULL);
+  if (!timer) {
+    fprintf(stderr, "No such timer: %s.\n", timer_s);
+    return _EVAL_FAILURE;
+  }
+
+  if (_eval_timer_apply(instr->opcode, timer) == -1)
+    return _EVAL_FAILURE;
+
+  return ip + 1;
+}
+
+/* Starts, stops or restarts the timer, for TIMER_* and TIMER_*K. */
+int _eval_timer_apply(int op, mvrt_event_t *timer)
+{
+  switch (op) {
+  case MVRT_OP_TIMER_START:
+  case MVRT_OP_TIMER_STARTK:
+    return mvrt_timer_start(timer);
+  case MVRT_OP_TIMER_STOP:
+  case MVRT_OP_TIMER_STOPK:
+    return mvrt_timer_stop(timer);
+  case MVRT_OP_TIMER_RESET:
+  case MVRT_OP_TIMER_RESETK:
+    return mvrt_timer_reset(timer);
+  default:
+    break;
+  }
+
+  assert(0 && "Invalid opcode.");
+  return -1;
+}
+
 int _eval_call_local(mvrt_instr_t *instr, mvrt_context_t *ctx)
 {
   mvrt_stack_t *stack = ctx->stack;
@@ -433,7 +1009,11 @@ int _eval_call_func(mvrt_instr_t *instr, mvrt_context_t *ctx)
     }
   }
 
-  const char *destaddr = mv_device_addr(dev_s);
+  const char *destaddr = mv_device_addrstr(dev_s);
+  if (!destaddr) {
+    free(dev_s);
+    return _EVAL_FAILURE;
+  }
   mvrt_native_t *native = NULL;
 
   static char arg[4096];
@@ -471,54 +1051,86 @@ int _eval_call_native(mvrt_func_t *f, mv_value_t farg_v,  mvrt_context_t *ctx)
 
   mvrt_native_t *native = mvrt_func_getnative(f);
 
-  /* get function */
-  if (!native->func1) {
-    void *handle = dlopen(native->lib, RTLD_NOW);
-    if (!handle) {
-      fprintf(stderr, "%s\n", dlerror());
-      exit(EXIT_FAILURE);
-    }
-    char *name = native->name;
-    native->func1 = (mvrt_native_func1_t) dlsym(handle, name);
-    native->func2 = (mvrt_native_func2_t) dlsym(handle, name);
-  }
-
-  /* prepare args */
-  int nargs = 0;
-  int arg1 = 0;
-  int arg2 = 0;
-  if (mv_value_tag(farg_v) == MV_VALUE_CONS) {
-    /* two integers */
-    nargs = 2;
-    mv_value_t car = mv_value_cons_car((mv_value_t) farg_v);
+  /* call_func passes a single argument. Legacy natives taking two 
+     integers get them as a pair (cons). */
+  mv_value_t argv[2];
+  int argc = 1;
+  argv[0] = farg_v;
+  if (native->conv == MVRT_NATIVE_LEGACY 
+      && mv_value_tag(farg_v) == MV_VALUE_CONS) {
     mv_value_t cdr = mv_value_cons_cdr((mv_value_t) farg_v);
-    mv_value_t cdar = mv_value_cons_car((mv_value_t) cdr);
-    arg2 = mv_value_int_get(car);
-    arg1 = mv_value_int_get(cdar);
-    fprintf(stdout, "arg1 = %d, arg2 = %d\n", arg1, arg2);
-    
+    argv[0] = mv_value_cons_car((mv_value_t) cdr);
+    argv[1] = mv_value_cons_car((mv_value_t) farg_v);
+    argc = 2;
   }
-  else {
-    /* integer */
-    nargs = 1;
-    arg1 = mv_value_int_get(farg_v);
-    fprintf(stdout, "arg1 = %d\n", arg1);
+  else if (native->conv == MVRT_NATIVE_TYPED && native->nargs == 0) {
+    argc = 0;
   }
 
-  /* call function */
-  int retval = 0;
-  if (nargs == 1) {
-    retval = (native->func1)(arg1);
+  mv_value_t retval_v;
+  if (mvrt_native_call(native, argc, argv, &retval_v) == -1) {
+    fprintf(stderr, "Native call failed: %s.\n", native->name);
+    return _EVAL_FAILURE;
+  }
+  mvrt_stack_push(stack, retval_v);
+
+  return ip + 1;
+}
+
+int _eval_call_native_n(mvrt_instr_t *instr, mvrt_context_t *ctx)
+{
+  mvrt_stack_t *stack = ctx->stack;
+  int ip = ctx->iptr;
+
+  /*
+     CALL_NATIVE n
+     CALL_BATCH n
+
+     Pop the name of a local native function, and call it with the n 
+     values below it, the first pushed being the first argument. The 
+     arguments are passed in place on the stack. CALL_NATIVE replaces
+     the arguments with the return value, and CALL_BATCH replaces each
+     argument with its result.
+   */
+  mv_value_t fnam_v = mvrt_stack_pop(stack);
+  int argc = (int) instr->operand;
+  mvrt_native_t *native = _eval_native_lookup(mv_value_string_get(fnam_v));
+  if (!native)
+    return _EVAL_FAILURE;
+
+  mv_value_t *argv = &stack->values[stack->sptr - argc + 1];
+  if (instr->opcode == MVRT_OP_CALL_BATCH) {
+    if (mvrt_native_call_batch(native, argc, argv) == -1) {
+      fprintf(stderr, "Native call failed: %s.\n", native->name);
+      return _EVAL_FAILURE;
+    }
+    return ip + 1;
   }
-  else
-    (native->func2)(arg1, arg2);
 
-  mv_value_t retval_v = mv_value_int(retval);
+  mv_value_t retval_v;
+  if (mvrt_native_call(native, argc, argv, &retval_v) == -1) {
+    fprintf(stderr, "Native call failed: %s.\n", native->name);
+    return _EVAL_FAILURE;
+  }
+  stack->sptr -= argc;
   mvrt_stack_push(stack, retval_v);
 
   return ip + 1;
 }
 
+/* Returns the local native function with the given name, or NULL. */
+mvrt_native_t *_eval_native_lookup(const char *name)
+{
+  mvrt_obj_t *obj = mvrt_obj_lookup(name, NULL);
+  if (!obj || obj->tag != MVRT_OBJ_FUNC 
+      || !mvrt_func_isnative((mvrt_func_t *) obj)) {
+    fprintf(stderr, "No such native function: %s.\n", name);
+    return NULL;
+  }
+
+  return mvrt_func_getnative((mvrt_func_t *) obj);
+}
+
 int _eval_call_return(mvrt_instr_t *instr, mvrt_context_t *ctx)
 {
   mvrt_stack_t *stack = ctx->stack;
@@ -559,6 +1171,30 @@ int _eval_call_continue(mvrt_instr_t *instr, mvrt_context_t *ctx)
   return ip + 1;
 }
 
+/* Returns 1 if the operation pops a string from the stack top, and only
+   uses it as a name or a key, without keeping it. */
+int _eval_takes_name(int op)
+{
+  switch (op) {
+  case MVRT_OP_PROP_GET:
+  case MVRT_OP_PROP_SET:
+  case MVRT_OP_EVENT_OCCUR:
+  case MVRT_OP_CALL_FUNC:
+  case MVRT_OP_CALL_FUNC_RET:
+  case MVRT_OP_TIMER_START:
+  case MVRT_OP_TIMER_STOP:
+  case MVRT_OP_TIMER_RESET:
+  case MVRT_OP_GETF:
+  case MVRT_OP_EVENT_P:
+  case MVRT_OP_FUNCTION_P:
+    return 1;
+  default:
+    break;
+  }
+
+  return 0;
+}
+
 /* Returns the first part of "dev:name". Caller is responsible to deallocate
    the returned string. */
 char *_eval_getdev(char *s)
@@ -588,6 +1224,90 @@ char *_eval_getname(char *s)
   return s;
 }
 
+/* Returns 1 if "u OP v" holds, 0 if not, and -1 if u and v cannot be
+   compared with OP. Integers take the fast path; an integer and a float
+   are compared as doubles, strings lexicographically. Values of 
+   different kinds are never equal. */
+int _eval_test(int op, mv_value_t u, mv_value_t v)
+{
+  mv_vtag_t utag = mv_value_tag(u);
+  mv_vtag_t vtag = mv_value_tag(v);
+  int cmp;
+
+  if (utag == MV_VALUE_INT && vtag == MV_VALUE_INT) {
+    int ui = mv_value_int_get(u);
+    int vi = mv_value_int_get(v);
+    cmp = (ui > vi) - (ui < vi);
+  }
+  else if ((utag == MV_VALUE_INT || utag == MV_VALUE_FLOAT)
+           && (vtag == MV_VALUE_INT || vtag == MV_VALUE_FLOAT)) {
+    /* in double, which holds every int exactly: in float, 16777217 would
+       equal 16777216.0 */
+    double ud = (utag == MV_VALUE_INT) 
+      ? (double) mv_value_int_get(u) : (double) mv_value_float_get(u);
+    double vd = (vtag == MV_VALUE_INT) 
+      ? (double) mv_value_int_get(v) : (double) mv_value_float_get(v);
+    cmp = (ud > vd) - (ud < vd);
+  }
+  else if (utag == MV_VALUE_STRING && vtag == MV_VALUE_STRING) {
+    cmp = strcmp(mv_value_string_get(u), mv_value_string_get(v));
+  }
+  else if (utag == MV_VALUE_NULL && vtag == MV_VALUE_NULL) {
+    cmp = 0;
+  }
+  else {
+    if (op == MVRT_OP_EQ || op == MVRT_OP_BEQ)
+      return 0;
+    else if (op == MVRT_OP_NE)
+      return 1;
+    return -1;
+  }
+
+  switch (op) {
+  case MVRT_OP_EQ:
+  case MVRT_OP_BEQ:
+    return cmp == 0;
+  case MVRT_OP_NE:
+    return cmp != 0;
+  case MVRT_OP_LT:
+  case MVRT_OP_BLT:
+    return cmp < 0;
+  case MVRT_OP_LE:
+  case MVRT_OP_BLE:
+    return cmp <= 0;
+  case MVRT_OP_GT:
+  case MVRT_OP_BGT:
+    return cmp > 0;
+  case MVRT_OP_GE:
+  case MVRT_OP_BGE:
+    return cmp >= 0;
+  default:
+    break;
+  }
+
+  assert(0 && "Invalid opcode.");
+  return -1;
+}
+
+/* Returns 0 for null, zero, and the empty string, and 1 otherwise. */
+int _eval_truth(mv_value_t v)
+{
+  switch (mv_value_tag(v)) {
+  case MV_VALUE_NULL:
+    return 0;
+  case MV_VALUE_INT:
+    return mv_value_int_get(v) != 0;
+  case MV_VALUE_FLOAT:
+    return mv_value_float_get(v) != 0.0;
+  case MV_VALUE_STRING:
+    return mv_value_string_get(v)[0] != '\0';
+  default:
+    break;
+  }
+
+  return 1;
+}
+
 
 /*
  * Functions for the eval interface.
@@ -600,11 +1320,17 @@ int mvrt_eval_reactor(mvrt_reactor_t *reactor, mvrt_eventinst_t *evinst)
   /* Create a new context
      . code
      . iptr = 0
-     . stack is newly created with the evdata as its only element
+     . stack is newly created with the evdata as its only element, and 
+       sized to the max depth found by the verifier
   */
-  mvrt_context_t *ctx = mvrt_context_new(mvrt_reactor_getcode(reactor));
+  mvrt_code_t *code = mvrt_reactor_getcode(reactor);
+  if (!code) {
+    fprintf(stderr, "Reactor has no code to evaluate.\n");
+    return _EVAL_FAILURE;
+  }
+  mvrt_context_t *ctx = mvrt_context_new(code);
   ctx->iptr = 0;
-  ctx->stack = mvrt_stack_new();
+  ctx->stack = mvrt_stack_new(ctx->code->maxstack);
   ctx->arg = evdata;
   mvrt_stack_push(ctx->stack, evdata);
   
@@ -616,3 +1342,29 @@ int mvrt_eval_reactor(mvrt_reactor_t *reactor, mvrt_eventinst_t *evinst)
   return retval;
 }
 
+void mvrt_eval_profile_print(FILE *fp)
+{
+#ifdef MVRT_PROFILE
+  int op;
+  int next;
+  unsigned long n;
+  fprintf(fp, "# opcode counts\n");
+  for (op = 0; op < MVRT_OP_NTAGS; op++) {
+    n = __atomic_load_n(&_eval_count[op], __ATOMIC_RELAXED);
+    if (n > 0)
+      fprintf(fp, "%-14s %lu\n", mvrt_opcode_str(op), n);
+  }
+
+  fprintf(fp, "# pair counts\n");
+  for (op = 0; op < MVRT_OP_NTAGS; op++) {
+    for (next = 0; next < MVRT_OP_NTAGS; next++) {
+      n = __atomic_load_n(&_eval_pair_count[op][next], __ATOMIC_RELAXED);
+      if (n > 0)
+        fprintf(fp, "%-14s %-14s %lu\n", mvrt_opcode_str(op),
+                mvrt_opcode_str(next), n);
+    }
+  }
+#else
+  fprintf(fp, "Profile not available -- build with -DMVRT_PROFILE.\n");
+#endif
+}
@@ -6,10 +6,16 @@
 #ifndef MVRT_EVAL_H
 #define MVRT_EVAL_H
 
+#include <stdio.h>     /* FILE */
 #include "rtevent.h"
 #include "rtreactor.h"
 
 /* Evalute the given reactor. */
 extern int mvrt_eval_reactor(mvrt_reactor_t *reactor, mvrt_eventinst_t *ev);
 
+/* Print the number of evaluations of each opcode and of each pair of 
+   consecutive opcodes. Counting is compiled in with -DMVRT_PROFILE. mvrt
+   prints them on SIGUSR2. */
+extern void mvrt_eval_profile_print(FILE *fp);
+
 #endif /* MVRT_EVAL_H */
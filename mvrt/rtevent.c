@@ -7,10 +7,13 @@
 #include <assert.h>       /* assert */
 #include <signal.h>       /* sigaction */
 #include <time.h>         /* timer_settime */
+#include <unistd.h>       /* getpid */
+#include <pthread.h>      /* pthread_sigmask */
 #include <mv/device.h>    /* mv_device_self */
 #include <mv/value.h>     /* mv_value_t */
 #include "rtevqueue.h"    /* mvrt_evqueue_instance */
 #include "rtevent.h"      /* mvrt_event_t */
+#include "rtreactor.h"    /* mvrt_remove_reactor_from_event */
 #include "rtobj.h"
 
 
@@ -19,67 +22,163 @@ typedef struct _rtimer {
   timer_t timerid;        /* timer */
   size_t sec;             /* interval sec */
   size_t nsec;            /* interval nsec */
+  size_t jitter;          /* max phase jitter in msec */
+  size_t phase;           /* phase offset chosen from jitter, in nsec */
   mvrt_event_t *rtev;     /* back pointer to mvrt_event_t */
+  unsigned mode    : 1;   /* MVRT_TIMER_PERIODIC or MVRT_TIMER_ONESHOT */
+  unsigned missed  : 2;   /* MVRT_TIMER_SKIP, etc. */
   unsigned stopped : 1;   /* timer is stopped */
   unsigned used    : 1;   /* used */
-  unsigned pad     : 30;  /* pad */
+  unsigned pad     : 27;  /* pad */
 } _rtimer_t;
 static _rtimer_t _rtimer_table[MAX_RTIMER_TABLE];
 
-static _rtimer_t *_rtimer_new(size_t sec, size_t nsec);
+static _rtimer_t *_rtimer_new(size_t sec, size_t nsec, int mode, 
+                              size_t jitter, int missed);
 static int _rtimer_delete(_rtimer_t *timer);
+static int _rtimer_arm(_rtimer_t *rtimer);
+static int _rtimer_disarm(_rtimer_t *rtimer);
+static int _rtimer_armed(_rtimer_t *rtimer);
 static void _rtimer_handler(int sig, siginfo_t *sinfo, void *uc);
 
 static int __rtevent_tokenize(char *line, char **, char **, char **, char **);
 static _rtimer_t *_rtevent_parse(char *line, char **type, char **name);
 
 
-static size_t _rtimerid = 0;
-_rtimer_t *_rtimer_new(size_t sec, size_t nsec)
+_rtimer_t *_rtimer_new(size_t sec, size_t nsec, int mode, size_t jitter,
+                       int missed)
 {
+  static unsigned seed = 0;
   struct sigevent sev;
-  struct itimerspec its;
+  struct timespec now;
 
-  /* TODO: reused empty spot in the table */
-  if (_rtimerid == MAX_RTIMER_TABLE) {
+  _rtimer_t *rtimer = NULL;
+  int i;
+  for (i = 0; i < MAX_RTIMER_TABLE; i++) {
+    if (!_rtimer_table[i].used) {
+      rtimer = _rtimer_table + i;
+      break;
+    }
+  }
+  if (!rtimer) {
     fprintf(stderr, "Cannot create more timers.\n");
     return NULL;
   }
-  _rtimer_t *rtimer = _rtimer_table + _rtimerid++;
 
   sev.sigev_notify = SIGEV_SIGNAL;
   sev.sigev_signo = SIGRTMIN;
-  sev.sigev_value.sival_ptr = &rtimer->timerid;
-
-  timer_create(CLOCK_REALTIME, &sev, &rtimer->timerid);
+  sev.sigev_value.sival_ptr = rtimer;
 
-  its.it_interval.tv_sec = sec;
-  its.it_interval.tv_nsec = nsec;
-  its.it_value.tv_sec = sec;
-  its.it_value.tv_nsec = nsec;
-
-  timer_settime(rtimer->timerid, 0, &its, NULL);
+  /* CLOCK_MONOTONIC is not affected by wall-clock adjustments, so the 
+     period does not drift when the device time is set by NTP, etc. */
+  if (timer_create(CLOCK_MONOTONIC, &sev, &rtimer->timerid) == -1) {
+    perror("timer_create@_rtimer_new");
+    return NULL;
+  }
 
   rtimer->sec = sec;
   rtimer->nsec = nsec;
+  rtimer->jitter = jitter;
+  rtimer->mode = mode;
+  rtimer->missed = missed;
+  rtimer->rtev = NULL;
+
+  /* Choose a random phase offset once, so that devices which load the
+     same timer definition do not all fire at the same instant. */
+  rtimer->phase = 0;
+  if (jitter > 0) {
+    if (!seed) {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      seed = (unsigned) now.tv_nsec ^ (unsigned) getpid();
+    }
+    rtimer->phase = (size_t) (rand_r(&seed) % jitter) * 1000000;
+  }
+
   rtimer->stopped = 0;
   rtimer->used = 1;
 
+  if (_rtimer_arm(rtimer) == -1) {
+    _rtimer_delete(rtimer);
+    return NULL;
+  }
+
   return rtimer;
 }
 
 int _rtimer_delete(_rtimer_t *rtimer)
 {
-  /* TODO: do real deletion */
   rtimer->stopped = 1;
   rtimer->used = 0;
+
+  if (timer_delete(rtimer->timerid) == -1) {
+    perror("timer_delete@_rtimer_delete");
+    return -1;
+  }
+
+  return 0;
+}
+
+/* (Re)starts the kernel timer from now. The first expiration is delayed
+   by the phase offset. */
+int _rtimer_arm(_rtimer_t *rtimer)
+{
+  struct itimerspec its;
+
+  size_t first_ns = rtimer->nsec + rtimer->phase;
+  its.it_value.tv_sec = rtimer->sec + first_ns / 1000000000;
+  its.it_value.tv_nsec = first_ns % 1000000000;
+  if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+    /* zero it_value disarms the timer: fire as soon as possible */
+    its.it_value.tv_nsec = 1;
+  }
+
+  if (rtimer->mode == MVRT_TIMER_ONESHOT) {
+    its.it_interval.tv_sec = 0;
+    its.it_interval.tv_nsec = 0;
+  }
+  else {
+    its.it_interval.tv_sec = rtimer->sec;
+    its.it_interval.tv_nsec = rtimer->nsec;
+  }
+
+  if (timer_settime(rtimer->timerid, 0, &its, NULL) == -1) {
+    perror("timer_settime@_rtimer_arm");
+    return -1;
+  }
+
+  return 0;
+}
+
+int _rtimer_disarm(_rtimer_t *rtimer)
+{
+  struct itimerspec its;
+  memset(&its, 0x0, sizeof(its));
+
+  if (timer_settime(rtimer->timerid, 0, &its, NULL) == -1) {
+    perror("timer_settime@_rtimer_disarm");
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Returns 1 if the kernel timer is armed, 0 if not: stopped, or a oneshot
+   timer which has fired. */
+int _rtimer_armed(_rtimer_t *rtimer)
+{
+  struct itimerspec its;
+
+  if (timer_gettime(rtimer->timerid, &its) == -1) {
+    perror("timer_gettime@_rtimer_armed");
+    return 0;
+  }
+
+  return its.it_value.tv_sec != 0 || its.it_value.tv_nsec != 0;
 }
 
 extern mvrt_evqueue_t *mvrt_evqueue_getcurrent();
 static void _rtimer_handler(int sig, siginfo_t *sinfo, void *uc)
 {
-  int i;
-  timer_t *tid;
   _rtimer_t *rtimer;
 
 #if 0  
@@ -91,22 +190,35 @@ static void _rtimer_handler(int sig, siginfo_t *sinfo, void *uc)
   ts.tv_nsec = 1000; 
   
   mvrt_evqueue_t *evq = mvrt_evqueue_getcurrent();
-  tid = sinfo->si_value.sival_ptr;
-  for (i = 0; i < _rtimerid; i++) {
-    rtimer = _rtimer_table + i;
-    if (*tid == rtimer->timerid) {
-      mvrt_event_t *rtev = rtimer->rtev;
-      if (rtimer->stopped)
-        continue;
+  rtimer = (_rtimer_t *) sinfo->si_value.sival_ptr;
+  if (!rtimer || !rtimer->used || rtimer->stopped || !rtimer->rtev)
+    return;
+
+  /* number of ticks which expired since the last delivered signal */
+  int overrun = timer_getoverrun(rtimer->timerid);
+  int nticks = (overrun > 0) ? overrun + 1 : 1;
+
+  int nevents = 1;
+  mv_value_t evdata = mv_value_null();
+  switch (rtimer->missed) {
+  case MVRT_TIMER_CATCHUP:
+    nevents = nticks;
+    break;
+  case MVRT_TIMER_COALESCE:
+    evdata = mv_value_int(nticks);
+    break;
+  case MVRT_TIMER_SKIP:
+  default:
+    break;
+  }
 
-      mv_value_t evdata = mv_value_null();
-      mvrt_eventinst_t *ev = mvrt_eventinst_new(rtev, evdata);
+  while (nevents-- > 0) {
+    mvrt_eventinst_t *ev = mvrt_eventinst_new(rtimer->rtev, evdata);
 
-      while (mvrt_evqueue_full(evq))
-        nanosleep(&ts, NULL);
+    while (mvrt_evqueue_full(evq))
+      nanosleep(&ts, NULL);
 
-      mvrt_evqueue_put(evq, ev);
-    }
+    mvrt_evqueue_put(evq, ev);
   }
 }
 
@@ -144,13 +256,16 @@ int _rtevent_tokenize(char *line, char **type, char **name, char **s, char **ns)
 
 /* In case the line specifies a timer, it returns a valid rtimer struct
    on success -- otherwise, returns NULL. In case the line specifies an
-   event, the type points to string "event" -- otherwise, sets type to NULL. */
+   event, the type points to string "event". On failure, including a timer
+   which cannot be created, sets type to NULL. */
 _rtimer_t *_rtevent_parse(char *line, char **type, char **name)
 {
   /* event ev0
      event ev1
      timer timer0 1 1000
      timer timer1 0 1000000
+     timer timer2 5 0 oneshot
+     timer timer3 60 0 jitter 5000 coalesce
   */
 
   char *arg0;
@@ -162,8 +277,44 @@ _rtimer_t *_rtevent_parse(char *line, char **type, char **name)
   }
 
   _rtimer_t *rtimer = NULL;
-  if (!strcmp(*type, "timer"))
-    rtimer = _rtimer_new(atoi(arg0), atoi(arg1));
+  if (!strcmp(*type, "timer")) {
+    /* optional timer attributes */
+    int mode = MVRT_TIMER_PERIODIC;
+    int missed = MVRT_TIMER_SKIP;
+    size_t jitter = 0;
+    char *token;
+    while ((token = strtok(NULL, " \t")) != NULL) {
+      if (token[0] == '#')
+        break;
+      else if (!strcmp(token, "oneshot"))
+        mode = MVRT_TIMER_ONESHOT;
+      else if (!strcmp(token, "periodic"))
+        mode = MVRT_TIMER_PERIODIC;
+      else if (!strcmp(token, "skip"))
+        missed = MVRT_TIMER_SKIP;
+      else if (!strcmp(token, "catchup"))
+        missed = MVRT_TIMER_CATCHUP;
+      else if (!strcmp(token, "coalesce"))
+        missed = MVRT_TIMER_COALESCE;
+      else if (!strcmp(token, "jitter")) {
+        if ((token = strtok(NULL, " \t")) == NULL) {
+          fprintf(stderr, "Missing jitter value for timer: %s\n", *name);
+          *type = NULL;
+          return NULL;
+        }
+        jitter = atoi(token);
+      }
+      else {
+        fprintf(stderr, "Unknown timer attribute: %s\n", token);
+        *type = NULL;
+        return NULL;
+      }
+    }
+    /* a timer which cannot be created is not loaded as a plain event */
+    if ((rtimer = _rtimer_new(atoi(arg0), atoi(arg1), mode, jitter,
+                              missed)) == NULL)
+      *type = NULL;
+  }
 
   return rtimer;
 }
@@ -184,7 +335,8 @@ mvrt_event_t *mvrt_event_new(const char *name, const char *dev)
       return (mvrt_event_t *) obj;
   }
   
-  obj = mvrt_obj_new(name, dev);
+  if ((obj = mvrt_obj_new(name, dev)) == NULL)
+    return NULL;
   obj->tag = MVRT_OBJ_EVENT;
 
   /* Regular events do not need data. The existence of "event object" itself 
@@ -195,6 +347,13 @@ mvrt_event_t *mvrt_event_new(const char *name, const char *dev)
 }
 
 mvrt_event_t *mvrt_timer_new(const char *name, size_t sec, size_t nsec)
+{
+  return mvrt_timer_new_opt(name, sec, nsec, MVRT_TIMER_PERIODIC, 0,
+                            MVRT_TIMER_SKIP);
+}
+
+mvrt_event_t *mvrt_timer_new_opt(const char *name, size_t sec, size_t nsec,
+                                 int mode, size_t jitter, int missed)
 {
   mvrt_obj_t *obj = mvrt_obj_lookup(name, NULL);
   if (obj) {
@@ -202,11 +361,12 @@ mvrt_event_t *mvrt_timer_new(const char *name, size_t sec, size_t nsec)
     return NULL;
   }
   
-  obj = mvrt_obj_new(name, NULL);
+  if ((obj = mvrt_obj_new(name, NULL)) == NULL)
+    return NULL;
   obj->tag = MVRT_OBJ_EVENT;
 
   _rtimer_t *rtimer = NULL;
-  if ((rtimer = _rtimer_new(sec, nsec)) == NULL) {
+  if ((rtimer = _rtimer_new(sec, nsec, mode, jitter, missed)) == NULL) {
     mvrt_obj_delete(obj);
     return NULL;
   }
@@ -228,9 +388,15 @@ mvrt_event_t *mvrt_event_load_str(char *line)
   mvrt_obj_t *obj = mvrt_obj_lookup(name, NULL);
   if (obj) {
     fprintf(stderr, "A runtime object already exists with name: %s.\n", name);
+    if (rtimer)
+      _rtimer_delete(rtimer);
+    return NULL;
+  }
+  if ((obj = mvrt_obj_new(name, NULL)) == NULL) {
+    if (rtimer)
+      _rtimer_delete(rtimer);
     return NULL;
   }
-  obj = mvrt_obj_new(name, NULL);
   obj->tag = MVRT_OBJ_EVENT;
 
   if (rtimer) {
@@ -248,6 +414,8 @@ int mvrt_event_delete(mvrt_event_t *ev)
   _rtimer_t *timer = (_rtimer_t *) obj->data;
   if (timer && _rtimer_delete(timer) == -1)
     return -1;
+  obj->data = NULL;
+  mvrt_remove_reactor_from_event(ev, NULL);
 
   return mvrt_obj_delete(obj);
 }
@@ -262,9 +430,14 @@ char *mvrt_event_save_str(mvrt_event_t *ev)
 
   _rtimer_t *timer = (_rtimer_t *) obj->data;
   if (timer) {
+    static const char *missed_s[] = { "skip", "catchup", "coalesce" };
     int sec = timer->sec;
     int nsec = timer->nsec;
-    if (snprintf(str, 4096, "timer %s %d %d", obj->name, sec, nsec) > 4095) {
+    int jitter = timer->jitter;
+    const char *mode_s = (timer->mode == MVRT_TIMER_ONESHOT) ? 
+      "oneshot" : "periodic";
+    if (snprintf(str, 4096, "timer %s %d %d %s jitter %d %s", obj->name, 
+                 sec, nsec, mode_s, jitter, missed_s[timer->missed]) > 4095) {
       fprintf(stderr, "Buffer overflow.\n");
       return NULL;
     }
@@ -323,26 +496,53 @@ int mvrt_timer_module_init()
   return 0;
 }
 
-int mvrt_timer_start(mvrt_event_t *ev)
+static _rtimer_t *_rtimer_get(mvrt_event_t *ev)
 {
   mvrt_obj_t *obj = (mvrt_obj_t *) ev;
-  assert(obj->tag == MVRT_OBJ_EVENT && obj->data);
+  if (!obj || obj->tag != MVRT_OBJ_EVENT || !obj->data) {
+    fprintf(stderr, "Not a timer: %s.\n", obj ? obj->name : "(null)");
+    return NULL;
+  }
+
+  return (_rtimer_t *) obj->data;
+}
+
+int mvrt_timer_start(mvrt_event_t *ev)
+{
+  _rtimer_t *timer = _rtimer_get(ev);
+  if (!timer)
+    return -1;
+
+  /* a running timer keeps its current phase; a oneshot timer which has
+     fired is started again */
+  if (!timer->stopped && _rtimer_armed(timer))
+    return 0;
 
-  _rtimer_t *timer = obj->data;
   timer->stopped = 0;
 
-  return 0;
+  return _rtimer_arm(timer);
 }
 
 int mvrt_timer_stop(mvrt_event_t* ev)
 {
-  mvrt_obj_t *obj = (mvrt_obj_t *) ev;
-  assert(obj->tag == MVRT_OBJ_EVENT && obj->data);
+  _rtimer_t *timer = _rtimer_get(ev);
+  if (!timer)
+    return -1;
 
-  _rtimer_t *timer = obj->data;
   timer->stopped = 1;
 
-  return 0;
+  return _rtimer_disarm(timer);
+}
+
+int mvrt_timer_reset(mvrt_event_t *ev)
+{
+  _rtimer_t *timer = _rtimer_get(ev);
+  if (!timer)
+    return -1;
+
+  timer->stopped = 0;
+
+  return _rtimer_arm(timer);
 }
 
 
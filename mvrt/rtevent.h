@@ -31,9 +31,25 @@ typedef struct mvrt_eventinst {
    runs the runtime. */
 extern mvrt_event_t *mvrt_event_new(const char *name, const char *dev);
 
+/* Timer modes. */
+#define MVRT_TIMER_PERIODIC   0    /* fire every interval */
+#define MVRT_TIMER_ONESHOT    1    /* fire once after the interval */
+
+/* Policies for ticks that expired while the runtime could not deliver
+   them, e.g. because the event queue was full. */
+#define MVRT_TIMER_SKIP       0    /* deliver one event, drop missed ticks */
+#define MVRT_TIMER_CATCHUP    1    /* deliver one event per missed tick */
+#define MVRT_TIMER_COALESCE   2    /* deliver one event with the tick count */
+
 /* Creates a local timer event with the interval in secs and nanosecs. */
 extern mvrt_event_t *mvrt_timer_new(const char *name, size_t s, size_t ns);
 
+/* Creates a local timer event with the given mode and missed-tick policy.
+   The first expiration is delayed by a random phase offset in 
+   [0, jitter) msecs, which is chosen once when the timer is created. */
+extern mvrt_event_t *mvrt_timer_new_opt(const char *name, size_t s, size_t ns,
+                                        int mode, size_t jitter, int missed);
+
 /* Parses a string into an event. The argument string must contain exactly
    one definition of a local event or a local timer. */
 extern mvrt_event_t *mvrt_event_load_str(char *line);
@@ -54,10 +70,15 @@ extern mvrt_event_t *mvrt_event_lookup(const char *name, const char *dev);
  */
 extern int mvrt_timer_module_init();
 
-/* Starts and stops the timer event. */
+/* Starts and stops the timer event. Stopping disarms the underlying
+   kernel timer; starting a stopped timer, or a oneshot timer which has
+   fired, re-arms it from now. */
 extern int mvrt_timer_start(mvrt_event_t *ev);
 extern int mvrt_timer_stop(mvrt_event_t *ev);
 
+/* Restarts the timer period from now, whether it is running or not. */
+extern int mvrt_timer_reset(mvrt_event_t *ev);
+
 
 /*
  * Functions for event instances.
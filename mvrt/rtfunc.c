@@ -5,8 +5,12 @@
 #include <stdlib.h>        /* free, exit */
 #include <string.h>        /* strdup */
 #include <assert.h>        /* assert */
+#include <dlfcn.h>         /* dlopen */
+#include <pthread.h>       /* pthread_create */
+#include <signal.h>        /* pthread_sigmask */
 #include "rtfunc.h"
 #include "rtobj.h"
+#include "rtreactor.h"     /* mvrt_reactor_retire */
 
 #define _RTFUNC_MV      0
 #define _RTFUNC_NATIVE  1
@@ -22,9 +26,46 @@ typedef struct _rtfunc {
 
 static _rtfunc_t *rtfunc_new();
 static int _rtfunc_delete(_rtfunc_t *f);
+static void _rtfunc_free(void *p);
 static int _rtfunc_token_tag(const char *token);
 static int _rtfunc_parse_nargs(int op);
 static _rtfunc_t *_rtfunc_parse(char *line, FILE *fp, char **name);
+static void _rtfunc_prefetch_one(mvrt_obj_t *obj, void *arg);
+static void *_rtfunc_prefetch_thread(void *arg);
+static mvrt_native_t *_rtnative_new(const char *name, const char *lib);
+static void _rtnative_delete(mvrt_native_t *native);
+static void *_rtnative_sym(mvrt_native_t *native);
+static int _rtnative_parse_type(const char *s, size_t len);
+static int _rtnative_parse_sig(mvrt_native_t *native, const char *sig);
+static void *_rtlib_open(const char *name);
+static void _rtlib_close(const char *name);
+
+/* A dynamic library opened for native functions. */
+typedef struct _rtlib {
+  char *name;              /* library file name, as in the native line */
+  void *handle;            /* handle from dlopen */
+  int refcount;            /* number of resolved functions in it */
+  struct _rtlib *next;     /* next library */
+} _rtlib_t;
+
+static _rtlib_t *_rtlibs = NULL;
+
+/* native functions to prefetch */
+typedef struct _rtnative_list {
+  mvrt_native_t **natives;
+  size_t n;                /* number of natives */
+  size_t size;             /* size of natives */
+} _rtnative_list_t;
+
+/* serializes resolving native functions and the library list */
+static pthread_mutex_t _rtfunc_native_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* words for passing arguments to typed native functions */
+typedef mv_ptr_t (*_word0_t)(void);
+typedef mv_ptr_t (*_word1_t)(mv_ptr_t);
+typedef mv_ptr_t (*_word2_t)(mv_ptr_t, mv_ptr_t);
+typedef mv_ptr_t (*_word3_t)(mv_ptr_t, mv_ptr_t, mv_ptr_t);
+typedef mv_ptr_t (*_word4_t)(mv_ptr_t, mv_ptr_t, mv_ptr_t, mv_ptr_t);
 
 
 _rtfunc_t *_rtfunc_new()
@@ -33,6 +74,7 @@ _rtfunc_t *_rtfunc_new()
   if (!func)
     return NULL;
   
+  func->tag = _RTFUNC_MV;
   func->u.code = NULL;
 
   return func;
@@ -46,7 +88,7 @@ int _rtfunc_delete(_rtfunc_t *func)
   }
   else if (func->tag == _RTFUNC_NATIVE) {
     if (func->u.native)
-      free(func->u.native);
+      _rtnative_delete(func->u.native);
   }
 
   free(func);
@@ -54,8 +96,175 @@ int _rtfunc_delete(_rtfunc_t *func)
   return 0;
 }
 
+/* Deletes a retired function. */
+void _rtfunc_free(void *p)
+{
+  _rtfunc_delete((_rtfunc_t *) p);
+}
+
+
+mvrt_native_t *_rtnative_new(const char *name, const char *lib)
+{
+  mvrt_native_t *native = malloc(sizeof(mvrt_native_t));
+  native->lib = strdup(lib);
+  native->name = strdup(name);
+  native->sig = NULL;
+  native->conv = MVRT_NATIVE_LEGACY;
+  native->ret = MVRT_NATIVE_INT;
+  native->nargs = 0;
+  native->sym = NULL;
+  native->func1 = (mvrt_native_func1_t) 0;
+  native->func2 = (mvrt_native_func2_t) 0;
+  native->refcount = 1;
+
+  return native;
+}
+
+/* Returns the resolved function, resolving it first if need be, or NULL if
+   it cannot be resolved. The function is read once and called through, 
+   since another thread may be resolving it. */
+void *_rtnative_sym(mvrt_native_t *native)
+{
+  void *sym = __atomic_load_n(&native->sym, __ATOMIC_ACQUIRE);
+  if (!sym && mvrt_native_resolve(native) == 0)
+    sym = __atomic_load_n(&native->sym, __ATOMIC_ACQUIRE);
+
+  return sym;
+}
 
-int _rtfunc_tokenize(char *line, char **type, char **name, char **lib)
+/* Drops a reference to the native function, and frees it with the last
+   one. */
+void _rtnative_delete(mvrt_native_t *native)
+{
+  pthread_mutex_lock(&_rtfunc_native_lock);
+  int last = (--native->refcount == 0);
+  if (last && native->sym)
+    _rtlib_close(native->lib);
+  pthread_mutex_unlock(&_rtfunc_native_lock);
+  if (!last)
+    return;
+
+  free(native->lib);
+  free(native->name);
+  if (native->sig)
+    free(native->sig);
+  free(native);
+}
+
+/* Returns the type named by the len characters at s, or -1. */
+int _rtnative_parse_type(const char *s, size_t len)
+{
+  if (len == 4 && !strncmp(s, "void", len))
+    return MVRT_NATIVE_VOID;
+  if (len == 3 && !strncmp(s, "int", len))
+    return MVRT_NATIVE_INT;
+  if (len == 5 && !strncmp(s, "value", len))
+    return MVRT_NATIVE_VALUE;
+
+  return -1;
+}
+
+/* Parses a signature such as "int(int,value)", "value(value[])" or 
+   "value[](value[])". */
+int _rtnative_parse_sig(mvrt_native_t *native, const char *sig)
+{
+  if (!strcmp(sig, "value[](value[])")) {
+    native->ret = MVRT_NATIVE_VALUE;
+    native->conv = MVRT_NATIVE_BATCH;
+    native->sig = strdup(sig);
+    return 0;
+  }
+
+  const char *lparen = strchr(sig, '(');
+  size_t len = strlen(sig);
+  if (!lparen || len < 2 || sig[len - 1] != ')')
+    return -1;
+  if ((native->ret = _rtnative_parse_type(sig, lparen - sig)) == -1)
+    return -1;
+
+  const char *p = lparen + 1;
+  const char *end = sig + len - 1;
+  if (!strcmp(p, "value[])")) {
+    if (native->ret != MVRT_NATIVE_VALUE)
+      return -1;
+    native->conv = MVRT_NATIVE_VECTOR;
+    native->sig = strdup(sig);
+    return 0;
+  }
+
+  native->conv = MVRT_NATIVE_TYPED;
+  native->nargs = 0;
+  if (p == end || (end - p == 4 && !strncmp(p, "void", 4))) {
+    native->sig = strdup(sig);
+    return 0;
+  }
+  while (p <= end) {
+    const char *q = p;
+    while (q < end && *q != ',')
+      q++;
+
+    int type = _rtnative_parse_type(p, q - p);
+    if (type == -1 || type == MVRT_NATIVE_VOID 
+        || native->nargs == MVRT_NATIVE_MAX_ARGS)
+      return -1;
+    native->args[native->nargs++] = type;
+    p = q + 1;
+  }
+  native->sig = strdup(sig);
+
+  return 0;
+}
+
+/* Returns the handle of the library, opening it if it is not open yet, 
+   and counts one more function resolved in it. Called with the lock. */
+void *_rtlib_open(const char *name)
+{
+  _rtlib_t *lib;
+  for (lib = _rtlibs; lib; lib = lib->next) {
+    if (!strcmp(lib->name, name))
+      break;
+  }
+
+  if (!lib) {
+    void *handle = dlopen(name, RTLD_NOW);
+    if (!handle) {
+      fprintf(stderr, "%s\n", dlerror());
+      return NULL;
+    }
+    lib = malloc(sizeof(_rtlib_t));
+    lib->name = strdup(name);
+    lib->handle = handle;
+    lib->refcount = 0;
+    lib->next = _rtlibs;
+    _rtlibs = lib;
+  }
+  lib->refcount++;
+
+  return lib->handle;
+}
+
+/* Counts one less function resolved in the library, and closes the 
+   library when none is left. Called with the lock. */
+void _rtlib_close(const char *name)
+{
+  _rtlib_t **libp;
+  for (libp = &_rtlibs; *libp; libp = &(*libp)->next) {
+    if (!strcmp((*libp)->name, name))
+      break;
+  }
+
+  _rtlib_t *lib = *libp;
+  if (!lib || --lib->refcount > 0)
+    return;
+
+  *libp = lib->next;
+  dlclose(lib->handle);
+  free(lib->name);
+  free(lib);
+}
+
+int _rtfunc_tokenize(char *line, char **type, char **name, char **lib,
+                     char **sig)
 {
   char *token;
 
@@ -74,6 +283,9 @@ int _rtfunc_tokenize(char *line, char **type, char **name, char **lib)
     if ((token = strtok(NULL, " \t")) == NULL)
       return -1;
     *lib = token;
+
+    /* get optional "sig" */
+    *sig = strtok(NULL, " \t");
   }
 
   return 0;
@@ -90,24 +302,28 @@ _rtfunc_t *_rtfunc_parse(char *line, FILE *fp, char **name)
      }
  
      native f1 lib.so
+     native f2 lib.so int(int,int)
   */
   char *token;
   char *type = NULL;
   char *lib = NULL;
-  if (_rtfunc_tokenize(line, &type, name, &lib) == -1) {
+  char *sig = NULL;
+  if (_rtfunc_tokenize(line, &type, name, &lib, &sig) == -1) {
     fprintf(stderr, "Line not recognized: %s\n", line);
     return NULL;
   }
 
   _rtfunc_t *func = NULL;
   if (!strcmp(type, "native")) {
+    mvrt_native_t *native = _rtnative_new(*name, lib);
+    if (sig && _rtnative_parse_sig(native, sig) == -1) {
+      fprintf(stderr, "Invalid signature of %s: %s\n", *name, sig);
+      _rtnative_delete(native);
+      return NULL;
+    }
     func = _rtfunc_new();
     func->tag = _RTFUNC_NATIVE;
-    func->u.native = malloc(sizeof(mvrt_native_t));
-    func->u.native->lib = strdup(lib);
-    func->u.native->name = strdup(*name);
-    func->u.native->func1 = (mvrt_native_func1_t) 0;
-    func->u.native->func2 = (mvrt_native_func2_t) 0;
+    func->u.native = native;
   }
   else if (!strcmp(type, "func")) {
     mvrt_code_t *code = mvrt_code_load_file(fp);
@@ -125,6 +341,52 @@ _rtfunc_t *_rtfunc_parse(char *line, FILE *fp, char **name)
 }
 
 
+/* Adds the native function of obj, if any, to the list arg, with a 
+   reference, since the function may be deleted before it is resolved. 
+   Called with the lock of the object table held, so nothing is resolved 
+   here: dlopen may take long, and run constructors which add objects. */
+void _rtfunc_prefetch_one(mvrt_obj_t *obj, void *arg)
+{
+  _rtnative_list_t *list = (_rtnative_list_t *) arg;
+  _rtfunc_t *rtfunc = (_rtfunc_t *) obj->data;
+  if (rtfunc->tag != _RTFUNC_NATIVE)
+    return;
+
+  if (list->n == list->size) {
+    size_t size = list->size ? list->size * 2 : 16;
+    mvrt_native_t **natives = realloc(list->natives, 
+                                      size * sizeof(mvrt_native_t *));
+    if (!natives)
+      return;
+    list->natives = natives;
+    list->size = size;
+  }
+  mvrt_native_t *native = rtfunc->u.native;
+  pthread_mutex_lock(&_rtfunc_native_lock);
+  native->refcount++;
+  pthread_mutex_unlock(&_rtfunc_native_lock);
+  list->natives[list->n++] = native;
+}
+
+void *_rtfunc_prefetch_thread(void *arg)
+{
+  (void) arg;
+
+  _rtnative_list_t list = { NULL, 0, 0 };
+  mvrt_obj_foreach(MVRT_OBJ_FUNC, _rtfunc_prefetch_one, &list);
+
+  size_t i;
+  for (i = 0; i < list.n; i++) {
+    mvrt_native_resolve(list.natives[i]);
+    _rtnative_delete(list.natives[i]);
+  }
+  free(list.natives);
+  fprintf(stdout, "Native functions prefetched...\n");
+
+  return NULL;
+}
+
+
 /*
  * Functions for rtfunc API.
  */
@@ -136,7 +398,8 @@ mvrt_func_t *mvrt_func_new(const char *name)
     return NULL;
   }
 
-  obj = mvrt_obj_new(name, NULL);
+  if ((obj = mvrt_obj_new(name, NULL)) == NULL)
+    return NULL;
   obj->tag = MVRT_OBJ_FUNC;
   obj->data = (void *) _rtfunc_new();
 
@@ -157,22 +420,51 @@ mvrt_func_t *mvrt_func_load_str(char *line, FILE *fp)
     return NULL;
   }
 
-  obj = mvrt_obj_new(name, NULL);
+  if ((obj = mvrt_obj_new(name, NULL)) == NULL)
+    return NULL;
   obj->tag = MVRT_OBJ_FUNC;
   obj->data = (void *) rtfunc;
 
   return (mvrt_func_t *) obj;
 }
 
+char *mvrt_func_save_str(mvrt_func_t *func)
+{
+  static char str[4096];
+
+  mvrt_obj_t *obj = (mvrt_obj_t *) func;
+  if (!obj)
+    return NULL;
+
+  _rtfunc_t *rtfunc = (_rtfunc_t *) obj->data;
+  mvrt_native_t *native = rtfunc->u.native;
+  int n;
+  if (rtfunc->tag == _RTFUNC_NATIVE && native->sig)
+    n = snprintf(str, 4096, "native %s %s %s", obj->name, native->lib,
+                 native->sig);
+  else if (rtfunc->tag == _RTFUNC_NATIVE)
+    n = snprintf(str, 4096, "native %s %s", obj->name, native->lib);
+  else
+    n = snprintf(str, 4096, "func %s", obj->name);
+  if (n > 4095) {
+    fprintf(stderr, "Buffer overflow.\n");
+    return NULL;
+  }
+
+  return &str[0];
+}
+
 int mvrt_func_delete(mvrt_func_t *func)
 {
   mvrt_obj_t *obj = (mvrt_obj_t *) func;
 
-  _rtfunc_t *prop = obj->data;
-  if (_rtfunc_delete(prop) == -1)
+  /* a running reactor may still be calling it */
+  _rtfunc_t *rtfunc = obj->data;
+  if (mvrt_obj_delete(obj) == -1)
     return -1;
+  mvrt_reactor_retire(rtfunc, _rtfunc_free);
 
-  return mvrt_obj_delete(obj);
+  return 0;
 }
 
 mvrt_func_t *mvrt_func_lookup(const char *name)
@@ -209,3 +501,180 @@ mvrt_native_t *mvrt_func_getnative(mvrt_func_t *func)
   return rtfunc->u.native;
 }
 
+mvrt_code_t *mvrt_func_getcode(mvrt_func_t *func)
+{
+  mvrt_obj_t *obj = (mvrt_obj_t *) func;
+  assert(obj->tag == MVRT_OBJ_FUNC);
+
+  _rtfunc_t *rtfunc = (_rtfunc_t *) obj->data;
+  assert(rtfunc);
+
+  return (rtfunc->tag == _RTFUNC_MV) ? rtfunc->u.code : NULL;
+}
+
+int mvrt_func_addcode(mvrt_func_t *func, mvrt_code_t *code)
+{
+  mvrt_obj_t *obj = (mvrt_obj_t *) func;
+  assert(obj->tag == MVRT_OBJ_FUNC);
+
+  _rtfunc_t *rtfunc = (_rtfunc_t *) obj->data;
+  if (rtfunc->tag != _RTFUNC_MV || rtfunc->u.code) {
+    fprintf(stderr, "Function already has code: %s.\n", obj->name);
+    return -1;
+  }
+  rtfunc->u.code = code;
+
+  return 0;
+}
+
+int mvrt_native_resolve(mvrt_native_t *native)
+{
+  int retval = 0;
+
+  pthread_mutex_lock(&_rtfunc_native_lock);
+  if (!native->sym) {
+    void *handle = _rtlib_open(native->lib);
+    void *sym = handle ? dlsym(handle, native->name) : NULL;
+    if (!sym) {
+      if (handle) {
+        fprintf(stderr, "%s\n", dlerror());
+        _rtlib_close(native->lib);
+      }
+      retval = -1;
+    }
+    else {
+      native->func1 = (mvrt_native_func1_t) sym;
+      native->func2 = (mvrt_native_func2_t) sym;
+      __atomic_store_n(&native->sym, sym, __ATOMIC_RELEASE);
+    }
+  }
+  pthread_mutex_unlock(&_rtfunc_native_lock);
+
+  return retval;
+}
+
+int mvrt_native_call(mvrt_native_t *native, int argc, mv_value_t *argv,
+                     mv_value_t *ret)
+{
+  void *sym = _rtnative_sym(native);
+  if (!sym)
+    return -1;
+
+  if (native->conv == MVRT_NATIVE_VECTOR) {
+    *ret = ((mvrt_native_vector_t) sym)(argc, argv);
+    return 0;
+  }
+
+  if (native->conv == MVRT_NATIVE_BATCH) {
+    fprintf(stderr, "%s is a batch function.\n", native->name);
+    return -1;
+  }
+
+  if (native->conv == MVRT_NATIVE_LEGACY) {
+    if (argc == 1) {
+      *ret = mv_value_int(((mvrt_native_func1_t) sym)
+                          (mv_value_int_get(argv[0])));
+    }
+    else if (argc == 2) {
+      ((mvrt_native_func2_t) sym)(mv_value_int_get(argv[0]), 
+                                  mv_value_int_get(argv[1]));
+      *ret = mv_value_int(0);
+    }
+    else {
+      fprintf(stderr, "%s takes 1 or 2 arguments, not %d.\n", 
+              native->name, argc);
+      return -1;
+    }
+    return 0;
+  }
+
+  if (argc != native->nargs) {
+    fprintf(stderr, "%s takes %d arguments, not %d.\n", 
+            native->name, native->nargs, argc);
+    return -1;
+  }
+
+  mv_ptr_t w[MVRT_NATIVE_MAX_ARGS];
+  int i;
+  for (i = 0; i < argc; i++) {
+    if (native->args[i] == MVRT_NATIVE_INT)
+      w[i] = (mv_ptr_t) (long) mv_value_int_get(argv[i]);
+    else
+      w[i] = (mv_ptr_t) argv[i];
+  }
+
+  mv_ptr_t r = 0;
+  switch (argc) {
+  case 0:
+    r = ((_word0_t) sym)();
+    break;
+  case 1:
+    r = ((_word1_t) sym)(w[0]);
+    break;
+  case 2:
+    r = ((_word2_t) sym)(w[0], w[1]);
+    break;
+  case 3:
+    r = ((_word3_t) sym)(w[0], w[1], w[2]);
+    break;
+  case 4:
+    r = ((_word4_t) sym)(w[0], w[1], w[2], w[3]);
+    break;
+  default:
+    assert(0 && "Too many arguments.");
+    break;
+  }
+
+  switch (native->ret) {
+  case MVRT_NATIVE_VOID:
+    *ret = mv_value_null();
+    break;
+  case MVRT_NATIVE_INT:
+    *ret = mv_value_int((int) r);
+    break;
+  default:
+    *ret = (mv_value_t) r;
+    break;
+  }
+
+  return 0;
+}
+
+int mvrt_native_call_batch(mvrt_native_t *native, int n, mv_value_t *argv)
+{
+  void *sym = _rtnative_sym(native);
+  if (!sym)
+    return -1;
+
+  if (native->conv != MVRT_NATIVE_BATCH) {
+    fprintf(stderr, "%s is not a batch function.\n", native->name);
+    return -1;
+  }
+
+  return ((mvrt_native_batch_t) sym)(n, argv, argv);
+}
+
+int mvrt_func_prefetch()
+{
+  /* keep SIGRTMIN for the timer in the main thread */
+  sigset_t sigmask;
+  sigset_t oldmask;
+  sigemptyset(&sigmask);
+  sigaddset(&sigmask, SIGRTMIN);
+  pthread_sigmask(SIG_BLOCK, &sigmask, &oldmask);
+
+  pthread_attr_t attr;
+  pthread_t thr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int retval = pthread_create(&thr, &attr, _rtfunc_prefetch_thread, NULL);
+  pthread_attr_destroy(&attr);
+  pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+
+  if (retval != 0) {
+    perror("pthread_create@mvrt_func_prefetch");
+    return -1;
+  }
+
+  return 0;
+}
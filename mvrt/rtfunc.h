@@ -7,16 +7,62 @@
 #define MVRT_FUNC_H
 
 #include <mv/defs.h>          /* mv_prt_t */
+#include <mv/value.h>         /* mv_value_t */
 #include "rtcode.h"           /* mvrt_code_t */
 
 
+/* Calling conventions of native functions. A native function is declared
+   with an optional signature, which selects the convention:
+
+     native name lib.so                    MVRT_NATIVE_LEGACY
+     native name lib.so int(int,int)       MVRT_NATIVE_TYPED
+     native name lib.so value(value[])     MVRT_NATIVE_VECTOR
+     native name lib.so value[](value[])   MVRT_NATIVE_BATCH
+
+   Typed signatures have a return type of void, int or value, and up to
+   MVRT_NATIVE_MAX_ARGS arguments of type int or value. Each argument is
+   passed in a machine word, as the C calling convention of the supported
+   platforms does. The vector convention is 
+   
+     mv_value_t f(int argc, mv_value_t *argv)
+
+   and gets the arguments as they are on the stack, with no conversion. 
+   The batch convention is
+
+     int f(int n, mv_value_t *argv, mv_value_t *retv)
+
+   which handles n independent requests in one call, e.g. reading n pins,
+   and sets retv[i] to the result for argv[i]. It returns 0 on success and 
+   -1 on failure. retv is argv itself, so argv[i] must be read before 
+   retv[i] is set. Batch functions are called with call_batch only. */
+#define MVRT_NATIVE_LEGACY    0    /* int f(int), or f(int, int) for pairs */
+#define MVRT_NATIVE_TYPED     1    /* declared C signature */
+#define MVRT_NATIVE_VECTOR    2    /* mvrt_native_vector_t */
+#define MVRT_NATIVE_BATCH     3    /* mvrt_native_batch_t */
+
+/* Types in native signatures. */
+#define MVRT_NATIVE_VOID      0
+#define MVRT_NATIVE_INT       1
+#define MVRT_NATIVE_VALUE     2
+
+#define MVRT_NATIVE_MAX_ARGS  4
+
 typedef int (*mvrt_native_func1_t)(int);
 typedef void *(*mvrt_native_func2_t)(int, int);
+typedef mv_value_t (*mvrt_native_vector_t)(int argc, mv_value_t *argv);
+typedef int (*mvrt_native_batch_t)(int n, mv_value_t *argv, mv_value_t *retv);
 typedef struct mv_native {
   char *lib;                  /* dynamic library name */
   char *name;                 /* function name */
+  char *sig;                  /* signature as declared, or NULL */
+  int conv;                   /* MVRT_NATIVE_LEGACY, etc. */
+  int ret;                    /* return type: MVRT_NATIVE_VOID, etc. */
+  int nargs;                  /* number of arguments, if typed */
+  int args[MVRT_NATIVE_MAX_ARGS];  /* argument types, if typed */
+  void *sym;                  /* resolved function, or NULL */
   mvrt_native_func1_t func1;  /* native function */
   mvrt_native_func2_t func2;  /* native function */
+  int refcount;               /* the function, and prefetching */
 } mvrt_native_t;
 
 /* Opaque handle to the runtime function. */
@@ -45,4 +91,33 @@ extern int mvrt_func_isnative(mvrt_func_t *func);
 /* Returns the given native function. */
 extern mvrt_native_t *mvrt_func_getnative(mvrt_func_t *func);
 
+/* Returns the code of the given MV function, or NULL for a native one. */
+extern mvrt_code_t *mvrt_func_getcode(mvrt_func_t *func);
+
+/* Sets the code of an MV function which has none. */
+extern int mvrt_func_addcode(mvrt_func_t *func, mvrt_code_t *code);
+
+/* Opens the library of the native function and looks up the function, 
+   unless it is done already. Each library is opened once, and closed when
+   its last function is deleted. Safe to call from any thread. Returns 0 on
+   success and -1 on failure. */
+extern int mvrt_native_resolve(mvrt_native_t *native);
+
+/* Calls the native function with argc arguments, resolving it first if
+   needed, and sets *ret to its return value. A void function returns the
+   null value. Returns 0 on success and -1 on failure, e.g. if argc does
+   not match the signature. */
+extern int mvrt_native_call(mvrt_native_t *native, int argc, mv_value_t *argv,
+                            mv_value_t *ret);
+
+/* Calls the batch native function with n requests, resolving it first if
+   needed. Results are stored over the arguments in argv. Returns 0 on 
+   success and -1 on failure. */
+extern int mvrt_native_call_batch(mvrt_native_t *native, int n, 
+                                  mv_value_t *argv);
+
+/* Resolves all native functions in a background thread, so that the first
+   call to each does not wait for the dynamic linker. */
+extern int mvrt_func_prefetch();
+
 #endif /* MVRT_FUNC_H */
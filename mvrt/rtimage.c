@@ -0,0 +1,175 @@
+/**
+ * @file rtimage.c
+ */
+#include <stdio.h>       /* fprintf */
+#include <stdlib.h>      /* malloc */
+#include <string.h>      /* memcmp */
+#include <unistd.h>      /* close */
+#include <fcntl.h>       /* open */
+#include <sys/mman.h>    /* mmap */
+#include <sys/stat.h>    /* fstat */
+#include "rtoper.h"      /* mvrt_instr_t */
+#include "rtimage.h"
+
+#define _IMAGE_NULLSTR  0xffffffff
+
+static mv_uint32_t _image_probe();
+static size_t _image_pad(size_t n);
+
+
+/* Returns the encoding of a fixed instruction on this host. */
+mv_uint32_t _image_probe()
+{
+  mvrt_instr_t instr;
+  mv_uint32_t probe = 0;
+
+  instr.opcode = 0x5a;
+  instr.operand = 0x123456;
+  memcpy(&probe, &instr, sizeof(instr));
+
+  return probe;
+}
+
+size_t _image_pad(size_t n)
+{
+  return (n + 3) & ~((size_t) 3);
+}
+
+
+/*
+ * Functions for rtimage API.
+ */
+int mvrt_image_isimage(const char *file)
+{
+  char magic[sizeof(MVRT_IMAGE_MAGIC)];
+  FILE *fp;
+  if ((fp = fopen(file, "r")) == NULL)
+    return 0;
+
+  size_t n = fread(magic, 1, sizeof(magic), fp);
+  fclose(fp);
+
+  return (n == sizeof(magic) && !memcmp(magic, MVRT_IMAGE_MAGIC, n));
+}
+
+int mvrt_image_put_header(FILE *fp, mv_uint32_t nobjs, mv_uint32_t nassocs)
+{
+  mvrt_image_header_t header;
+  memset(&header, 0x0, sizeof(header));
+  memcpy(header.magic, MVRT_IMAGE_MAGIC, sizeof(MVRT_IMAGE_MAGIC));
+  header.version = MVRT_IMAGE_VERSION;
+  header.probe = _image_probe();
+  header.nobjs = nobjs;
+  header.nassocs = nassocs;
+
+  return mvrt_image_put_bytes(fp, &header, sizeof(header));
+}
+
+int mvrt_image_put_u32(FILE *fp, mv_uint32_t v)
+{
+  return (fwrite(&v, sizeof(v), 1, fp) == 1) ? 0 : -1;
+}
+
+int mvrt_image_put_str(FILE *fp, const char *s)
+{
+  if (!s)
+    return mvrt_image_put_u32(fp, _IMAGE_NULLSTR);
+
+  size_t len = strlen(s);
+  if (mvrt_image_put_u32(fp, (mv_uint32_t) len) == -1)
+    return -1;
+
+  return mvrt_image_put_bytes(fp, s, len + 1);
+}
+
+int mvrt_image_put_bytes(FILE *fp, const void *p, size_t n)
+{
+  static const char zeros[4] = { 0, 0, 0, 0 };
+
+  if (n > 0 && fwrite(p, 1, n, fp) != n)
+    return -1;
+  if (_image_pad(n) > n && fwrite(zeros, 1, _image_pad(n) - n, fp) == 0)
+    return -1;
+
+  return 0;
+}
+
+mvrt_image_t *mvrt_image_map(const char *file, mvrt_image_header_t *header)
+{
+  int fd;
+  struct stat st;
+  if ((fd = open(file, O_RDONLY)) == -1) {
+    fprintf(stderr, "mvrt_image_map: Failed to open %s.\n", file);
+    return NULL;
+  }
+  if (fstat(fd, &st) == -1 || (size_t) st.st_size < sizeof(*header)) {
+    fprintf(stderr, "mvrt_image_map: Image too short: %s.\n", file);
+    close(fd);
+    return NULL;
+  }
+
+  void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "mvrt_image_map: Failed to map %s.\n", file);
+    return NULL;
+  }
+
+  memcpy(header, base, sizeof(*header));
+  if (memcmp(header->magic, MVRT_IMAGE_MAGIC, sizeof(MVRT_IMAGE_MAGIC))
+      || header->version != MVRT_IMAGE_VERSION
+      || header->probe != _image_probe()) {
+    fprintf(stderr, "mvrt_image_map: Incompatible image: %s.\n", file);
+    munmap(base, st.st_size);
+    return NULL;
+  }
+
+  mvrt_image_t *img = malloc(sizeof(mvrt_image_t));
+  img->base = (const char *) base;
+  img->size = st.st_size;
+  img->off = sizeof(*header);
+
+  return img;
+}
+
+int mvrt_image_get_u32(mvrt_image_t *img, mv_uint32_t *v)
+{
+  if (img->off + sizeof(*v) > img->size)
+    return -1;
+
+  memcpy(v, img->base + img->off, sizeof(*v));
+  img->off += sizeof(*v);
+
+  return 0;
+}
+
+int mvrt_image_get_str(mvrt_image_t *img, const char **s)
+{
+  mv_uint32_t len;
+  if (mvrt_image_get_u32(img, &len) == -1)
+    return -1;
+
+  if (len == _IMAGE_NULLSTR) {
+    *s = NULL;
+    return 0;
+  }
+
+  const void *p;
+  if (mvrt_image_get_bytes(img, (size_t) len + 1, &p) == -1)
+    return -1;
+  *s = (const char *) p;
+
+  /* must be terminated where the length says */
+  return ((*s)[len] == '\0') ? 0 : -1;
+}
+
+int mvrt_image_get_bytes(mvrt_image_t *img, size_t n, const void **p)
+{
+  if (n > img->size || _image_pad(n) > img->size - img->off)
+    return -1;
+
+  *p = img->base + img->off;
+  img->off += _image_pad(n);
+
+  return 0;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file rtimage.h
+ *
+ * @brief Interface to binary images of runtime objects.
+ *
+ * An image is produced from the text format by mvrt_obj_savefile and is
+ * mapped read-only by mvrt_obj_loadfile. It consists of a header, followed
+ * by the object table and the event-reactor assoc table:
+ *
+ *   header    magic, version, probe, number of objects and assocs
+ *   object    tag, name, descriptor line, code section size, code section
+ *   code      size, number of constants, instructions, constant pool
+ *   assoc     event name, event device, reactor name
+ *
+ * All fields are 32-bit words in host byte order. Strings are a length
+ * word followed by the NUL-terminated bytes, padded to a word boundary.
+ * Instructions are used in place, so code pages are shared between all
+ * processes that map the same image. Code sections are sized, so they can
+ * be skipped and loaded later.
+ */
+#ifndef MVRT_IMAGE_H
+#define MVRT_IMAGE_H
+
+#include <stdio.h>           /* FILE */
+#include <mv/defs.h>         /* mv_uint32_t */
+
+
+#define MVRT_IMAGE_MAGIC    "MVRTIMG"
+#define MVRT_IMAGE_VERSION  4
+
+typedef struct mvrt_image_header {
+  char magic[8];             /* MVRT_IMAGE_MAGIC */
+  mv_uint32_t version;       /* MVRT_IMAGE_VERSION */
+  mv_uint32_t probe;         /* encoded instruction: catches byte order and
+                                instruction layout mismatches */
+  mv_uint32_t nobjs;         /* number of entries in the object table */
+  mv_uint32_t nassocs;       /* number of entries in the assoc table */
+} mvrt_image_header_t;
+
+/* A read-only mapping of an image, and the current read position. */
+typedef struct mvrt_image {
+  const char *base;          /* start of the mapping */
+  size_t size;               /* size of the mapping */
+  size_t off;                /* offset of the next field to read */
+} mvrt_image_t;
+
+
+/* Returns 1 if the file starts with MVRT_IMAGE_MAGIC. Returns 0 otherwise. */
+extern int mvrt_image_isimage(const char *file);
+
+/* Writes the header of an image. Returns 0 on success and -1 on failure. */
+extern int mvrt_image_put_header(FILE *fp, mv_uint32_t nobjs,
+                                 mv_uint32_t nassocs);
+
+/* Writes a word, a string, or a block of bytes padded to a word boundary.
+   A NULL string is written as such. Returns 0 on success and -1 on
+   failure. */
+extern int mvrt_image_put_u32(FILE *fp, mv_uint32_t v);
+extern int mvrt_image_put_str(FILE *fp, const char *s);
+extern int mvrt_image_put_bytes(FILE *fp, const void *p, size_t n);
+
+/* Maps the image read-only, and checks its header. The mapping is never
+   unmapped, since loaded code points into it. Returns NULL on failure. */
+extern mvrt_image_t *mvrt_image_map(const char *file,
+                                    mvrt_image_header_t *header);
+
+/* Reads a word, a string, or a block of bytes, and advances the read
+   position. Strings and bytes point into the mapping. Returns 0 on success
+   and -1 if the image is truncated or malformed. */
+extern int mvrt_image_get_u32(mvrt_image_t *img, mv_uint32_t *v);
+extern int mvrt_image_get_str(mvrt_image_t *img, const char **s);
+extern int mvrt_image_get_bytes(mvrt_image_t *img, size_t n, const void **p);
+
+#endif /* MVRT_IMAGE_H */
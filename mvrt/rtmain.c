@@ -12,6 +12,9 @@
 #include <sys/wait.h>        /* waitpid */
 #include <sys/stat.h>        /* waitpid */
 #include <signal.h>          /* sigaction */
+#include <getopt.h>          /* getopt_long */
+#include <pthread.h>         /* pthread_create */
+#include <time.h>            /* clock_gettime */
 #include <mv/device.h>       /* mv_device_self */
 #include <mv/message.h>      /* mv_message_selfaddr */
 
@@ -21,6 +24,10 @@
 #include "rtprop.h"          /* mvrt_prop_module_init */
 #include "rtfunc.h"          /* mvrt_func_module_init */
 #include "rtreactor.h"       /* mvrt_reactor_module_init */
+#include "rtsub.h"           /* mvrt_subscribe */
+#include "rtobj.h"           /* mvrt_obj_loadfile */
+#include "rtevqueue.h"       /* mvrt_evqueue */
+#include "rteval.h"          /* mvrt_eval_profile_print */
 #include "rtutil.h"          /* daemon_init */
 
 
@@ -40,6 +47,75 @@ static void sig_child(int signo)
   return;
 }
 
+/*
+ * startup profile
+ */
+static int _profile = 0;
+static struct timespec _profile_start;
+static struct timespec _profile_last;
+
+static double _elapsed_ms(struct timespec *from, struct timespec *to)
+{
+  return (to->tv_sec - from->tv_sec) * 1e3 
+    + (to->tv_nsec - from->tv_nsec) / 1e6;
+}
+
+/* Prints the time taken by a startup phase, and since the start. */
+static void _profile_mark(const char *phase)
+{
+  struct timespec now;
+  if (!_profile)
+    return;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  fprintf(stdout, "startup: %-24s %9.3f ms %9.3f ms\n", phase,
+          _elapsed_ms(&_profile_last, &now), 
+          _elapsed_ms(&_profile_start, &now));
+  _profile_last = now;
+}
+
+/* Loads the device directory, while the main thread loads syslib. */
+static void *_device_thread(void *arg)
+{
+  mv_device_module_init((const char *) arg);
+  return NULL;
+}
+
+/* Tells whoever waits on fd that the runtime is serving. */
+static void _notify_ready(int fd)
+{
+  static const char msg[] = "READY=1\n";
+  if (fd < 0)
+    return;
+
+  if (write(fd, msg, sizeof(msg) - 1) == -1)
+    perror("write@_notify_ready");
+  close(fd);
+}
+
+static void _usage(const char *prog)
+{
+  fprintf(stdout, "Usage: %s [options] [name] [datafile]\n", prog);
+  fprintf(stdout, "       %s -c [datafile] [imagefile]\n", prog);
+  fprintf(stdout, "  - [name]:     globally unqiue name of this device\n");
+  fprintf(stdout, "  - [datafile]: file which contains device data such as "
+          " properties. Either text or binary image.\n");
+  fprintf(stdout, "  - -c:         compile the text datafile into a binary "
+          "image, and exit.\n");
+  fprintf(stdout, "Options:\n");
+  fprintf(stdout, "  --profile:    print the time taken by each startup "
+          "phase.\n");
+  fprintf(stdout, "  --ready-fd N: write \"READY=1\" to file descriptor N "
+          "when serving.\n");
+  fprintf(stdout, "  --memreport:  print the memory used by each runtime "
+          "object once loaded.\n");
+  fprintf(stdout, "  --directory host:port: look up devices not in "
+          "etc/device.dat in the device directory, and register there.\n");
+  fprintf(stdout, "Send SIGUSR1 to print how events were dispatched to "
+          "reactors, SIGUSR2 to print\nthe opcode counts of a build with "
+          "-DMVRT_PROFILE, and SIGHUP to reload etc/device.dat.\n");
+}
+
 /* 
  * the main entry point
  */
@@ -50,32 +126,99 @@ int main(int argc, char *argv[])
     daemon_init(0);
   */
 
-  if (argc < 3) {
-    fprintf(stdout, "Usage: %s [name] [datafile]\n", argv[0]);
-    fprintf(stdout, "  - [name]:     globally unqiue name of this device\n");
-    fprintf(stdout, "  - [datafile]: file which contains device data such as "
-            " properties.\n");
+  static struct option longopts[] = {
+    { "profile",  no_argument,       NULL, 'p' },
+    { "ready-fd", required_argument, NULL, 'r' },
+    { "directory", required_argument, NULL, 'd' },
+    { "memreport", no_argument,      NULL, 'm' },
+    { NULL,       0,                 NULL, 0 }
+  };
+  int compile = 0;
+  int memreport = 0;
+  int readyfd = -1;
+  const char *directory = NULL;
+  int opt;
+  while ((opt = getopt_long(argc, argv, "cpr:", longopts, NULL)) != -1) {
+    switch (opt) {
+    case 'c':
+      compile = 1;
+      break;
+    case 'p':
+      _profile = 1;
+      break;
+    case 'm':
+      memreport = 1;
+      break;
+    case 'r':
+      readyfd = atoi(optarg);
+      break;
+    case 'd':
+      directory = optarg;
+      break;
+    default:
+      _usage(argv[0]);
+      exit(1);
+    }
+  }
+
+  if (argc - optind < 2) {
+    _usage(argv[0]);
     exit(1);
   }
 
-  char *selfdev = strdup(argv[1]);
-  char *datafile = strdup(argv[2]);
+  clock_gettime(CLOCK_MONOTONIC, &_profile_start);
+  _profile_last = _profile_start;
+  mvrt_obj_module_init();
+
+  if (compile) {
+    if (mvrt_obj_loadfile(argv[optind]) == -1 
+        || mvrt_obj_savefile(argv[optind + 1]) == -1)
+      exit(1);
+    _profile_mark("compile");
+    if (memreport)
+      mvrt_obj_memreport(stdout);
+    exit(0);
+  }
 
-  /* initialize device service */
-  mv_device_module_init("etc/device.dat");
-  
-  /* load system properties, reactors, etc. */
+  /* blocked in all threads, so that only the main thread takes them */
+  sigset_t waitmask;
+  sigemptyset(&waitmask);
+  sigaddset(&waitmask, SIGUSR1);
+  sigaddset(&waitmask, SIGUSR2);
+  sigaddset(&waitmask, SIGHUP);
+  if (pthread_sigmask(SIG_BLOCK, &waitmask, NULL) != 0) {
+    perror("pthread_sigmask@main");
+    exit(1);
+  }
+
+  char *self = strdup(argv[optind]);
+  char *datafile = strdup(argv[optind + 1]);
+
+  /* initialize device service, in parallel with loading system 
+     properties, reactors, etc. */
+  pthread_t devthr;
+  if (pthread_create(&devthr, NULL, _device_thread, "etc/device.dat") != 0) {
+    perror("pthread_create@main");
+    exit(1);
+  }
   mvrt_obj_loadfile("etc/syslib.dat");
+  _profile_mark("syslib");
+  pthread_join(devthr, NULL);
+  if (directory && mv_device_dir_connect(directory) == -1)
+    exit(1);
+  _profile_mark("device");
 
   /*
    * device sign using the MQ address
    */
-  mv_device_t selfdev = mv_device_signon(self, mv_message_selfaddr());
+  mv_device_t selfdev = mv_device_signon(self, 
+                                          mv_addr(mv_message_selfaddr()));
   if (MV_DEVICE_INVALID(selfdev)) {
-    fprintf(stdout, "No device with name, %s, is not registered.\n", selfdev);
+    fprintf(stdout, "No device with name, %s, is not registered.\n", self);
     exit(1);
   }
-  fprintf(stdout, "Device %s signed on at %s.\n", self, mv_device_addr(self));
+  fprintf(stdout, "Device %s signed on.\n", self);
+  _profile_mark("signon");
 
   /* 
    * initialize event queue 
@@ -92,12 +235,14 @@ int main(int argc, char *argv[])
     exit(1);
   }
   fprintf(stdout, "Message decoder thread started...\n");
+  _profile_mark("decoder");
 
   /* 
    * initialize scheduler 
    */
   mvrt_sched_t *sched = mvrt_sched(evq);
   mvrt_sched_run(sched);
+  _profile_mark("scheduler");
 
   /* Load user property, reactors, etc. 
      
@@ -107,15 +252,35 @@ int main(int argc, char *argv[])
   */
   mvrt_timer_module_init();
 
+  /* Code in binary images is loaded when each reactor is first 
+     dispatched. Native functions are resolved in the background. */
   mvrt_obj_loadfile(datafile);
+  _profile_mark("datafile");
+  if (memreport)
+    mvrt_obj_memreport(stdout);
+  mvrt_func_prefetch();
 
   fprintf(stdout, "Runtime initialization finished...\n");
+  _profile_mark("ready");
+  _notify_ready(readyfd);
 
   /*
-   * main thread perform infinite loop - Is there a better way which would
-   * not wake up on SIGRTMIN?
+   * main thread waits for SIGUSR1, which asks for the dispatch report,
+   * SIGUSR2, for the opcode counts, and SIGHUP, which reloads the device
+   * directory. Timer signals are still handled while it waits.
    */
-  while (1) ;
+  while (1) {
+    int sig;
+    if (sigwait(&waitmask, &sig) != 0)
+      continue;
+    if (sig == SIGUSR1)
+      mvrt_reactor_dispatch_report(stdout);
+    else if (sig == SIGUSR2)
+      mvrt_eval_profile_print(stdout);
+    else if (sig == SIGHUP)
+      mv_device_reload("etc/device.dat");
+    fflush(stdout);
+  }
 
   return EXIT_SUCCESS;
 }
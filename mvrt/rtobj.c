@@ -5,67 +5,214 @@
 #include <stdlib.h>    /* exit */
 #include <string.h>    /* memset */
 #include <assert.h>    /* assert */
+#include <pthread.h>   /* pthread_rwlock_t */
+#include <mv/hash.h>   /* mv_hash_str_cont */
 #include "rtprop.h"    /* mvrt_prop_load_str */
 #include "rtfunc.h"    /* mvrt_func_load_str */
 #include "rtevent.h"   /* mvrt_event_load_str */
 #include "rtreactor.h" /* mvrt_reactor_load_str */
+#include "rtimage.h"   /* mvrt_image_map */
 #include "rtobj.h"
 
-# define MAX_RTABLE_SIZE  4096
-static mvrt_obj_t _rtable[MAX_RTABLE_SIZE];
+/* The object table is an open-addressing hash table of pointers to 
+   objects, probed linearly. Each slot keeps the hash of its object, so 
+   that probing rarely touches the objects themselves. Deleted slots become
+   tombstones, which keep probe chains intact until the next rehash. The 
+   table is rehashed into twice the size when live objects fill half of 
+   it, and in place when tombstones fill a quarter of it. 
+
+   Lookups take the read lock, so any number of scheduler threads can look
+   up objects at once. Objects themselves never move. */
+#define _RTABLE_MIN_SIZE  64
+#define _RTABLE_TOMB      ((mvrt_obj_t *) &_rtable_tomb)
+
+typedef struct _rtslot {
+  mv_uint32_t hash;          /* hash of obj */
+  mvrt_obj_t *obj;           /* NULL if empty, _RTABLE_TOMB if deleted */
+} _rtslot_t;
+
+static _rtslot_t *_rtable = NULL;
+static size_t _rtable_size = 0;    /* number of slots: a power of two */
+static size_t _rtable_count = 0;   /* number of objects */
+static size_t _rtable_tombs = 0;   /* number of tombstones */
+static char _rtable_tomb;
+static pthread_rwlock_t _rtable_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* starts at 1 so that new references are unbound */
+mv_uint32_t mvrt_obj_generation = 1;
 
 static mv_uint32_t _objhash(const char *str, const char *dev);
+static int _match(mvrt_obj_t *obj, const char *name, const char *dev);
+static _rtslot_t *_rtable_find(const char *name, const char *dev, 
+                               mv_uint32_t hash);
+static int _rtable_rehash(size_t size);
+static mvrt_obj_t *_rtable_at(size_t i);
+static void _rtobj_free(void *p);
+static int _rtobj_save_image(mvrt_obj_t *obj, FILE *fp);
+static int _rtobj_load_image(const char *file);
+static int _rtobj_load_image_obj(mvrt_image_t *img);
+static int _rtobj_load_image_assoc(mvrt_image_t *img);
 
+/* Hash of the device name, if any, and the object name. The device name
+   is followed by a separator, so that "a" on "bc" and "ab" on "c" hash 
+   differently. */
 mv_uint32_t _objhash(const char *str, const char *dev)
 {
+  mv_uint32_t hash = MV_HASH_INIT;
+  if (dev)
+    hash = mv_hash_str_cont(mv_hash_str_cont(hash, dev), ":");
 
-  /* TODO: For now, only str is used for computing hash. */
-  size_t hash = 0;
-  while (*str)
-    hash = hash * 101 + *str++;
-
-  return hash % MAX_RTABLE_SIZE;
+  return mv_hash_str_cont(hash, str);
 }
 
 int _match(mvrt_obj_t *obj, const char *name, const char *dev)
 {
-  return (obj && !strcmp(obj->name, name) && (!dev || !strcmp(obj->dev, dev)));
+  if (strcmp(obj->name, name))
+    return 0;
+  if (!dev || !obj->dev)
+    return (!dev && !obj->dev);
+
+  return !strcmp(obj->dev, dev);
+}
+
+/* Returns the slot of the object with the given name and device, or NULL 
+   if there is no such object. Call with the lock held. */
+_rtslot_t *_rtable_find(const char *name, const char *dev, mv_uint32_t hash)
+{
+  size_t mask = _rtable_size - 1;
+  size_t i = hash & mask;
+  _rtslot_t *slot;
+
+  if (!_rtable)
+    return NULL;
+
+  /* terminates, since the table always has an empty slot */
+  while ((slot = _rtable + i)->obj) {
+    if (slot->obj != _RTABLE_TOMB && slot->hash == hash 
+        && _match(slot->obj, name, dev))
+      return slot;
+    i = (i + 1) & mask;
+  }
+
+  return NULL;
+}
+
+/* Moves all objects into a new table of the given size, leaving out the
+   tombstones. Call with the write lock held. */
+int _rtable_rehash(size_t size)
+{
+  _rtslot_t *table = calloc(size, sizeof(_rtslot_t));
+  if (!table) {
+    fprintf(stderr, "Failed to allocate object table of size %lu.\n",
+            (unsigned long) size);
+    return -1;
+  }
+
+  size_t mask = size - 1;
+  size_t i;
+  for (i = 0; i < _rtable_size; i++) {
+    _rtslot_t *slot = _rtable + i;
+    if (!slot->obj || slot->obj == _RTABLE_TOMB)
+      continue;
+
+    size_t j = slot->hash & mask;
+    while (table[j].obj)
+      j = (j + 1) & mask;
+    table[j] = *slot;
+  }
+
+  free(_rtable);
+  _rtable = table;
+  _rtable_size = size;
+  _rtable_tombs = 0;
+
+  return 0;
+}
+
+/* Returns the object in the i-th slot, or NULL if the slot is empty or a
+   tombstone. Call with the lock held. */
+mvrt_obj_t *_rtable_at(size_t i)
+{
+  mvrt_obj_t *obj = _rtable[i].obj;
+  return (obj == _RTABLE_TOMB) ? NULL : obj;
+}
+
+
+/* Frees a deleted object, once retired. */
+void _rtobj_free(void *p)
+{
+  mvrt_obj_t *obj = (mvrt_obj_t *) p;
+  if (obj->dev) 
+    free(obj->dev);
+  free(obj->name);
+  free(obj);
 }
 
 
 /*
  * Functions for rtobj API.
  */
-static mvrt_obj_t *_rtable_end;
 int mvrt_obj_module_init()
 {
-  size_t mvrt_obj_sz = sizeof(mvrt_obj_t);
-  memset(&_rtable[0], 0x0, mvrt_obj_sz * MAX_RTABLE_SIZE);
-  
-  _rtable_end = _rtable + (MAX_RTABLE_SIZE - 1);
+  pthread_rwlock_wrlock(&_rtable_lock);
+  int retval = 0;
+  if (!_rtable)
+    retval = _rtable_rehash(_RTABLE_MIN_SIZE);
+  pthread_rwlock_unlock(&_rtable_lock);
+
+  return retval;
 }
 
 mvrt_obj_t *mvrt_obj_new(const char *name, const char *dev)
 {
-  size_t hash = _objhash(name, dev);
-  mvrt_obj_t *p = _rtable + hash;
-  mvrt_obj_t *end = (p != _rtable) ? (p - 1) : _rtable_end;
+  mv_uint32_t hash = _objhash(name, dev);
+  mvrt_obj_t *p = NULL;
 
-  while (p->used && p != end) {
-    p = (p == _rtable_end) ? _rtable : (p + 1);
+  pthread_rwlock_wrlock(&_rtable_lock);
+  if (_rtable_find(name, dev, hash)) {
+    fprintf(stderr, "A runtime object already exists with name: %s.\n", 
+            name);
+    goto out;
   }
 
-  if (p->used) {
-    fprintf(stderr, "No more free entry.");
-    exit(1);
+  /* keep at least half of the slots empty */
+  if (!_rtable || (_rtable_count + 1) * 2 > _rtable_size) {
+    size_t size = _rtable_size ? _rtable_size * 2 : _RTABLE_MIN_SIZE;
+    if (_rtable_rehash(size) == -1)
+      goto out;
+  }
+  else if ((_rtable_count + _rtable_tombs + 1) * 4 > _rtable_size * 3) {
+    if (_rtable_rehash(_rtable_size) == -1)
+      goto out;
   }
 
-  p->dev = dev ? strdup(name) : NULL;
+  if ((p = calloc(1, sizeof(mvrt_obj_t))) == NULL) {
+    fprintf(stderr, "Failed to allocate runtime object: %s.\n", name);
+    goto out;
+  }
+  p->dev = dev ? strdup(dev) : NULL;
   p->name = strdup(name);
+  p->hash = hash;
   p->used = 1;
 
+  /* reuse the first tombstone on the probe chain */
+  size_t mask = _rtable_size - 1;
+  size_t i = hash & mask;
+  while (_rtable[i].obj && _rtable[i].obj != _RTABLE_TOMB)
+    i = (i + 1) & mask;
+  if (_rtable[i].obj == _RTABLE_TOMB)
+    _rtable_tombs--;
+  _rtable[i].hash = hash;
+  _rtable[i].obj = p;
+  _rtable_count++;
+  __atomic_add_fetch(&mvrt_obj_generation, 1, __ATOMIC_RELEASE);
+
+#ifndef NDEBUG
   fprintf(stdout, "Runtime object created: %s\n", p->name);
+#endif
 
+ out:
+  pthread_rwlock_unlock(&_rtable_lock);
   return p;
 }
 
@@ -74,33 +221,149 @@ int mvrt_obj_delete(mvrt_obj_t *p)
   if (!p)
     return -1;
 
-  p->used = 0;
-  if (p->dev) 
-    free(p->dev);
-  free(p->name);
+  pthread_rwlock_wrlock(&_rtable_lock);
+  _rtslot_t *slot = _rtable_find(p->name, p->dev, p->hash);
+  if (!slot || slot->obj != p) {
+    pthread_rwlock_unlock(&_rtable_lock);
+    fprintf(stderr, "No such runtime object: %s.\n", p->name);
+    return -1;
+  }
+  slot->obj = _RTABLE_TOMB;
+  _rtable_count--;
+  _rtable_tombs++;
+  __atomic_add_fetch(&mvrt_obj_generation, 1, __ATOMIC_RELEASE);
+  pthread_rwlock_unlock(&_rtable_lock);
+
+  /* a reactor may have followed a reference to it before the generation
+     changed, and be using it still */
+  mvrt_reactor_retire(p, _rtobj_free);
 
   return 0;
 }
 
 mvrt_obj_t *mvrt_obj_lookup(const char *name, const char *dev)
 {
-  size_t hash = _objhash(name, dev);
-  mvrt_obj_t *p = _rtable + hash;
-  mvrt_obj_t *end = (p != _rtable) ? (p - 1) : _rtable_end;
+  mv_uint32_t hash = _objhash(name, dev);
 
-  int matched = 0;
-  while (p->used && !(matched = _match(p, name, dev)) && p != end)
-    p = (p == _rtable_end) ? _rtable : (p + 1);
+  pthread_rwlock_rdlock(&_rtable_lock);
+  _rtslot_t *slot = _rtable_find(name, dev, hash);
+  mvrt_obj_t *obj = slot ? slot->obj : NULL;
+  pthread_rwlock_unlock(&_rtable_lock);
 
-  if (!matched)
-    return NULL;
+  return obj;
+}
 
-  return p;
+mvrt_ref_t *mvrt_ref_new(const char *name, unsigned tag)
+{
+  mvrt_ref_t *ref = malloc(sizeof(mvrt_ref_t));
+  ref->name = strdup(name);
+  ref->tag = tag;
+  ref->gen = 0;
+  ref->obj = NULL;
+
+  return ref;
+}
+
+int mvrt_ref_delete(mvrt_ref_t *ref)
+{
+  if (!ref)
+    return -1;
+
+  free(ref->name);
+  free(ref);
+
+  return 0;
+}
+
+mvrt_obj_t *mvrt_ref_bind(mvrt_ref_t *ref)
+{
+  mv_uint32_t hash = _objhash(ref->name, NULL);
+
+  /* The generation only changes under the write lock, so it is the one of
+     the object found. The reference is set before the lock is released, 
+     so a thread binding it later, after another change, overwrites it. */
+  pthread_rwlock_rdlock(&_rtable_lock);
+  mv_uint32_t gen = __atomic_load_n(&mvrt_obj_generation, __ATOMIC_RELAXED);
+  _rtslot_t *slot = _rtable_find(ref->name, NULL, hash);
+  mvrt_obj_t *obj = slot ? slot->obj : NULL;
+  if (obj && obj->tag != ref->tag)
+    obj = NULL;
+
+  __atomic_store_n(&ref->obj, obj, __ATOMIC_RELAXED);
+  __atomic_store_n(&ref->gen, gen, __ATOMIC_RELEASE);
+  pthread_rwlock_unlock(&_rtable_lock);
+
+  return obj;
+}
+
+void mvrt_obj_foreach(unsigned tag, void (*fn)(mvrt_obj_t *obj, void *arg), 
+                      void *arg)
+{
+  size_t i;
+  pthread_rwlock_rdlock(&_rtable_lock);
+  for (i = 0; i < _rtable_size; i++) {
+    mvrt_obj_t *obj = _rtable_at(i);
+    if (obj && obj->tag == tag)
+      fn(obj, arg);
+  }
+  pthread_rwlock_unlock(&_rtable_lock);
+}
+
+size_t mvrt_obj_memsize(mvrt_obj_t *obj)
+{
+  size_t size = sizeof(mvrt_obj_t) + strlen(obj->name) + 1;
+  if (obj->dev)
+    size += strlen(obj->dev) + 1;
+
+  mvrt_code_t *code = NULL;
+  int inimage;
+  switch (obj->tag) {
+  case MVRT_OBJ_REACTOR:
+    code = mvrt_reactor_peekcode((mvrt_reactor_t *) obj, &inimage);
+    break;
+  case MVRT_OBJ_FUNC:
+    code = mvrt_func_getcode((mvrt_func_t *) obj);
+    break;
+  default:
+    break;
+  }
+  if (code)
+    size += mvrt_code_memsize(code);
+
+  return size;
+}
+
+void mvrt_obj_memreport(FILE *fp)
+{
+  static const char *tagstr[MVRT_OBJ_NTAGS] = {
+    "prop", "func", "event", "reactor"
+  };
+  size_t total = 0;
+  size_t i;
+  pthread_rwlock_rdlock(&_rtable_lock);
+  for (i = 0; i < _rtable_size; i++) {
+    mvrt_obj_t *obj = _rtable_at(i);
+    if (!obj)
+      continue;
+
+    size_t size = mvrt_obj_memsize(obj);
+    int inimage = 0;
+    if (obj->tag == MVRT_OBJ_REACTOR)
+      mvrt_reactor_peekcode((mvrt_reactor_t *) obj, &inimage);
+    fprintf(fp, "%-8s %-32s %8lu%s\n", tagstr[obj->tag], obj->name, 
+            (unsigned long) size, inimage ? "  (code in image)" : "");
+    total += size;
+  }
+  pthread_rwlock_unlock(&_rtable_lock);
+  fprintf(fp, "%-8s %-32s %8lu\n", "total", "", (unsigned long) total);
 }
 
 #define MAX_FILE_LINE  4096
 int mvrt_obj_loadfile(const char *file)
 {
+  if (mvrt_image_isimage(file))
+    return _rtobj_load_image(file);
+
   FILE *fp;
   if ((fp = fopen(file, "r")) == NULL) {
     fprintf(stdout, "mvrt_table_loadfile: Failed to load %s.\n", file);
@@ -157,7 +420,238 @@ int mvrt_obj_loadfile(const char *file)
   return 0;
 }
 
-int mvrt_obj_savefile(const char *file)
+/* Writes an entry of the object table of an image. */
+int _rtobj_save_image(mvrt_obj_t *obj, FILE *fp)
 {
+  char *line = NULL;
+  mvrt_code_t *code = NULL;
+  switch (obj->tag) {
+  case MVRT_OBJ_PROP:
+    line = mvrt_prop_save_str((mvrt_prop_t *) obj);
+    break;
+  case MVRT_OBJ_EVENT:
+    line = mvrt_event_save_str((mvrt_event_t *) obj);
+    break;
+  case MVRT_OBJ_FUNC:
+    line = mvrt_func_save_str((mvrt_func_t *) obj);
+    code = mvrt_func_getcode((mvrt_func_t *) obj);
+    break;
+  case MVRT_OBJ_REACTOR:
+    code = mvrt_reactor_getcode((mvrt_reactor_t *) obj);
+    break;
+  default:
+    break;
+  }
+  if (!line && obj->tag != MVRT_OBJ_REACTOR)
+    return -1;
+
+  if (mvrt_image_put_u32(fp, obj->tag) == -1
+      || mvrt_image_put_str(fp, obj->name) == -1
+      || mvrt_image_put_str(fp, line) == -1)
+    return -1;
+
+  /* the size of the code section is filled in once it is written */
+  long sizepos = ftell(fp);
+  if (mvrt_image_put_u32(fp, 0) == -1)
+    return -1;
+  if (!code)
+    return 0;
+
+  long start = ftell(fp);
+  if (mvrt_code_save_image(code, fp) == -1)
+    return -1;
+  long end = ftell(fp);
+  if (fseek(fp, sizepos, SEEK_SET) == -1
+      || mvrt_image_put_u32(fp, (mv_uint32_t) (end - start)) == -1
+      || fseek(fp, end, SEEK_SET) == -1)
+    return -1;
+
   return 0;
 }
+
+/* Loads an entry of the object table of an image. Properties, events and
+   native functions are loaded from their descriptor lines. The code of a
+   reactor is only loaded when the reactor is first dispatched. Returns -1
+   only if the image is malformed, since the rest cannot be read then. */
+int _rtobj_load_image_obj(mvrt_image_t *img)
+{
+  mv_uint32_t tag;
+  mv_uint32_t codesize;
+  const char *name;
+  const char *line_s;
+  const void *section;
+  if (mvrt_image_get_u32(img, &tag) == -1
+      || mvrt_image_get_str(img, &name) == -1 || !name
+      || mvrt_image_get_str(img, &line_s) == -1
+      || mvrt_image_get_u32(img, &codesize) == -1) {
+    fprintf(stderr, "Malformed object table in image.\n");
+    return -1;
+  }
+
+  size_t codeoff = img->off;
+  if (codesize > 0 && mvrt_image_get_bytes(img, codesize, &section) == -1) {
+    fprintf(stderr, "Malformed code section in image.\n");
+    return -1;
+  }
+
+  char line[MAX_FILE_LINE];
+  if (line_s) {
+    if (strlen(line_s) >= MAX_FILE_LINE) {
+      fprintf(stderr, "Descriptor of %s is too long.\n", name);
+      return -1;
+    }
+    strcpy(line, line_s);
+  }
+
+  mvrt_obj_t *obj = NULL;
+  mvrt_code_t *code = NULL;
+  mvrt_image_t at = *img;
+  at.off = codeoff;
+  switch (tag) {
+  case MVRT_OBJ_PROP:
+    if (line_s)
+      obj = (mvrt_obj_t *) mvrt_prop_load_str(line);
+    break;
+  case MVRT_OBJ_EVENT:
+    if (line_s)
+      obj = (mvrt_obj_t *) mvrt_event_load_str(line);
+    break;
+  case MVRT_OBJ_FUNC:
+    if (codesize > 0) {
+      if ((code = mvrt_code_load_image(&at)) == NULL)
+        break;
+      obj = (mvrt_obj_t *) mvrt_func_new(name);
+      if (obj && mvrt_func_addcode((mvrt_func_t *) obj, code) == -1)
+        obj = NULL;
+      if (!obj)
+        mvrt_code_delete(code);
+    }
+    else if (line_s) {
+      obj = (mvrt_obj_t *) mvrt_func_load_str(line, NULL);
+    }
+    break;
+  case MVRT_OBJ_REACTOR:
+    if (codesize > 0) {
+      obj = (mvrt_obj_t *) mvrt_reactor_new(name);
+      if (obj && mvrt_reactor_addimage((mvrt_reactor_t *) obj, img, 
+                                        codeoff) == -1)
+        obj = NULL;
+    }
+    break;
+  default:
+    break;
+  }
+
+  if (!obj)
+    fprintf(stderr, "Failed to load object: %s\n", name);
+
+  return 0;
+}
+
+/* Loads an entry of the assoc table of an image. Returns -1 only if the
+   image is malformed. */
+int _rtobj_load_image_assoc(mvrt_image_t *img)
+{
+  const char *name;
+  const char *dev;
+  const char *reactor_s;
+  if (mvrt_image_get_str(img, &name) == -1 || !name
+      || mvrt_image_get_str(img, &dev) == -1
+      || mvrt_image_get_str(img, &reactor_s) == -1 || !reactor_s) {
+    fprintf(stderr, "Malformed assoc table in image.\n");
+    return -1;
+  }
+
+  mvrt_event_t *ev = mvrt_event_lookup(name, dev);
+  if (!ev && dev) {
+    /* external event is not inside the runtime: add one */
+    ev = mvrt_event_new(name, dev);
+  }
+  mvrt_reactor_t *reactor = mvrt_reactor_lookup(reactor_s);
+  if (!ev || !reactor) {
+    fprintf(stderr, "Failed to load assoc: %s %s\n", name, reactor_s);
+    return 0;
+  }
+  mvrt_add_reactor_to_event(ev, reactor);
+
+  return 0;
+}
+
+int _rtobj_load_image(const char *file)
+{
+  mvrt_image_header_t header;
+  mvrt_image_t *img;
+  if ((img = mvrt_image_map(file, &header)) == NULL)
+    return -1;
+
+  mv_uint32_t i;
+  for (i = 0; i < header.nobjs; i++) {
+    if (_rtobj_load_image_obj(img) == -1)
+      return -1;
+  }
+  for (i = 0; i < header.nassocs; i++) {
+    if (_rtobj_load_image_assoc(img) == -1)
+      return -1;
+  }
+
+  return 0;
+}
+
+int mvrt_obj_savefile(const char *file)
+{
+  FILE *fp;
+  if ((fp = fopen(file, "w")) == NULL) {
+    fprintf(stderr, "mvrt_obj_savefile: Failed to open %s.\n", file);
+    return -1;
+  }
+
+  /* External events are not saved: assocs add them back on load. */
+  mv_uint32_t nobjs = 0;
+  mv_uint32_t nassocs = 0;
+  size_t i;
+  pthread_rwlock_rdlock(&_rtable_lock);
+  for (i = 0; i < _rtable_size; i++) {
+    mvrt_obj_t *obj = _rtable_at(i);
+    if (!obj)
+      continue;
+    if (!obj->dev)
+      nobjs++;
+    if (obj->tag == MVRT_OBJ_EVENT) {
+      mvrt_reactor_set_t *set = mvrt_get_reactors_for_event(obj);
+      if (set)
+        nassocs += set->n;
+      mvrt_reactor_set_release(set);
+    }
+  }
+
+  int retval = mvrt_image_put_header(fp, nobjs, nassocs);
+  for (i = 0; i < _rtable_size && retval == 0; i++) {
+    mvrt_obj_t *obj = _rtable_at(i);
+    if (obj && !obj->dev)
+      retval = _rtobj_save_image(obj, fp);
+  }
+  for (i = 0; i < _rtable_size && retval == 0; i++) {
+    mvrt_obj_t *obj = _rtable_at(i);
+    if (!obj || obj->tag != MVRT_OBJ_EVENT)
+      continue;
+
+    mvrt_reactor_set_t *set = mvrt_get_reactors_for_event(obj);
+    size_t j;
+    for (j = 0; set && j < set->n && retval == 0; j++) {
+      mvrt_obj_t *reactor = (mvrt_obj_t *) set->reactors[j];
+      if (mvrt_image_put_str(fp, obj->name) == -1
+          || mvrt_image_put_str(fp, obj->dev) == -1
+          || mvrt_image_put_str(fp, reactor->name) == -1)
+        retval = -1;
+    }
+    mvrt_reactor_set_release(set);
+  }
+  pthread_rwlock_unlock(&_rtable_lock);
+
+  if (fclose(fp) == EOF)
+    retval = -1;
+  if (retval == -1)
+    fprintf(stderr, "mvrt_obj_savefile: Failed to save %s.\n", file);
+
+  return retval;
+}
@@ -7,6 +7,7 @@
 #ifndef MVRT_OBJ_H
 #define MVRT_OBJ_H
 
+#include <stdio.h>           /* FILE */
 #include <mv/defs.h>         /* mv_uint32_t */
 
 
@@ -28,29 +29,83 @@ typedef struct mvrt_obj {
   unsigned pad   : 28;       /* pad */
 
   void *data;                /* object-specific data */
+  void *assoc;               /* events: associated reactors (rtreactor.c) */
 } mvrt_obj_t;
 
+/* A reference to a local runtime object by name, as held by bytecode. It 
+   is bound lazily and rebound after any object is added or deleted, so 
+   following a reference is a pointer dereference in the common case. The
+   generation and the object are read and written atomically, since the 
+   scheduler threads share the code of a reactor. */
+typedef struct mvrt_ref {
+  char *name;                /* name of the object */
+  unsigned tag;              /* MVRT_OBJ_PROP, etc. */
+  mv_uint32_t gen;           /* mvrt_obj_generation when bound */
+  mvrt_obj_t *obj;           /* bound object: NULL if no such object */
+} mvrt_ref_t;
+
+/* Incremented whenever a runtime object is added or deleted, under the
+   lock of the object table. */
+extern mv_uint32_t mvrt_obj_generation;
 
-/* Initializes the MVRT obj item table. Call at time 0. */
+
+/* Initializes the MVRT obj item table. Call at time 0. The table grows as
+   objects are added, so there is no limit on the number of objects. */
 extern int mvrt_obj_module_init();
 
 /* Creates a new runtime object. Caller is responsible for filling in the 
-   fields except for the name. Returns -1 when 1) there is a name conflict 
-   or 2) the maximum number supported runtime objects is reached. 
+   fields except for the name. Objects are identified by both dev and name,
+   so a remote object may have the same name as a local one. Returns NULL 
+   when 1) there is a name conflict or 2) memory runs out. 
 
   NOTE: Do not directly call this. Call mvrt_prop_new or mvrt_event_new
   instead. */
 extern mvrt_obj_t *mvrt_obj_new(const char *name, const char *dev);
 
 /* Removes the given object from the local registry of runtime objects. 
+   The object is freed once no reactor may still be running with it (see
+   mvrt_reactor_retire).
 
   NOTE: Do not directly call this. Call mvrt_prop_delete or mvrt_event_delete
   instead. */
 extern int mvrt_obj_delete(mvrt_obj_t *o);
 
-/* Looks up the runtime object. Returns NULL if no such object eixsts. */
+/* Looks up the runtime object. A NULL dev only matches local objects. 
+   Returns NULL if no such object eixsts. Lookups may run concurrently with
+   each other and with mvrt_obj_new; an object must not be deleted while 
+   another thread may still use it. */
 extern mvrt_obj_t *mvrt_obj_lookup(const char *name, const char *dev);
 
+/* Creates a reference to the local object with the given name and tag. */
+extern mvrt_ref_t *mvrt_ref_new(const char *name, unsigned tag);
+extern int mvrt_ref_delete(mvrt_ref_t *ref);
+
+/* Binds the reference to the current object with its name and tag, and
+   returns the object. Returns NULL if there is no such object. */
+extern mvrt_obj_t *mvrt_ref_bind(mvrt_ref_t *ref);
+
+/* Returns the object the reference refers to, or NULL. The generation of
+   the reference is acquired, so the object bound with it is seen. */
+#define mvrt_ref_get(ref)                                               \
+  (__atomic_load_n(&(ref)->gen, __ATOMIC_ACQUIRE)                       \
+   == __atomic_load_n(&mvrt_obj_generation, __ATOMIC_ACQUIRE)           \
+   ? __atomic_load_n(&(ref)->obj, __ATOMIC_RELAXED) : mvrt_ref_bind(ref))
+
+/* Calls fn with every object with the given tag. */
+extern void mvrt_obj_foreach(unsigned tag, 
+                             void (*fn)(mvrt_obj_t *obj, void *arg), 
+                             void *arg);
+
+/* Returns the number of bytes used by the object, including its code if
+   it is loaded. The code of a reactor still in its image is not loaded
+   to count it. */
+extern size_t mvrt_obj_memsize(mvrt_obj_t *obj);
+
+/* Prints the memory used by each runtime object, and the total. Reactors
+   whose code is still in the image are marked so. mvrt prints it after
+   loading with --memreport. */
+extern void mvrt_obj_memreport(FILE *fp);
+
 /* Loads runtime objects from the given file. */
 extern int mvrt_obj_loadfile(const char *file);
 
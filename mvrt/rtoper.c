@@ -2,98 +2,125 @@
  * @file rtoper.c
  */
 #include <stdlib.h>      /* malloc */
+#include <string.h>      /* strcmp */
 #include "rtoper.h"
 
 
+/* Stack effect of each operator: the number of values popped from and
+   pushed to the stack. An operator with nrets == _NOIMPL is not supported
+   by the evaluator, and code using it is rejected by the verifier. */
+#define _NOIMPL  -1
+
 struct {
   const char *str;    /* string */
   int nargs;          /* number of args on stack */
+  int nrets;          /* number of results pushed to stack */
 } _operinfo[] = {
   /* nop */
-  { "nop", 0 },
+  { "nop", 0, 0 },
 
   /* sleep */
-  { "sleep", 1 },
+  { "sleep", 1, 0 },
 
   /* arithmetic */
-  { "add", 2 },
-  { "sub", 2 },
-  { "mul", 2 }, 
-  { "div", 2 },
+  { "add", 2, 1 },
+  { "sub", 2, 1 },
+  { "mul", 2, 1 }, 
+  { "div", 2, 1 },
 
   /* logical */
-  { "not", 1 },
-  { "and", 2 },
-  { "or",  2 },
+  { "not", 1, 1 },
+  { "and", 2, 1 },
+  { "or",  2, 1 },
 
   /* comparison, predicates */
-  { "eq", 2 },
-  { "ne", 2 },
-  { "gt", 2 },
-  { "ge", 2 },
-  { "lt", 2 },
-  { "le", 2 },
-  { "integer_p",  1 },
-  { "float_p",    1 },
-  { "string_p",   1 },
-  { "map_p",      1 },
-  { "function_p", 1 },
-  { "event_p",    1 },
+  { "eq", 2, 1 },
+  { "ne", 2, 1 },
+  { "gt", 2, 1 },
+  { "ge", 2, 1 },
+  { "lt", 2, 1 },
+  { "le", 2, 1 },
+  { "integer_p",  1, 1 },
+  { "float_p",    1, 1 },
+  { "string_p",   1, 1 },
+  { "map_p",      1, 1 },
+  { "function_p", 1, 1 },
+  { "event_p",    1, 1 },
 
   /* flow control */
-  { "jmp", 1 },
-  { "beq", 2 },       
-  { "blt", 2 },
-  { "ble", 2 },
-  { "bgt", 2 },
-  { "bge", 2 },
-  { "ret", 1 },
+  { "jmp", 0, 0 },
+  { "beq", 2, 0 },       
+  { "blt", 2, 0 },
+  { "ble", 2, 0 },
+  { "bgt", 2, 0 },
+  { "bge", 2, 0 },
+  { "ret", 0, 0 },
 
   /* value builders */
-  { "pair_new", 2 },
-  { "pair_1st", 1 },
-  { "pair_2nd", 1 },
-  { "map_new",  0 },
-  { "map_add",  3 },
-  { "cons",     1 },
-  { "car",      2 },
-  { "cdr",      2 },
-  { "setcar",   2 },
-  { "setcdr",   2 },
+  { "pair_new", 2, 1 },
+  { "pair_1st", 1, 1 },
+  { "pair_2nd", 1, 1 },
+  { "map_new",  0, 1 },
+  { "map_add",  3, 1 },
+  { "cons",     2, 1 },
+  { "car",      1, 1 },
+  { "cdr",      1, 1 },
+  { "setcar",   2, 1 },
+  { "setcdr",   2, 1 },
 
   /* load/save values */
-  { "getarg",   0 },
+  { "getarg",   0, 1 },
 
-  { "getf",     1 },
-  { "setf",     1 },
+  { "getf",     2, 1 },
+  { "setf",     3, 1 },
 
-  { "pushn",    0 },
-  { "push0",    0 },
-  { "push1",    0 },
-  { "pushi",    1 },
-  { "pushs",    1 },
+  { "pushn",    0, 1 },
+  { "push0",    0, 1 },
+  { "push1",    0, 1 },
+  { "pushi",    0, 1 },
+  { "pushs",    0, 1 },
 
-  { "pop",      0 },
+  { "pop",      1, 0 },
 
-  { "save0",    1 },
-  { "save1",    1 },
-  { "load0",    1 },
-  { "load1",    1 },
+  { "save0",    1, 0 },
+  { "save1",    1, 0 },
+  { "load0",    0, 1 },
+  { "load1",    0, 1 },
+  { "save",     1, 0 },
+  { "load",     0, 1 },
 
   /* events */
-  { "event_occur", 2 },
+  { "event_occur", 2, 0 },
+
+  /* timers */
+  { "timer_start", 1, 0 },
+  { "timer_stop",  1, 0 },
+  { "timer_reset", 1, 0 },
 
   /* properties */
-  { "prop_get",    1 },
-  { "prop_set",    2 },
+  { "prop_get",    1, 1 },
+  { "prop_set",    2, 0 },
 
   /* functions */
-  { "call_func",      2 },
-  { "call_func_ret",  2 },
-  { "call_return",    2 },
-  { "call_continue",  2 },
-
-  { "",            0 }
+  { "call_func",      2, 1 },
+  { "call_func_ret",  2, 1 },
+  { "call_native",    1, 1 },    /* plus the arguments */
+  { "call_batch",     1, 0 },    /* plus the arguments, and the results */
+  { "call_return",    3, 0 },
+  { "call_continue",  2, 0 },
+
+  /* superinstructions */
+  { "prop_getk",      0, 1 },
+  { "prop_setk",      1, 0 },
+  { "getargf",        0, 1 },
+  { "call_funck",     1, 1 },
+  { "timer_startk",   0, 0 },
+  { "timer_stopk",    0, 0 },
+  { "timer_resetk",   0, 0 },
+  { "event_occurk",   1, 0 },
+  { "pushil",         0, 1 },
+
+  { "",            0, 0 }
 };
 
 const char *mvrt_opcode_str(mvrt_opcode_t op)
@@ -106,12 +133,17 @@ size_t mvrt_opcode_nargs(mvrt_opcode_t op)
   return _operinfo[op].nargs;
 }
 
+int mvrt_opcode_nrets(mvrt_opcode_t op)
+{
+  return _operinfo[op].nrets;
+}
+
 int mvrt_opcode_tag(const char *str)
 {
   /* TODO: make it efficient - search tree or trie */
 
   int op;
-  for (op = 0; op < MVRT_OP_NTAGS; op++) {
+  for (op = 0; op < MVRT_OP_SUPER_FIRST; op++) {
     if (!strcmp(_operinfo[op].str, str))
       return op;
   }
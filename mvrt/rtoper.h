@@ -13,7 +13,7 @@ typedef enum {
   MVRT_OP_NOP = 0,
 
   /* sleep */
-  MVRT_OP_SLEEP,
+  MVRT_OP_SLEEP,            /* sleep for the msec on stack top */
 
   /* arithmetic */
   MVRT_OP_ADD,
@@ -26,7 +26,8 @@ typedef enum {
   MVRT_OP_AND,
   MVRT_OP_OR,
 
-  /* comparison, predicates */
+  /* comparison, predicates: binary operators compare the stack top with
+     the value below it, i.e., "top OP next", and push 1 or 0 */
   MVRT_OP_EQ,
   MVRT_OP_NE,
   MVRT_OP_GT,
@@ -41,7 +42,8 @@ typedef enum {
   MVRT_OP_FUNCTION_P,
   MVRT_OP_EVENT_P,
 
-  /* flow control */
+  /* flow control: compare-and-branch operators pop two values and jump 
+     to the operand if "top OP next" holds */
   MVRT_OP_JMP,
   MVRT_OP_BEQ,
   MVRT_OP_BLT,
@@ -81,9 +83,16 @@ typedef enum {
   MVRT_OP_SAVE1,            /* save to temporary 1 */
   MVRT_OP_LOAD0,            /* load to stack top from temporary 0 */
   MVRT_OP_LOAD1,            /* load to stack top from temporary 1 */
+  MVRT_OP_SAVE,             /* save to the temporary given as operand */
+  MVRT_OP_LOAD,             /* load from the temporary given as operand */
 
   /* event service */
-  MVRT_OP_EVENT_OCCUR,
+  MVRT_OP_EVENT_OCCUR,      /* raise the named event with the given value */
+
+  /* timer service */
+  MVRT_OP_TIMER_START,      /* start the named timer */
+  MVRT_OP_TIMER_STOP,       /* stop the named timer */
+  MVRT_OP_TIMER_RESET,      /* restart the period of the named timer */
 
   /* property service */
   MVRT_OP_PROP_GET,
@@ -92,25 +101,60 @@ typedef enum {
   /* funtion service */
   MVRT_OP_CALL_FUNC,        /* call function */
   MVRT_OP_CALL_FUNC_RET,    /* call function with return value */
+  MVRT_OP_CALL_NATIVE,      /* call local native function with as many
+                               arguments as the operand */
+  MVRT_OP_CALL_BATCH,       /* call local batch native function with as 
+                               many arguments as the operand, and push as 
+                               many results */
 
   MVRT_OP_CALL_RETURN,      /* return the value to caller */
   MVRT_OP_CALL_CONTINUE,    /* resume suspended computation */
 
+  /* superinstructions: fused by the loader, never accepted from source.
+     Names of local objects are resolved to a mvrt_ref_t operand. */
+  MVRT_OP_PROP_GETK,        /* pushs "p"; prop_get -- p resolved */
+  MVRT_OP_PROP_SETK,        /* pushs "p"; prop_set -- p resolved */
+  MVRT_OP_GETARGF,          /* getarg; pushs "k"; getf -- k prebuilt */
+  MVRT_OP_CALL_FUNCK,       /* pushs "f"; call_func -- f resolved */
+  MVRT_OP_TIMER_STARTK,     /* pushs "t"; timer_start -- t resolved */
+  MVRT_OP_TIMER_STOPK,      /* pushs "t"; timer_stop -- t resolved */
+  MVRT_OP_TIMER_RESETK,     /* pushs "t"; timer_reset -- t resolved */
+  MVRT_OP_EVENT_OCCURK,     /* pushs "e"; event_occur -- e resolved */
+  MVRT_OP_PUSHIL,           /* pushi of a constant not fitting in operand */
+
   MVRT_OP_NTAGS
 } mvrt_opcode_t;
 
+#define MVRT_OP_SUPER_FIRST MVRT_OP_PROP_GETK
+
+/* An instruction is a single 32-bit word. The operand is an immediate
+   (branch target, temporary, or small integer) or an index into the
+   constant pool of the code (strings, references, large integers). */
 typedef struct mvrt_instr {
   unsigned int opcode  : 8;    /* OP code */
   unsigned int operand : 24;   /* operand, if any */
-  mv_ptr_t     ptr;            /* opaque pointer to some value */
 } mvrt_instr_t;
 
+/* Range of integers which fit in the operand of pushi. */
+#define MVRT_OPERAND_MIN  (-(1 << 23))
+#define MVRT_OPERAND_MAX  ((1 << 23) - 1)
+
+/* Returns the operand as a sign-extended integer. */
+#define mvrt_instr_simm(instr) \
+  ((int) ((instr)->operand ^ 0x800000) - 0x800000)
+
 /* Returns the string for the given operator. */
 extern const char *mvrt_opcode_str(mvrt_opcode_t op);
+
+/* Returns the number of values the given operator pops from the stack. */
 extern size_t mvrt_opcode_nargs(mvrt_opcode_t op);
 
+/* Returns the number of values the given operator pushes to the stack, 
+   or -1 if the operator is not supported by the evaluator. */
+extern int mvrt_opcode_nrets(mvrt_opcode_t op);
+
 /* Returns the opcode tag for the given string. If it's not a valid
-   opcode, returns -1.  */
+   opcode or is a superinstruction, returns -1.  */
 extern int mvrt_opcode_tag(const char *str);
 
 #endif /* MVRT_OPER_H */
@@ -94,7 +94,8 @@ mvrt_prop_t *mvrt_prop_new(const char *name)
     return NULL;
   }
 
-  obj = mvrt_obj_new(name, NULL);
+  if ((obj = mvrt_obj_new(name, NULL)) == NULL)
+    return NULL;
   obj->tag = MVRT_OBJ_PROP;
   obj->data = (void *) _rtprop_new();
 
@@ -116,7 +117,8 @@ mvrt_prop_t *mvrt_prop_load_str(char *line)
     return NULL;
   }
 
-  obj = mvrt_obj_new(name, NULL);
+  if ((obj = mvrt_obj_new(name, NULL)) == NULL)
+    return NULL;
   obj->tag = MVRT_OBJ_PROP;
   obj->data = (void *) rtprop;
 
@@ -5,6 +5,7 @@
 #include <stdlib.h>      /* malloc */
 #include <string.h>      /* strstr, strdup */
 #include <assert.h>      /* assert */
+#include <pthread.h>     /* pthread_mutex_lock */
 #include "rtcode.h"      /* mvrt_code_t */
 #include "rtevent.h"     /* mvrt_event_lookup */
 #include "rtreactor.h"
@@ -13,16 +14,23 @@
 
 typedef struct _rtreactor {
   mvrt_code_t *code;     /* code */
+  mvrt_image_t *img;     /* image with the code not loaded yet, or NULL */
+  size_t off;            /* offset of the code section in img */
 } _rtreactor_t;
 
+/* serializes loading code from images */
+static pthread_mutex_t _rtreactor_lock = PTHREAD_MUTEX_INITIALIZER;
+
 
 static _rtreactor_t *_rtreactor_new();
 static int _rtreactor_delete(_rtreactor_t *p);
+static void _rtreactor_free(void *p);
 static int _rtreactor_token_tag(const char *token);
 static int _rtreactor_parse_nargs(int op);
 static int _rtreactor_tokenize(char *line, char **name);
 static _rtreactor_t *_rtreactor_parse(char *line, FILE *fp, char **name);
 static int _reactor_assoc_tokenize(char *line, char **name, char **reactor);
+static void _rtreactor_materialize(mvrt_obj_t *obj);
 
 _rtreactor_t *_rtreactor_new()
 {
@@ -31,6 +39,8 @@ _rtreactor_t *_rtreactor_new()
     return NULL;
 
   reactor->code = NULL;
+  reactor->img = NULL;
+  reactor->off = 0;
 
   return reactor;
 }
@@ -41,10 +51,16 @@ int _rtreactor_delete(_rtreactor_t *reactor)
     mvrt_code_delete(reactor->code);
   
   free(reactor);
-  
+
   return 0;
 }
 
+/* Deletes a retired reactor. */
+void _rtreactor_free(void *p)
+{
+  _rtreactor_delete((_rtreactor_t *) p);
+}
+
 int _rtreactor_tokenize(char *line, char **name)
 {
   char *token;
@@ -112,6 +128,25 @@ int _reactor_assoc_tokenize(char *line, char **name, char **reactor)
   return 0;
 }
 
+/* Loads the code of the reactor from its image. A reactor whose code
+   fails to load is left without code, and is not tried again. */
+void _rtreactor_materialize(mvrt_obj_t *obj)
+{
+  _rtreactor_t *rtreactor = (_rtreactor_t *) obj->data;
+
+  pthread_mutex_lock(&_rtreactor_lock);
+  if (rtreactor->img) {
+    mvrt_image_t at = *rtreactor->img;
+    at.off = rtreactor->off;
+    mvrt_code_t *code = mvrt_code_load_image(&at);
+    if (!code)
+      fprintf(stderr, "Failed to load code of reactor: %s\n", obj->name);
+    __atomic_store_n(&rtreactor->code, code, __ATOMIC_RELEASE);
+    rtreactor->img = NULL;
+  }
+  pthread_mutex_unlock(&_rtreactor_lock);
+}
+
 /* 
  * Functions for rtreactor API.
  */
@@ -123,7 +158,8 @@ mvrt_reactor_t *mvrt_reactor_new(const char *name)
     return NULL;
   }
 
-  obj = mvrt_obj_new(name, NULL);
+  if ((obj = mvrt_obj_new(name, NULL)) == NULL)
+    return NULL;
   obj->tag = MVRT_OBJ_REACTOR;
   obj->data = (void *) _rtreactor_new();
 
@@ -145,7 +181,10 @@ mvrt_reactor_t *mvrt_reactor_load_str(char *line, FILE *fp)
     return NULL;
   }
 
-  obj = mvrt_obj_new(name, NULL);
+  if ((obj = mvrt_obj_new(name, NULL)) == NULL) {
+    _rtreactor_delete(rtreactor);
+    return NULL;
+  }
   obj->tag = MVRT_OBJ_REACTOR;
   obj->data = (void *) rtreactor;
 
@@ -176,9 +215,62 @@ mvrt_code_t *mvrt_reactor_getcode(mvrt_reactor_t *reactor)
     return NULL;
 
   assert(obj->tag == MVRT_OBJ_REACTOR);
+  /* the code is published with release once built, so that a thread 
+     which sees it sees all of it */
   _rtreactor_t *rtreactor = (_rtreactor_t *) obj->data;
+  mvrt_code_t *code = __atomic_load_n(&rtreactor->code, __ATOMIC_ACQUIRE);
+  if (!code) {
+    _rtreactor_materialize(obj);
+    code = __atomic_load_n(&rtreactor->code, __ATOMIC_ACQUIRE);
+  }
   
-  return rtreactor->code;
+  return code;
+}
+
+mvrt_code_t *mvrt_reactor_peekcode(mvrt_reactor_t *reactor, int *inimage)
+{
+  mvrt_obj_t *obj = (mvrt_obj_t *) reactor;
+  assert(obj->tag == MVRT_OBJ_REACTOR);
+
+  _rtreactor_t *rtreactor = (_rtreactor_t *) obj->data;
+  pthread_mutex_lock(&_rtreactor_lock);
+  mvrt_code_t *code = rtreactor->code;
+  *inimage = rtreactor->img != NULL;
+  pthread_mutex_unlock(&_rtreactor_lock);
+
+  return code;
+}
+
+int mvrt_reactor_addcode(mvrt_reactor_t *reactor, mvrt_code_t *code)
+{
+  mvrt_obj_t *obj = (mvrt_obj_t *) reactor;
+  assert(obj->tag == MVRT_OBJ_REACTOR);
+
+  _rtreactor_t *rtreactor = (_rtreactor_t *) obj->data;
+  if (rtreactor->code || rtreactor->img) {
+    fprintf(stderr, "Reactor already has code: %s.\n", obj->name);
+    return -1;
+  }
+  __atomic_store_n(&rtreactor->code, code, __ATOMIC_RELEASE);
+
+  return 0;
+}
+
+int mvrt_reactor_addimage(mvrt_reactor_t *reactor, mvrt_image_t *img,
+                          size_t off)
+{
+  mvrt_obj_t *obj = (mvrt_obj_t *) reactor;
+  assert(obj->tag == MVRT_OBJ_REACTOR);
+
+  _rtreactor_t *rtreactor = (_rtreactor_t *) obj->data;
+  if (rtreactor->code || rtreactor->img) {
+    fprintf(stderr, "Reactor already has code: %s.\n", obj->name);
+    return -1;
+  }
+  rtreactor->img = img;
+  rtreactor->off = off;
+
+  return 0;
 }
 
 /*
@@ -240,115 +332,288 @@ mvrt_reactor_t *mvrt_reactor_assoc_load_str(char *line)
 }
 
 
-#define MAX_EVENT_REACTOR_TABLE 1001
-typedef struct _event_reactor_assoc {
-  mvrt_event_t *event;                /* event */
-  mvrt_reactor_list_t *head;          /* head of reactor list */
-  mvrt_reactor_list_t *tail;          /* tail of reactor list */
-  struct _event_reactor_assoc *next;  /* assoc chain, in case of collision */
-} _event_reactor_assoc_t;
-static _event_reactor_assoc_t *_event_reactor_table[MAX_EVENT_REACTOR_TABLE];
-
-static _event_reactor_assoc_t  *_event_reactor_assoc_new(mvrt_event_t *ev)
+/* The reactors associated with an event are kept in an array, which is
+   never changed once published: adding or removing a reactor publishes a
+   new copy. Dispatching an event therefore takes no lock. Readers announce
+   themselves in _assoc_readers, and replaced arrays are freed only once 
+   there are no readers, since a reader may still be iterating over one. 
+   Writers are serialized by _assoc_lock. */
+typedef struct _rtassoc {
+  mvrt_reactor_set_t *set;   /* current reactors, or NULL */
+  mv_uint64_t ndispatch;     /* number of times the event was dispatched */
+  mv_uint64_t nrun;          /* number of reactors run for the event */
+  mv_uint64_t ns;            /* total dispatch time */
+  mv_uint64_t maxns;         /* longest dispatch time */
+} _rtassoc_t;
+
+typedef struct _rtretired {
+  void *p;                   /* replaced set, deleted assoc or object */
+  void (*fn)(void *p);       /* frees p: NULL for free() */
+  struct _rtretired *next;
+} _rtretired_t;
+
+static pthread_mutex_t _assoc_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned _assoc_readers = 0;
+static _rtretired_t *_assoc_retired = NULL;
+
+static mvrt_reactor_set_t *_reactor_set_new(size_t n);
+static void _assoc_retire(void *p, void (*fn)(void *p));
+static void _assoc_reclaim();
+static void _assoc_read_begin();
+static void _assoc_read_end();
+static void _assoc_remove_reactor(mvrt_obj_t *obj, void *reactor);
+static void _assoc_report_event(mvrt_obj_t *obj, void *fp);
+
+mvrt_reactor_set_t *_reactor_set_new(size_t n)
 {
-  _event_reactor_assoc_t *assoc = malloc(sizeof(_event_reactor_assoc_t));
-  assoc->event = ev;
-  assoc->head = NULL;
-  assoc->tail = NULL;
-  assoc->next = NULL;
-  return assoc;
+  mvrt_reactor_set_t *set = malloc(sizeof(mvrt_reactor_set_t) 
+                                   + n * sizeof(mvrt_reactor_t *));
+  if (set)
+    set->n = n;
+
+  return set;
 }
 
-static int _event_reactor_table_hash(mvrt_event_t *ev)
+/* Frees p once there are no readers. Call with _assoc_lock held. */
+void _assoc_retire(void *p, void (*fn)(void *p))
 {
-  return (((mv_ptr_t) ev) % MAX_EVENT_REACTOR_TABLE);
+  if (!p)
+    return;
+
+  _rtretired_t *r = malloc(sizeof(_rtretired_t));
+  r->p = p;
+  r->fn = fn;
+  r->next = _assoc_retired;
+  __atomic_store_n(&_assoc_retired, r, __ATOMIC_SEQ_CST);
+  _assoc_reclaim();
 }
 
-static mvrt_reactor_list_t *_reactor_list_new()
+/* Frees everything retired so far, if there are no readers. Any reader 
+   which comes later finds only the current sets. Call with _assoc_lock 
+   held. */
+void _assoc_reclaim()
 {
-  mvrt_reactor_list_t *reactor_list = malloc(sizeof(mvrt_reactor_list_t));
-  reactor_list->reactor = NULL;
-  reactor_list->next = NULL;
+  if (__atomic_load_n(&_assoc_readers, __ATOMIC_SEQ_CST) != 0)
+    return;
+
+  _rtretired_t *r = _assoc_retired;
+  __atomic_store_n(&_assoc_retired, NULL, __ATOMIC_SEQ_CST);
+  while (r) {
+    _rtretired_t *next = r->next;
+    if (r->fn)
+      r->fn(r->p);
+    else
+      free(r->p);
+    free(r);
+    r = next;
+  }
+}
 
-  return reactor_list;
+void _assoc_read_begin()
+{
+  __atomic_add_fetch(&_assoc_readers, 1, __ATOMIC_SEQ_CST);
 }
 
-int mvrt_add_reactor_to_event(mvrt_event_t *ev, mvrt_reactor_t *react)
+/* The last reader out frees what was retired while it was reading, unless
+   a writer is busy, in which case the writer will. */
+void _assoc_read_end()
 {
-  int hash = _event_reactor_table_hash(ev);
-  _event_reactor_assoc_t *assoc = _event_reactor_table[hash];
-  while (assoc) {
-    if (assoc->event == ev)
-      break; 
-    assoc = assoc->next;
+  if (__atomic_sub_fetch(&_assoc_readers, 1, __ATOMIC_SEQ_CST) == 0
+      && __atomic_load_n(&_assoc_retired, __ATOMIC_SEQ_CST)
+      && pthread_mutex_trylock(&_assoc_lock) == 0) {
+    _assoc_reclaim();
+    pthread_mutex_unlock(&_assoc_lock);
   }
+}
 
+void _assoc_remove_reactor(mvrt_obj_t *obj, void *reactor)
+{
+  mvrt_remove_reactor_from_event((mvrt_event_t *) obj, reactor);
+}
+
+void _assoc_report_event(mvrt_obj_t *obj, void *fp)
+{
+  mv_uint64_t n = 0, ndispatch = 0, nrun = 0, ns = 0, maxns = 0;
+
+  _assoc_read_begin();
+  _rtassoc_t *assoc = __atomic_load_n(&obj->assoc, __ATOMIC_SEQ_CST);
   if (assoc) {
-    if (assoc->event == ev) {
-      /* assoc for the given event found */
-      mvrt_reactor_list_t *entry = _reactor_list_new();
-      entry->reactor = react;
-      if (!assoc->head) {
-        assoc->head = entry;
-        assoc->tail = entry;
-      }
-      else {
-        assoc->tail->next = entry;
-        assoc->tail = entry;
-      }
-    }
-    else {
-      /* there are assoc for other events but not for this event */
-      _event_reactor_assoc_t *nassoc = _event_reactor_assoc_new(ev);
-      mvrt_reactor_list_t *entry = _reactor_list_new();
-      entry->reactor = react;
-      assoc->head = entry;
-      assoc->tail = entry;
-      assoc->next = nassoc;
-    }
-  }
-  else {
-    /* no assoc at all at this hash address */
-    assoc = _event_reactor_assoc_new(ev);
-    mvrt_reactor_list_t *entry = _reactor_list_new();
-    entry->reactor = react;
-    assoc->head = entry;
-    assoc->tail = entry;
-    _event_reactor_table[hash] = assoc;
+    mvrt_reactor_set_t *set = __atomic_load_n(&assoc->set, __ATOMIC_SEQ_CST);
+    n = set ? set->n : 0;
+    ndispatch = __atomic_load_n(&assoc->ndispatch, __ATOMIC_RELAXED);
+    nrun = __atomic_load_n(&assoc->nrun, __ATOMIC_RELAXED);
+    ns = __atomic_load_n(&assoc->ns, __ATOMIC_RELAXED);
+    maxns = __atomic_load_n(&assoc->maxns, __ATOMIC_RELAXED);
   }
+  _assoc_read_end();
+  if (!assoc)
+    return;
+
+  char name[64];
+  snprintf(name, sizeof(name), "%s%s%s", obj->dev ? obj->dev : "", 
+           obj->dev ? ":" : "", obj->name);
+  fprintf((FILE *) fp, "%-32s %8lu %10lu %10lu %8.2f %10.1f %10.1f\n", name,
+          (unsigned long) n, (unsigned long) ndispatch, (unsigned long) nrun,
+          ndispatch ? (double) nrun / ndispatch : 0.0,
+          ndispatch ? ns / 1e3 / ndispatch : 0.0, maxns / 1e3);
+}
+
+int mvrt_reactor_delete(mvrt_reactor_t *reactor)
+{
+  mvrt_obj_t *obj = (mvrt_obj_t *) reactor;
+  if (!obj)
+    return -1;
+
+  mvrt_obj_foreach(MVRT_OBJ_EVENT, _assoc_remove_reactor, reactor);
+
+  /* a scheduler thread may still be running it from a set it holds, so 
+     its code is freed only once no set is held, as the object is */
+  _rtreactor_t *rtreactor = (_rtreactor_t *) obj->data;
+  if (mvrt_obj_delete(obj) == -1)
+    return -1;
+  mvrt_reactor_retire(rtreactor, _rtreactor_free);
 
   return 0;
 }
 
-int mvrt_remove_reactor_from_event(mvrt_event_t *ev, mvrt_reactor_t *react)
+int mvrt_add_reactor_to_event(mvrt_event_t *ev, mvrt_reactor_t *react)
 {
-  return 0;
+  mvrt_obj_t *obj = (mvrt_obj_t *) ev;
+  int retval = 0;
+
+  pthread_mutex_lock(&_assoc_lock);
+  _rtassoc_t *assoc = (_rtassoc_t *) obj->assoc;
+  if (!assoc) {
+    if ((assoc = calloc(1, sizeof(_rtassoc_t))) == NULL) {
+      retval = -1;
+      goto out;
+    }
+    __atomic_store_n(&obj->assoc, assoc, __ATOMIC_SEQ_CST);
+  }
+
+  mvrt_reactor_set_t *old = assoc->set;
+  size_t n = old ? old->n : 0;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    if (old->reactors[i] == react)
+      goto out;
+  }
+
+  mvrt_reactor_set_t *set;
+  if ((set = _reactor_set_new(n + 1)) == NULL) {
+    retval = -1;
+    goto out;
+  }
+  if (n > 0)
+    memcpy(set->reactors, old->reactors, n * sizeof(mvrt_reactor_t *));
+  set->reactors[n] = react;
+
+  __atomic_store_n(&assoc->set, set, __ATOMIC_SEQ_CST);
+  _assoc_retire(old, NULL);
+
+ out:
+  pthread_mutex_unlock(&_assoc_lock);
+  return retval;
 }
 
-mvrt_reactor_list_t *mvrt_get_reactors_for_event(mvrt_event_t *ev)
+int mvrt_remove_reactor_from_event(mvrt_event_t *ev, mvrt_reactor_t *react)
 {
-  int hash = _event_reactor_table_hash(ev);
-  _event_reactor_assoc_t *assoc = _event_reactor_table[hash];
-  while (assoc) {
-    if (assoc->event == ev)
-      break; 
-    assoc = assoc->next;
+  mvrt_obj_t *obj = (mvrt_obj_t *) ev;
+  int retval = -1;
+
+  pthread_mutex_lock(&_assoc_lock);
+  _rtassoc_t *assoc = (_rtassoc_t *) obj->assoc;
+  if (!assoc)
+    goto out;
+
+  if (!react) {
+    /* all of them, and the assoc itself */
+    __atomic_store_n(&obj->assoc, NULL, __ATOMIC_SEQ_CST);
+    _assoc_retire(assoc->set, NULL);
+    _assoc_retire(assoc, NULL);
+    retval = 0;
+    goto out;
   }
 
-  if (assoc) {
-    if (assoc->event == ev) {
-      /* assoc for the given event found */
-      return assoc->head;
-    }
-    else {
-      /* there are assoc for other events but not for this event */
-      return NULL;
+  mvrt_reactor_set_t *old = assoc->set;
+  size_t n = old ? old->n : 0;
+  size_t i, j;
+  for (i = 0; i < n && old->reactors[i] != react; i++)
+    ;
+  if (i == n)
+    goto out;
+
+  mvrt_reactor_set_t *set = NULL;
+  if (n > 1) {
+    if ((set = _reactor_set_new(n - 1)) == NULL)
+      goto out;
+    for (i = 0, j = 0; i < n; i++) {
+      if (old->reactors[i] != react)
+        set->reactors[j++] = old->reactors[i];
     }
   }
-  else {
-    /* no assoc at all at this hash address */
-    return NULL;
+
+  __atomic_store_n(&assoc->set, set, __ATOMIC_SEQ_CST);
+  _assoc_retire(old, NULL);
+  retval = 0;
+
+ out:
+  pthread_mutex_unlock(&_assoc_lock);
+  return retval;
+}
+
+mvrt_reactor_set_t *mvrt_get_reactors_for_event(mvrt_event_t *ev)
+{
+  mvrt_obj_t *obj = (mvrt_obj_t *) ev;
+
+  _assoc_read_begin();
+  _rtassoc_t *assoc = __atomic_load_n(&obj->assoc, __ATOMIC_SEQ_CST);
+  mvrt_reactor_set_t *set = 
+    assoc ? __atomic_load_n(&assoc->set, __ATOMIC_SEQ_CST) : NULL;
+  if (!set)
+    _assoc_read_end();
+
+  return set;
+}
+
+void mvrt_reactor_set_release(mvrt_reactor_set_t *set)
+{
+  if (set)
+    _assoc_read_end();
+}
+
+void mvrt_reactor_retire(void *p, void (*fn)(void *p))
+{
+  pthread_mutex_lock(&_assoc_lock);
+  _assoc_retire(p, fn);
+  pthread_mutex_unlock(&_assoc_lock);
+}
+
+void mvrt_reactor_note_dispatch(mvrt_event_t *ev, size_t nrun, 
+                                mv_uint64_t ns)
+{
+  mvrt_obj_t *obj = (mvrt_obj_t *) ev;
+
+  _assoc_read_begin();
+  _rtassoc_t *assoc = __atomic_load_n(&obj->assoc, __ATOMIC_SEQ_CST);
+  if (assoc) {
+    __atomic_add_fetch(&assoc->ndispatch, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&assoc->nrun, nrun, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&assoc->ns, ns, __ATOMIC_RELAXED);
+
+    mv_uint64_t maxns = __atomic_load_n(&assoc->maxns, __ATOMIC_RELAXED);
+    while (ns > maxns 
+           && !__atomic_compare_exchange_n(&assoc->maxns, &maxns, ns, 0,
+                                           __ATOMIC_RELAXED, 
+                                           __ATOMIC_RELAXED))
+      ;
   }
+  _assoc_read_end();
+}
 
-  return NULL;
+void mvrt_reactor_dispatch_report(FILE *fp)
+{
+  fprintf(fp, "%-32s %8s %10s %10s %8s %10s %10s\n", "event", "reactors", 
+          "dispatch", "runs", "fan-out", "avg (us)", "max (us)");
+  mvrt_obj_foreach(MVRT_OBJ_EVENT, _assoc_report_event, fp);
 }
@@ -15,11 +15,12 @@
 /* Opaque pointer to reactors. */
 typedef void mvrt_reactor_t;
 
-/* Reactor list. */
-typedef struct mvrt_reactor_list {
-  mvrt_reactor_t *reactor;
-  struct mvrt_reactor_list *next;
-} mvrt_reactor_list_t;
+/* Reactors associated with an event. A set is never changed once it is 
+   returned: adding or removing reactors makes a new set. */
+typedef struct mvrt_reactor_set {
+  size_t n;                       /* number of reactors */
+  mvrt_reactor_t *reactors[];     /* reactors, in the order added */
+} mvrt_reactor_set_t;
 
 
 /*
@@ -36,11 +37,27 @@ extern mvrt_reactor_t *mvrt_reactor_load_str(char *line, FILE *fp);
 /* Prints a reactor into a string which can be saved to a file. */
 extern char *mvrt_reactor_save_str(mvrt_reactor_t *reactor);
 
+/* Removes the reactor from all events, and deletes it. The reactor must 
+   not be running. */
 extern int mvrt_reactor_delete(mvrt_reactor_t *reactor);
 
+/* Returns the code of the reactor, loading it from its image first if 
+   needed. Returns NULL if the reactor has no code. */
 extern mvrt_code_t *mvrt_reactor_getcode(mvrt_reactor_t *reactor);
+
+/* Returns the code of the reactor if it is loaded, or NULL, without
+   loading it. Sets *inimage to 1 if the code is still in the image, and
+   to 0 otherwise. */
+extern mvrt_code_t *mvrt_reactor_peekcode(mvrt_reactor_t *reactor,
+                                          int *inimage);
 extern int mvrt_reactor_addcode(mvrt_reactor_t *reactor, mvrt_code_t *code);
 
+/* Sets the code of the reactor to the code section at offset off of the
+   image. The code is loaded and verified when first needed, which is
+   usually when the reactor is first dispatched. */
+extern int mvrt_reactor_addimage(mvrt_reactor_t *reactor, mvrt_image_t *img,
+                                 size_t off);
+
 extern mvrt_reactor_t *mvrt_reactor_lookup(const char *name);
 
 
@@ -49,10 +66,35 @@ extern mvrt_reactor_t *mvrt_reactor_lookup(const char *name);
  */
 extern mvrt_reactor_t *mvrt_reactor_assoc_load_str(char *str);
 
+/* Adds a reactor to the event. Adding a reactor twice has no effect. */
 extern int mvrt_add_reactor_to_event(mvrt_event_t *ev, mvrt_reactor_t *r);
+
+/* Removes a reactor from the event, or all of them if r is NULL. Returns 
+   -1 if the reactor is not associated with the event. */
 extern int mvrt_remove_reactor_from_event(mvrt_event_t *ev, mvrt_reactor_t *r);
 
-extern mvrt_reactor_list_t *mvrt_get_reactors_for_event(mvrt_event_t *ev);
+/* Returns the reactors associated with the event, or NULL if there are 
+   none. Takes no lock. The set stays valid until it is released with 
+   mvrt_reactor_set_release, even if reactors are added or removed in the
+   meantime. Release it soon, since replaced sets are freed only when no 
+   set is held. */
+extern mvrt_reactor_set_t *mvrt_get_reactors_for_event(mvrt_event_t *ev);
+extern void mvrt_reactor_set_release(mvrt_reactor_set_t *set);
+
+/* Frees p with fn, or with free() if fn is NULL, once no set is held. The
+   reactors run while the set of their event is held, so anything they may
+   still use, such as a deleted object, is retired so. */
+extern void mvrt_reactor_retire(void *p, void (*fn)(void *p));
+
+/* Records that the event was dispatched to nrun reactors, in ns 
+   nanoseconds. */
+extern void mvrt_reactor_note_dispatch(mvrt_event_t *ev, size_t nrun, 
+                                       mv_uint64_t ns);
+
+/* Prints, for each event with reactors, the number of reactors, the number
+   of dispatches and reactor runs, the average fan-out, and the average and
+   longest dispatch times. */
+extern void mvrt_reactor_dispatch_report(FILE *fp);
 
 
 #endif /* MVRT_REACTOR_H */
@@ -5,11 +5,12 @@
 #include <stdlib.h>      /* malloc */
 #include <pthread.h>     /* pthread_create */
 #include <signal.h>      /* sigemptyset */
-#include <time.h>        /* nanosleep */
+#include <time.h>        /* nanosleep, clock_gettime */
 #include "rtevent.h"     /* mvrt_event_t */
 #include "rtreactor.h"   /* mvrt_reactor_t */
 #include "rtoper.h"      /* mvrt_operator_t */
 #include "rtevqueue.h"   /* mvrt_evqueue_t */
+#include "rtsub.h"       /* mvrt_publish */
 #include "rtsched.h"
 
 
@@ -51,8 +52,9 @@ void *_sched_thread(void *arg)
   mvrt_eventinst_t *evinst;
   mvrt_event_t *ev;
 
-  mvrt_reactor_list_t *rptr;
-  mvrt_reactor_t *reactor;
+  mvrt_reactor_set_t *set;
+  struct timespec t0, t1;
+  size_t i;
 
   ts.tv_sec = 0;
   ts.tv_nsec = 1000;
@@ -65,16 +67,22 @@ void *_sched_thread(void *arg)
       continue;
 
     ev = evinst->type;
-    rptr = mvrt_get_reactors_for_event(ev);
-    if (!rptr)
+    if (mvrt_sub_any())
+      mvrt_publish(ev, evinst->data);
+
+    set = mvrt_get_reactors_for_event(ev);
+    if (!set)
       continue;
 
-    while (rptr) {
-      reactor = rptr->reactor;
-      _sched_exec_reactor(reactor, evinst);
-      
-      rptr = rptr->next;
-    }
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < set->n; i++)
+      _sched_exec_reactor(set->reactors[i], evinst);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    mvrt_reactor_note_dispatch(ev, set->n, 
+                               (t1.tv_sec - t0.tv_sec) * 1000000000UL
+                               + t1.tv_nsec - t0.tv_nsec);
+    mvrt_reactor_set_release(set);
   }
 
   return NULL;
@@ -0,0 +1,398 @@
+/**
+ * @file rtsub.c
+ */
+#include <stdio.h>       /* fprintf */
+#include <stdlib.h>      /* malloc */
+#include <string.h>      /* strcmp, strdup */
+#include <pthread.h>     /* pthread_rwlock_t */
+#include <mv/device.h>   /* mv_device_lookup_batch */
+#include <mv/hash.h>     /* mv_hash_str */
+#include <mv/message.h>  /* mv_message_send_multi */
+#include "rtobj.h"       /* mvrt_obj_t */
+#include "rtsub.h"
+
+
+/* Comparison ops of filters. */
+enum {
+  _SUB_EQ, _SUB_NE, _SUB_LT, _SUB_LE, _SUB_GT, _SUB_GE
+};
+
+/* A condition of a filter, compiled from its map when subscribed. */
+typedef struct _subpred {
+  mv_value_t key;             /* field of the event value: 0 for itself */
+  int op;                     /* _SUB_EQ, etc. */
+  mv_value_t operand;         /* value compared with */
+} _subpred_t;
+
+typedef struct _sub {
+  char *dev;                  /* subscriber */
+  mv_device_t device;         /* subscriber, for its current address */
+  int npreds;                 /* number of conditions: 0 for no filter */
+  _subpred_t *preds;          /* conditions, which must all hold */
+} _sub_t;
+
+/* Subscribers to an event. */
+typedef struct _subentry {
+  char *event;                /* local event name */
+  mv_uint32_t hash;           /* hash of event */
+  int n;                      /* number of subscribers */
+  int max;                    /* size of subs */
+  _sub_t *subs;               /* subscribers */
+  struct _subentry *next;     /* hash chain */
+} _subentry_t;
+
+/* Subscriptions are changed by the decoder, and read by the scheduler on
+   every local event, under the lock. */
+#define _SUB_BUCKETS  256
+static _subentry_t *_sub_table[_SUB_BUCKETS];
+static int _sub_count = 0;
+static pthread_rwlock_t _sub_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static _subentry_t *_sub_find(const char *event, mv_uint32_t hash);
+static int _sub_compile_pred(mv_value_t cond, _subpred_t *pred);
+static int _sub_compile(mv_value_t filter, _subpred_t **preds);
+static int _sub_compare(mv_value_t lhs, int op, mv_value_t rhs);
+static void _sub_share_keys(_subentry_t *entry, _subpred_t *preds, int n);
+static int _sub_holds(_sub_t *sub, mv_value_t value, mv_value_t *key,
+                      mv_value_t *field);
+
+/* Call with the lock held. */
+_subentry_t *_sub_find(const char *event, mv_uint32_t hash)
+{
+  _subentry_t *entry = _sub_table[hash % _SUB_BUCKETS];
+  while (entry && (entry->hash != hash || strcmp(entry->event, event)))
+    entry = entry->next;
+
+  return entry;
+}
+
+int _sub_compile_pred(mv_value_t cond, _subpred_t *pred)
+{
+  if (mv_value_tag(cond) != MV_VALUE_MAP) {
+    fprintf(stderr, "Subscription filter must be a map.\n");
+    return -1;
+  }
+
+  mv_value_t field_v = mv_value_map_lookup(cond, mv_value_string("field"));
+  mv_value_t op_v = mv_value_map_lookup(cond, mv_value_string("op"));
+  mv_value_t operand_v = mv_value_map_lookup(cond, mv_value_string("value"));
+  if (mv_value_tag(op_v) != MV_VALUE_STRING || mv_value_is_null(operand_v)) {
+    fprintf(stderr, "Subscription filter needs \"op\" and \"value\".\n");
+    return -1;
+  }
+
+  static const char *ops[] = { "==", "!=", "<", "<=", ">", ">=" };
+  const char *op_s = mv_value_string_get(op_v);
+  int op;
+  for (op = _SUB_EQ; op <= _SUB_GE; op++) {
+    if (!strcmp(op_s, ops[op]))
+      break;
+  }
+  if (op > _SUB_GE) {
+    fprintf(stderr, "Subscription filter op not recognized: %s\n", op_s);
+    return -1;
+  }
+
+  pred->key = (mv_value_tag(field_v) == MV_VALUE_STRING) ? field_v : 0;
+  pred->op = op;
+  pred->operand = operand_v;
+
+  return 0;
+}
+
+/* Compiles the filter into conditions. Returns the number of conditions,
+   or -1 on failure. */
+int _sub_compile(mv_value_t filter, _subpred_t **preds)
+{
+  *preds = NULL;
+  if (MV_VALUE_INVALID(filter) || mv_value_is_null(filter))
+    return 0;
+
+  if (mv_value_tag(filter) == MV_VALUE_MAP) {
+    *preds = malloc(sizeof(_subpred_t));
+    if (_sub_compile_pred(filter, *preds) == -1) {
+      free(*preds);
+      *preds = NULL;
+      return -1;
+    }
+    return 1;
+  }
+
+  if (mv_value_tag(filter) != MV_VALUE_CONS) {
+    fprintf(stderr, "Subscription filter must be a map or a list.\n");
+    return -1;
+  }
+
+  int n = 0;
+  mv_value_t cons;
+  for (cons = filter; mv_value_tag(cons) == MV_VALUE_CONS;
+       cons = mv_value_cons_cdr(cons))
+    n++;
+
+  *preds = malloc((n ? n : 1) * sizeof(_subpred_t));
+  int i = 0;
+  for (cons = filter; i < n; cons = mv_value_cons_cdr(cons), i++) {
+    if (_sub_compile_pred(mv_value_cons_car(cons), *preds + i) == -1) {
+      free(*preds);
+      *preds = NULL;
+      return -1;
+    }
+  }
+
+  return n;
+}
+
+int _sub_compare(mv_value_t lhs, int op, mv_value_t rhs)
+{
+  mv_vtag_t ltag = mv_value_tag(lhs);
+  mv_vtag_t rtag = mv_value_tag(rhs);
+  int cmp;
+
+  if ((ltag == MV_VALUE_INT || ltag == MV_VALUE_FLOAT)
+      && (rtag == MV_VALUE_INT || rtag == MV_VALUE_FLOAT)) {
+    if (ltag == MV_VALUE_INT && rtag == MV_VALUE_INT) {
+      int l = mv_value_int_get(lhs);
+      int r = mv_value_int_get(rhs);
+      cmp = (l > r) - (l < r);
+    }
+    else {
+      /* in double, as in the reactors; in float, and with an int and a
+         float operand to ?:, the int is rounded to float */
+      double l = (ltag == MV_VALUE_INT) ?
+        (double) mv_value_int_get(lhs) : (double) mv_value_float_get(lhs);
+      double r = (rtag == MV_VALUE_INT) ?
+        (double) mv_value_int_get(rhs) : (double) mv_value_float_get(rhs);
+      cmp = (l > r) - (l < r);
+    }
+  }
+  else if (ltag == MV_VALUE_STRING && rtag == MV_VALUE_STRING) {
+    cmp = strcmp(mv_value_string_get(lhs), mv_value_string_get(rhs));
+  }
+  else {
+    return 0;
+  }
+
+  switch (op) {
+  case _SUB_EQ: return cmp == 0;
+  case _SUB_NE: return cmp != 0;
+  case _SUB_LT: return cmp < 0;
+  case _SUB_LE: return cmp <= 0;
+  case _SUB_GT: return cmp > 0;
+  case _SUB_GE: return cmp >= 0;
+  }
+
+  return 0;
+}
+
+/* Makes the conditions use the same key value as the other subscribers
+   for the same field, so that a field is looked up once per occurrence
+   while most subscribers filter on it. Call with the write lock held. */
+void _sub_share_keys(_subentry_t *entry, _subpred_t *preds, int n)
+{
+  int i, j, k;
+  for (k = 0; k < n; k++) {
+    if (!preds[k].key)
+      continue;
+    const char *key_s = mv_value_string_get(preds[k].key);
+    for (i = 0; i < entry->n; i++) {
+      _sub_t *sub = entry->subs + i;
+      for (j = 0; j < sub->npreds; j++) {
+        if (sub->preds[j].key
+            && !strcmp(mv_value_string_get(sub->preds[j].key), key_s)) {
+          preds[k].key = sub->preds[j].key;
+          goto next;
+        }
+      }
+    }
+  next:
+    ;
+  }
+}
+
+/* Returns 1 if the subscriber's filter holds. The field last looked up
+   is kept in key and field. */
+int _sub_holds(_sub_t *sub, mv_value_t value, mv_value_t *key,
+               mv_value_t *field)
+{
+  int i;
+  for (i = 0; i < sub->npreds; i++) {
+    _subpred_t *pred = sub->preds + i;
+    mv_value_t lhs = value;
+    if (pred->key) {
+      if (mv_value_tag(value) != MV_VALUE_MAP)
+        return 0;
+      if (pred->key != *key) {
+        *key = pred->key;
+        *field = mv_value_map_lookup(value, pred->key);
+      }
+      lhs = *field;
+    }
+    if (!_sub_compare(lhs, pred->op, pred->operand))
+      return 0;
+  }
+
+  return 1;
+}
+
+
+/*
+ * Functions for the subscription API.
+ */
+int mvrt_subscribe(const char *event, const char *dev, mv_value_t filter)
+{
+  if (!mvrt_event_lookup(event, NULL)) {
+    fprintf(stderr, "mvrt_subscribe: No such event: %s\n", event);
+    return -1;
+  }
+
+  /* a new subscriber is not cached yet with a directory, so wait for it,
+     on the decoder thread */
+  mv_device_t device;
+  mv_device_lookup_batch(&dev, 1, &device);
+  if (MV_DEVICE_INVALID(device)) {
+    fprintf(stderr, "mvrt_subscribe: No such device: %s\n", dev);
+    return -1;
+  }
+
+  _subpred_t *preds;
+  int npreds = _sub_compile(filter, &preds);
+  if (npreds == -1)
+    return -1;
+
+  mv_uint32_t hash = mv_hash_str(event);
+  pthread_rwlock_wrlock(&_sub_lock);
+  _subentry_t *entry = _sub_find(event, hash);
+  if (!entry) {
+    entry = calloc(1, sizeof(_subentry_t));
+    entry->event = strdup(event);
+    entry->hash = hash;
+    entry->next = _sub_table[hash % _SUB_BUCKETS];
+    _sub_table[hash % _SUB_BUCKETS] = entry;
+  }
+
+  int i;
+  for (i = 0; i < entry->n; i++) {
+    if (!strcmp(entry->subs[i].dev, dev))
+      break;
+  }
+  if (i == entry->n) {
+    if (entry->n == entry->max) {
+      entry->max = entry->max ? entry->max * 2 : 4;
+      entry->subs = realloc(entry->subs, entry->max * sizeof(_sub_t));
+    }
+    entry->subs[i].dev = strdup(dev);
+    entry->subs[i].preds = NULL;
+    entry->n++;
+    __atomic_add_fetch(&_sub_count, 1, __ATOMIC_RELAXED);
+  }
+  free(entry->subs[i].preds);
+  entry->subs[i].npreds = 0;
+  _sub_share_keys(entry, preds, npreds);
+  entry->subs[i].device = device;
+  entry->subs[i].npreds = npreds;
+  entry->subs[i].preds = preds;
+  pthread_rwlock_unlock(&_sub_lock);
+
+  return 0;
+}
+
+int mvrt_unsubscribe(const char *event, const char *dev)
+{
+  int retval = -1;
+
+  pthread_rwlock_wrlock(&_sub_lock);
+  _subentry_t *entry = _sub_find(event, mv_hash_str(event));
+  int i;
+  for (i = 0; entry && i < entry->n; i++) {
+    if (strcmp(entry->subs[i].dev, dev))
+      continue;
+
+    free(entry->subs[i].dev);
+    free(entry->subs[i].preds);
+    entry->subs[i] = entry->subs[--entry->n];
+    __atomic_sub_fetch(&_sub_count, 1, __ATOMIC_RELAXED);
+    retval = 0;
+    break;
+  }
+  pthread_rwlock_unlock(&_sub_lock);
+
+  if (retval == -1)
+    fprintf(stderr, "mvrt_unsubscribe: %s does not subscribe to %s\n",
+            dev, event);
+  return retval;
+}
+
+int mvrt_sub_match(mvrt_event_t *ev, mv_value_t value, const char **addrs,
+                   int max)
+{
+  mvrt_obj_t *obj = (mvrt_obj_t *) ev;
+  int n = 0;
+
+  if (obj->dev || !mvrt_sub_any())
+    return 0;
+
+  mv_value_t key = 0;
+  mv_value_t field = 0;
+  pthread_rwlock_rdlock(&_sub_lock);
+  _subentry_t *entry = _sub_find(obj->name, mv_hash_str(obj->name));
+  int i;
+  for (i = 0; entry && i < entry->n; i++) {
+    _sub_t *sub = entry->subs + i;
+    if (!_sub_holds(sub, value, &key, &field))
+      continue;
+
+    if (n < max)
+      addrs[n] = mv_addr_str(mv_device_addr(sub->device));
+    n++;
+  }
+  pthread_rwlock_unlock(&_sub_lock);
+
+  return n;
+}
+
+#define _SUB_MAX_LOCAL  64
+int mvrt_publish(mvrt_event_t *ev, mv_value_t value)
+{
+  const char *local[_SUB_MAX_LOCAL];
+  const char **addrs = local;
+  int max = _SUB_MAX_LOCAL;
+  int n;
+
+  while ((n = mvrt_sub_match(ev, value, addrs, max)) > max) {
+    if (addrs != local)
+      free(addrs);
+    max = n * 2;
+    addrs = malloc(max * sizeof(char *));
+  }
+
+  int retval = 0;
+  if (n > 0) {
+    /* serialized once, whatever the number of subscribers */
+    mv_device_t self = mv_device_self();
+    const char *name_s = ((mvrt_obj_t *) ev)->name;
+    const char *self_s = MV_DEVICE_INVALID(self) ? "" : mv_device_name(self);
+    char *value_s = mv_value_to_str(value);
+    if (!value_s) {
+      fprintf(stderr, "Failed to serialize event: %s\n", name_s);
+      if (addrs != local)
+        free(addrs);
+      return -1;
+    }
+    size_t sz = strlen(name_s) + strlen(self_s) + strlen(value_s) + 64;
+    char *arg = malloc(sz);
+    snprintf(arg, sz, "{\"name\":\"%s\", \"dev\":\"%s\", \"value\":%s}",
+             name_s, self_s, value_s);
+    retval = mv_message_send_multi(addrs, n, MV_MESSAGE_EVENT_OCCUR, arg);
+    free(arg);
+    free(value_s);
+  }
+
+  if (addrs != local)
+    free(addrs);
+  return retval;
+}
+
+int mvrt_sub_any()
+{
+  return __atomic_load_n(&_sub_count, __ATOMIC_RELAXED) > 0;
+}
@@ -0,0 +1,43 @@
+/**
+ * @file rtsub.h
+ *
+ * @brief Interface to event subscriptions. Other devices subscribe to
+ * local events, and are sent each occurrence which passes their filter.
+ */
+#ifndef MVRT_SUB_H
+#define MVRT_SUB_H
+
+#include <mv/value.h>       /* mv_value_t */
+#include "rtevent.h"        /* mvrt_event_t */
+
+
+/* Subscribes the device to the local event. The filter is null, a map
+
+     { "field": "celsius", "op": ">", "value": 30 }
+
+   or a list of such maps, which must all hold for an occurrence to be
+   sent. The field of the event value, or the value itself if there is no
+   field, is compared with the value by the op: ==, !=, <, <=, > or >=.
+   Subscribing again replaces the filter. Returns -1 if the event or the
+   device is not known, or the filter is none of these, and 0 otherwise.
+   Waits for the directory to reply about a device not cached yet. */
+extern int mvrt_subscribe(const char *event, const char *dev,
+                          mv_value_t filter);
+extern int mvrt_unsubscribe(const char *event, const char *dev);
+
+/* Finds the subscribers to the event whose filters hold for the value,
+   and puts up to max of their addresses to addrs. Returns the number of
+   subscribers found, which may be more than max. */
+extern int mvrt_sub_match(mvrt_event_t *ev, mv_value_t value,
+                          const char **addrs, int max);
+
+/* Sends an occurrence of the local event to its subscribers, if their
+   filters hold. The message is serialized once for all of them. Returns
+   the number of messages sent, or -1 on failure. */
+extern int mvrt_publish(mvrt_event_t *ev, mv_value_t value);
+
+/* Returns 1 if any device subscribes to any event. */
+extern int mvrt_sub_any();
+
+
+#endif /* MVRT_SUB_H */
@@ -4,7 +4,7 @@
 #include <stdio.h>        /* fprintf */
 #include <stdlib.h>       /* exit */
 #include <string.h>       /* strchr */
-#include <mv/device.h>    /* mv_device_addr */
+#include <mv/device.h>    /* mv_device_addrstr */
 #include <mv/value.h>     /* mv_value_t */
 #include <mv/message.h>   /* mv_message_send */
 #include "sh_command.h"
@@ -59,7 +59,13 @@ static int _command_prop_get(char *arg0)
   char *dev = strdup(arg0);
   *charp = save;
 
-  const char *destaddr = mv_device_addr(dev);
+  const char *destaddr = mv_device_addrstr(dev);
+  if (!destaddr) {
+    fprintf(stdout, "No such device: %s\n", dev);
+    free(prop);
+    free(dev);
+    return -1;
+  }
 
   char arg[4096];
   sprintf(arg, "{\"name\":\"%s\", \"retid\":0, \"retaddr\": \"%s\"}",
@@ -101,7 +107,13 @@ static int _command_prop_set(char *arg0, char *arg1)
   char *dev = strdup(arg0);
   *charp = save;
 
-  const char *destaddr = mv_device_addr(dev);
+  const char *destaddr = mv_device_addrstr(dev);
+  if (!destaddr) {
+    fprintf(stdout, "No such device: %s\n", dev);
+    free(prop);
+    free(dev);
+    return -1;
+  }
 
   char arg[4096];
   sprintf(arg, "{\"name\":\"%s\", \"value\":%s}", prop, arg1);
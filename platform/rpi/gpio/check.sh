@@ -0,0 +1,60 @@
+#!/bin/sh
+#
+# Runs test and test_batch against a fake sysfs GPIO tree under a temporary
+# directory, and checks what they read and wrote.
+
+root=$(mktemp -d) || exit 1
+trap 'rm -rf "$root"' EXIT
+
+nfailed=0
+
+# expect what got: fails if they differ
+expect() {
+  if [ "$2" != "$3" ]; then
+    echo "FAILED: $1: expected \"$2\", got \"$3\""
+    nfailed=$((nfailed + 1))
+  fi
+}
+
+# gpioN/direction starts empty, since writes do not truncate it as sysfs
+# does; gpioN/value holds the given value
+fake() {
+  touch "$root/export" "$root/unexport"
+  rm -rf "$root/gpio$1"
+  mkdir "$root/gpio$1"
+  : > "$root/gpio$1/direction"
+  echo "$2" > "$root/gpio$1/value"
+}
+
+# test reads 1 from gpio24 three times, and turns the led on gpio4 off once
+fake 24 1
+fake 4 1
+out=$(./test "$root" 2>&1)
+expect "test reads" 3 "$(echo "$out" | grep -c "I'm reading 1 in GPIO 24")"
+expect "test led" "Led off" "$(echo "$out" | grep Led)"
+expect "gpio24 direction" in "$(cat "$root/gpio24/direction")"
+expect "gpio4 direction" out "$(cat "$root/gpio4/direction")"
+expect "gpio4 value" 0 "$(head -c 1 "$root/gpio4/value")"
+
+# the batch natives succeed as a whole, and give -1 for the pin which fails:
+# gpio30 is a valid pin, but exporting it makes no directory here
+fake 4 0
+fake 17 1
+fake 24 1
+fake 25 0
+rm -rf "$root/gpio30"
+out=$(./test_batch "$root" 2>"$root/stderr")
+expect "put batch" "put 0: 0 0" "$(echo "$out" | grep put)"
+expect "get batch" "get 0: 1 0 -1" "$(echo "$out" | grep get)"
+expect "gpio30 error" "Failed to open gpio direction for writing!" \
+  "$(cat "$root/stderr")"
+expect "gpio4 value" 1 "$(head -c 1 "$root/gpio4/value")"
+expect "gpio17 value" 0 "$(head -c 1 "$root/gpio17/value")"
+expect "gpio17 direction" out "$(cat "$root/gpio17/direction")"
+expect "gpio25 direction" in "$(cat "$root/gpio25/direction")"
+
+if [ $nfailed -ne 0 ]; then
+  echo "$nfailed checks failed"
+  exit 1
+fi
+echo "PASS"
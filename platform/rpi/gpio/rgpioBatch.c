@@ -0,0 +1,38 @@
+#include <mv/value.h>
+#include "rpigpio.h"
+
+/*
+ * Batch natives for the runtime:
+ *
+ *   native gpioGetBatch libgpio.so value[](value[])
+ *   native gpioPutBatch libgpio.so value[](value[])
+ *
+ * Called with call_batch n. Results are stored over the arguments. Both
+ * return 0: a pin which fails gives -1 in its own result, since the 
+ * runtime fails the whole reactor on -1, and the other results with it.
+ */
+
+/* argv[i] is a pin; retv[i] is its value, or -1. */
+int gpioGetBatch(int n, mv_value_t *argv, mv_value_t *retv)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    retv[i] = mv_value_int(GPIORead(mv_value_int_get(argv[i])));
+
+  return 0;
+}
+
+/* argv[i] is a pair of a pin and its value; retv[i] is 0, or -1. */
+int gpioPutBatch(int n, mv_value_t *argv, mv_value_t *retv)
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    int pin = mv_value_int_get(mv_value_pair_first(argv[i]));
+    int value = mv_value_int_get(mv_value_pair_second(argv[i]));
+    retv[i] = mv_value_int(GPIOWrite(pin, value));
+  }
+
+  return 0;
+}
@@ -1,21 +1,128 @@
+#include <string.h>
 #include "rpigpio.h"
 
+#define PATH_MAX_LEN 256
+
+/* Root of the GPIO sysfs tree. Set to a directory with the same layout
+   for testing without GPIO hardware, with GPIOSetRoot or by the 
+   RPIGPIO_ROOT environment variable. */
+static char gpio_root[PATH_MAX_LEN] = "/sys/class/gpio";
+static int gpio_root_set = 0;
+
+/* Open value files, kept across calls: fd + 1, or 0 if not open. */
+static int gpio_fd[GPIO_MAX_PINS];
+
+/* Direction each value file was opened for. */
+static int gpio_dir[GPIO_MAX_PINS];
+
+static int
+gpio_path(char *path, const char *file, int pin)
+{
+  int n;
+
+  if (!gpio_root_set) {
+    const char *env = getenv("RPIGPIO_ROOT");
+    if (env && strlen(env) < PATH_MAX_LEN)
+      strcpy(gpio_root, env);
+    gpio_root_set = 1;
+  }
+
+  if (pin < 0)
+    n = snprintf(path, PATH_MAX_LEN, "%s/%s", gpio_root, file);
+  else
+    n = snprintf(path, PATH_MAX_LEN, "%s/gpio%d/%s", gpio_root, pin, file);
+
+  return (n < PATH_MAX_LEN) ? 0 : -1;
+}
+
+/* Returns the value file of the pin, set for the given direction. The pin
+   is exported and its value file opened on first use only. */
+static int
+gpio_value_fd(int pin, int dir)
+{
+  char path[PATH_MAX_LEN];
+  int fd;
+
+  if (pin < 0 || pin >= GPIO_MAX_PINS) {
+    fprintf(stderr, "Invalid gpio pin %d!\n", pin);
+    return(-1);
+  }
+
+  if (gpio_fd[pin] && gpio_dir[pin] == dir)
+    return gpio_fd[pin] - 1;
+
+  if (!gpio_fd[pin]) {
+    struct stat st;
+    if (gpio_path(path, "", pin) == -1)
+      return(-1);
+    if (stat(path, &st) == -1 && GPIOExport(pin) == -1)
+      return(-1);
+  }
+
+  if (GPIODirection(pin, dir) == -1)
+    return(-1);
+
+  if (!gpio_fd[pin]) {
+    if (gpio_path(path, "value", pin) == -1)
+      return(-1);
+    fd = open(path, O_RDWR);
+    if (-1 == fd) {
+      fprintf(stderr, "Failed to open gpio value!\n");
+      return(-1);
+    }
+    gpio_fd[pin] = fd + 1;
+  }
+  gpio_dir[pin] = dir;
+
+  return gpio_fd[pin] - 1;
+}
+
+int
+GPIOSetRoot(const char *root)
+{
+  if (strlen(root) >= PATH_MAX_LEN)
+    return(-1);
+
+  GPIOClose();
+  strcpy(gpio_root, root);
+  gpio_root_set = 1;
+  return(0);
+}
+
+void
+GPIOClose(void)
+{
+  int pin;
+
+  for (pin = 0; pin < GPIO_MAX_PINS; pin++) {
+    if (gpio_fd[pin])
+      close(gpio_fd[pin] - 1);
+    gpio_fd[pin] = 0;
+  }
+}
+
 int
 GPIOExport(int pin)
 {
 #define BUFFER_MAX 3
   char buffer[BUFFER_MAX];
+  char path[PATH_MAX_LEN];
   ssize_t bytes_written;
   int fd;
 
-  fd = open("/sys/class/gpio/export", O_WRONLY);
+  if (gpio_path(path, "export", -1) == -1)
+    return(-1);
+  fd = open(path, O_WRONLY);
   if (-1 == fd) {
     fprintf(stderr, "Failed to open export for writing!\n");
     return(-1);
   }
 
   bytes_written = snprintf(buffer, BUFFER_MAX, "%d", pin);
-  write(fd, buffer, bytes_written);
+  if (-1 == write(fd, buffer, bytes_written)) {
+    close(fd);
+    return(-1);
+  }
   close(fd);
   return(0);
 }
@@ -24,17 +131,28 @@ int
 GPIOUnexport(int pin)
 {
   char buffer[BUFFER_MAX];
+  char path[PATH_MAX_LEN];
   ssize_t bytes_written;
   int fd;
 
-  fd = open("/sys/class/gpio/unexport", O_WRONLY);
+  if (pin >= 0 && pin < GPIO_MAX_PINS && gpio_fd[pin]) {
+    close(gpio_fd[pin] - 1);
+    gpio_fd[pin] = 0;
+  }
+
+  if (gpio_path(path, "unexport", -1) == -1)
+    return(-1);
+  fd = open(path, O_WRONLY);
   if (-1 == fd) {
     fprintf(stderr, "Failed to open unexport for writing!\n");
     return(-1);
   }
 
   bytes_written = snprintf(buffer, BUFFER_MAX, "%d", pin);
-  write(fd, buffer, bytes_written);
+  if (-1 == write(fd, buffer, bytes_written)) {
+    close(fd);
+    return(-1);
+  }
   close(fd);
   return(0);
 }
@@ -44,11 +162,11 @@ GPIODirection(int pin, int dir)
 {
   static const char s_directions_str[]  = "in\0out";
 
-#define DIRECTION_MAX 35
-  char path[DIRECTION_MAX];
+  char path[PATH_MAX_LEN];
   int fd;
 
-  snprintf(path, DIRECTION_MAX, "/sys/class/gpio/gpio%d/direction", pin);
+  if (gpio_path(path, "direction", pin) == -1)
+    return(-1);
   fd = open(path, O_WRONLY);
   if (-1 == fd) {
     fprintf(stderr, "Failed to open gpio direction for writing!\n");
@@ -57,6 +175,7 @@ GPIODirection(int pin, int dir)
 
   if (-1 == write(fd, &s_directions_str[IN == dir ? 0 : 3], IN == dir ? 2 : 3)) {
     fprintf(stderr, "Failed to set direction!\n");
+    close(fd);
     return(-1);
   }
 
@@ -67,24 +186,20 @@ GPIODirection(int pin, int dir)
 int
 GPIORead(int pin)
 {
-#define VALUE_MAX 30
-  char path[VALUE_MAX];
-  char value_str[3];
+  char value_str[4];
+  ssize_t n;
   int fd;
 
-  snprintf(path, VALUE_MAX, "/sys/class/gpio/gpio%d/value", pin);
-  fd = open(path, O_RDONLY);
-  if (-1 == fd) {
-    fprintf(stderr, "Failed to open gpio value for reading!\n");
+  if ((fd = gpio_value_fd(pin, IN)) == -1)
     return(-1);
-  }
 
-  if (-1 == read(fd, value_str, 3)) {
+  /* sysfs value files are read from the start every time */
+  n = pread(fd, value_str, 3, 0);
+  if (n <= 0) {
     fprintf(stderr, "Failed to read value!\n");
     return(-1);
   }
-
-  close(fd);
+  value_str[n] = '\0';
 
   return(atoi(value_str));
 }
@@ -94,22 +209,43 @@ GPIOWrite(int pin, int value)
 {
   static const char s_values_str[] = "01";
 
-  char path[VALUE_MAX];
   int fd;
 
-  snprintf(path, VALUE_MAX, "/sys/class/gpio/gpio%d/value", pin);
-  fd = open(path, O_WRONLY);
-  if (-1 == fd) {
-    fprintf(stderr, "Failed to open gpio value for writing!\n");
+  if ((fd = gpio_value_fd(pin, OUT)) == -1)
     return(-1);
-  }
 
-  if (1 != write(fd, &s_values_str[LOW == value ? 0 : 1], 1)) {
+  if (1 != pwrite(fd, &s_values_str[LOW == value ? 0 : 1], 1, 0)) {
     fprintf(stderr, "Failed to write value!\n");
     return(-1);
   }
 
-  close(fd);
   return(0);
 }
 
+int
+GPIOReadBatch(int n, const int *pins, int *values)
+{
+  int retval = 0;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    if ((values[i] = GPIORead(pins[i])) == -1)
+      retval = -1;
+  }
+
+  return retval;
+}
+
+int
+GPIOWriteBatch(int n, const int *pins, const int *values)
+{
+  int retval = 0;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    if (GPIOWrite(pins[i], values[i]) == -1)
+      retval = -1;
+  }
+
+  return retval;
+}
@@ -14,12 +14,27 @@
 #define LOW  0
 #define HIGH 1
 
+#define GPIO_MAX_PINS 64
+
 int GPIOExport(int pin);
 int GPIOUnexport(int pin);
 int GPIODirection(int pin, int dir);
 int GPIORead(int pin);
 int GPIOWrite(int pin, int value);
 
+// Pins are exported and their value files opened on first use, and kept
+// open until GPIOClose or GPIOUnexport.
+void GPIOClose(void);
+
+// Uses a directory laid out like /sys/class/gpio, e.g. a fake one in tests.
+// The RPIGPIO_ROOT environment variable does the same.
+int GPIOSetRoot(const char *root);
+
+// Reads/writes n pins. Returns -1 if any of them fails; a failed read
+// sets its value to -1.
+int GPIOReadBatch(int n, const int *pins, int *values);
+int GPIOWriteBatch(int n, const int *pins, const int *values);
+
 extern int gpioGet(int pin);
 extern void gpioPut(int pout, int value);
 
@@ -3,12 +3,20 @@
 #define PIN  24 /* P1-18 */
 #define POUT 4  /* P1-07 */
 
-int main()
+// Usage: test [root]
+//   root: a directory laid out like /sys/class/gpio, to run without GPIO
+//         hardware. The value of PIN is read from root/gpio24/value.
+int main(int argc, char *argv[])
 {
   int repeat = 120;
   int prev = -1;
   int state = 0;
 
+  if (argc > 1) {
+    GPIOSetRoot(argv[1]);
+    repeat = 2;
+  }
+
   do {
     int now = gpioGet(PIN);
         printf("I'm reading %d in GPIO %d\n", now, PIN);
@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <mv/value.h>
+#include "rpigpio.h"
+
+extern int gpioGetBatch(int n, mv_value_t *argv, mv_value_t *retv);
+extern int gpioPutBatch(int n, mv_value_t *argv, mv_value_t *retv);
+
+// Usage: test_batch root
+//   root: a directory laid out like /sys/class/gpio. Writes 1 to gpio4 and
+//         0 to gpio17, and reads gpio24, gpio25 and gpio30, which has no
+//         directory, so that its read fails. Prints what each call gave.
+int main(int argc, char *argv[])
+{
+  mv_value_t puts[2];
+  mv_value_t gets[3];
+  int rv;
+  int i;
+
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s root\n", argv[0]);
+    return 1;
+  }
+  GPIOSetRoot(argv[1]);
+
+  puts[0] = mv_value_pair(mv_value_int(4), mv_value_int(1));
+  puts[1] = mv_value_pair(mv_value_int(17), mv_value_int(0));
+  rv = gpioPutBatch(2, puts, puts);
+  printf("put %d:", rv);
+  for (i = 0; i < 2; i++)
+    printf(" %d", mv_value_int_get(puts[i]));
+  printf("\n");
+
+  gets[0] = mv_value_int(24);
+  gets[1] = mv_value_int(25);
+  gets[2] = mv_value_int(30);
+  rv = gpioGetBatch(3, gets, gets);
+  printf("get %d:", rv);
+  for (i = 0; i < 3; i++)
+    printf(" %d", mv_value_int_get(gets[i]));
+  printf("\n");
+
+  return 0;
+}
@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# Compiles test.mv with a cost report, and checks the loop bounds and the
+# worst-case costs it gives for each reactor. Run in this directory, after
+# mvc is built.
+
+nfailed=0
+
+# expect what got: fails if they differ
+expect() {
+  if [ "$2" != "$3" ]; then
+    echo "FAILED: $1: expected \"$2\", got \"$3\""
+    nfailed=$((nfailed + 1))
+  fi
+}
+
+# prints the given field of the named reactor in cost.json
+field() {
+  awk -F'"' -v name="$1" -v key="\"$2\":" '
+    /"name":/ { cur = $4 }
+    cur == name && index($0, key) { sub(/^ */, ""); sub(/,$/, ""); print }
+  ' cost.json
+}
+
+rm -f cost.json
+if ! ../mvc -r cost.json test.mv > mvc.log 2>&1; then
+  echo "FAILED: mvc: see mvc.log"
+  exit 1
+fi
+
+# r1: for (i = 0; i < 8; ...) runs 8 times
+expect "r1 loops" '"loops": [{ "header": 1, "bound": 8 }]' "$(field r1 loops)"
+expect "r1 worst" \
+  '"worst": { "instructions": 106, "allocations": 0, "roundtrips": 0, "sends": 0 }' \
+  "$(field r1 worst)"
+
+# r2: i from 10 down by 2 runs 5 times, and j from 0 to 4 inside it 4 times
+expect "r2 loops" \
+  '"loops": [{ "header": 1, "bound": 5 }, { "header": 3, "bound": 4 }]' \
+  "$(field r2 loops)"
+expect "r2 worst" \
+  '"worst": { "instructions": 315, "allocations": 0, "roundtrips": 0, "sends": 0 }' \
+  "$(field r2 worst)"
+
+# r3: i < limit has no bound known at compile time
+expect "r3 loops" '"loops": [{ "header": 1, "bound": null }]' "$(field r3 loops)"
+expect "r3 worst" '"worst": null' "$(field r3 worst)"
+
+if [ $nfailed -ne 0 ]; then
+  echo "$nfailed checks failed"
+  exit 1
+fi
+echo "PASS"